@@ -0,0 +1,64 @@
+#! /usr/bin/perl -w
+#
+# make-queue-contention.pl -- make a queue contention benchmark configuration
+#
+# ./make-queue-contention.pl p c [queue [seconds]]
+#    options: p       - number of producer threads
+#             c       - number of consumer threads
+#             queue   - queue element, with arguments if any; default
+#                       "ThreadSafeQueue(1024)"
+#             seconds - measurement time; default 5
+#    each producer thread pushes 64-byte packets into one shared queue as
+#    fast as it can; each consumer thread pulls from that queue as fast as
+#    it can.  prints the queue's mode, the packets each consumer delivered,
+#    drops, and the total delivery rate in packets per second.
+#
+#    run the result with "click --threads=P+C", for example:
+#    ./make-queue-contention.pl 2 1 'ThreadSafeQueue(1024, MODE CAS)' \
+#        | click --threads=3
+
+if ($#ARGV < 1 || $#ARGV > 3 || $ARGV[0] !~ /^[1-9]\d*$/
+    || $ARGV[1] !~ /^[1-9]\d*$/
+    || (defined($ARGV[3]) && $ARGV[3] !~ /^\d+(\.\d*)?$/)) {
+  print STDERR "usage: make-queue-contention.pl producers consumers [queue [seconds]]\n";
+  exit(1);
+}
+
+my $np = $ARGV[0];
+my $nc = $ARGV[1];
+my $queue = defined($ARGV[2]) ? $ARGV[2] : "ThreadSafeQueue(1024)";
+my $t = defined($ARGV[3]) ? $ARGV[3] : 5;
+
+print "// Generated by make-queue-contention.pl $np $nc '$queue' $t\n";
+print "// Run with click --threads=", $np + $nc, "\n\n";
+
+print "q :: $queue;\n\n";
+
+my @sched;
+for (my $i = 0; $i < $np; $i++) {
+  print "src$i :: InfiniteSource(LENGTH 64, LIMIT -1, BURST 32, STOP false) -> q;\n";
+  push @sched, "src$i $i";
+}
+print "\n";
+for (my $i = 0; $i < $nc; $i++) {
+  print "q -> uq$i :: Unqueue(BURST 32) -> c$i :: Counter -> Discard;\n";
+  push @sched, "uq$i " . ($np + $i);
+}
+print "\nStaticThreadSched(", join(", ", @sched), ");\n\n";
+
+my @counts = map { "\$(c$_.count)" } (0 .. $nc - 1);
+print <<EOF;
+DriverManager(wait 0.5s,
+	write q.reset_counts,
+EOF
+for (my $i = 0; $i < $nc; $i++) {
+  print "\twrite c$i.reset,\n";
+}
+print "\twait ${t}s,\n";
+print "\tprint \"mode \$(q.mode)\",\n";
+for (my $i = 0; $i < $nc; $i++) {
+  print "\tprint \"consumer$i \$(c$i.count)\",\n";
+}
+print "\tprint \"drops \$(q.drops)\",\n";
+print "\tprint \"pps \$(div \$(add ", join(" ", @counts), ") $t)\",\n";
+print "\tstop);\n";
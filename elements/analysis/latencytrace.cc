@@ -0,0 +1,173 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * latencytrace.{cc,hh} -- trace sampled packets' latency through a router
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "latencytrace.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/packet_anno.hh>
+#include <click/latencytracer.hh>
+CLICK_DECLS
+
+LatencyTrace::LatencyTrace()
+    : _tracer(0)
+{
+}
+
+int
+LatencyTrace::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _sample = 100;
+    _anno = PERFCTR_ANNO_OFFSET;
+    _ntraces = 1024;
+    if (Args(conf, this, errh)
+	.read_p("SAMPLE", _sample)
+	.read("ANNO", AnnoArg(4), _anno)
+	.read("TRACES", _ntraces)
+	.read("FILENAME", FilenameArg(), _filename)
+	.complete() < 0)
+	return -1;
+    if (_ntraces == 0 || _ntraces > 0x100000)
+	return errh->error("TRACES out of range");
+    return 0;
+}
+
+int
+LatencyTrace::initialize(ErrorHandler *errh)
+{
+    _tracer = router()->latency_tracer();
+    if (!_tracer) {
+	_tracer = new LatencyTracer(router(), _anno, _ntraces);
+	router()->set_latency_tracer(_tracer);
+    } else if (_tracer->anno() != _anno)
+	return errh->error("ANNO conflicts with another LatencyTrace");
+    _countdown = _sample;
+    _count = 0;
+    return 0;
+}
+
+void
+LatencyTrace::cleanup(CleanupStage)
+{
+    if (_filename && _tracer)
+	(void) write_file(_filename, ErrorHandler::default_handler());
+}
+
+Packet *
+LatencyTrace::simple_action(Packet *p)
+{
+    ++_count;
+    if (_sample && --_countdown == 0) {
+	_countdown = _sample;
+	if (!_tracer->traced(p))
+	    _tracer->begin(this, p);
+    }
+    return p;
+}
+
+int
+LatencyTrace::write_file(const String &filename, ErrorHandler *errh) const
+{
+    FILE *f;
+    if (filename == "-")
+	f = stdout;
+    else
+	f = fopen(filename.c_str(), "w");
+    if (!f)
+	return errh->error("%s: %s", filename.c_str(), strerror(errno));
+
+    StringAccum sa;
+    _tracer->unparse_hops(sa);
+    sa << '\n';
+    _tracer->unparse_traces(sa);
+    ignore_result(fwrite(sa.data(), 1, sa.length(), f));
+
+    bool had_err = ferror(f);
+    if (f != stdout)
+	fclose(f);
+    if (had_err)
+	return errh->error("%s: file error", filename.c_str());
+    return 0;
+}
+
+enum { H_SAMPLE, H_COUNT, H_TRACED, H_HOPS, H_TRACES, H_WRITE_FILE, H_RESET };
+
+String
+LatencyTrace::read_handler(Element *e, void *thunk)
+{
+    LatencyTrace *lt = static_cast<LatencyTrace *>(e);
+    StringAccum sa;
+    switch ((intptr_t) thunk) {
+    case H_SAMPLE:
+	return String(lt->_sample);
+    case H_COUNT:
+	return String(lt->_count);
+    case H_TRACED:
+	return String(lt->_tracer->nstarted());
+    case H_HOPS:
+	lt->_tracer->unparse_hops(sa);
+	break;
+    case H_TRACES:
+	lt->_tracer->unparse_traces(sa);
+	break;
+    }
+    return sa.take_string();
+}
+
+int
+LatencyTrace::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    LatencyTrace *lt = static_cast<LatencyTrace *>(e);
+    switch ((intptr_t) thunk) {
+    case H_SAMPLE: {
+	uint32_t sample;
+	if (!IntArg().parse(str, sample))
+	    return errh->error("syntax error");
+	lt->_sample = lt->_countdown = sample;
+	return 0;
+    }
+    case H_WRITE_FILE: {
+	String filename;
+	if (!FilenameArg().parse(str, filename))
+	    return errh->error("argument should be filename");
+	return lt->write_file(filename, errh);
+    }
+    case H_RESET:
+	lt->_count = 0;
+	lt->_tracer->reset();
+	return 0;
+    default:
+	return 0;
+    }
+}
+
+void
+LatencyTrace::add_handlers()
+{
+    add_read_handler("sample", read_handler, H_SAMPLE);
+    add_write_handler("sample", write_handler, H_SAMPLE);
+    add_read_handler("count", read_handler, H_COUNT);
+    add_read_handler("traced", read_handler, H_TRACED);
+    add_read_handler("hops", read_handler, H_HOPS);
+    add_read_handler("traces", read_handler, H_TRACES);
+    add_write_handler("write_file", write_handler, H_WRITE_FILE);
+    add_write_handler("reset", write_handler, H_RESET, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(LatencyTrace)
@@ -0,0 +1,129 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_LATENCYTRACE_HH
+#define CLICK_LATENCYTRACE_HH
+#include <click/element.hh>
+CLICK_DECLS
+class LatencyTracer;
+
+/*
+=c
+
+LatencyTrace([SAMPLE, I<keywords> ANNO, TRACES, FILENAME])
+
+=s timestamps
+
+traces sampled packets' latency through the router
+
+=d
+
+Starts a latency trace for one in every SAMPLE packets passing through the
+element, then passes all packets unchanged.  Each later push or pull of a
+traced packet records a cycle-counter timestamp, on whatever thread handles
+it, so a trace follows the packet through queues such as ThreadSafeQueue.
+The latencies between consecutive elements along traced paths are
+aggregated into per-element-pair histograms.
+
+Whereas SetTimestamp and TimestampAccum measure end-to-end latency over a
+fixed path, LatencyTrace shows where along the path time is spent.  Any
+number of LatencyTrace elements can start traces; they share one set of
+traces and histograms per router.
+
+A traced packet stores its trace ID in a 4-byte annotation.  Tracing
+continues until the packet dies or until TRACES newer traces have been
+started.  Clones share their parent's trace.  Measurements assume that all
+threads' cycle counters are synchronized.
+
+Keyword arguments are:
+
+=over 8
+
+=item SAMPLE
+
+Unsigned.  Trace one in every SAMPLE packets.  0 means trace no packets.
+Default is 100.
+
+=item ANNO
+
+Annotation offset for the trace ID.  Default is PERFCTR, which is shared
+with SetCycleCount and friends.  All LatencyTrace elements in a router must
+use the same ANNO.
+
+=item TRACES
+
+Unsigned.  The number of recent traces to keep, rounded up to a power of
+two.  Default is 1024.
+
+=item FILENAME
+
+String.  If given, write the C<hops> and C<traces> reports to this file when
+the router is cleaned up.
+
+=back
+
+=h sample read/write
+Returns or sets the SAMPLE argument.
+
+=h count read-only
+Returns the number of packets that have passed through this element.
+
+=h traced read-only
+Returns the number of traces started in this router.
+
+=h hops read-only
+Returns hop latency statistics in CSV format.  Each row contains the names of
+two consecutive elements on a traced path, the number of traced packets that
+made that hop, and the hop's minimum, mean, 50th, 90th, 99th and 99.9th
+percentile, and maximum latency in nanoseconds.  Percentiles are accurate to
+within about 6%.
+
+=h traces read-only
+Returns recent traces, one per line.  Each line contains the trace ID, the
+wall-clock time the trace started, and then an C<ELEMENT@NS> entry for each
+hop, where NS is the time since the trace started in nanoseconds.
+
+=h write_file write-only
+Writes the C<hops> and C<traces> reports to the specified file.
+
+=h reset write-only
+Clears all hop statistics and traces.
+
+=e
+
+  FromDevice(eth0) -> LatencyTrace(SAMPLE 1000)
+      -> ... -> ThreadSafeQueue -> ToDevice(eth1);
+
+=a SetTimestamp, TimestampAccum, SetCycleCount, CycleCountAccum */
+
+class LatencyTrace : public Element { public:
+
+    LatencyTrace();
+
+    const char *class_name() const	{ return "LatencyTrace"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    Packet *simple_action(Packet *);
+
+  private:
+
+    uint32_t _sample;
+    uint32_t _countdown;
+    uint64_t _count;
+    int _anno;
+    uint32_t _ntraces;
+    String _filename;
+    LatencyTracer *_tracer;
+
+    int write_file(const String &filename, ErrorHandler *errh) const;
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -2,7 +2,7 @@
 #define CLICK_ARPTABLE_HH
 #include <click/element.hh>
 #include <click/etheraddress.hh>
-#include <click/hashcontainer.hh>
+#include <click/flathashtable.hh>
 #include <click/hashallocator.hh>
 #include <click/sync.hh>
 #include <click/timer.hh>
@@ -184,7 +184,7 @@ class ARPTable : public Element { public:
 
     ReadWriteLock _lock;
 
-    typedef HashContainer<ARPEntry> Table;
+    typedef FlatHashContainer<ARPEntry> Table;
     Table _table;
     typedef List<ARPEntry, &ARPEntry::_age_link> AgeList;
     AgeList _age;
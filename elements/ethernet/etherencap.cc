@@ -49,7 +49,8 @@ EtherEncap::configure(Vector<String> &conf, ErrorHandler *errh)
 Packet *
 EtherEncap::smaction(Packet *p)
 {
-    if (WritablePacket *q = p->push_mac_header(14)) {
+    if (WritablePacket *q = p->push_header(14)) {
+	q->set_mac_header(q->data(), 14);
 	memcpy(q->data(), &_ethh, 14);
 	return q;
     } else
@@ -51,7 +51,7 @@ Packet *
 StoreEtherAddress::simple_action(Packet *p)
 {
     if (_offset + 6 <= p->length()) {
-	if (WritablePacket *q = p->uniqueify()) {
+	if (WritablePacket *q = p->uniqueify_header(_offset + 6)) {
 	    memcpy(q->data() + _offset, &_address, 6);
 	    return q;
 	} else
@@ -2,7 +2,7 @@
 #define CLICK_ETHERSWITCH_HH
 #include <click/element.hh>
 #include <click/etheraddress.hh>
-#include <click/hashtable.hh>
+#include <click/flathashtable.hh>
 CLICK_DECLS
 
 /*
@@ -82,7 +82,7 @@ class EtherSwitch : public Element { public:
 
   private:
 
-    typedef HashTable<EtherAddress, AddrInfo> Table;
+    typedef FlatHashTable<EtherAddress, AddrInfo> Table;
     Table _table;
     uint32_t _timeout;
 
@@ -24,6 +24,7 @@
 #include <click/args.hh>
 #include <click/straccum.hh>
 #include <click/error.hh>
+#include <click/master.hh>
 #include <click/standard/alignmentinfo.hh>
 CLICK_DECLS
 
@@ -74,14 +75,12 @@ CheckIPHeader::InterfacesArg::parse(const String &str,
 }
 
 CheckIPHeader::CheckIPHeader()
-  : _checksum(true), _reason_drops(0)
+  : _addrs(0), _checksum(true), _details(false)
 {
-  _drops = 0;
 }
 
 CheckIPHeader::~CheckIPHeader()
 {
-  delete[] _reason_drops;
 }
 
 int
@@ -90,11 +89,12 @@ CheckIPHeader::configure(Vector<String> &conf, ErrorHandler *errh)
   _offset = 0;
   bool verbose = false;
   bool details = false;
+  Vector<IPAddress> bad_src, good_dst;
 
   if (Args(this, errh).bind(conf)
-      .read("INTERFACES", InterfacesArg(), _bad_src, _good_dst)
-      .read("BADSRC", _bad_src)
-      .read("GOODDST", _good_dst)
+      .read("INTERFACES", InterfacesArg(), bad_src, good_dst)
+      .read("BADSRC", bad_src)
+      .read("GOODDST", good_dst)
       .read("OFFSET", _offset)
       .read("VERBOSE", verbose)
       .read("DETAILS", details)
@@ -106,17 +106,19 @@ CheckIPHeader::configure(Vector<String> &conf, ErrorHandler *errh)
       || (conf.size() == 1 && IntArg().parse(conf[0], _offset)))
     /* nada */;
   else if (Args(conf, this, errh)
-	   .read("BADSRC", OldBadSrcArg(), _bad_src)
+	   .read("BADSRC", OldBadSrcArg(), bad_src)
 	   .read("OFFSET", _offset)
 	   .complete() < 0)
     return -1;
 
   _verbose = verbose;
-  if (details) {
-      _reason_drops = new atomic_uint32_t[NREASONS];
-      for (int i = 0; i < NREASONS; ++i)
-	  _reason_drops[i] = 0;
-  }
+  _details = details;
+
+  _addrs.clear();
+  for (IPAddress *a = bad_src.begin(); a != bad_src.end(); ++a)
+    _addrs[*a] |= ADDR_BADSRC;
+  for (IPAddress *a = good_dst.begin(); a != good_dst.end(); ++a)
+    _addrs[*a] |= ADDR_GOODDST;
 
 #if HAVE_FAST_CHECKSUM && FAST_CHECKSUM_ALIGNED
   // check alignment
@@ -132,23 +134,53 @@ CheckIPHeader::configure(Vector<String> &conf, ErrorHandler *errh)
   }
 #endif
 
-  //for (int i = 0; i < _bad_src.n; i++)
-  //  click_chatter("bad: %s", IPAddress(_bad_src.vec[i]).s().c_str());
-  //for (int i = 0; i < _good_dst.n; i++)
-  //  click_chatter("good: %s", IPAddress(_good_dst.vec[i]).s().c_str());
+  return 0;
+}
 
+int
+CheckIPHeader::initialize(ErrorHandler *)
+{
+  _drops.initialize(master()->nthreads());
   return 0;
 }
 
+inline bool
+CheckIPHeader::checksum_ok(const click_ip *ip, unsigned hlen) const
+{
+#if HAVE_FAST_CHECKSUM && FAST_CHECKSUM_ALIGNED
+  if (_aligned)
+    return ip_fast_csum((unsigned char *)ip, ip->ip_hl) == 0;
+#elif HAVE_FAST_CHECKSUM
+  return ip_fast_csum((unsigned char *)ip, ip->ip_hl) == 0;
+#endif
+  if (hlen != sizeof(click_ip))
+    return click_in_cksum((const unsigned char *)ip, hlen) == 0;
+
+  // Sum a 20-byte header a word at a time.  The header is valid iff its
+  // ones'-complement sum is 0xFFFF.
+#if HAVE_INDIFFERENT_ALIGNMENT && HAVE_INT64_TYPES
+  const uint32_t *w = reinterpret_cast<const uint32_t *>(ip);
+  uint64_t sum = (uint64_t) w[0] + w[1] + w[2] + w[3] + w[4];
+  sum = (sum & 0xFFFFFFFFU) + (sum >> 32);
+  sum = (sum & 0xFFFF) + (sum >> 16);
+#else
+  const uint16_t *w = reinterpret_cast<const uint16_t *>(ip);
+  uint32_t sum = w[0] + w[1] + w[2] + w[3] + w[4]
+    + w[5] + w[6] + w[7] + w[8] + w[9];
+#endif
+  sum = (sum & 0xFFFF) + (sum >> 16);
+  sum = (sum & 0xFFFF) + (sum >> 16);
+  return sum == 0xFFFF;
+}
+
 Packet *
 CheckIPHeader::drop(Reason reason, Packet *p)
 {
-    if (_drops == 0 || _verbose)
+    Drops &d = _drops.local();
+    if (d.drops == 0 || _verbose)
 	click_chatter("%s: IP header check failed: %s", name().c_str(), reason_texts[reason]);
-    _drops++;
-
-    if (_reason_drops)
-	_reason_drops[reason]++;
+    ++d.drops;
+    ++d.reason_drops[reason];
 
     if (noutputs() == 2)
 	output(1).push(p);
@@ -169,40 +201,36 @@ CheckIPHeader::simple_action(Packet *p)
   if ((int)plen < (int)sizeof(click_ip))
     return drop(MINISCULE_PACKET, p);
 
-  if (ip->ip_v != 4)
-    return drop(BAD_VERSION, p);
-
-  hlen = ip->ip_hl << 2;
-  if (hlen < sizeof(click_ip))
-    return drop(BAD_HLEN, p);
-
+  // Fast path: version 4, a 20-byte header, and sizeof(click_ip) <= len <=
+  // plen, checked with one comparison each.  Other packets are classified
+  // one field at a time.
   len = ntohs(ip->ip_len);
-  if (len > plen || len < hlen)
-    return drop(BAD_IP_LEN, p);
-
-  if (_checksum) {
-    int val;
-#if HAVE_FAST_CHECKSUM && FAST_CHECKSUM_ALIGNED
-    if (_aligned)
-      val = ip_fast_csum((unsigned char *)ip, ip->ip_hl);
-    else
-      val = click_in_cksum((const unsigned char *)ip, hlen);
-#elif HAVE_FAST_CHECKSUM
-    val = ip_fast_csum((unsigned char *)ip, ip->ip_hl);
-#else
-    val = click_in_cksum((const unsigned char *)ip, hlen);
-#endif
-    if (val != 0)
-      return drop(BAD_CHECKSUM, p);
+  if (likely(*reinterpret_cast<const uint8_t *>(ip) == 0x45
+	     && len - sizeof(click_ip) <= plen - sizeof(click_ip)))
+    hlen = sizeof(click_ip);
+  else {
+    if (ip->ip_v != 4)
+      return drop(BAD_VERSION, p);
+
+    hlen = ip->ip_hl << 2;
+    if (hlen < sizeof(click_ip))
+      return drop(BAD_HLEN, p);
+
+    if (len > plen || len < hlen)
+      return drop(BAD_IP_LEN, p);
   }
 
+  if (_checksum && !checksum_ok(ip, hlen))
+    return drop(BAD_CHECKSUM, p);
+
   /*
    * RFC1812 5.3.7 and 4.2.2.11: discard illegal source addresses.
    * Configuration string should have listed all subnet
    * broadcast addresses known to this router.
    */
-  if (find(_bad_src.begin(), _bad_src.end(), IPAddress(ip->ip_src)) < _bad_src.end()
-      && find(_good_dst.begin(), _good_dst.end(), IPAddress(ip->ip_dst)) == _good_dst.end())
+  if (!_addrs.empty()
+      && (_addrs.get(IPAddress(ip->ip_src)) & ADDR_BADSRC)
+      && !(_addrs.get(IPAddress(ip->ip_dst)) & ADDR_GOODDST))
     return drop(BAD_SADDR, p);
 
   /*
@@ -226,20 +254,30 @@ CheckIPHeader::simple_action(Packet *p)
 }
 
 String
-CheckIPHeader::read_handler(Element *e, void *)
+CheckIPHeader::read_handler(Element *e, void *thunk)
 {
   CheckIPHeader *c = reinterpret_cast<CheckIPHeader *>(e);
+  if (!thunk) {
+    uint32_t n = 0;
+    for (int t = 0; t < c->_drops.size(); ++t)
+      n += c->_drops[t].drops;
+    return String(n);
+  }
   StringAccum sa;
-  for (int i = 0; i < NREASONS; i++)
-      sa << c->_reason_drops[i] << '\t' << reason_texts[i] << '\n';
+  for (int i = 0; i < NREASONS; i++) {
+      uint32_t n = 0;
+      for (int t = 0; t < c->_drops.size(); ++t)
+	  n += c->_drops[t].reason_drops[i];
+      sa << n << '\t' << reason_texts[i] << '\n';
+  }
   return sa.take_string();
 }
 
 void
 CheckIPHeader::add_handlers()
 {
-    add_data_handlers("drops", Handler::OP_READ, &_drops);
-    if (_reason_drops)
+    add_read_handler("drops", read_handler, 0);
+    if (_details)
 	add_read_handler("drop_details", read_handler, 1);
 }
 
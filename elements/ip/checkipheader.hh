@@ -1,7 +1,8 @@
 #ifndef CLICK_CHECKIPHEADER_HH
 #define CLICK_CHECKIPHEADER_HH
 #include <click/element.hh>
-#include <click/atomic.hh>
+#include <click/flathashtable.hh>
+#include <click/perthread.hh>
 CLICK_DECLS
 class Args;
 
@@ -36,6 +37,12 @@ the INTERFACES, BADSRC, and GOODDST keyword arguments are supplied (RFC1812
 CheckIPHeader prints a message to the console the first time it encounters an
 incorrect IP packet (but see VERBOSE below).
 
+Packets with 20-byte headers, the common case, take a fast path that checks
+the version, header length, and length fields together and sums the header
+checksum inline. Source and destination addresses are looked up in a hash
+table, so long BADSRC and GOODDST lists cost no more than short ones. Drop
+counts are kept per thread.
+
 Keyword arguments are:
 
 =over 5
@@ -115,6 +122,7 @@ class CheckIPHeader : public Element { public:
   const char *flags() const			{ return "A"; }
 
   int configure(Vector<String> &, ErrorHandler *);
+  int initialize(ErrorHandler *);
   void add_handlers();
 
   Packet *simple_action(Packet *);
@@ -133,19 +141,17 @@ class CheckIPHeader : public Element { public:
 
   unsigned _offset;
 
-  Vector<IPAddress> _bad_src;	// array of illegal IP src addresses
+  // BADSRC: illegal IP src addresses; GOODDST: IP dst addrs for which
+  // BADSRC does not apply
+  enum { ADDR_BADSRC = 1, ADDR_GOODDST = 2 };
+  FlatHashTable<IPAddress, uint8_t> _addrs;
 
   bool _checksum;
 #if HAVE_FAST_CHECKSUM && FAST_CHECKSUM_ALIGNED
   bool _aligned;
 #endif
   bool _verbose;
-
-  Vector<IPAddress> _good_dst;	// array of IP dst addrs for which _bad_src
-				// does not apply
-
-  atomic_uint32_t _drops;
-  atomic_uint32_t *_reason_drops;
+  bool _details;
 
   enum Reason {
     MINISCULE_PACKET,
@@ -158,6 +164,17 @@ class CheckIPHeader : public Element { public:
   };
   static const char * const reason_texts[NREASONS];
 
+  struct Drops {
+    uint32_t drops;
+    uint32_t reason_drops[NREASONS];
+    Drops() : drops(0) {
+      for (int i = 0; i < NREASONS; ++i)
+	reason_drops[i] = 0;
+    }
+  };
+  per_thread<Drops> _drops;
+
+  inline bool checksum_ok(const click_ip *ip, unsigned hlen) const;
   Packet *drop(Reason, Packet *);
   static String read_handler(Element *, void *);
 
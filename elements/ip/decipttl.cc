@@ -56,7 +56,7 @@ DecIPTTL::simple_action(Packet *p)
 	checked_output_push(1, p);
 	return 0;
     } else {
-	WritablePacket *q = p->uniqueify();
+	WritablePacket *q = p->uniqueify_header(p->network_header_offset() + sizeof(click_ip));
 	if (!q)
 	    return 0;
 	click_ip *ip = q->ip_header();
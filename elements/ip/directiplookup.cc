@@ -24,6 +24,8 @@
 #include <click/straccum.hh>
 #include <click/router.hh>
 #include <click/error.hh>
+#include <click/args.hh>
+#include <click/numa.hh>
 CLICK_DECLS
 
 
@@ -488,6 +490,7 @@ DirectIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, Er
 // DIRECTIPLOOKUP
 
 DirectIPLookup::DirectIPLookup()
+    : _replicas(0), _nreplicas(0), _replicate(false)
 {
 }
 
@@ -498,6 +501,10 @@ DirectIPLookup::~DirectIPLookup()
 int
 DirectIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
 {
+    if (Args(this, errh).bind(conf)
+	.read("REPLICATE", _replicate)
+	.consume() < 0)
+	return -1;
     int r;
     if ((r = _t.initialize()) < 0)
 	return r;
@@ -505,12 +512,118 @@ DirectIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
     return IPRouteTable::configure(conf, errh);
 }
 
+int
+DirectIPLookup::initialize(ErrorHandler *errh)
+{
+    if (!_replicate)
+	return 0;
+    _nreplicas = Numa::nnodes();
+    _replicas = new Replica[_nreplicas];
+    memset(_replicas, 0, sizeof(Replica) * _nreplicas);
+    for (int node = 0; node < _nreplicas; ++node)
+	if (!(_replicas[node].tbl_0_23 = (uint16_t *) Numa::allocate(sizeof(uint16_t) << 24, node)))
+	    return errh->error("out of memory");
+    return sync_replicas(0, 1 << 24);
+}
+
 void
 DirectIPLookup::cleanup(CleanupStage)
 {
+    cleanup_replicas();
     _t.cleanup();
 }
 
+void
+DirectIPLookup::cleanup_replicas()
+{
+    for (int node = 0; node < _nreplicas; ++node) {
+	Replica &r = _replicas[node];
+	if (r.tbl_0_23)
+	    Numa::deallocate(r.tbl_0_23, sizeof(uint16_t) << 24, node);
+	if (r.tbl_24_31)
+	    Numa::deallocate(r.tbl_24_31, sizeof(uint16_t) * r.tbl_24_31_capacity, node);
+	if (r.vport)
+	    Numa::deallocate(r.vport, sizeof(VirtualPort) * r.vport_capacity, node);
+    }
+    for (int i = 0; i < _retired.size(); ++i)
+	Numa::deallocate(_retired[i].p, _retired[i].size, _retired[i].node);
+    _retired.clear();
+    delete[] _replicas;
+    _replicas = 0;
+    _nreplicas = 0;
+}
+
+/** Free a replica's outgrown table once no thread can be reading it.
+ * Other threads may still be looking up routes in the old copy, and no
+ * cheap grace period tells us when they are done, so it is freed at
+ * cleanup.  Capacities double, so retired copies take less memory than the
+ * live ones. */
+void
+DirectIPLookup::retire(void *p, size_t size, int node)
+{
+    Retired r;
+    r.p = p;
+    r.size = size;
+    r.node = node;
+    _retired.push_back(r);
+}
+
+/** Copy _tbl_0_23[@a start, @a end), and everything those entries refer to,
+ * to every replica.  Entries are copied after the secondary table blocks and
+ * virtual ports they refer to, so concurrent lookups see consistent routes.
+ * Grown tables are filled before they are published, and the old ones are
+ * retired rather than freed. */
+int
+DirectIPLookup::sync_replicas(uint32_t start, uint32_t end)
+{
+    for (int node = 0; node < _nreplicas; ++node) {
+	Replica &r = _replicas[node];
+
+	if (r.vport_capacity != _t._vport_capacity) {
+	    VirtualPort *v = (VirtualPort *) Numa::allocate(sizeof(VirtualPort) * _t._vport_capacity, node);
+	    if (!v)
+		return -ENOMEM;
+	    memcpy(v, _t._vport, sizeof(VirtualPort) * _t._vport_capacity);
+	    click_compiler_fence();
+	    if (r.vport)
+		retire(r.vport, sizeof(VirtualPort) * r.vport_capacity, node);
+	    r.vport = v;
+	    r.vport_capacity = _t._vport_capacity;
+	} else
+	    memcpy(r.vport, _t._vport, sizeof(VirtualPort) * _t._vport_capacity);
+
+	if (r.tbl_24_31_capacity != _t._tbl_24_31_capacity) {
+	    uint16_t *t = (uint16_t *) Numa::allocate(sizeof(uint16_t) * _t._tbl_24_31_capacity, node);
+	    if (!t)
+		return -ENOMEM;
+	    memcpy(t, _t._tbl_24_31, sizeof(uint16_t) * _t._tbl_24_31_capacity);
+	    click_compiler_fence();
+	    if (r.tbl_24_31)
+		retire(r.tbl_24_31, sizeof(uint16_t) * r.tbl_24_31_capacity, node);
+	    r.tbl_24_31 = t;
+	    r.tbl_24_31_capacity = _t._tbl_24_31_capacity;
+	} else
+	    for (uint32_t i = start; i < end; ++i)
+		if (_t._tbl_0_23[i] & 0x8000) {
+		    uint32_t sec = (_t._tbl_0_23[i] & 0x7fff) << 8;
+		    memcpy(r.tbl_24_31 + sec, _t._tbl_24_31 + sec, sizeof(uint16_t) * 256);
+		}
+
+	click_compiler_fence();
+	memcpy(r.tbl_0_23 + start, _t._tbl_0_23 + start, sizeof(uint16_t) * (end - start));
+    }
+    return 0;
+}
+
+int
+DirectIPLookup::sync_route(const IPRoute &route)
+{
+    uint32_t start = ntohl(route.addr.addr()) >> 8;
+    int plen = route.prefix_len();
+    uint32_t end = start + (plen >= 24 ? 1 : 1 << (24 - plen));
+    return sync_replicas(start, end);
+}
+
 void
 DirectIPLookup::push(int, Packet *p)
 {
@@ -528,34 +641,51 @@ DirectIPLookup::push(int, Packet *p)
 int
 DirectIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
 {
+    const uint16_t *tbl_0_23 = _t._tbl_0_23, *tbl_24_31 = _t._tbl_24_31;
+    const VirtualPort *vport = _t._vport;
+    if (_replicas) {
+	const Replica &r = _replicas[Numa::current_node()];
+	tbl_0_23 = r.tbl_0_23;
+	tbl_24_31 = r.tbl_24_31;
+	vport = r.vport;
+    }
+
     uint32_t ip_addr = ntohl(dest.addr());
-    uint16_t vport_i = _t._tbl_0_23[ip_addr >> 8];
+    uint16_t vport_i = tbl_0_23[ip_addr >> 8];
 
     if (vport_i & 0x8000)
-        vport_i = _t._tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
+        vport_i = tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
 
-    gw = _t._vport[vport_i].gw;
-    return _t._vport[vport_i].port;
+    gw = vport[vport_i].gw;
+    return vport[vport_i].port;
 }
 
 int
 DirectIPLookup::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.add_route(route, allow_replace, old_route, errh);
+    int r = _t.add_route(route, allow_replace, old_route, errh);
+    if (r >= 0 && _replicas && sync_route(route) < 0)
+	return errh->error("out of memory");
+    return r;
 }
 
 int
 DirectIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.remove_route(route, old_route, errh);
+    int r = _t.remove_route(route, old_route, errh);
+    if (r >= 0 && _replicas && sync_route(route) < 0)
+	return errh->error("out of memory");
+    return r;
 }
 
 int
 DirectIPLookup::flush_handler(const String &, Element *e, void *,
-				ErrorHandler *)
+				ErrorHandler *errh)
 {
     DirectIPLookup *t = static_cast<DirectIPLookup *>(e);
     t->_t.flush();
+    if (t->_replicas && t->sync_replicas(0, 1 << 24) < 0)
+	return errh->error("out of memory");
     return 0;
 }
 
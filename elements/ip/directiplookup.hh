@@ -7,7 +7,7 @@ CLICK_DECLS
 /*
 =c
 
-DirectIPLookup(ADDR1/MASK1 [GW1] OUT1, ADDR2/MASK2 [GW2] OUT2, ...)
+DirectIPLookup(ADDR1/MASK1 [GW1] OUT1, ADDR2/MASK2 [GW2] OUT2, ..., I<keyword> REPLICATE)
 
 =s iproute
 
@@ -33,6 +33,11 @@ relatively low CPU overhead, allowing for high update rates.
 DirectIPLookup implements the I<DIR-24-8-BASIC> lookup scheme described by
 Gupta, Lin, and McKeown in the paper cited below.
 
+If REPLICATE is true, DirectIPLookup keeps a copy of its lookup tables on
+every NUMA node, about 32 MB each, and each thread looks up addresses in its
+own node's copy.  Route changes are applied to the copies as they happen.
+Default is false.
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -94,6 +99,7 @@ class DirectIPLookup : public IPRouteTable { public:
     const char *processing() const	{ return PUSH; }
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
     void cleanup(CleanupStage stage);
     void add_handlers();
 
@@ -181,9 +187,33 @@ class DirectIPLookup : public IPRouteTable { public:
 
     };
 
+    // Per-NUMA-node copy of the lookup structures
+    struct Replica {
+	uint16_t *tbl_0_23;
+	uint16_t *tbl_24_31;
+	VirtualPort *vport;
+	uint32_t tbl_24_31_capacity;
+	uint32_t vport_capacity;
+    };
+
   protected:
 
     Table _t;
+    Replica *_replicas;
+    int _nreplicas;
+    bool _replicate;
+
+    struct Retired {
+	void *p;
+	size_t size;
+	int node;
+    };
+    Vector<Retired> _retired;
+
+    void cleanup_replicas();
+    void retire(void *p, size_t size, int node);
+    int sync_replicas(uint32_t start, uint32_t end);
+    int sync_route(const IPRoute &route);
 
     friend class RangeIPLookup;
 
@@ -0,0 +1,616 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * flowdispatch.{cc,hh} -- spreads flows over outputs by symmetric hash
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "flowdispatch.hh"
+#include <clicknet/ip.h>
+#include <clicknet/ip6.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/handler.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+#include <click/crc32.h>
+CLICK_DECLS
+
+static const char * const hash_names[] = { "toeplitz", "crc32" };
+
+FlowDispatch::FlowDispatch()
+    : _toeplitz(0)
+{
+}
+
+FlowDispatch::~FlowDispatch()
+{
+    delete[] _toeplitz;
+}
+
+int
+FlowDispatch::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String hash, key;
+    uint32_t buckets = 128, timeout = 30;
+    int anno = 0;
+    bool set_anno = false;
+
+    if (Args(conf, this, errh)
+	.read("HASH", WordArg(), hash)
+	.read("KEY", key)
+	.read("BUCKETS", buckets)
+	.read("ANNO", AnnoArg(4), anno).read_status(set_anno)
+	.read("FRAGMENT_TIMEOUT", SecondsArg(), timeout)
+	.complete() < 0)
+	return -1;
+
+    _hash = H_TOEPLITZ;
+    if (hash) {
+	for (_hash = H_TOEPLITZ; _hash <= H_CRC32; ++_hash)
+	    if (hash.lower() == hash_names[_hash])
+		break;
+	if (_hash > H_CRC32)
+	    return errh->error("bad HASH %<%s%>", hash.c_str());
+    }
+    if (buckets == 0 || buckets > 65536 || (buckets & (buckets - 1)))
+	return errh->error("BUCKETS must be a power of two no more than 65536");
+    if (key && _hash != H_TOEPLITZ)
+	return errh->error("KEY requires HASH TOEPLITZ");
+    if (key && key.length() < TOEPLITZ_KEY_SIZE)
+	return errh->error("KEY must be at least %d bytes long", TOEPLITZ_KEY_SIZE);
+
+    if (_hash == H_TOEPLITZ) {
+	uint8_t k[TOEPLITZ_KEY_SIZE];
+	for (int i = 0; i < TOEPLITZ_KEY_SIZE; ++i)
+	    k[i] = key ? key[i] : (i & 1 ? 0x5a : 0x6d);
+	// Precompute each input byte's contribution at each position.  Bit
+	// j of the input XORs in the 32 key bits starting at bit j.
+	delete[] _toeplitz;
+	_toeplitz = new uint32_t[TUPLE_SIZE][256];
+	for (int pos = 0; pos < TUPLE_SIZE; ++pos)
+	    for (int b = 0; b < 256; ++b) {
+		uint32_t v = 0;
+		for (int j = 0; j < 8; ++j)
+		    if (b & (0x80 >> j)) {
+			const uint8_t *kp = k + pos;
+			uint32_t w = (kp[0] << 24) | (kp[1] << 16) | (kp[2] << 8) | kp[3];
+			if (j)
+			    w = (w << j) | (kp[4] >> (8 - j));
+			v ^= w;
+		    }
+		_toeplitz[pos][b] = v;
+	    }
+    } else
+	// update_crc() builds its table on first use; do it now, before
+	// several threads can race to.
+	(void) update_crc(0xFFFFFFFFU, "", 0);
+
+    _mask = buckets - 1;
+    _anno = anno;
+    _set_anno = set_anno;
+    _frag_timeout = timeout * CLICK_HZ;
+    _table.resize(buckets);
+    for (uint32_t b = 0; b < buckets; ++b)
+	_table[b] = b % noutputs();
+    return 0;
+}
+
+int
+FlowDispatch::initialize(ErrorHandler *)
+{
+    _stats.initialize(master()->nthreads());
+    for (int i = 0; i < _stats.size(); ++i) {
+	_stats[i].sent.assign(noutputs(), 0);
+	_stats[i].count.assign(_table.size(), 0);
+    }
+    _balance_base.assign(_table.size(), 0);
+
+    // Moves judge whether a queue has drained from its handlers.
+    for (int p = 0; p < noutputs(); ++p) {
+	Element *e = output(p).element();
+	const Handler *h = Router::handler(e, "length");
+	_length_h.push_back(h && h->readable() ? h : 0);
+	h = Router::handler(e, "drops");
+	_drops_h.push_back(h && h->readable() ? h : 0);
+    }
+
+    _frag_gc = click_jiffies() + _frag_timeout;
+    _pending = 0;
+    _check_jiffies = click_jiffies();
+    _hold_drops = 0;
+    return 0;
+}
+
+void
+FlowDispatch::cleanup(CleanupStage)
+{
+    for (Move *m = _moves.begin(); m != _moves.end(); ++m)
+	while (Packet *p = m->head) {
+	    m->head = p->next();
+	    p->kill();
+	}
+    _moves.clear();
+}
+
+hashcode_t
+FlowDispatch::FragKey::hashcode() const
+{
+    uint32_t h = id ^ (proto << 24);
+    for (int i = 0; i < 4; ++i)
+	h = (h * 33) ^ src[i] ^ (dst[i] << 1);
+    return h;
+}
+
+static inline bool
+has_ports(int proto)
+{
+    return proto == IP_PROTO_TCP || proto == IP_PROTO_UDP
+	|| proto == IP_PROTO_SCTP || proto == IP_PROTO_DCCP;
+}
+
+inline uint32_t
+FlowDispatch::tuple_hash(uint8_t *tuple, int addr_len, bool ports) const
+{
+    int n = 2 * addr_len + (ports ? 4 : 0);
+    if (_hash == H_TOEPLITZ) {
+	uint32_t h = 0;
+	for (int i = 0; i < n; ++i)
+	    h ^= _toeplitz[i][tuple[i]];
+	return h;
+    }
+
+    // Put the lesser endpoint first so both directions hash alike.
+    uint8_t *src = tuple, *dst = tuple + addr_len;
+    int c = memcmp(src, dst, addr_len);
+    if (c == 0 && ports)
+	c = memcmp(tuple + 2 * addr_len, tuple + 2 * addr_len + 2, 2);
+    if (c > 0) {
+	uint8_t t[16];
+	memcpy(t, src, addr_len);
+	memcpy(src, dst, addr_len);
+	memcpy(dst, t, addr_len);
+	if (ports) {
+	    uint8_t *pp = tuple + 2 * addr_len;
+	    click_swap(pp[0], pp[2]);
+	    click_swap(pp[1], pp[3]);
+	}
+    }
+    return update_crc(0xFFFFFFFFU, reinterpret_cast<const char *>(tuple), n);
+}
+
+void
+FlowDispatch::note_first_fragment(const FragKey &key, uint32_t hash)
+{
+    click_jiffies_t now = click_jiffies();
+    _frag_lock.acquire();
+    if (!click_jiffies_less(now, _frag_gc)) {
+	for (HashTable<FragKey, FragInfo>::iterator it = _frags.begin(); it; )
+	    if (click_jiffies_less(it.value().expiry, now))
+		it = _frags.erase(it);
+	    else
+		++it;
+	_frag_gc = now + _frag_timeout;
+    }
+    if (_frags.size() < MAX_FRAGMENTS || _frags.find(key)) {
+	FragInfo &fi = _frags[key];
+	fi.hash = hash;
+	fi.expiry = now + _frag_timeout;
+    }
+    _frag_lock.release();
+}
+
+bool
+FlowDispatch::find_fragment(const FragKey &key, uint32_t &hash)
+{
+    bool found = false;
+    _frag_lock.acquire();
+    if (HashTable<FragKey, FragInfo>::iterator it = _frags.find(key))
+	if (!click_jiffies_less(it.value().expiry, click_jiffies())) {
+	    hash = it.value().hash;
+	    found = true;
+	}
+    _frag_lock.release();
+    return found;
+}
+
+uint32_t
+FlowDispatch::flow_hash(Packet *p)
+{
+    const uint8_t *nh = p->has_network_header() ? p->network_header() : p->data();
+    int len = p->end_data() - nh;
+    uint8_t tuple[TUPLE_SIZE];
+    int addr_len, proto, thoff;
+    bool first = false, later = false;
+    uint32_t id = 0;
+
+    if (len >= (int) sizeof(click_ip) && (nh[0] >> 4) == 4) {
+	const click_ip *iph = reinterpret_cast<const click_ip *>(nh);
+	addr_len = 4;
+	memcpy(tuple, &iph->ip_src, 8);
+	proto = iph->ip_p;
+	thoff = iph->ip_hl << 2;
+	if (thoff < (int) sizeof(click_ip))
+	    thoff = len;
+	uint16_t off = ntohs(iph->ip_off);
+	if (off & (IP_MF | IP_OFFMASK)) {
+	    first = !(off & IP_OFFMASK);
+	    later = !first;
+	    id = iph->ip_id;
+	}
+    } else if (len >= (int) sizeof(click_ip6) && (nh[0] >> 4) == 6) {
+	const click_ip6 *ip6h = reinterpret_cast<const click_ip6 *>(nh);
+	addr_len = 16;
+	memcpy(tuple, &ip6h->ip6_src, 32);
+	proto = ip6h->ip6_nxt;
+	thoff = sizeof(click_ip6);
+	while (thoff + 8 <= len) {
+	    if (proto == 0 || proto == 43 || proto == 60) {
+		proto = nh[thoff];
+		thoff += (nh[thoff + 1] + 1) * 8;
+	    } else if (proto == 44 && !first && !later) {
+		uint16_t off = (nh[thoff + 2] << 8) | nh[thoff + 3];
+		proto = nh[thoff];
+		memcpy(&id, nh + thoff + 4, 4);
+		thoff += 8;
+		if (off & 0xFFF8)
+		    later = true;
+		else
+		    first = (off & 1);
+		if (later)
+		    break;
+	    } else
+		break;
+	}
+    } else
+	return 0;
+
+    FragKey key;
+    if (first || later) {
+	memset(&key, 0, sizeof(key));
+	memcpy(key.src, tuple, addr_len);
+	memcpy(key.dst, tuple + addr_len, addr_len);
+	key.id = id;
+	key.proto = proto;
+    }
+
+    uint32_t hash;
+    if (later && find_fragment(key, hash))
+	return hash;
+    bool ports = has_ports(proto) && !later && thoff + 4 <= len;
+    if (ports)
+	memcpy(tuple + 2 * addr_len, nh + thoff, 4);
+    hash = tuple_hash(tuple, addr_len, ports);
+    if (first)
+	note_first_fragment(key, hash);
+    return hash;
+}
+
+void
+FlowDispatch::push(int, Packet *p)
+{
+    uint32_t hash = flow_hash(p);
+    if (_set_anno)
+	p->set_anno_u32(_anno, hash);
+    if (unlikely(_pending))
+	service();
+
+    int bucket = hash & _mask;
+    int port = _table[bucket];
+    if (unlikely(port < 0)) {
+	hold(bucket, p);
+	return;
+    }
+    Stats &st = _stats.local();
+    ++st.count[bucket];
+    ++st.sent[port];
+    output(port).push(p);
+}
+
+
+// MOVING BUCKETS
+//
+// A move holds a bucket's packets until its old output's queue has passed
+// every packet sent there before the move.  Moves start and finish in the
+// push path, so that a single pushing thread sees a consistent table.
+
+uint32_t
+FlowDispatch::sent(int port) const
+{
+    uint32_t n = 0;
+    for (int i = 0; i < _stats.size(); ++i)
+	n += _stats[i].sent[port];
+    return n;
+}
+
+static uint32_t
+read_count(const Handler *h, Element *e)
+{
+    uint32_t n = 0;
+    if (h)
+	(void) IntArg().parse(cp_uncomment(h->call_read(e)), n);
+    return n;
+}
+
+bool
+FlowDispatch::drained(const Move &m)
+{
+    if (!_length_h[m.from])
+	return true;
+    Element *e = output(m.from).element();
+    uint32_t length = read_count(_length_h[m.from], e);
+    uint32_t drops = read_count(_drops_h[m.from], e) - m.drops;
+    // The queue holds at most the last length + drops packets sent to it.
+    return (int32_t) (sent(m.from) - length - drops - m.mark) >= 0;
+}
+
+void
+FlowDispatch::service()
+{
+    _move_lock.acquire();
+
+    bool started = _requests.size() != 0;
+    for (int i = 0; i < _requests.size(); i += 2) {
+	int bucket = _requests[i], port = _requests[i + 1];
+	int from = _table[bucket];
+	if (from < 0) {
+	    for (Move *m = _moves.begin(); m != _moves.end(); ++m)
+		if (m->bucket == bucket)
+		    m->to = port;
+	} else if (from != port) {
+	    Move m;
+	    m.bucket = bucket;
+	    m.from = from;
+	    m.to = port;
+	    m.mark = sent(from);
+	    m.drops = read_count(_drops_h[from], output(from).element());
+	    m.head = m.tail = 0;
+	    m.nheld = 0;
+	    _moves.push_back(m);
+	    _table[bucket] = -1;
+	}
+    }
+    _requests.clear();
+
+    // Check queues at most once a jiffy.  Held packets go out under the
+    // lock, so that other threads' packets for the bucket wait behind them.
+    click_jiffies_t now = click_jiffies();
+    if (started || now != _check_jiffies) {
+	_check_jiffies = now;
+	for (int i = 0; i < _moves.size(); )
+	    if (drained(_moves[i])) {
+		Move &m = _moves[i];
+		if (m.head) {
+		    Stats &st = _stats.local();
+		    while (Packet *p = m.head) {
+			m.head = p->next();
+			p->set_next(0);
+			++st.sent[m.to];
+			output(m.to).push(p);
+		    }
+		}
+		_table[m.bucket] = m.to;
+		_moves[i] = _moves.back();
+		_moves.pop_back();
+	    } else
+		++i;
+    }
+
+    _pending = _moves.size() + _requests.size();
+    _move_lock.release();
+}
+
+void
+FlowDispatch::hold(int bucket, Packet *p)
+{
+    _move_lock.acquire();
+    int port = _table[bucket];
+    Stats &st = _stats.local();
+    ++st.count[bucket];
+    if (port >= 0) {
+	// The move finished while we waited for the lock.
+	_move_lock.release();
+	++st.sent[port];
+	output(port).push(p);
+	return;
+    }
+    Move *m = _moves.begin();
+    while (m->bucket != bucket)
+	++m;
+    if (m->nheld >= HOLD_CAPACITY) {
+	++_hold_drops;
+	p->kill();
+    } else {
+	p->set_next(0);
+	if (m->tail)
+	    m->tail->set_next(p);
+	else
+	    m->head = p;
+	m->tail = p;
+	++m->nheld;
+    }
+    _move_lock.release();
+}
+
+int
+FlowDispatch::target(int bucket) const
+{
+    for (int i = _requests.size() - 2; i >= 0; i -= 2)
+	if (_requests[i] == bucket)
+	    return _requests[i + 1];
+    if (_table[bucket] >= 0)
+	return _table[bucket];
+    for (const Move *m = _moves.begin(); m != _moves.end(); ++m)
+	if (m->bucket == bucket)
+	    return m->to;
+    return 0;
+}
+
+void
+FlowDispatch::request(int bucket, int port)
+{
+    _move_lock.acquire();
+    if (target(bucket) != port) {
+	_requests.push_back(bucket);
+	_requests.push_back(port);
+	_pending = _moves.size() + _requests.size();
+    }
+    _move_lock.release();
+}
+
+void
+FlowDispatch::balance()
+{
+    int nbuckets = _table.size();
+    Vector<uint32_t> count(nbuckets, 0);
+    for (int b = 0; b < nbuckets; ++b) {
+	uint32_t n = 0;
+	for (int i = 0; i < _stats.size(); ++i)
+	    n += _stats[i].count[b];
+	count[b] = n - _balance_base[b];
+	_balance_base[b] = n;
+    }
+
+    Vector<int> dest(nbuckets, 0);
+    Vector<uint32_t> load(noutputs(), 0);
+    _move_lock.acquire();
+    for (int b = 0; b < nbuckets; ++b)
+	dest[b] = target(b);
+    _move_lock.release();
+    for (int b = 0; b < nbuckets; ++b)
+	load[dest[b]] += count[b];
+
+    // Move buckets from the busiest output to the idlest while that narrows
+    // the gap between them, preferring buckets near half the gap.
+    for (int iter = 0; iter < nbuckets; ++iter) {
+	int hi = 0, lo = 0;
+	for (int o = 1; o < noutputs(); ++o) {
+	    if (load[o] > load[hi])
+		hi = o;
+	    if (load[o] < load[lo])
+		lo = o;
+	}
+	uint32_t gap = load[hi] - load[lo], half = gap / 2;
+	int best = -1;
+	uint32_t best_diff = 0;
+	for (int b = 0; b < nbuckets; ++b)
+	    if (dest[b] == hi && count[b] > 0 && count[b] < gap) {
+		uint32_t diff = count[b] > half ? count[b] - half : half - count[b];
+		if (best < 0 || diff < best_diff) {
+		    best = b;
+		    best_diff = diff;
+		}
+	    }
+	if (best < 0)
+	    break;
+	dest[best] = lo;
+	load[hi] -= count[best];
+	load[lo] += count[best];
+    }
+
+    for (int b = 0; b < nbuckets; ++b)
+	request(b, dest[b]);
+}
+
+enum { H_TABLE, H_MOVE, H_BALANCE, H_COUNTS, H_PENDING, H_DROPS, H_FRAGMENTS };
+
+String
+FlowDispatch::read_handler(Element *e, void *thunk)
+{
+    FlowDispatch *fd = static_cast<FlowDispatch *>(e);
+    StringAccum sa;
+    switch ((intptr_t) thunk) {
+    case H_TABLE:
+	fd->_move_lock.acquire();
+	for (int b = 0; b < fd->_table.size(); ++b)
+	    sa << (b ? " " : "") << fd->target(b);
+	fd->_move_lock.release();
+	return sa.take_string();
+    case H_COUNTS:
+	for (int p = 0; p < fd->noutputs(); ++p)
+	    sa << fd->sent(p) << '\n';
+	return sa.take_string();
+    case H_PENDING:
+	return String(fd->_pending.value());
+    case H_DROPS:
+	return String(fd->_hold_drops);
+    case H_FRAGMENTS: {
+	fd->_frag_lock.acquire();
+	int n = fd->_frags.size();
+	fd->_frag_lock.release();
+	return String(n);
+    }
+    default:
+	return String();
+    }
+}
+
+int
+FlowDispatch::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    FlowDispatch *fd = static_cast<FlowDispatch *>(e);
+    Vector<String> words;
+    cp_spacevec(str, words);
+    switch ((intptr_t) thunk) {
+    case H_TABLE: {
+	Vector<int> ports;
+	for (String *w = words.begin(); w != words.end(); ++w) {
+	    int port;
+	    if (!IntArg().parse(*w, port) || port < 0 || port >= fd->noutputs())
+		return errh->error("bad port %<%s%>", w->c_str());
+	    ports.push_back(port);
+	}
+	if (!ports.size())
+	    return errh->error("empty table");
+	for (int b = 0; b < fd->_table.size(); ++b)
+	    fd->request(b, ports[b % ports.size()]);
+	return 0;
+    }
+    case H_MOVE: {
+	int bucket, port;
+	if (Args(words, fd, errh)
+	    .read_mp("BUCKET", bucket)
+	    .read_mp("PORT", port)
+	    .complete() < 0)
+	    return -1;
+	if (bucket < 0 || bucket >= fd->_table.size())
+	    return errh->error("BUCKET out of range");
+	if (port < 0 || port >= fd->noutputs())
+	    return errh->error("PORT out of range");
+	fd->request(bucket, port);
+	return 0;
+    }
+    case H_BALANCE:
+	fd->balance();
+	return 0;
+    default:
+	return -1;
+    }
+}
+
+void
+FlowDispatch::add_handlers()
+{
+    add_read_handler("table", read_handler, H_TABLE);
+    add_write_handler("table", write_handler, H_TABLE);
+    add_write_handler("move", write_handler, H_MOVE);
+    add_write_handler("balance", write_handler, H_BALANCE, Handler::BUTTON);
+    add_read_handler("counts", read_handler, H_COUNTS);
+    add_read_handler("pending", read_handler, H_PENDING);
+    add_read_handler("drops", read_handler, H_DROPS);
+    add_read_handler("fragments", read_handler, H_FRAGMENTS);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(FlowDispatch)
+ELEMENT_MT_SAFE(FlowDispatch)
@@ -0,0 +1,227 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_FLOWDISPATCH_HH
+#define CLICK_FLOWDISPATCH_HH
+#include <click/element.hh>
+#include <click/hashtable.hh>
+#include <click/perthread.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+class Handler;
+
+/*
+=c
+
+FlowDispatch([I<keywords> HASH, KEY, BUCKETS, ANNO, FRAGMENT_TIMEOUT])
+
+=s classification
+
+spreads flows over outputs by symmetric hash
+
+=d
+
+Can have any number of outputs.  Hashes each packet's flow, that is, its
+source and destination addresses and, for TCP, UDP, SCTP, and DCCP, its
+source and destination ports, and emits the packet on the output that an
+indirection table assigns to that hash.  The hash is symmetric: both
+directions of a connection go to the same output.  Typically each output
+leads to a ThreadSafeQueue drained by a different thread, so that stateful
+elements downstream, such as IPRewriter or AggregateIPFlows, see every packet
+of a flow on one thread.
+
+FlowDispatch handles IPv4 and IPv6 packets.  It looks for the IP header at
+the network header, if the packet has one, and otherwise at the start of the
+packet.  IPv6 hop-by-hop, routing, and destination options headers are
+skipped.  Only the first fragment of a fragmented packet carries ports, so
+FlowDispatch remembers the hash of each first fragment for FRAGMENT_TIMEOUT
+and gives later fragments with the same addresses, protocol, and
+identification the same hash.  Fragments that arrive before their first
+fragment are hashed by address alone.  Packets that are neither IPv4 nor
+IPv6 go to bucket 0.
+
+The indirection table has BUCKETS entries; the low bits of the hash select an
+entry, whose value is an output port.  Initially buckets are assigned to
+outputs round-robin.  The C<table>, C<move>, and C<balance> handlers reassign
+buckets while the router runs.  Packets are not reordered by a reassignment.
+While a bucket moves, FlowDispatch holds its packets until every packet it
+already sent to the old output has left that output's queue, as judged by
+the queue's C<length> and C<drops> handlers, then sends the held packets,
+and later packets, to the new output.  At most 1024 packets are held per
+bucket; more are dropped.  Moves complete as later packets arrive.  Ordering
+is exact when a single thread pushes to FlowDispatch, and each output leads
+to a queue that only FlowDispatch fills, or to no queue at all.
+
+Keyword arguments are:
+
+=over 8
+
+=item HASH
+
+The hash function: C<TOEPLITZ> or C<CRC32>.  TOEPLITZ is the Toeplitz hash
+that network cards use for receive-side scaling; it is symmetric if KEY is.
+CRC32 orders the two endpoints before hashing them with the CRC-32 used by
+SetCRC32, so it is always symmetric.  Default is TOEPLITZ.
+
+=item KEY
+
+String.  The Toeplitz key, at least 40 bytes long, usually written in hex
+as C<\E<lt>...E<gt>>.  The default repeats the bytes 6d5a, which makes the
+hash symmetric.
+
+=item BUCKETS
+
+The number of indirection table entries, a power of two.  Default is 128.
+
+=item ANNO
+
+Annotation name.  If given, FlowDispatch stores each packet's 32-bit hash in
+this annotation.
+
+=item FRAGMENT_TIMEOUT
+
+Time in seconds.  How long to remember a first fragment's hash.  Default is
+30.
+
+=back
+
+=e
+
+Spread IPv4 flows over three threads:
+
+  FromDevice(eth0) -> Strip(14) -> CheckIPHeader
+    -> fd :: FlowDispatch;
+  fd[0] -> ThreadSafeQueue -> Unqueue -> ... ;
+  fd[1] -> ThreadSafeQueue -> Unqueue -> ... ;
+  fd[2] -> ThreadSafeQueue -> Unqueue -> ... ;
+
+=h table read/write
+
+Returns the indirection table: one output port per bucket, separated by
+spaces.  Buckets being moved show their new output.  When written with a
+space-separated list of ports, reassigns every bucket whose port changes;
+the list repeats to fill the table if it is shorter.
+
+=h move write-only
+
+Write "BUCKET PORT" to move one bucket to output PORT.
+
+=h balance write-only
+
+Moves buckets from busy outputs to idle ones, based on the packets each
+bucket received since the last write to C<balance>.
+
+=h counts read-only
+
+Returns the number of packets sent to each output, one per line.
+
+=h pending read-only
+
+Returns the number of bucket moves in progress.
+
+=h drops read-only
+
+Returns the number of packets dropped because a moving bucket held too many.
+
+=h fragments read-only
+
+Returns the number of first fragments whose hashes FlowDispatch remembers.
+
+=a HashSwitch, RoundRobinSwitch, ThreadSafeQueue, SetCRC32 */
+
+class FlowDispatch : public Element { public:
+
+    FlowDispatch();
+    ~FlowDispatch();
+
+    const char *class_name() const	{ return "FlowDispatch"; }
+    const char *port_count() const	{ return "1/1-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void push(int port, Packet *);
+
+    enum { H_TOEPLITZ, H_CRC32 };
+
+    uint32_t flow_hash(Packet *p);
+
+  private:
+
+    enum { TOEPLITZ_KEY_SIZE = 40, TUPLE_SIZE = 36, HOLD_CAPACITY = 1024,
+	   MAX_FRAGMENTS = 16384 };
+
+    int _hash;
+    int _anno;
+    bool _set_anno;
+    uint32_t _mask;
+    uint32_t (*_toeplitz)[256];	// per input byte position
+
+    Vector<int> _table;		// bucket -> output, or -1 while moving
+
+    struct Stats {
+	Vector<uint32_t> sent;	// per output
+	Vector<uint32_t> count;	// per bucket
+    };
+    per_thread<Stats> _stats;
+    Vector<uint32_t> _balance_base;
+
+    struct FragKey {
+	uint32_t src[4];
+	uint32_t dst[4];
+	uint32_t id;
+	uint32_t proto;
+	hashcode_t hashcode() const;
+	inline bool operator==(const FragKey &x) const {
+	    return memcmp(this, &x, sizeof(FragKey)) == 0;
+	}
+    };
+    struct FragInfo {
+	uint32_t hash;
+	click_jiffies_t expiry;
+    };
+    HashTable<FragKey, FragInfo> _frags;
+    click_jiffies_t _frag_timeout;
+    click_jiffies_t _frag_gc;
+    Spinlock _frag_lock;
+
+    struct Move {
+	int bucket;
+	int from;
+	int to;
+	uint32_t mark;		// packets sent to from before the move
+	uint32_t drops;		// from's queue drops when the move began
+	Packet *head;
+	Packet *tail;
+	int nheld;
+    };
+    Vector<Move> _moves;
+    Vector<int> _requests;	// bucket, port pairs
+    Spinlock _move_lock;
+    atomic_uint32_t _pending;
+    click_jiffies_t _check_jiffies;
+    uint32_t _hold_drops;
+
+    Vector<const Handler *> _length_h;
+    Vector<const Handler *> _drops_h;
+
+    inline uint32_t tuple_hash(uint8_t *tuple, int addr_len, bool ports) const;
+    void note_first_fragment(const FragKey &key, uint32_t hash);
+    bool find_fragment(const FragKey &key, uint32_t &hash);
+
+    uint32_t sent(int port) const;
+    bool drained(const Move &m);
+    void service();
+    void hold(int bucket, Packet *p);
+    int target(int bucket) const;
+    void request(int bucket, int port);
+    void balance();
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -98,13 +98,12 @@ IPFragmenter::fragment(Packet *p_in)
 	return;
     }
 
-    // make sure we can modify the packet
-    WritablePacket *p = p_in->uniqueify();
+    // make sure we can modify the header; the payload stays shared
+    WritablePacket *p = p_in->uniqueify_header(p_in->network_header_offset() + hlen);
     if (!p)
 	return;
     click_ip *ip = p->ip_header();
 
-    // output the first fragment
     // If we're cheating the DF bit, we can't trust the ip_id; set to random.
     if (ip->ip_off & htons(IP_DF)) {
 	ip->ip_id = click_random();
@@ -115,13 +114,12 @@ IPFragmenter::fragment(Packet *p_in)
     ip->ip_off |= htons(IP_MF);
     ip->ip_sum = 0;
     ip->ip_sum = click_in_cksum((const unsigned char *)ip, hlen);
-    Packet *first_fragment = p->clone();
-    first_fragment->take(p->length() - p->network_header_offset() - hlen - first_dlen);
-    output(0).push(first_fragment);
-    _fragments++;
 
-    // output the remaining fragments
+    // Build the remaining fragments first, as header packets that share p's
+    // payload; p itself then becomes the first fragment.
     int out_hlen = sizeof(click_ip) + optcopy(ip, 0);
+    uint32_t payload_offset = p->network_header_offset() + hlen;
+    Packet *head = 0, **tailp = &head;
 
     for (int off = first_dlen; off < in_dlen; ) {
 	// prepare packet
@@ -129,14 +127,18 @@ IPFragmenter::fragment(Packet *p_in)
 	if (out_dlen + off > in_dlen)
 	    out_dlen = in_dlen - off;
 
-	WritablePacket *q = Packet::make(_headroom, 0, out_hlen + out_dlen, 0);
+	WritablePacket *q = Packet::make(_headroom, 0, out_hlen, out_dlen);
 	if (q) {
 	    q->set_network_header(q->data(), out_hlen);
 	    click_ip *qip = q->ip_header();
 
 	    memcpy(qip, ip, sizeof(click_ip));
 	    optcopy(ip, qip);
-	    memcpy(q->transport_header(), p->transport_header() + off, out_dlen);
+	    if (!q->append_shared(p, payload_offset + off, out_dlen)) {
+		q = q->put(out_dlen);
+		memcpy(q->transport_header(), p->data() + payload_offset + off, out_dlen);
+		qip = q->ip_header();
+	    }
 
 	    qip->ip_hl = out_hlen >> 2;
 	    qip->ip_off = htons(ntohs(ip->ip_off) + (off >> 3));
@@ -148,14 +150,23 @@ IPFragmenter::fragment(Packet *p_in)
 
 	    q->copy_annotations(p);
 
-	    output(0).push(q);
-	    _fragments++;
+	    *tailp = q;
+	    tailp = &q->next();
 	}
 
 	off += out_dlen;
     }
 
-    p->kill();
+    // output the first fragment, then the rest
+    p->take(p->length() - payload_offset - first_dlen);
+    output(0).push(p);
+    _fragments++;
+    while (Packet *q = head) {
+	head = q->next();
+	q->set_next(0);
+	output(0).push(q);
+	_fragments++;
+    }
 }
 
 void
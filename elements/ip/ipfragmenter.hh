@@ -24,6 +24,11 @@ CLICK_DECLS
  *
  * Sends the fragments in order, starting with the first.
  *
+ * Fragments after the first share the input packet's payload rather than
+ * copying it (see Packet::append_shared), and a shared input packet has
+ * only its headers copied; the payload is copied, if at all, by whichever
+ * element first reads it.
+ *
  * It is best to Strip() the MAC header from a packet before sending it to
  * IPFragmenter, since any MAC header is not copied to second and subsequent
  * fragments.
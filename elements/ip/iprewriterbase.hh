@@ -80,7 +80,7 @@ class IPRewriterHeap { public:
 
 class IPRewriterBase : public Element { public:
 
-    typedef HashContainer<IPRewriterEntry> Map;
+    typedef IPRewriterMap Map;
     enum {
 	rw_drop = -1, rw_addmap = -2
     };
@@ -110,7 +110,7 @@ class IPRewriterBase : public Element { public:
     IPRewriterBase *reply_element(int input) const {
 	return _input_specs[input].reply_element;
     }
-    virtual HashContainer<IPRewriterEntry> *get_map(int mapid) {
+    virtual Map *get_map(int mapid) {
 	return likely(mapid == IPRewriterInput::mapid_default) ? &_map : 0;
     }
 
@@ -210,7 +210,7 @@ IPRewriterInput::rewrite_flowid(const IPFlowID &flowid,
 	rewritten_flowid = flowid;
 	return IPRewriterBase::rw_addmap;
     case i_pattern: {
-	HashContainer<IPRewriterEntry> *reply_map;
+	IPRewriterMap *reply_map;
 	if (likely(mapid == mapid_default))
 	    reply_map = &reply_element->_map;
 	else
@@ -219,7 +219,7 @@ IPRewriterPattern::parse_with_ports(const String &conf, IPRewriterInput *input,
 int
 IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 				  IPFlowID &rewritten_flowid,
-				  const HashContainer<IPRewriterEntry> &reply_map)
+				  const IPRewriterMap &reply_map)
 {
     rewritten_flowid = flowid;
     if (_saddr)
@@ -2,12 +2,13 @@
 #ifndef CLICK_IPRW_PATTERN_HH
 #define CLICK_IPRW_PATTERN_HH
 #include <click/element.hh>
-#include <click/hashcontainer.hh>
+#include <click/flathashtable.hh>
 #include <click/ipflowid.hh>
 CLICK_DECLS
 class IPRewriterFlow;
 class IPRewriterEntry;
 class IPRewriterInput;
+typedef FlatHashContainer<IPRewriterEntry> IPRewriterMap;
 
 class IPRewriterPattern { public:
 
@@ -38,7 +39,7 @@ class IPRewriterPattern { public:
     }
 
     int rewrite_flowid(const IPFlowID &flowid, IPFlowID &rewritten_flowid,
-		       const HashContainer<IPRewriterEntry> &reply_map);
+		       const IPRewriterMap &reply_map);
 
     String unparse() const;
 
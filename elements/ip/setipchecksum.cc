@@ -34,7 +34,9 @@ SetIPChecksum::~SetIPChecksum()
 Packet *
 SetIPChecksum::simple_action(Packet *p_in)
 {
-    if (WritablePacket *p = p_in->uniqueify()) {
+    // 60 is the maximum IP header length
+    int nh_offset = (p_in->has_network_header() ? p_in->network_header_offset() : 0);
+    if (WritablePacket *p = p_in->uniqueify_header(nh_offset + 60)) {
 	unsigned char *nh_data = (p->has_network_header() ? p->network_header() : p->data());
 	click_ip *iph = reinterpret_cast<click_ip *>(nh_data);
 	unsigned plen = p->end_data() - nh_data, hlen;
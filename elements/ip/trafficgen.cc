@@ -0,0 +1,416 @@
+/*
+ * trafficgen.{cc,hh} -- generates IP traffic from a flow-mix profile
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "trafficgen.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/glue.hh>
+#include <click/standard/scheduleinfo.hh>
+#include <clicknet/ether.h>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <clicknet/udp.h>
+#include <clicknet/icmp.h>
+#include <math.h>
+CLICK_DECLS
+
+TrafficGen::TrafficGen()
+    : _ring_pos(0), _eth_len(0), _count(0), _task(this)
+{
+}
+
+void *
+TrafficGen::cast(const char *n)
+{
+    if (strcmp(n, class_name()) == 0)
+	return static_cast<Element *>(this);
+    else if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(this);
+    else
+	return 0;
+}
+
+int
+TrafficGen::parse_choices(const String &str, bool proto,
+			  Vector<Choice> &choices, ErrorHandler *errh)
+{
+    Vector<String> words;
+    cp_spacevec(str == "imix" && !proto ? "40:7 576:4 1500:1" : str, words);
+    for (String *w = words.begin(); w != words.end(); ++w) {
+	const char *colon = find(*w, ':');
+	String value = w->substring(w->begin(), colon);
+	Choice c;
+	c.weight = 1;
+	if (colon != w->end()
+	    && (!IntArg().parse(w->substring(colon + 1, w->end()), c.weight)
+		|| c.weight == 0))
+	    return errh->error("bad weight in %<%s%>", w->c_str());
+	if (!proto) {
+	    if (!IntArg().parse(value, c.value) || c.value <= 0 || c.value > 0xFFFF)
+		return errh->error("bad LENGTH %<%s%>", w->c_str());
+	} else if (value == "tcp")
+	    c.value = IP_PROTO_TCP;
+	else if (value == "udp")
+	    c.value = IP_PROTO_UDP;
+	else if (value == "icmp")
+	    c.value = IP_PROTO_ICMP;
+	else
+	    return errh->error("bad PROTO %<%s%>", w->c_str());
+	choices.push_back(c);
+    }
+    if (choices.empty())
+	return errh->error("empty %s", proto ? "PROTO" : "LENGTH");
+    return 0;
+}
+
+int
+TrafficGen::parse_range(const String &str, uint16_t range[2])
+{
+    const char *dash = find(str, '-');
+    if (!IntArg().parse(str.substring(str.begin(), dash), range[0]))
+	return -1;
+    if (dash == str.end())
+	range[1] = range[0];
+    else if (!IntArg().parse(str.substring(dash + 1, str.end()), range[1])
+	     || range[1] < range[0])
+	return -1;
+    return 0;
+}
+
+int
+TrafficGen::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    ActiveNotifier::initialize(Notifier::EMPTY_NOTIFIER, router());
+    _nflows = 1024;
+    _src = IPAddress(htonl(0x0A000000));
+    _src_mask = IPAddress::make_prefix(8);
+    _dst = IPAddress(htonl(0xC0A80000));
+    _dst_mask = IPAddress::make_prefix(16);
+    String sport = "1024-65535", dport = "1-1023";
+    String proto = "udp", length = "64";
+    _zipf = 0;
+    _ring_size = 8192;
+    _limit = -1;
+    _burst = 32;
+    _active = true;
+    _stop = false;
+    _timestamp = true;
+    _unique = true;
+    bool have_srceth, have_dsteth;
+
+    if (Args(conf, this, errh)
+	.read("FLOWS", _nflows)
+	.read("SRC", IPPrefixArg(true), _src, _src_mask)
+	.read("DST", IPPrefixArg(true), _dst, _dst_mask)
+	.read("SPORT", AnyArg(), sport)
+	.read("DPORT", AnyArg(), dport)
+	.read("PROTO", AnyArg(), proto)
+	.read("LENGTH", AnyArg(), length)
+	.read("ZIPF", _zipf)
+	.read("RING", _ring_size)
+	.read("SRCETH", _srceth).read_status(have_srceth)
+	.read("DSTETH", _dsteth).read_status(have_dsteth)
+	.read("LIMIT", _limit)
+	.read("BURST", _burst)
+	.read("ACTIVE", _active)
+	.read("STOP", _stop)
+	.read("TIMESTAMP", _timestamp)
+	.read("UNIQUE", _unique)
+	.read("SEED", _seed).read_status(_seeded)
+	.complete() < 0)
+	return -1;
+
+    if (_nflows == 0 || _ring_size <= 0)
+	return errh->error("FLOWS and RING must be positive");
+    if (_burst < 1)
+	return errh->error("BURST must be >= 1");
+    if (_zipf < 0)
+	return errh->error("ZIPF must be >= 0");
+    if (have_srceth != have_dsteth)
+	return errh->error("supply both SRCETH and DSTETH, or neither");
+    _eth_len = (have_srceth ? sizeof(click_ether) : 0);
+    if (parse_range(sport, _sport) < 0)
+	return errh->error("bad SPORT range");
+    if (parse_range(dport, _dport) < 0)
+	return errh->error("bad DPORT range");
+    _protos.clear();
+    _lengths.clear();
+    if (parse_choices(proto, true, _protos, errh) < 0
+	|| parse_choices(length, false, _lengths, errh) < 0)
+	return -1;
+    return 0;
+}
+
+int
+TrafficGen::choose(const Vector<Choice> &choices)
+{
+    uint32_t total = 0;
+    for (const Choice *c = choices.begin(); c != choices.end(); ++c)
+	total += c->weight;
+    uint32_t r = click_random(0, total - 1);
+    for (const Choice *c = choices.begin(); c != choices.end(); ++c)
+	if (r < c->weight)
+	    return c->value;
+	else
+	    r -= c->weight;
+    return choices.back().value;
+}
+
+void
+TrafficGen::make_flows()
+{
+    _flows.resize(_nflows);
+    uint32_t src_host = ~ntohl(_src_mask.addr()), dst_host = ~ntohl(_dst_mask.addr());
+    for (Flow *f = _flows.begin(); f != _flows.end(); ++f) {
+	f->src = IPAddress(_src.addr() | htonl(click_random(0, src_host)));
+	f->dst = IPAddress(_dst.addr() | htonl(click_random(0, dst_host)));
+	f->sport = click_random(_sport[0], _sport[1]);
+	f->dport = click_random(_dport[0], _dport[1]);
+	f->proto = choose(_protos);
+	f->ip_id = click_random(0, 0xFFFF);
+	f->seq = click_random();
+    }
+}
+
+Packet *
+TrafficGen::make_template(const Flow &flow, int length) const
+{
+    int thlen = (flow.proto == IP_PROTO_TCP ? sizeof(click_tcp) : sizeof(click_udp));
+    if (length < (int) sizeof(click_ip) + thlen)
+	length = sizeof(click_ip) + thlen;
+    WritablePacket *p = Packet::make(Packet::default_headroom, 0,
+				     _eth_len + length, 0);
+    if (!p)
+	return 0;
+    memset(p->data(), 0, p->length());
+
+    if (_eth_len) {
+	click_ether *ethh = reinterpret_cast<click_ether *>(p->data());
+	memcpy(ethh->ether_dhost, _dsteth.data(), 6);
+	memcpy(ethh->ether_shost, _srceth.data(), 6);
+	ethh->ether_type = htons(ETHERTYPE_IP);
+    }
+
+    click_ip *iph = reinterpret_cast<click_ip *>(p->data() + _eth_len);
+    iph->ip_v = 4;
+    iph->ip_hl = sizeof(click_ip) >> 2;
+    iph->ip_len = htons(length);
+    iph->ip_id = htons(flow.ip_id);
+    iph->ip_ttl = 64;
+    iph->ip_p = flow.proto;
+    iph->ip_src = flow.src;
+    iph->ip_dst = flow.dst;
+    iph->ip_sum = click_in_cksum(reinterpret_cast<unsigned char *>(iph), sizeof(click_ip));
+    p->set_ip_header(iph, sizeof(click_ip));
+
+    int tlen = length - sizeof(click_ip);
+    unsigned char *th = p->transport_header();
+    // Give payloads recognizable, nonzero contents.
+    for (int i = thlen; i < tlen; ++i)
+	th[i] = i;
+    if (flow.proto == IP_PROTO_TCP) {
+	click_tcp *tcph = reinterpret_cast<click_tcp *>(th);
+	tcph->th_sport = htons(flow.sport);
+	tcph->th_dport = htons(flow.dport);
+	tcph->th_seq = htonl(flow.seq);
+	tcph->th_ack = htonl(1);
+	tcph->th_off = sizeof(click_tcp) >> 2;
+	tcph->th_flags = TH_ACK;
+	tcph->th_win = htons(65535);
+	tcph->th_sum = click_in_cksum_pseudohdr(click_in_cksum(th, tlen), iph, tlen);
+    } else if (flow.proto == IP_PROTO_UDP) {
+	click_udp *udph = reinterpret_cast<click_udp *>(th);
+	udph->uh_sport = htons(flow.sport);
+	udph->uh_dport = htons(flow.dport);
+	udph->uh_ulen = htons(tlen);
+	udph->uh_sum = click_in_cksum_pseudohdr(click_in_cksum(th, tlen), iph, tlen);
+	if (udph->uh_sum == 0)
+	    udph->uh_sum = 0xFFFF;
+    } else {
+	click_icmp_sequenced *icmph = reinterpret_cast<click_icmp_sequenced *>(th);
+	icmph->icmp_type = ICMP_ECHO;
+	icmph->icmp_identifier = htons(flow.sport);
+	icmph->icmp_sequence = htons(flow.seq);
+	icmph->icmp_cksum = click_in_cksum(th, tlen);
+    }
+    return p;
+}
+
+int
+TrafficGen::make_ring(ErrorHandler *errh)
+{
+    // Zipf popularity: flow k is chosen with probability proportional to
+    // 1/(k+1)^ZIPF.  Sample with a binary search over the cumulative
+    // distribution.
+    Vector<double> cdf(_nflows, 0);
+    double total = 0;
+    for (uint32_t k = 0; k < _nflows; ++k) {
+	total += (_zipf == 0 ? 1 : pow(k + 1, -_zipf));
+	cdf[k] = total;
+    }
+
+    _ring.resize(_ring_size);
+    for (Slot *s = _ring.begin(); s != _ring.end(); ++s) {
+	double x = total * click_random() / ((double) CLICK_RAND_MAX + 1);
+	uint32_t l = 0, r = _nflows - 1;
+	while (l < r) {
+	    uint32_t m = (l + r) / 2;
+	    if (cdf[m] <= x)
+		l = m + 1;
+	    else
+		r = m;
+	}
+	s->flow = l;
+	if (!(s->packet = make_template(_flows[l], choose(_lengths))))
+	    return errh->error("out of memory");
+    }
+    _ring_pos = 0;
+    return 0;
+}
+
+int
+TrafficGen::initialize(ErrorHandler *errh)
+{
+    if (_seeded)
+	click_srandom(_seed);
+    make_flows();
+    if (make_ring(errh) < 0)
+	return -1;
+    ScheduleInfo::initialize_task(this, &_task, errh);
+    _nonfull_signal = Notifier::downstream_full_signal(this, 0, &_task);
+    return 0;
+}
+
+void
+TrafficGen::cleanup(CleanupStage)
+{
+    for (Slot *s = _ring.begin(); s != _ring.end(); ++s)
+	if (s->packet)
+	    s->packet->kill();
+    _ring.clear();
+}
+
+inline Packet *
+TrafficGen::next_packet()
+{
+    Slot &s = _ring[_ring_pos];
+    if (++_ring_pos == _ring.size())
+	_ring_pos = 0;
+    if (!_unique)
+	return s.packet->clone();
+
+    WritablePacket *p = Packet::make(Packet::default_headroom, s.packet->data(),
+				     s.packet->length(), 0);
+    if (!p)
+	return 0;
+    click_ip *iph = reinterpret_cast<click_ip *>(p->data() + _eth_len);
+    p->set_ip_header(iph, sizeof(click_ip));
+
+    // Advance the flow's IP ID and sequence number, starting from the
+    // template's values, and patch the checksums to match.
+    Flow &f = _flows[s.flow];
+    uint16_t old_hw = iph->ip_id;
+    iph->ip_id = htons(++f.ip_id);
+    click_update_in_cksum(&iph->ip_sum, old_hw, iph->ip_id);
+    if (f.proto == IP_PROTO_TCP) {
+	click_tcp *tcph = p->tcp_header();
+	uint32_t old_seq = tcph->th_seq, new_seq = htonl(f.seq);
+	tcph->th_seq = new_seq;
+	f.seq += p->length() - (_eth_len + sizeof(click_ip) + sizeof(click_tcp));
+	click_update_in_cksum(&tcph->th_sum, old_seq >> 16, new_seq >> 16);
+	click_update_in_cksum(&tcph->th_sum, old_seq, new_seq);
+    } else if (f.proto == IP_PROTO_ICMP) {
+	click_icmp_sequenced *icmph = reinterpret_cast<click_icmp_sequenced *>(p->icmp_header());
+	old_hw = icmph->icmp_sequence;
+	icmph->icmp_sequence = htons(++f.seq);
+	click_update_in_cksum(&icmph->icmp_cksum, old_hw, icmph->icmp_sequence);
+    }
+    return p;
+}
+
+bool
+TrafficGen::run_task(Task *)
+{
+    if (!_active || !_nonfull_signal)
+	return false;
+    int n = _burst;
+    if (_limit >= 0 && _count + n >= (uint64_t) _limit)
+	n = (_count > (uint64_t) _limit ? 0 : _limit - _count);
+    Timestamp now;
+    if (_timestamp && n > 0)
+	now.assign_now();
+    for (int i = 0; i < n; ++i)
+	if (Packet *p = next_packet()) {
+	    if (_timestamp)
+		p->set_timestamp_anno(now);
+	    output(0).push(p);
+	}
+    _count += n;
+    if (n > 0)
+	_task.fast_reschedule();
+    else if (_stop && _limit >= 0 && _count >= (uint64_t) _limit)
+	router()->please_stop_driver();
+    return n > 0;
+}
+
+int
+TrafficGen::write_handler(const String &str, Element *e, void *user_data,
+			  ErrorHandler *errh)
+{
+    TrafficGen *tg = static_cast<TrafficGen *>(e);
+    switch ((intptr_t) user_data) {
+    case h_active:
+	if (!BoolArg().parse(str, tg->_active))
+	    return errh->error("syntax error");
+	break;
+    case h_limit:
+	if (!IntArg().parse(str, tg->_limit))
+	    return errh->error("syntax error");
+	break;
+    case h_burst: {
+	int burst;
+	if (!IntArg().parse(str, burst) || burst < 1)
+	    return errh->error("burst must be integer >= 1");
+	tg->_burst = burst;
+	break;
+    }
+    case h_reset:
+	tg->_count = 0;
+	break;
+    }
+    if (tg->_active && (tg->_limit < 0 || tg->_count < (uint64_t) tg->_limit)
+	&& !tg->_task.scheduled())
+	tg->_task.reschedule();
+    return 0;
+}
+
+void
+TrafficGen::add_handlers()
+{
+    add_data_handlers("count", Handler::OP_READ, &_count);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+    add_data_handlers("active", Handler::OP_READ | Handler::CHECKBOX, &_active);
+    add_write_handler("active", write_handler, h_active);
+    add_data_handlers("limit", Handler::OP_READ | Handler::CALM, &_limit);
+    add_write_handler("limit", write_handler, h_limit);
+    add_data_handlers("burst", Handler::OP_READ | Handler::CALM, &_burst);
+    add_write_handler("burst", write_handler, h_burst);
+    add_task_handlers(&_task, &_nonfull_signal);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(TrafficGen)
@@ -0,0 +1,258 @@
+#ifndef CLICK_TRAFFICGEN_HH
+#define CLICK_TRAFFICGEN_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/notifier.hh>
+#include <click/ipaddress.hh>
+#include <click/etheraddress.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TrafficGen([I<keywords> FLOWS, SRC, DST, SPORT, DPORT, PROTO, LENGTH, ZIPF, ...])
+
+=s basicsources
+
+generates IP traffic from a flow-mix profile
+
+=d
+
+TrafficGen generates IP packets belonging to FLOWS different flows, and
+pushes them out its single output BURST packets at a time.  It is meant for
+load-testing flow-sensitive configurations, such as NATs and flow tables,
+without external traffic sources.
+
+At initialization time, TrafficGen creates FLOWS flows.  Each flow has a
+source address chosen at random from the SRC prefix, a destination address
+chosen from the DST prefix, source and destination ports chosen from the
+SPORT and DPORT ranges, and a protocol chosen from the PROTO mix.
+TrafficGen then fills a ring of RING template packets.  Each template
+belongs to a flow chosen according to the ZIPF popularity distribution, and
+has a length chosen from the LENGTH distribution.  Templates have complete
+IP and transport headers with valid checksums.
+
+When running, TrafficGen emits the ring's templates in order, wrapping around
+as necessary.  If UNIQUE is true, each packet is a copy of its template in
+which the IP ID, and the TCP sequence number or ICMP echo sequence number, are
+advanced per flow; checksums are updated incrementally.  If UNIQUE is false,
+packets are clones sharing the template's data, which is faster, but every
+lap of the ring repeats the same packets and downstream elements that modify
+packets must copy them.
+
+Packets have their network header annotation set.  By default they are IP
+packets; if SRCETH and DSTETH are given, each packet starts with an Ethernet
+header.
+
+Keyword arguments are:
+
+=over 8
+
+=item FLOWS
+
+Integer. Number of flows. Default is 1024.
+
+=item SRC
+
+IP prefix. Source addresses are chosen from this prefix. Default is
+10.0.0.0/8.
+
+=item DST
+
+IP prefix. Destination addresses are chosen from this prefix. Default is
+192.168.0.0/16.
+
+=item SPORT
+
+Port range, such as "1024-65535", or a single port. Source ports are chosen
+from this range. Default is 1024-65535. For ICMP flows, the source port is
+used as the echo identifier.
+
+=item DPORT
+
+Port range. Destination ports are chosen from this range. Default is 1-1023.
+
+=item PROTO
+
+The protocol mix: a space-separated list of protocols, each optionally
+followed by a colon and an integer weight, such as "tcp:8 udp:3 icmp:1".
+Protocols are "tcp", "udp", and "icmp"; weights default to 1. Default is
+"udp".
+
+=item LENGTH
+
+The IP packet length distribution: a space-separated list of lengths, each
+optionally followed by a colon and an integer weight, or "imix" for the
+simple IMIX distribution "40:7 576:4 1500:1". Lengths are raised to the
+minimum for each packet's protocol (28 bytes for UDP and ICMP, 40 for TCP).
+Default is 64.
+
+=item ZIPF
+
+Real number. Flow popularity follows a Zipf distribution with this
+exponent: the I<k>th most popular flow is chosen with probability
+proportional to 1/I<k>^ZIPF. 0 means all flows are equally popular; values
+around 1 model the skew seen on real links. Default is 0.
+
+=item RING
+
+Integer. Number of template packets. The ring repeats every RING packets, so
+it should be large compared to FLOWS. Default is 8192.
+
+=item SRCETH, DSTETH
+
+Ethernet addresses. If both are given, packets get an Ethernet header with
+these addresses.
+
+=item LIMIT
+
+Integer. Stop sending after LIMIT packets. Default is -1, meaning send
+packets forever.
+
+=item BURST
+
+Integer. Number of packets to push each time TrafficGen is scheduled.
+Default is 32.
+
+=item ACTIVE
+
+Boolean. TrafficGen sends packets only when active. Default is true.
+
+=item STOP
+
+Boolean. If true, stop the driver once LIMIT packets are sent. Default is
+false.
+
+=item TIMESTAMP
+
+Boolean. If true, set the timestamp annotation on generated packets. All
+packets in a burst share a timestamp. Default is true.
+
+=item UNIQUE
+
+Boolean. See above. Default is true.
+
+=item SEED
+
+Integer. If given, the random number generator is seeded with SEED before
+flows and templates are chosen, so that runs are repeatable.
+
+=back
+
+TrafficGen listens for downstream full notification.
+
+=e
+
+Load-test a NAT with 10000 flows, mostly TCP, with IMIX lengths and skewed
+flow popularity:
+
+  TrafficGen(FLOWS 10000, PROTO tcp:9 udp:1, LENGTH imix, ZIPF 1,
+             SRC 10.0.0.0/16, DST 0.0.0.0/0, SEED 1)
+    -> rw :: IPRewriter(pattern 1.0.0.1 1024-65535 - - 0 0) -> Discard;
+
+=h count read-only
+
+Returns the number of packets generated.
+
+=h reset write-only
+
+Resets the count to 0. TrafficGen will then generate another LIMIT packets
+(if it is active).
+
+=h active read/write
+
+Returns or sets the ACTIVE parameter.
+
+=h limit read/write
+
+Returns or sets the LIMIT parameter.
+
+=h burst read/write
+
+Returns or sets the BURST parameter.
+
+=a
+
+InfiniteSource, RatedSource, FastUDPFlows, IPRewriter */
+
+class TrafficGen : public Element, public ActiveNotifier { public:
+
+    TrafficGen();
+
+    const char *class_name() const	{ return "TrafficGen"; }
+    void *cast(const char *);
+    const char *port_count() const	{ return PORTS_0_1; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    struct Flow {
+	IPAddress src;
+	IPAddress dst;
+	uint16_t sport;
+	uint16_t dport;
+	uint8_t proto;
+	uint16_t ip_id;
+	uint32_t seq;
+    };
+
+    struct Slot {
+	Packet *packet;
+	uint32_t flow;
+    };
+
+    struct Choice {
+	int value;
+	uint32_t weight;
+    };
+
+    Vector<Flow> _flows;
+    Vector<Slot> _ring;
+    int _ring_pos;
+    int _eth_len;
+
+    int _burst;
+    int64_t _limit;
+    uint64_t _count;
+    bool _active;
+    bool _stop;
+    bool _timestamp;
+    bool _unique;
+    Task _task;
+    NotifierSignal _nonfull_signal;
+
+    uint32_t _nflows;
+    IPAddress _src, _src_mask, _dst, _dst_mask;
+    uint16_t _sport[2], _dport[2];
+    Vector<Choice> _protos;
+    Vector<Choice> _lengths;
+    double _zipf;
+    int _ring_size;
+    EtherAddress _srceth, _dsteth;
+    bool _seeded;
+    uint32_t _seed;
+
+    static int parse_choices(const String &str, bool proto,
+			     Vector<Choice> &choices, ErrorHandler *errh);
+    static int parse_range(const String &str, uint16_t range[2]);
+    static int choose(const Vector<Choice> &choices);
+
+    void make_flows();
+    int make_ring(ErrorHandler *errh);
+    Packet *make_template(const Flow &flow, int length) const;
+    inline Packet *next_packet();
+
+    enum { h_active, h_limit, h_burst, h_reset };
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
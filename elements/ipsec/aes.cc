@@ -69,6 +69,10 @@ Aes::initialize(ErrorHandler *)
 Packet *
 Aes::simple_action(Packet *p_in)
 {
+  // packets of combined-mode SAs are protected by IPsecESPEncap
+  const SADataTuple *sa = (const SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p_in);
+  if (sa && sa->suite() != ESPCrypto::S_LEGACY)
+    return p_in;
 
   WritablePacket *p = p_in->uniqueify();
   unsigned char hold[8];
@@ -53,11 +53,13 @@ class Aes : public Element {
 
    enum { AES_DECRYPT = 0, AES_ENCRYPT = 1 };
 
+   // Table-based block cipher, also used by the portable ESP cipher suites
+   static int AES_set_encrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
+   static int AES_set_decrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
+   static void AES_encrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
+   static void AES_decrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
+
  private:
-   int AES_set_encrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
-   int AES_set_decrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
-   void AES_encrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
-   void AES_decrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
    unsigned _op;
    int _ignore;
    AES_KEY _key;
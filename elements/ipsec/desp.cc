@@ -43,37 +43,19 @@ IPsecESPUnencap::~IPsecESPUnencap()
 
 int
 IPsecESPUnencap::checkreplaywindow(SADataTuple * sa_data,unsigned long seq)
-  {
-	unsigned long diff;
-
-	if (seq == 0)
-		return 0;		/* first == 0 or wrapped */
-	/*This logic has been added for the time being to deal with replay rollover*/
-	if((seq == sa_data->replay_start_counter) && (sa_data->lastseq!=sa_data->replay_start_counter)) { sa_data->bitmap=0;sa_data->lastseq=seq;return 1;}
-
-	if (seq > sa_data->lastseq)	/* new larger sequence number */
-	{
-		diff = seq - sa_data->lastseq;
-		if (diff < sa_data->ooowin) /* In win, set bit for this pkt */
-			sa_data->bitmap = (sa_data->bitmap << diff) | 1;
-		else
-			sa_data->bitmap = 1; /* This packet has way larger */
-
-		sa_data->lastseq = seq;
-		return 1;		/* larger is good */
-	}
-	diff = sa_data->lastseq - seq;
-	if (diff >= sa_data->ooowin) {	/* too old or wrapped */
-		click_chatter("Replay protection: This packet is too old to be accepted\n");
-		return 0;
-
-        }
-	if (sa_data->bitmap & (1 << diff)) { /* this packet already seen */
-		click_chatter("Replay protection: This packet is already seen...\n");
-		return 0;
-        }
-	sa_data->bitmap |= (1 << diff);	/* mark as seen */
-	return 1;			/* out of order but good */
+{
+    if (seq == 0)
+	return 0;		/* first == 0 or wrapped */
+    switch (sa_data->replay.check(seq, sa_data->ooowin)) {
+    case ESPReplayWindow::TOO_OLD:
+	click_chatter("Replay protection: This packet is too old to be accepted\n");
+	return 0;
+    case ESPReplayWindow::SEEN:
+	click_chatter("Replay protection: This packet is already seen...\n");
+	return 0;
+    default:
+	return 1;
+    }
 }
 
 Packet *
@@ -83,20 +65,45 @@ IPsecESPUnencap::simple_action(Packet *p)
   const unsigned char * blk;
   SADataTuple * sa;
 
-  //Check replay counter:
-  struct esp_new *esp = (struct esp_new *) p->data();
-
   sa=(SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p);
 
   if(sa==NULL) {click_chatter("Null reference to Security Association Table");}
 
+  // combined-mode suites: verify the ICV and decrypt before anything in the
+  // packet is trusted, including the sequence number
+  int hlen = sizeof(esp_new), tlen = 0;
+  if (sa && sa->suite() != ESPCrypto::S_LEGACY) {
+      int suite = sa->suite();
+      hlen = 8 + ESPCrypto::iv_length(suite);
+      tlen = ESPCrypto::ICV_LEN;
+      int len = (int) p->length() - hlen - tlen;
+      if (len < 2 || len % ESPCrypto::block_size(suite)) {
+	  click_chatter("Invalid ESP payload length");
+	  p->kill();
+	  return 0;
+      }
+      WritablePacket *q = p->uniqueify();
+      if (!q)
+	  return 0;
+      if (!ESPCrypto::open(sa->cipher, q->data(), len)) {
+	  click_chatter("ESP authentication failed");
+	  q->kill();
+	  return 0;
+      }
+      p = q;
+  }
+
+  //Check replay counter:
+  struct esp_new *esp = (struct esp_new *) p->data();
+
   if(!checkreplaywindow(sa,(unsigned long)ntohl(esp->esp_rpl))) {
       p->kill(); //The packet failed replay check and it is therefore dropped
       return (0);
   }
 
-  // rip off ESP header
-  p->pull(sizeof(esp_new));
+  // rip off ESP header and ICV
+  p->pull(hlen);
+  p->take(tlen);
   // verify padding
   blks = p->length();
   blk = p->data();
@@ -121,5 +128,6 @@ IPsecESPUnencap::simple_action(Packet *p)
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecESPCrypto)
 EXPORT_ELEMENT(IPsecESPUnencap)
 ELEMENT_MT_SAFE(IPsecESPUnencap)
@@ -13,8 +13,15 @@ CLICK_DECLS
  * removes IPSec encapsulation
  * =d
  *
- * Removes ESP header added by IPsecESPEncap. see RFC 2406. Does not perform
- * the optional anti-replay attack checks.
+ * Removes ESP header added by IPsecESPEncap. see RFC 2406. Drops packets
+ * whose sequence numbers were already seen, or fall more than the SA's
+ * OOSIZE behind the highest sequence number seen.  The window is updated
+ * without locks, so several threads may unencapsulate packets of one SA;
+ * packets they reorder are accepted as long as they stay within the window.
+ *
+ * If the packet's security association uses a combined cipher suite (see
+ * IPsecRouteTable), IPsecESPUnencap first verifies the ICV and decrypts the
+ * payload in one pass, dropping packets that fail authentication.
  *
  * =a IPsecESPUnencap, IPsecDES, IPsecAuthSHA1
  */
@@ -61,30 +61,41 @@ IPsecESPEncap::simple_action(Packet *p)
       ip_p = p->ip_header()->ip_p;
   sa_data=(SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p);
 
+  // combined-mode suites encrypt and authenticate here
+  int suite = sa_data ? sa_data->suite() : ESPCrypto::S_LEGACY;
+  int blks = BLKS, hlen = sizeof(esp_new), tlen = 0;
+  if (suite != ESPCrypto::S_LEGACY) {
+      blks = ESPCrypto::block_size(suite);
+      hlen = 8 + ESPCrypto::iv_length(suite);
+      tlen = ESPCrypto::ICV_LEN;
+  }
+
   // make room for ESP header and padding
   int plen = p->length();
-  int padding = ((BLKS - ((plen + 2) % BLKS)) % BLKS) + 2;
+  int padding = ((blks - ((plen + 2) % blks)) % blks) + 2;
 
-  WritablePacket *q = p->push(sizeof(esp_new));
-  q = q->put(padding);
+  WritablePacket *q = p->push(hlen);
+  if (!q)
+      return 0;
+  q = q->put(padding + tlen);
+  if (!q)
+      return 0;
 
   struct esp_new *esp = (struct esp_new *) q->data();
-  u_char *pad = ((u_char *) q->data()) + sizeof(esp_new) + plen;
+  u_char *pad = ((u_char *) q->data()) + hlen + plen;
 
   // copy in ESP header
   // Get SPI from packet user annotation. This is the fourth user integer.
   esp->esp_spi = htonl((uint32_t)IPSEC_SPI_ANNO(p));
-  esp->esp_rpl = htonl(sa_data->cur_rpl);
-
-  if((sa_data->cur_rpl++) == 0) {
-	//if the replay counter rolls over...set it to the agreed start value
-        sa_data->cur_rpl = sa_data->replay_start_counter;
+  uint64_t iv_seed;
+  esp->esp_rpl = htonl(sa_data->next_sequence(iv_seed));
+  if (suite == ESPCrypto::S_LEGACY) {
+      i = click_random() >> 2;
+      memmove(&esp->esp_iv[0], &i, 4);
+      i = click_random() >> 2;
+      memmove(&esp->esp_iv[4], &i, 4);
+      memmove(q->data(), esp, sizeof(struct esp_new));
   }
-  i = click_random() >> 2;
-  memmove(&esp->esp_iv[0], &i, 4);
-  i = click_random() >> 2;
-  memmove(&esp->esp_iv[4], &i, 4);
-  memmove(q->data(), esp, sizeof(struct esp_new));
 
   // default padding specified by RFC 2406
   for (i = 0; i < padding - 2; i++)
@@ -94,11 +105,15 @@ IPsecESPEncap::simple_action(Packet *p)
   // next header = ip protocol number
   pad[padding - 1] = ip_p;
 
+  // encrypt payload and trailer, then append the ICV
+  if (suite != ESPCrypto::S_LEGACY)
+      ESPCrypto::seal(sa_data->cipher, q->data(), plen + padding, iv_seed);
+
   return(q);
 }
 
 
-
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecESPCrypto)
 EXPORT_ELEMENT(IPsecESPEncap)
 ELEMENT_MT_SAFE(IPsecESPEncap)
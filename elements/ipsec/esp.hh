@@ -20,7 +20,17 @@ CLICK_DECLS
  * The ESP header added to the packet includes the 32 bit SPI, 32 bit replay
  * counter, and 64 bit Integrity Vector (IV).
  *
- * =a IPsecESPUnencap, IPsecAuthSHA1, IPsecDES
+ * Sequence numbers are allocated atomically from the security association,
+ * so several threads may encapsulate packets for one tunnel.
+ *
+ * If the packet's security association uses a combined cipher suite (see
+ * IPsecRouteTable), IPsecESPEncap also encrypts the payload and appends the
+ * ICV, in a single pass over the packet.  AES-GCM pads to 4 bytes and carries
+ * an 8-byte IV; AES-CBC with HMAC-SHA-256 pads to 16 bytes and carries a
+ * 16-byte IV.  In that case no separate cipher or authentication elements are
+ * needed, and those elements pass the packet through unchanged.
+ *
+ * =a IPsecESPUnencap, IPsecAuthSHA1, IPsecDES, IPsecRouteTable, IPsecESPBench
  */
 
 struct esp_new {
@@ -0,0 +1,935 @@
+/*
+ * espcrypto.{cc,hh} -- ESP cipher suites with CPU-accelerated AES, GHASH
+ * and SHA-256
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "espcrypto.hh"
+#if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define ESPCRYPTO_X86 1
+# include <cpuid.h>
+# include <immintrin.h>
+# define ESP_TARGET_AES __attribute__((target("aes,pclmul,sse2,ssse3,sse4.1")))
+# define ESP_TARGET_SHA __attribute__((target("sha,sse2,ssse3,sse4.1")))
+#endif
+CLICK_DECLS
+
+int ESPCrypto::_features = -1;
+
+static inline uint32_t
+load_be32(const uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16)
+	| ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline void
+store_be32(uint8_t *p, uint32_t x)
+{
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+static inline uint64_t
+load_be64(const uint8_t *p)
+{
+    return ((uint64_t) load_be32(p) << 32) | load_be32(p + 4);
+}
+
+static inline void
+store_be64(uint8_t *p, uint64_t x)
+{
+    store_be32(p, x >> 32);
+    store_be32(p + 4, x);
+}
+
+// Compare without an early exit, so timing does not reveal how many bytes
+// of a forged ICV were correct.
+static bool
+icv_equal(const uint8_t *a, const uint8_t *b)
+{
+    uint8_t d = 0;
+    for (int i = 0; i < ESPCrypto::ICV_LEN; ++i)
+	d |= a[i] ^ b[i];
+    return d == 0;
+}
+
+
+/*****************************************************************************
+ * CPU features
+ */
+
+unsigned
+ESPCrypto::cpu_features()
+{
+    unsigned f = 0;
+#if ESPCRYPTO_X86
+    unsigned a, b, c, d;
+    if (__get_cpuid(1, &a, &b, &c, &d)) {
+	bool ssse3 = c & (1U << 9), sse41 = c & (1U << 19);
+	if (ssse3 && sse41 && (c & (1U << 25)))
+	    f |= F_AESNI;
+	if (ssse3 && sse41 && (c & (1U << 1)))
+	    f |= F_PCLMUL;
+	if (ssse3 && sse41 && __get_cpuid_max(0, 0) >= 7) {
+	    __cpuid_count(7, 0, a, b, c, d);
+	    if (b & (1U << 29))
+		f |= F_SHA;
+	}
+    }
+#endif
+    return f;
+}
+
+unsigned
+ESPCrypto::detect()
+{
+    _features = cpu_features();
+    return _features;
+}
+
+void
+ESPCrypto::set_features(unsigned mask)
+{
+    _features = cpu_features() & mask;
+}
+
+bool
+ESPCrypto::parse_suite(const String &str, int &suite)
+{
+    if (str == "legacy")
+	suite = S_LEGACY;
+    else if (str == "aes-gcm" || str == "aes128-gcm")
+	suite = S_AES_GCM;
+    else if (str == "aes-cbc-hmac-sha256" || str == "aes128-cbc-hmac-sha256")
+	suite = S_AES_CBC_HMAC_SHA256;
+    else
+	return false;
+    return true;
+}
+
+const char *
+ESPCrypto::suite_name(int suite)
+{
+    switch (suite) {
+    case S_AES_GCM:
+	return "aes-gcm";
+    case S_AES_CBC_HMAC_SHA256:
+	return "aes-cbc-hmac-sha256";
+    default:
+	return "legacy";
+    }
+}
+
+
+/*****************************************************************************
+ * SHA-256
+ */
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static inline uint32_t
+ror32(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static void
+sha256_blocks_portable(uint32_t *h, const uint8_t *p, size_t nblocks)
+{
+    uint32_t w[64];
+    for (; nblocks; --nblocks, p += 64) {
+	for (int i = 0; i < 16; ++i)
+	    w[i] = load_be32(p + 4 * i);
+	for (int i = 16; i < 64; ++i) {
+	    uint32_t s0 = ror32(w[i-15], 7) ^ ror32(w[i-15], 18) ^ (w[i-15] >> 3);
+	    uint32_t s1 = ror32(w[i-2], 17) ^ ror32(w[i-2], 19) ^ (w[i-2] >> 10);
+	    w[i] = w[i-16] + s0 + w[i-7] + s1;
+	}
+	uint32_t a = h[0], b = h[1], c = h[2], d = h[3],
+	    e = h[4], f = h[5], g = h[6], hh = h[7];
+	for (int i = 0; i < 64; ++i) {
+	    uint32_t t1 = hh + (ror32(e, 6) ^ ror32(e, 11) ^ ror32(e, 25))
+		+ ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+	    uint32_t t2 = (ror32(a, 2) ^ ror32(a, 13) ^ ror32(a, 22))
+		+ ((a & b) ^ (a & c) ^ (b & c));
+	    hh = g;
+	    g = f;
+	    f = e;
+	    e = d + t1;
+	    d = c;
+	    c = b;
+	    b = a;
+	    a = t1 + t2;
+	}
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+	h[5] += f;
+	h[6] += g;
+	h[7] += hh;
+    }
+}
+
+#if ESPCRYPTO_X86
+// The SHA extensions keep the state as two registers, ABEF and CDGH, and
+// perform two rounds per sha256rnds2.  Message words for round group g
+// (four rounds) live in w[g % 4].
+ESP_TARGET_SHA static void
+sha256_blocks_sha(uint32_t *h, const uint8_t *p, size_t nblocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_loadu_si128((const __m128i *) &h[0]);
+    __m128i state1 = _mm_loadu_si128((const __m128i *) &h[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);		// CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1B);	// EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);	// ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);	// CDGH
+
+    for (; nblocks; --nblocks, p += 64) {
+	__m128i save0 = state0, save1 = state1;
+	__m128i w[4];
+#pragma GCC unroll 16
+	for (int g = 0; g < 16; ++g) {
+	    if (g < 4)
+		w[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 16 * g)), bswap);
+	    __m128i msg = _mm_add_epi32(w[g & 3], _mm_loadu_si128((const __m128i *) &sha256_k[4 * g]));
+	    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	    if (g >= 3 && g < 15) {
+		__m128i t = _mm_alignr_epi8(w[g & 3], w[(g - 1) & 3], 4);
+		w[(g + 1) & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(w[(g + 1) & 3], t), w[g & 3]);
+	    }
+	    msg = _mm_shuffle_epi32(msg, 0x0E);
+	    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	    if (g >= 1 && g <= 12)
+		w[(g - 1) & 3] = _mm_sha256msg1_epu32(w[(g - 1) & 3], w[g & 3]);
+	}
+	state0 = _mm_add_epi32(state0, save0);
+	state1 = _mm_add_epi32(state1, save1);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);	// FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);	// DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);	// DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);	// HGFE
+    _mm_storeu_si128((__m128i *) &h[0], state0);
+    _mm_storeu_si128((__m128i *) &h[4], state1);
+}
+#endif
+
+static inline void
+sha256_blocks(uint32_t *h, const uint8_t *p, size_t nblocks)
+{
+#if ESPCRYPTO_X86
+    if (ESPCrypto::features() & ESPCrypto::F_SHA) {
+	sha256_blocks_sha(h, p, nblocks);
+	return;
+    }
+#endif
+    sha256_blocks_portable(h, p, nblocks);
+}
+
+namespace {
+// Streaming SHA-256.  ESP's authenticated data starts 24 bytes before the
+// first cipher block, so chunks of ciphertext never line up with SHA-256
+// blocks; the context buffers the straddling bytes.
+struct SHA256Stream {
+    uint32_t h[8];
+    uint8_t buf[64];
+    unsigned nbuf;
+    uint64_t total;
+
+    SHA256Stream(const uint32_t *state, uint64_t prefix)
+	: nbuf(0), total(prefix) {
+	memcpy(h, state, sizeof(h));
+    }
+
+    void update(const uint8_t *p, size_t n) {
+	total += n;
+	if (nbuf) {
+	    size_t k = 64 - nbuf;
+	    if (n < k) {
+		memcpy(buf + nbuf, p, n);
+		nbuf += n;
+		return;
+	    }
+	    memcpy(buf + nbuf, p, k);
+	    sha256_blocks(h, buf, 1);
+	    p += k;
+	    n -= k;
+	    nbuf = 0;
+	}
+	if (n >= 64) {
+	    sha256_blocks(h, p, n / 64);
+	    p += n & ~(size_t) 63;
+	    n &= 63;
+	}
+	memcpy(buf, p, n);
+	nbuf = n;
+    }
+
+    void final(uint8_t *digest) {
+	uint64_t bits = total * 8;
+	buf[nbuf++] = 0x80;
+	if (nbuf > 56) {
+	    memset(buf + nbuf, 0, 64 - nbuf);
+	    sha256_blocks(h, buf, 1);
+	    nbuf = 0;
+	}
+	memset(buf + nbuf, 0, 56 - nbuf);
+	store_be64(buf + 56, bits);
+	sha256_blocks(h, buf, 1);
+	for (int i = 0; i < 8; ++i)
+	    store_be32(digest + 4 * i, h[i]);
+    }
+};
+}
+
+/** @brief Compute the SHA-256 digest of @a data. */
+void
+ESPCrypto::sha256(const uint8_t *data, int len, uint8_t *digest)
+{
+    SHA256Stream s(sha256_iv, 0);
+    s.update(data, len);
+    s.final(digest);
+}
+
+static void
+hmac_finish(const ESPCipherState &cs, SHA256Stream &inner, uint8_t *digest)
+{
+    uint8_t d[32];
+    inner.final(d);
+    SHA256Stream outer(cs.hmac_outer, 64);
+    outer.update(d, 32);
+    outer.final(digest);
+}
+
+/** @brief Compute HMAC-SHA-256 of @a data with @a cs's authentication key.
+ *
+ * Stores the full 32-byte MAC in @a digest. */
+void
+ESPCrypto::hmac_sha256(const ESPCipherState &cs, const uint8_t *data, int len,
+		       uint8_t *digest)
+{
+    SHA256Stream inner(cs.hmac_inner, 64);
+    inner.update(data, len);
+    hmac_finish(cs, inner, digest);
+}
+
+
+/*****************************************************************************
+ * GHASH, portable: Shoup's method with 4-bit tables.  A block is held as two
+ * big-endian 64-bit halves.  Multiplying by x shifts right by one bit.
+ */
+
+static uint64_t ghash_rem[16];
+
+static void
+ghash_init_rem()
+{
+    // ghash_rem[r] is the reduction term when the bits r are shifted out
+    // during multiplication by x^4.
+    for (int r = 0; r < 16; ++r) {
+	uint64_t hi = 0, lo = r;
+	for (int i = 0; i < 4; ++i) {
+	    uint64_t carry = lo & 1;
+	    lo = (lo >> 1) | (hi << 63);
+	    hi >>= 1;
+	    if (carry)
+		hi ^= 0xE100000000000000ULL;
+	}
+	ghash_rem[r] = hi;
+    }
+}
+
+static void
+ghash_table_setup(uint64_t table[16][2], const uint8_t *h)
+{
+    uint64_t hi = load_be64(h), lo = load_be64(h + 8);
+    memset(table, 0, 16 * 2 * sizeof(uint64_t));
+    for (int i = 8; i > 0; i >>= 1) {
+	table[i][0] = hi;
+	table[i][1] = lo;
+	uint64_t carry = lo & 1;
+	lo = (lo >> 1) | (hi << 63);
+	hi >>= 1;
+	if (carry)
+	    hi ^= 0xE100000000000000ULL;
+    }
+    for (int i = 2; i < 16; i <<= 1)
+	for (int j = 1; j < i; ++j) {
+	    table[i + j][0] = table[i][0] ^ table[j][0];
+	    table[i + j][1] = table[i][1] ^ table[j][1];
+	}
+}
+
+// y = (y ^ block) * H
+static void
+ghash_portable(uint64_t *y, const uint8_t *block, const uint64_t table[16][2])
+{
+    uint8_t x[16];
+    store_be64(x, y[0] ^ load_be64(block));
+    store_be64(x + 8, y[1] ^ load_be64(block + 8));
+    uint64_t zh = 0, zl = 0;
+    for (int k = 15; k >= 0; --k)
+	for (int half = 0; half < 2; ++half) {
+	    int nib = half ? x[k] >> 4 : x[k] & 15;
+	    unsigned r = zl & 15;
+	    zl = (zl >> 4) | (zh << 60);
+	    zh = (zh >> 4) ^ ghash_rem[r];
+	    zh ^= table[nib][0];
+	    zl ^= table[nib][1];
+	}
+    y[0] = zh;
+    y[1] = zl;
+}
+
+
+/*****************************************************************************
+ * AES-NI and PCLMULQDQ
+ */
+
+#if ESPCRYPTO_X86
+
+ESP_TARGET_AES static inline __m128i
+aes128_expand_step(__m128i k, __m128i t)
+{
+    t = _mm_shuffle_epi32(t, 0xFF);
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    return _mm_xor_si128(k, t);
+}
+
+ESP_TARGET_AES static void
+aes128_expand_ni(const uint8_t *key, uint8_t enc[11][16], uint8_t dec[11][16])
+{
+    __m128i k[11];
+    k[0] = _mm_loadu_si128((const __m128i *) key);
+# define EXPAND(i, rcon) k[i] = aes128_expand_step(k[i-1], _mm_aeskeygenassist_si128(k[i-1], rcon))
+    EXPAND(1, 0x01); EXPAND(2, 0x02); EXPAND(3, 0x04); EXPAND(4, 0x08);
+    EXPAND(5, 0x10); EXPAND(6, 0x20); EXPAND(7, 0x40); EXPAND(8, 0x80);
+    EXPAND(9, 0x1B); EXPAND(10, 0x36);
+# undef EXPAND
+    for (int i = 0; i < 11; ++i)
+	_mm_storeu_si128((__m128i *) enc[i], k[i]);
+    _mm_storeu_si128((__m128i *) dec[0], k[10]);
+    for (int i = 1; i < 10; ++i)
+	_mm_storeu_si128((__m128i *) dec[i], _mm_aesimc_si128(k[10 - i]));
+    _mm_storeu_si128((__m128i *) dec[10], k[0]);
+}
+
+namespace {
+struct NIKeys {
+    __m128i k[11];
+    ESP_TARGET_AES NIKeys(const uint8_t rk[11][16]) {
+	for (int i = 0; i < 11; ++i)
+	    k[i] = _mm_loadu_si128((const __m128i *) rk[i]);
+    }
+    ESP_TARGET_AES __m128i encrypt(__m128i x) const {
+	x = _mm_xor_si128(x, k[0]);
+	for (int i = 1; i < 10; ++i)
+	    x = _mm_aesenc_si128(x, k[i]);
+	return _mm_aesenclast_si128(x, k[10]);
+    }
+    ESP_TARGET_AES __m128i decrypt(__m128i x) const {
+	x = _mm_xor_si128(x, k[0]);
+	for (int i = 1; i < 10; ++i)
+	    x = _mm_aesdec_si128(x, k[i]);
+	return _mm_aesdeclast_si128(x, k[10]);
+    }
+};
+}
+
+ESP_TARGET_AES static inline __m128i
+bswap128(__m128i x)
+{
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+// Carry-less multiplication of byte-reversed GHASH blocks, accumulating the
+// 256-bit product in lo/mid/hi.  Several products can be accumulated and
+// then reduced once, since reduction is linear.
+ESP_TARGET_AES static inline void
+clmul_acc(__m128i a, __m128i b, __m128i &lo, __m128i &mid, __m128i &hi)
+{
+    lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, b, 0x00));
+    hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, b, 0x11));
+    mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x10));
+    mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x01));
+}
+
+// Shift the 256-bit product left by one bit (GHASH's bit order is reflected)
+// and reduce modulo x^128 + x^7 + x^2 + x + 1.
+ESP_TARGET_AES static inline __m128i
+ghash_reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+    __m128i t3 = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    __m128i t6 = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    __m128i t7 = _mm_srli_epi32(t3, 31);
+    __m128i t8 = _mm_srli_epi32(t6, 31);
+    t3 = _mm_slli_epi32(t3, 1);
+    t6 = _mm_slli_epi32(t6, 1);
+    __m128i t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    t3 = _mm_or_si128(t3, t7);
+    t6 = _mm_or_si128(t6, t8);
+    t6 = _mm_or_si128(t6, t9);
+    t7 = _mm_slli_epi32(t3, 31);
+    t8 = _mm_slli_epi32(t3, 30);
+    t9 = _mm_slli_epi32(t3, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    t3 = _mm_xor_si128(t3, t7);
+    __m128i t2 = _mm_srli_epi32(t3, 1);
+    __m128i t4 = _mm_srli_epi32(t3, 2);
+    __m128i t5 = _mm_srli_epi32(t3, 7);
+    t2 = _mm_xor_si128(t2, t4);
+    t2 = _mm_xor_si128(t2, t5);
+    t2 = _mm_xor_si128(t2, t8);
+    t3 = _mm_xor_si128(t3, t2);
+    return _mm_xor_si128(t6, t3);
+}
+
+ESP_TARGET_AES static inline __m128i
+gfmul(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_setzero_si128(), mid = lo, hi = lo;
+    clmul_acc(a, b, lo, mid, hi);
+    return ghash_reduce(lo, mid, hi);
+}
+
+ESP_TARGET_AES static void
+ghash_setup_ni(uint8_t h_pow[4][16], const uint8_t *h)
+{
+    __m128i h1 = bswap128(_mm_loadu_si128((const __m128i *) h));
+    __m128i hp = h1;
+    for (int i = 0; i < 4; ++i) {
+	_mm_storeu_si128((__m128i *) h_pow[i], hp);
+	hp = gfmul(hp, h1);
+    }
+}
+
+namespace {
+// GHASH state in the byte-reversed domain.
+struct NIGhash {
+    __m128i y, h1, h2, h3, h4;
+    ESP_TARGET_AES NIGhash(const uint8_t h_pow[4][16])
+	: y(_mm_setzero_si128()),
+	  h1(_mm_loadu_si128((const __m128i *) h_pow[0])),
+	  h2(_mm_loadu_si128((const __m128i *) h_pow[1])),
+	  h3(_mm_loadu_si128((const __m128i *) h_pow[2])),
+	  h4(_mm_loadu_si128((const __m128i *) h_pow[3])) {
+    }
+    ESP_TARGET_AES void update1(__m128i block) {
+	y = gfmul(_mm_xor_si128(y, bswap128(block)), h1);
+    }
+    ESP_TARGET_AES void update4(const __m128i *b) {
+	__m128i lo = _mm_setzero_si128(), mid = lo, hi = lo;
+	clmul_acc(_mm_xor_si128(y, bswap128(b[0])), h4, lo, mid, hi);
+	clmul_acc(bswap128(b[1]), h3, lo, mid, hi);
+	clmul_acc(bswap128(b[2]), h2, lo, mid, hi);
+	clmul_acc(bswap128(b[3]), h1, lo, mid, hi);
+	y = ghash_reduce(lo, mid, hi);
+    }
+};
+}
+
+ESP_TARGET_AES static inline __m128i
+ctr_block(__m128i j0, uint32_t ctr)
+{
+    return _mm_insert_epi32(j0, (int) __builtin_bswap32(ctr), 3);
+}
+
+ESP_TARGET_AES static inline __m128i
+load_partial(const uint8_t *p, int n)
+{
+    uint8_t b[16];
+    memset(b, 0, sizeof(b));
+    memcpy(b, p, n);
+    return _mm_loadu_si128((const __m128i *) b);
+}
+
+// AES-GCM: CTR encryption eight blocks at a time, each chunk hashed while
+// hot.  When decrypting, a chunk is hashed before it is decrypted.
+ESP_TARGET_AES static void
+gcm_ni(const ESPCipherState &cs, uint8_t *esp, int len, bool decrypt,
+       uint8_t *tag)
+{
+    NIKeys keys(cs.ni_enc);
+    NIGhash gh(cs.h_pow);
+    uint8_t j0b[16];
+    memcpy(j0b, cs.salt, 4);
+    memcpy(j0b + 4, esp + 8, 8);
+    store_be32(j0b + 12, 1);
+    __m128i j0 = _mm_loadu_si128((const __m128i *) j0b);
+
+    gh.update1(load_partial(esp, 8));	// AAD: SPI and sequence number
+
+    uint8_t *data = esp + 16;
+    uint32_t ctr = 2;
+    int pos = 0;
+    for (; pos + 128 <= len; pos += 128, ctr += 8) {
+	__m128i *d = (__m128i *) (data + pos);
+	__m128i c[8], x[8];
+	for (int i = 0; i < 8; ++i)
+	    c[i] = _mm_loadu_si128(d + i);
+	if (decrypt) {
+	    gh.update4(c);
+	    gh.update4(c + 4);
+	}
+	for (int i = 0; i < 8; ++i)
+	    x[i] = _mm_xor_si128(ctr_block(j0, ctr + i), keys.k[0]);
+	for (int r = 1; r < 10; ++r)
+	    for (int i = 0; i < 8; ++i)
+		x[i] = _mm_aesenc_si128(x[i], keys.k[r]);
+	for (int i = 0; i < 8; ++i) {
+	    x[i] = _mm_xor_si128(_mm_aesenclast_si128(x[i], keys.k[10]), c[i]);
+	    _mm_storeu_si128(d + i, x[i]);
+	}
+	if (!decrypt) {
+	    gh.update4(x);
+	    gh.update4(x + 4);
+	}
+    }
+    for (; pos < len; pos += 16, ++ctr) {
+	int n = len - pos < 16 ? len - pos : 16;
+	__m128i c = load_partial(data + pos, n);
+	if (decrypt)
+	    gh.update1(c);
+	__m128i x = _mm_xor_si128(keys.encrypt(ctr_block(j0, ctr)), c);
+	uint8_t b[16];
+	_mm_storeu_si128((__m128i *) b, x);
+	memcpy(data + pos, b, n);
+	if (!decrypt)
+	    gh.update1(load_partial(b, n));
+    }
+
+    uint8_t lens[16];
+    store_be64(lens, 8 * 8);
+    store_be64(lens + 8, (uint64_t) len * 8);
+    gh.update1(_mm_loadu_si128((const __m128i *) lens));
+    __m128i t = _mm_xor_si128(bswap128(gh.y), keys.encrypt(j0));
+    _mm_storeu_si128((__m128i *) tag, t);
+}
+
+// AES-CBC with HMAC-SHA-256.  Encryption is serial; decryption runs four
+// blocks in parallel.
+ESP_TARGET_AES static void
+cbc_encrypt_ni(const ESPCipherState &cs, uint8_t *data, int len,
+	       SHA256Stream &mac)
+{
+    NIKeys keys(cs.ni_enc);
+    __m128i prev = _mm_loadu_si128((const __m128i *) (data - 16));
+    for (int pos = 0; pos < len; pos += 64) {
+	int end = pos + 64 < len ? pos + 64 : len;
+	for (int i = pos; i < end; i += 16) {
+	    __m128i *d = (__m128i *) (data + i);
+	    prev = keys.encrypt(_mm_xor_si128(_mm_loadu_si128(d), prev));
+	    _mm_storeu_si128(d, prev);
+	}
+	mac.update(data + pos, end - pos);
+    }
+}
+
+ESP_TARGET_AES static void
+cbc_decrypt_ni(const ESPCipherState &cs, uint8_t *data, int len,
+	       SHA256Stream &mac)
+{
+    NIKeys keys(cs.ni_dec);
+    __m128i prev = _mm_loadu_si128((const __m128i *) (data - 16));
+    int pos = 0;
+    for (; pos + 64 <= len; pos += 64) {
+	mac.update(data + pos, 64);
+	__m128i *d = (__m128i *) (data + pos);
+	__m128i c[4], x[4];
+	for (int i = 0; i < 4; ++i) {
+	    c[i] = _mm_loadu_si128(d + i);
+	    x[i] = _mm_xor_si128(c[i], keys.k[0]);
+	}
+	for (int r = 1; r < 10; ++r)
+	    for (int i = 0; i < 4; ++i)
+		x[i] = _mm_aesdec_si128(x[i], keys.k[r]);
+	for (int i = 0; i < 4; ++i) {
+	    x[i] = _mm_xor_si128(_mm_aesdeclast_si128(x[i], keys.k[10]), prev);
+	    _mm_storeu_si128(d + i, x[i]);
+	    prev = c[i];
+	}
+    }
+    if (pos < len)
+	mac.update(data + pos, len - pos);
+    for (; pos < len; pos += 16) {
+	__m128i *d = (__m128i *) (data + pos);
+	__m128i c = _mm_loadu_si128(d);
+	_mm_storeu_si128(d, _mm_xor_si128(keys.decrypt(c), prev));
+	prev = c;
+    }
+}
+
+ESP_TARGET_AES static void
+aes_encrypt_ni(const uint8_t rk[11][16], const uint8_t *in, uint8_t *out)
+{
+    NIKeys keys(rk);
+    _mm_storeu_si128((__m128i *) out, keys.encrypt(_mm_loadu_si128((const __m128i *) in)));
+}
+
+#endif
+
+
+/*****************************************************************************
+ * Portable AES-GCM and AES-CBC
+ */
+
+static void
+gcm_portable(const ESPCipherState &cs, uint8_t *esp, int len, bool decrypt,
+	     uint8_t *tag)
+{
+    uint8_t j0[16], ctr[16], ks[16], b[16];
+    memcpy(j0, cs.salt, 4);
+    memcpy(j0 + 4, esp + 8, 8);
+    store_be32(j0 + 12, 1);
+    memcpy(ctr, j0, 16);
+
+    uint64_t y[2] = { 0, 0 };
+    memset(b, 0, sizeof(b));
+    memcpy(b, esp, 8);
+    ghash_portable(y, b, cs.h_table);
+
+    uint8_t *data = esp + 16;
+    uint32_t c = 2;
+    for (int pos = 0; pos < len; pos += 16, ++c) {
+	int n = len - pos < 16 ? len - pos : 16;
+	memset(b, 0, sizeof(b));
+	memcpy(b, data + pos, n);
+	if (decrypt)
+	    ghash_portable(y, b, cs.h_table);
+	store_be32(ctr + 12, c);
+	Aes::AES_encrypt(ctr, ks, &cs.enc);
+	for (int i = 0; i < n; ++i)
+	    data[pos + i] = b[i] ^= ks[i];
+	if (!decrypt) {
+	    memset(b + n, 0, 16 - n);
+	    ghash_portable(y, b, cs.h_table);
+	}
+    }
+
+    store_be64(b, 8 * 8);
+    store_be64(b + 8, (uint64_t) len * 8);
+    ghash_portable(y, b, cs.h_table);
+    Aes::AES_encrypt(j0, ks, &cs.enc);
+    store_be64(tag, y[0]);
+    store_be64(tag + 8, y[1]);
+    for (int i = 0; i < 16; ++i)
+	tag[i] ^= ks[i];
+}
+
+static void
+cbc_encrypt_portable(const ESPCipherState &cs, uint8_t *data, int len,
+		     SHA256Stream &mac)
+{
+    const uint8_t *prev = data - 16;
+    for (int pos = 0; pos < len; pos += 64) {
+	int end = pos + 64 < len ? pos + 64 : len;
+	for (int i = pos; i < end; i += 16) {
+	    for (int j = 0; j < 16; ++j)
+		data[i + j] ^= prev[j];
+	    Aes::AES_encrypt(data + i, data + i, &cs.enc);
+	    prev = data + i;
+	}
+	mac.update(data + pos, end - pos);
+    }
+}
+
+static void
+cbc_decrypt_portable(const ESPCipherState &cs, uint8_t *data, int len,
+		     SHA256Stream &mac)
+{
+    uint8_t prev[16], c[16];
+    memcpy(prev, data - 16, 16);
+    for (int pos = 0; pos < len; pos += 16) {
+	mac.update(data + pos, 16);
+	memcpy(c, data + pos, 16);
+	Aes::AES_decrypt(data + pos, data + pos, &cs.dec);
+	for (int j = 0; j < 16; ++j)
+	    data[pos + j] ^= prev[j];
+	memcpy(prev, c, 16);
+    }
+}
+
+
+/*****************************************************************************
+ * Suites
+ */
+
+/** @brief Expand keys for @a suite into @a cs.
+ *
+ * @a enc_key is 16 bytes and @a auth_key is auth_key_length(@a suite) bytes.
+ * For AES-GCM, the first four bytes of @a auth_key are the nonce salt; for
+ * AES-CBC, @a auth_key is the 32-byte HMAC key. */
+void
+ESPCrypto::setup(ESPCipherState &cs, int suite, const uint8_t *enc_key,
+		 const uint8_t *auth_key)
+{
+    memset(&cs, 0, sizeof(cs));
+    cs.suite = suite;
+    if (suite == S_LEGACY)
+	return;
+    if (!ghash_rem[1])
+	ghash_init_rem();
+
+    Aes::AES_set_encrypt_key(enc_key, 128, &cs.enc);
+    Aes::AES_set_decrypt_key(enc_key, 128, &cs.dec);
+#if ESPCRYPTO_X86
+    if (cpu_features() & F_AESNI)
+	aes128_expand_ni(enc_key, cs.ni_enc, cs.ni_dec);
+#endif
+
+    if (suite == S_AES_GCM) {
+	memcpy(cs.salt, auth_key, 4);
+	uint8_t h[16];
+	memset(h, 0, sizeof(h));
+	Aes::AES_encrypt(h, h, &cs.enc);
+	ghash_table_setup(cs.h_table, h);
+#if ESPCRYPTO_X86
+	if (cpu_features() & F_PCLMUL)
+	    ghash_setup_ni(cs.h_pow, h);
+#endif
+    } else {
+	uint8_t pad[64];
+	memset(pad, 0x36, sizeof(pad));
+	for (int i = 0; i < auth_key_length(suite); ++i)
+	    pad[i] ^= auth_key[i];
+	memcpy(cs.hmac_inner, sha256_iv, sizeof(sha256_iv));
+	sha256_blocks_portable(cs.hmac_inner, pad, 1);
+	for (int i = 0; i < 64; ++i)
+	    pad[i] ^= 0x36 ^ 0x5c;
+	memcpy(cs.hmac_outer, sha256_iv, sizeof(sha256_iv));
+	sha256_blocks_portable(cs.hmac_outer, pad, 1);
+    }
+}
+
+/** @brief Encrypt and authenticate an ESP packet in place.
+ * @param cs SA key material
+ * @param esp ESP header, with SPI and sequence number already set
+ * @param len length of the data to encrypt: payload, padding, pad length and
+ * next header; a multiple of block_size()
+ * @param iv_seed value unique to this packet under this SA
+ *
+ * Writes the IV after the ESP header and the ICV after the encrypted data.
+ * The IV for AES-GCM is @a iv_seed itself; for AES-CBC it is @a iv_seed
+ * encrypted, so that it is unpredictable. */
+void
+ESPCrypto::seal(const ESPCipherState &cs, uint8_t *esp, int len,
+		uint64_t iv_seed)
+{
+    unsigned f = features();
+    if (cs.suite == S_AES_GCM) {
+	store_be64(esp + 8, iv_seed);
+	uint8_t *icv = esp + 16 + len;
+#if ESPCRYPTO_X86
+	if ((f & (F_AESNI | F_PCLMUL)) == (F_AESNI | F_PCLMUL)) {
+	    gcm_ni(cs, esp, len, false, icv);
+	    return;
+	}
+#endif
+	gcm_portable(cs, esp, len, false, icv);
+    } else {
+	uint8_t *iv = esp + 8;
+	memset(iv, 0, 16);
+	store_be64(iv, iv_seed);
+	SHA256Stream mac(cs.hmac_inner, 64);
+#if ESPCRYPTO_X86
+	if (f & F_AESNI) {
+	    aes_encrypt_ni(cs.ni_enc, iv, iv);
+	    mac.update(esp, 24);
+	    cbc_encrypt_ni(cs, esp + 24, len, mac);
+	} else
+#endif
+	{
+	    Aes::AES_encrypt(iv, iv, &cs.enc);
+	    mac.update(esp, 24);
+	    cbc_encrypt_portable(cs, esp + 24, len, mac);
+	}
+	uint8_t digest[32];
+	hmac_finish(cs, mac, digest);
+	memcpy(esp + 24 + len, digest, ICV_LEN);
+    }
+    (void) f;
+}
+
+/** @brief Verify and decrypt an ESP packet in place.
+ * @param cs SA key material
+ * @param esp ESP header
+ * @param len length of the encrypted data, between the IV and the ICV
+ * @return true if the ICV was valid
+ *
+ * If the ICV is invalid, the decrypted data is garbage and the packet should
+ * be dropped. */
+bool
+ESPCrypto::open(const ESPCipherState &cs, uint8_t *esp, int len)
+{
+    unsigned f = features();
+    uint8_t icv[32];
+    if (cs.suite == S_AES_GCM) {
+#if ESPCRYPTO_X86
+	if ((f & (F_AESNI | F_PCLMUL)) == (F_AESNI | F_PCLMUL))
+	    gcm_ni(cs, esp, len, true, icv);
+	else
+#endif
+	    gcm_portable(cs, esp, len, true, icv);
+	return icv_equal(icv, esp + 16 + len);
+    } else {
+	if (len % 16)
+	    return false;
+	SHA256Stream mac(cs.hmac_inner, 64);
+	mac.update(esp, 24);
+#if ESPCRYPTO_X86
+	if (f & F_AESNI)
+	    cbc_decrypt_ni(cs, esp + 24, len, mac);
+	else
+#endif
+	    cbc_decrypt_portable(cs, esp + 24, len, mac);
+	hmac_finish(cs, mac, icv);
+	return icv_equal(icv, esp + 24 + len);
+    }
+    (void) f;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(Aes)
+ELEMENT_PROVIDES(IPsecESPCrypto)
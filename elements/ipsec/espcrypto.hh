@@ -0,0 +1,103 @@
+#ifndef CLICK_ESPCRYPTO_HH
+#define CLICK_ESPCRYPTO_HH
+#include <click/glue.hh>
+#include <click/string.hh>
+#include "aes.hh"
+CLICK_DECLS
+
+/*
+ * espcrypto.{cc,hh} -- ESP cipher suites for IPsecESPEncap/IPsecESPUnencap
+ *
+ * Two suites are supported, AES-128-GCM with a 16-byte ICV (RFC 4106) and
+ * AES-128-CBC with HMAC-SHA-256-128 (RFC 3602, RFC 4868).  Each packet is
+ * encrypted and authenticated in one pass: the cipher works through the
+ * payload a few blocks at a time, and each chunk is authenticated while it
+ * is still in the L1 cache.  AES-NI, PCLMULQDQ and the SHA extensions are
+ * used when the CPU has them; otherwise portable table-based code runs.
+ */
+
+/** @brief Per-SA key material, expanded once when the SA is created. */
+struct ESPCipherState {
+    int suite;
+    uint8_t salt[4];			// GCM nonce salt
+    // AES-NI round keys; decryption keys for CBC only
+    uint8_t ni_enc[11][16];
+    uint8_t ni_dec[11][16];
+    // portable round keys
+    AES_KEY enc;
+    AES_KEY dec;
+    // GHASH key: byte-reversed powers H^1..H^4 for PCLMULQDQ, and the
+    // 4-bit multiplication table for portable code
+    uint8_t h_pow[4][16];
+    uint64_t h_table[16][2];
+    // HMAC-SHA-256 inner and outer states after the padded key block
+    uint32_t hmac_inner[8];
+    uint32_t hmac_outer[8];
+};
+
+class ESPCrypto { public:
+
+    enum {
+	S_LEGACY = 0,			///< separate IPsecAES/IPsecDES and
+					///  IPsecAuthHMACSHA1 elements
+	S_AES_GCM = 1,			///< AES-128-GCM, 16-byte ICV
+	S_AES_CBC_HMAC_SHA256 = 2	///< AES-128-CBC, HMAC-SHA-256-128
+    };
+
+    enum {
+	F_AESNI = 1, F_PCLMUL = 2, F_SHA = 4
+    };
+
+    enum { ICV_LEN = 16, MAX_IV_LEN = 16, MAX_AUTH_KEY_LEN = 32 };
+
+    static bool parse_suite(const String &str, int &suite);
+    static const char *suite_name(int suite);
+
+    /** @brief Return the length of the explicit IV carried in each packet. */
+    static int iv_length(int suite) {
+	return suite == S_AES_GCM ? 8 : 16;
+    }
+    /** @brief Return the length of the authentication key.
+     *
+     * HMAC-SHA-256-128 takes a 32-byte key (RFC 4868); the other suites take
+     * 16 bytes, of which AES-GCM uses the first four as nonce salt. */
+    static int auth_key_length(int suite) {
+	return suite == S_AES_CBC_HMAC_SHA256 ? 32 : 16;
+    }
+    /** @brief Return the block size to which the encrypted payload, pad
+     * length and next header bytes are padded. */
+    static int block_size(int suite) {
+	return suite == S_AES_GCM ? 4 : 16;
+    }
+
+    /** @brief Return the CPU features that the current CPU supports. */
+    static unsigned cpu_features();
+    /** @brief Return the CPU features currently in use. */
+    static unsigned features() {
+	return _features < 0 ? detect() : _features;
+    }
+    /** @brief Use only the CPU features in @a mask (for testing and
+     * benchmarks). */
+    static void set_features(unsigned mask);
+
+    static void setup(ESPCipherState &cs, int suite, const uint8_t *enc_key,
+		      const uint8_t *auth_key);
+
+    static void seal(const ESPCipherState &cs, uint8_t *esp, int len,
+		     uint64_t iv_seed);
+    static bool open(const ESPCipherState &cs, uint8_t *esp, int len);
+
+    static void sha256(const uint8_t *data, int len, uint8_t *digest);
+    static void hmac_sha256(const ESPCipherState &cs, const uint8_t *data,
+			    int len, uint8_t *digest);
+
+  private:
+
+    static int _features;
+
+    static unsigned detect();
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -61,6 +61,11 @@ IPsecAuthHMACSHA1::initialize(ErrorHandler *)
 Packet *
 IPsecAuthHMACSHA1::simple_action(Packet *p)
 {
+  // packets of combined-mode SAs are protected by IPsecESPEncap
+  const SADataTuple *sa = (const SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p);
+  if (sa && sa->suite() != ESPCrypto::S_LEGACY)
+    return p;
+
   SADataTuple * sa_data=(SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p);
   unsigned int len;
   // compute HMAC
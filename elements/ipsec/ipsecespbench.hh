@@ -0,0 +1,98 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPSECESPBENCH_HH
+#define CLICK_IPSECESPBENCH_HH
+#include <click/element.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+IPsecESPBench([I<keywords> N, ROUNDS, SIZES])
+
+=s ipsec
+
+benchmarks ESP cipher suites
+
+=d
+
+IPsecESPBench measures the combined-mode ESP cipher suites used by
+IPsecESPEncap and IPsecESPUnencap at initialization time.  It does not route
+packets.
+
+First it runs known-answer tests for SHA-256, HMAC-SHA-256, AES-GCM and
+AES-CBC with HMAC-SHA-256, using both the portable code and the
+CPU-accelerated code (AES-NI, PCLMULQDQ and the SHA extensions), and checks
+that the two produce identical packets for a range of payload lengths.  If any
+test fails, the router fails to initialize.
+
+Then, for each suite, implementation and payload size, it times sealing
+(encrypting and computing the ICV) and opening (verifying and decrypting) N
+packets.  Each measurement is repeated ROUNDS times and the fastest round is
+reported.  On CPUs without the relevant instructions, the "accelerated"
+measurements run the portable code.
+
+Keyword arguments are:
+
+=over 8
+
+=item N
+
+Integer. Number of packets per measurement. Default is 20000.
+
+=item ROUNDS
+
+Integer. Number of times to repeat each measurement. Default is 3.
+
+=item SIZES
+
+Space-separated list of integers. ESP payload sizes to measure, in bytes.
+Default is "64 576 1500".
+
+=back
+
+=h results read-only
+
+Returns the measurements as CSV, with header line
+"suite,impl,op,size,ns_per_packet,gbps".
+
+=h features read-only
+
+Returns the accelerated features the CPU supports: some of "aesni", "pclmul"
+and "sha".
+
+=e
+
+  click -qe 'b :: IPsecESPBench(N 100000)' -h b.results
+
+=a
+
+IPsecESPEncap, IPsecESPUnencap, IPsecRouteTable */
+
+class IPsecESPBench : public Element { public:
+
+    IPsecESPBench();
+
+    const char *class_name() const		{ return "IPsecESPBench"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+  private:
+
+    uint32_t _n;
+    uint32_t _rounds;
+    Vector<int> _sizes;
+    String _results;
+
+    int self_test(ErrorHandler *errh);
+    void bench(int suite, unsigned features, const char *impl, int size,
+	       StringAccum &sa);
+
+    static String read_features(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
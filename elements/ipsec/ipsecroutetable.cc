@@ -47,6 +47,7 @@ cp_ipsec_route(String s, IPsecRoute *r_store, bool remove_route, Element *contex
     //Data to initialize the SADataTuple
     unsigned int replay;
     uint8_t  oowin;
+    int suite = ESPCrypto::S_LEGACY;
 
     SADataTuple * sa_data;
 
@@ -80,22 +81,28 @@ cp_ipsec_route(String s, IPsecRoute *r_store, bool remove_route, Element *contex
     Vector<String> words;
     words.push_back(word);
     cp_spacevec(s, words);
-    String enc_key, auth_key;
+    String enc_key, auth_key, suite_name;
     if (Args(words, context, ErrorHandler::default_handler())
 	.read_mp("SPI", r.spi)
 	.read_mp("ENCRYPT_KEY", enc_key)
 	.read_mp("AUTH_KEY", auth_key)
 	.read_mp("REPLAY", replay)
 	.read_mp("OOSIZE", oowin)
+	.read_p("SUITE", WordArg(), suite_name)
 	.complete() < 0)
 	return false;
-    if (enc_key.length() != 16 || auth_key.length() != 16) {
+    if (suite_name && !ESPCrypto::parse_suite(suite_name, suite)) {
+	click_chatter("unknown ESP cipher suite %s", suite_name.c_str());
+	return false;
+    }
+    if (enc_key.length() != 16
+	|| auth_key.length() != ESPCrypto::auth_key_length(suite)) {
 	click_chatter("key has bad length");
 	return false;
     }
 
     // Create new Security Association Table entry
-    sa_data = new SADataTuple(enc_key.data(), auth_key.data(), replay, oowin);
+    sa_data = new SADataTuple(enc_key.data(), auth_key.data(), replay, oowin, suite);
     ((IPsecRouteTable*)context)->_sa_table.insert(SPI(r.spi),*sa_data);
     //Set Tuple reference in the Routing entry
     r.sa_data = sa_data;
@@ -127,7 +134,10 @@ IPsecRoute::unparse(StringAccum& sa, bool tabs) const
     if(spi != 0) {
 	sa << "  |TUNNELED CONNECTION| \n|SPI| |ENC KEY| |AUTH KEY| ||\n";
 	sa << " |" <<spi<<"|";
-	sa << sa_data->unparse_entries().c_str() <<"\n";
+	sa << sa_data->unparse_entries().c_str();
+	if (sa_data->suite() != ESPCrypto::S_LEGACY)
+	    sa << " |" << ESPCrypto::suite_name(sa_data->suite()) << "|";
+	sa << "\n";
     }
     return sa;
 }
@@ -387,4 +397,5 @@ IPsecRouteTable::add_handlers()
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecESPCrypto)
 ELEMENT_PROVIDES(IPsecRouteTable)
@@ -25,6 +25,30 @@ function uses those virtual functions to look up routes and output packets
 accordingly. There are also some functions useful for implementing handlers.
 IPsecRouteTable also supports IPsec ESP tunnels between gateways.
 
+A tunneled route has the form `C<ADDR/MASK [GW] OUT SPI ENCRYPT_KEY AUTH_KEY
+REPLAY OOSIZE [SUITE]>'.  The keys are 16 characters each, except that
+AUTH_KEY is 32 characters for C<aes-cbc-hmac-sha256>.  SUITE selects how
+IPsecESPEncap and IPsecESPUnencap protect the tunnel's packets:
+
+=over 8
+
+=item C<legacy>
+
+The default.  ESP encapsulation only; encryption and authentication are left
+to separate elements such as IPsecAES and IPsecAuthHMACSHA1.
+
+=item C<aes-gcm>
+
+AES-128-GCM with a 16-byte ICV (RFC 4106).  The first four bytes of AUTH_KEY
+are the nonce salt.
+
+=item C<aes-cbc-hmac-sha256>
+
+AES-128-CBC with HMAC-SHA-256-128 (RFC 3602, RFC 4868).  AUTH_KEY is the
+32-byte HMAC key.
+
+=back
+
 
 
 =head1 PERFORMANCE
@@ -5,6 +5,8 @@
 #include <click/etheraddress.hh>
 #include <click/bighashmap.hh>
 #include <click/glue.hh>
+#include <click/atomic.hh>
+#include "espcrypto.hh"
 CLICK_DECLS
 
 /*
@@ -67,54 +69,154 @@ class SPI {
 	uint32_t _spi;
  };
 
+/* Anti-replay window (RFC 4303 section 3.4.3) that many threads can update
+   at once without locks.  Rather than shifting one bitmap, the window is a
+   ring of words, each holding a 16-bit tag naming the block of 16 sequence
+   numbers it covers and a 16-bit bitmap of the numbers seen in that block.
+   Marking a sequence number is a single compare-and-swap on its word; a word
+   whose tag is older than the block being marked is recycled in the same
+   step, so advancing the window never clears words in bulk (compare
+   RFC 6479).  The ring covers more than the largest window (255), so words
+   within the window are never shared by two live blocks. */
+class ESPReplayWindow {
+  public:
+
+    enum { BLOCK_BITS = 16, NWORDS = 256 / BLOCK_BITS + 1 };
+    enum { ACCEPT = 0, TOO_OLD = 1, SEEN = 2 };
+
+    /* Each word starts out tagged with a block between 2*NWORDS-1 and
+       NWORDS blocks before start's, so that every block the window can
+       accept is newer and recycles it.  (A zero tag would look newer than
+       every block once start/BLOCK_BITS reached 0x8000.) */
+    void reset(uint32_t start) {
+	_top = start;
+	int64_t b0 = start / BLOCK_BITS;
+	for (int i = 0; i < NWORDS; ++i) {
+	    int64_t r = ((b0 - i) % NWORDS + NWORDS) % NWORDS;
+	    uint32_t tag = (uint32_t) (b0 - NWORDS - r) & 0xFFFF;
+	    _words[i] = tag << 16;
+	}
+    }
+
+    /* Check and record sequence number seq.  Returns ACCEPT if seq is new
+       and within window sequence numbers of the highest seen. */
+    int check(uint32_t seq, uint32_t window) {
+	uint32_t top = _top.value();
+	if (seq < top && top - seq >= window)
+	    return TOO_OLD;
+
+	uint32_t block = seq / BLOCK_BITS;
+	uint32_t tag = block & 0xFFFF;
+	uint32_t bit = 1U << (seq % BLOCK_BITS);
+	atomic_uint32_t &word = _words[block % NWORDS];
+	while (1) {
+	    uint32_t old = word.value(), next;
+	    int16_t age = (int16_t) (tag - (old >> 16));
+	    if (age < 0)		/* word recycled by a newer block */
+		return TOO_OLD;
+	    else if (age > 0)		/* stale word: recycle it */
+		next = (tag << 16) | bit;
+	    else if (old & bit)
+		return SEEN;
+	    else
+		next = old | bit;
+	    if (word.compare_swap(old, next) == old)
+		break;
+	}
+
+	while (seq > top) {
+	    uint32_t prev = _top.compare_swap(top, seq);
+	    if (prev == top)
+		break;
+	    top = prev;
+	}
+	return ACCEPT;
+    }
+
+    uint32_t top() const {
+	return _top.value();
+    }
+
+  private:
+
+    atomic_uint32_t _top;		/* highest sequence number seen */
+    atomic_uint32_t _words[NWORDS];
+
+};
+
 // Security Association Data Tuple
 class SADataTuple {
   public:
 
     //SA Data must be added here...
     uint8_t Encryption_key[KEY_SIZE]; // The Data key
-    uint8_t Authentication_key[KEY_SIZE];//The Authentication key
+    uint8_t Authentication_key[ESPCrypto::MAX_AUTH_KEY_LEN];//The Authentication key; ESPCrypto::auth_key_length(suite()) bytes
     /*These fields below deal with replay protection*/
     uint32_t replay_start_counter;
-    uint32_t cur_rpl;
     uint8_t  ooowin;	/* out-of-order window size */
-    uint32_t bitmap;	/* Support out-of-order receive support */
-    uint32_t lastseq;	/* in host order */
+    uint64_t iv_base;	/* per-SA IV offset */
+    /*Outbound: packets sent so far. Threads allocate sequence numbers with
+      an atomic add, so several threads can encapsulate for one tunnel.*/
+    atomic_uint32_t out_count;
+    /*Combined-mode cipher suite (ESPCrypto::S_LEGACY for separate elements).
+      The expanded keys are read-only; they also keep the outbound counter
+      and the inbound window on different cache lines.*/
+    ESPCipherState cipher;
+    /*Inbound: anti-replay state*/
+    ESPReplayWindow replay;
 
     SADataTuple() {
 	memset(this, 0, sizeof(*this));
     }
 
-    SADataTuple(const void * enc_key , const void * Auth_key, uint32_t counter, uint8_t o_oowin)
+    SADataTuple(const void * enc_key , const void * Auth_key, uint32_t counter, uint8_t o_oowin, int suite = ESPCrypto::S_LEGACY)
      {
 		memset(this, 0, sizeof(*this));
 		memcpy(Encryption_key, enc_key, KEY_SIZE);
-		memcpy(Authentication_key, Auth_key, KEY_SIZE);
+		memcpy(Authentication_key, Auth_key, ESPCrypto::auth_key_length(suite));
 		replay_start_counter = counter;
 		ooowin = o_oowin;
-	        bitmap=0;
-		lastseq=cur_rpl=counter;
+		out_count = 0;
+		replay.reset(counter);
+		ESPCrypto::setup(cipher, suite, Encryption_key, Authentication_key);
+		// an SA re-added with the same key must not reuse GCM nonces
+		iv_base = ((uint64_t) click_random() << 32) ^ click_random();
+     }
+
+     int suite() const
+     {
+         return cipher.suite;
+     }
+
+     /*Allocate the next outbound sequence number. The SA must be rekeyed
+       before 2^32 packets; after that, sequence numbers (and IVs) repeat.*/
+     uint32_t next_sequence(uint64_t &iv_seed)
+     {
+         uint32_t n = out_count.fetch_and_add(1);
+         iv_seed = iv_base + n;
+         return replay_start_counter + n;
      }
 
      operator bool() const
      {
-         return ((cur_rpl != 0));
+         return ((replay_start_counter != 0));
      }
 
 String unparse_entries() const
      {
-         char buf[71];
+         char buf[38 + 2 * ESPCrypto::MAX_AUTH_KEY_LEN];
 	 int i,j;
+	 int alen = ESPCrypto::auth_key_length(suite());
 	 sprintf(buf," |");
 	 for(i=0,j=0;i<16;i++,j+=2) {
 		sprintf(&buf[2+j],"%02x",Encryption_key[i]);
 	 }
 	 sprintf(&buf[34],"| |");
-	 for(i=0,j=0;i<16;i++,j+=2) {
+	 for(i=0,j=0;i<alen;i++,j+=2) {
 		sprintf(&buf[37+j],"%02x",Authentication_key[i]);
 	 }
-	 sprintf(&buf[69],"|");
-         return String(buf, 70);
+	 sprintf(&buf[37+j],"|");
+         return String(buf, 38+j);
     }
 };
 
@@ -33,6 +33,9 @@ SATable::SATable()
 
 SATable::~SATable()
 {
+  for (int i = 0; i < NSHARDS; i++)
+    for (SIter iter = _shards[i].table.begin(); iter.live(); iter++)
+      delete iter.value();
 }
 
 /*Get a reference to SA Data*/
@@ -44,7 +47,10 @@ SATable::lookup(SPI this_spi)
     return NULL;
   }
   //retrieve security association
-  SADataTuple  *dat = _table.findp(this_spi);
+  Shard &sh = _shards[shard_of(this_spi)];
+  sh.lock.acquire_read();
+  SADataTuple *dat = sh.table.find(this_spi, 0);
+  sh.lock.release_read();
   return dat;
 }
 
@@ -56,10 +62,11 @@ SATable::insert(SPI spi , SADataTuple SA_data)
     click_chatter("SATable %s: Attempt to insert data failed. Invalid arguments\n",name().c_str());
     return -1;
   }
-  SADataTuple * dat = _table.findp(spi);
-  if (!dat) {
-    _table.insert(spi, SA_data);
-  }
+  Shard &sh = _shards[shard_of(spi)];
+  sh.lock.acquire_write();
+  if (!sh.table.find(spi, 0))
+    sh.table.insert(spi, new SADataTuple(SA_data));
+  sh.lock.release_write();
   return 0;
 }
 
@@ -71,13 +78,17 @@ SATable::remove(unsigned int spi)
 	click_chatter("Invalid SPI parameter");
 	return -1;
   }
-  SADataTuple  *dat = _table.findp(spi);
+  Shard &sh = _shards[shard_of(SPI(spi))];
+  sh.lock.acquire_write();
+  SADataTuple *dat = sh.table.find(SPI(spi), 0);
+  if (dat)
+    sh.table.remove(SPI(spi));
+  sh.lock.release_write();
   if(!dat) {
 	click_chatter("No such entry");
 	return -1;
   }
   delete dat;
-  _table.remove(SPI(spi));
 
   return 0;
 }
@@ -88,15 +99,19 @@ SATable::print_sa_data()
 {
   StringAccum sa;
   int k;
-  for (SIter iter = _table.begin(); iter.live(); iter++) {
-    SADataTuple n = iter.value();
-    sa << "\nNew Entry\n";
-    for(k=0; k< 16;k++)
-	{sa << n.Encryption_key[k];}
-    sa <<" ";
-    for(k=0; k< 16;k++)
-        {sa << n.Authentication_key[k];}
-    sa << " ";
+  for (int i = 0; i < NSHARDS; i++) {
+    _shards[i].lock.acquire_read();
+    for (SIter iter = _shards[i].table.begin(); iter.live(); iter++) {
+      const SADataTuple &n = *iter.value();
+      sa << "\nNew Entry\n";
+      for(k=0; k< 16;k++)
+	  {sa << n.Encryption_key[k];}
+      sa <<" ";
+      for(k=0; k< ESPCrypto::auth_key_length(n.suite());k++)
+	  {sa << n.Authentication_key[k];}
+      sa << " ";
+    }
+    _shards[i].lock.release_read();
   }
   return sa.take_string();
 }
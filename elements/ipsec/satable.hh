@@ -5,10 +5,16 @@
 #include <click/etheraddress.hh>
 #include <click/bighashmap.hh>
 #include <click/glue.hh>
+#include <click/sync.hh>
 #include "sadatatuple.hh"
 
 CLICK_DECLS
 
+/* SATable stores security associations by SPI.  The table is split into
+   shards by SPI, each with its own lock, so that threads looking up
+   different tunnels do not contend.  Entries are allocated individually and
+   never move, so the pointer returned by lookup() stays valid until the
+   entry is removed. */
 class SATable : public Element { public:
 
   SATable();
@@ -21,10 +27,22 @@ class SATable : public Element { public:
   SADataTuple * lookup(SPI this_spi);
 
 private:
+  enum { NSHARDS = 16 };
+
   //Defines a click hashmap object the SA table in our case
-  typedef HashMap<SPI,SADataTuple> STable;
+  typedef HashMap<SPI,SADataTuple *> STable;
   typedef STable::const_iterator SIter;
-  STable _table;
+
+  struct Shard {
+    ReadWriteLock lock;
+    STable table;
+  };
+  Shard _shards[NSHARDS];
+
+  static inline unsigned shard_of(SPI spi) {
+    // SPIs are often allocated sequentially; spread them over the shards
+    return (spi.getValue() * 0x9E3779B1U) >> 28;
+  }
 
 };
 
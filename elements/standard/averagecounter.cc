@@ -22,6 +22,7 @@
 #include <click/sync.hh>
 #include <click/glue.hh>
 #include <click/error.hh>
+#include <click/master.hh>
 CLICK_DECLS
 
 AverageCounter::AverageCounter()
@@ -31,10 +32,37 @@ AverageCounter::AverageCounter()
 void
 AverageCounter::reset()
 {
-  _count = 0;
-  _byte_count = 0;
+  _shards.assign(Shard());
   _first = 0;
-  _last = 0;
+}
+
+uint32_t
+AverageCounter::count() const
+{
+    uint32_t c = 0;
+    for (int i = 0; i < _shards.size(); ++i)
+	c += _shards[i].count;
+    return c;
+}
+
+uint32_t
+AverageCounter::byte_count() const
+{
+    uint32_t c = 0;
+    for (int i = 0; i < _shards.size(); ++i)
+	c += _shards[i].byte_count;
+    return c;
+}
+
+uint32_t
+AverageCounter::last() const
+{
+    // Compare relative to _first, since jiffies wrap.
+    uint32_t first = _first, d = 0;
+    for (int i = 0; i < _shards.size(); ++i)
+	if (_shards[i].last && _shards[i].last - first > d)
+	    d = _shards[i].last - first;
+    return first + d;
 }
 
 int
@@ -50,6 +78,7 @@ AverageCounter::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 AverageCounter::initialize(ErrorHandler *)
 {
+  _shards.initialize(master()->nthreads());
   reset();
   return 0;
 }
@@ -58,12 +87,14 @@ Packet *
 AverageCounter::simple_action(Packet *p)
 {
     uint32_t jpart = click_jiffies();
-    _first.compare_swap(0, jpart);
+    if (unlikely(!_first))
+	_first.compare_swap(0, jpart);
+    Shard &s = _shards.local();
     if (jpart - _first >= _ignore) {
-	_count++;
-	_byte_count += p->length();
+	s.count++;
+	s.byte_count += p->length();
     }
-    _last = jpart;
+    s.last = jpart;
     return p;
 }
 
@@ -20,6 +20,7 @@
 #include "bandwidthmeter.hh"
 #include <click/error.hh>
 #include <click/args.hh>
+#include <click/master.hh>
 CLICK_DECLS
 
 BandwidthMeter::BandwidthMeter()
@@ -52,11 +53,11 @@ BandwidthMeter::configure(Vector<String> &conf, ErrorHandler *errh)
     else if (ba.status == NumArg::status_unitless)
       errh->warning("no units for bandwidth argument %d, assuming Bps", i+1);
 
-  unsigned max_value = 0xFFFFFFFF >> _rate.scale();
+  unsigned max_value = 0xFFFFFFFF >> rate_scale();
   for (int i = 0; i < conf.size(); i++) {
     if (vals[i] > max_value)
       return errh->error("rate %d too large (max %u)", i+1, max_value);
-    vals[i] = (vals[i]<<_rate.scale()) / _rate.epoch_frequency();
+    vals[i] = (vals[i]<<rate_scale()) / rate_freq();
   }
 
   if (vals.size() == 1) {
@@ -73,12 +74,31 @@ BandwidthMeter::configure(Vector<String> &conf, ErrorHandler *errh)
   return 0;
 }
 
+int
+BandwidthMeter::initialize(ErrorHandler *)
+{
+  _shards.initialize(master()->nthreads());
+  return 0;
+}
+
+// Sum copies brought up to date, so that readers never write to a shard that
+// another thread owns.
+unsigned
+BandwidthMeter::scaled_rate() const
+{
+  unsigned r = 0;
+  for (int i = 0; i < _shards.size(); i++) {
+    RateEWMA x = _shards[i].rate;
+    x.update(0);
+    r += x.scaled_average();
+  }
+  return r;
+}
+
 void
 BandwidthMeter::push(int, Packet *p)
 {
-  _rate.update(p->length());
-
-  unsigned r = _rate.scaled_average();
+  unsigned r = update_rate(p->length());
   if (_nmeters < 2) {
     int n = (r >= _meter1);
     output(n).push(p);
@@ -112,7 +132,6 @@ String
 BandwidthMeter::read_rate_handler(Element *f, void *)
 {
   BandwidthMeter *c = (BandwidthMeter *)f;
-  c->_rate.update(0);
   return cp_unparse_real2(c->scaled_rate()*c->rate_freq(), c->rate_scale());
 }
 
@@ -2,6 +2,7 @@
 #define CLICK_BANDWIDTHMETER_HH
 #include <click/element.hh>
 #include <click/ewma.hh>
+#include <click/perthread.hh>
 CLICK_DECLS
 
 /*
@@ -25,6 +26,10 @@ CLICK_DECLS
  * sent to output 1; and so on. If it is >= RATEI<n>, packets are sent to
  * output I<n>.
  *
+ * In multithreaded drivers, each thread measures the packets it pushes, and
+ * the meter classifies by the sum of the threads' rates.  A thread refreshes
+ * its view of the other threads' rates once per jiffy.
+ *
  * =e
  *
  * This configuration fragment drops the input stream when it is generating
@@ -37,12 +42,20 @@ CLICK_DECLS
 
 class BandwidthMeter : public Element { protected:
 
-  RateEWMA _rate;
+  struct Shard {
+    RateEWMA rate;
+    unsigned epoch;
+    unsigned total;
+    Shard() : epoch(0), total(0) { }
+  };
+  per_thread<Shard> _shards;
 
   unsigned _meter1;
   unsigned *_meters;
   int _nmeters;
 
+  inline unsigned update_rate(unsigned delta);
+
   static String meters_read_handler(Element *, void *);
   static String read_rate_handler(Element *, void *);
 
@@ -55,16 +68,36 @@ class BandwidthMeter : public Element { protected:
   const char *port_count() const		{ return "1/2-"; }
   const char *processing() const		{ return PUSH; }
 
-  unsigned scaled_rate() const		{ return _rate.scaled_average(); }
-  unsigned rate_scale() const		{ return _rate.scale(); }
-  unsigned rate_freq() const		{ return _rate.epoch_frequency(); }
+  unsigned scaled_rate() const;
+  unsigned rate_scale() const		{ return _shards[0].rate.scale(); }
+  unsigned rate_freq() const		{ return RateEWMA::epoch_frequency(); }
 
   int configure(Vector<String> &, ErrorHandler *);
+  int initialize(ErrorHandler *);
   void add_handlers();
 
   void push(int port, Packet *);
 
 };
 
+/** @brief Add @a delta to this thread's rate and return the total rate.
+ *
+ * An average changes only when an epoch closes, so the other threads'
+ * averages are recombined only then. */
+inline unsigned
+BandwidthMeter::update_rate(unsigned delta)
+{
+  Shard &s = _shards.local();
+  s.rate.update(delta);
+  if (_shards.size() == 1)
+    return s.rate.scaled_average();
+  unsigned now = RateEWMA::epoch();
+  if (s.epoch != now) {
+    s.epoch = now;
+    s.total = scaled_rate();
+  }
+  return s.total;
+}
+
 CLICK_ENDDECLS
 #endif
@@ -22,6 +22,7 @@
 #include <click/confparse.hh>
 #include <click/args.hh>
 #include <click/handlercall.hh>
+#include <click/master.hh>
 CLICK_DECLS
 
 Counter::Counter()
@@ -38,10 +39,54 @@ Counter::~Counter()
 void
 Counter::reset()
 {
-  _count = _byte_count = 0;
+  _shards.assign(Shard());
   _count_triggered = _byte_triggered = false;
 }
 
+Counter::counter_t
+Counter::count() const
+{
+    counter_t c = 0;
+    for (int i = 0; i < _shards.size(); ++i)
+	c += _shards[i].count;
+    return c;
+}
+
+Counter::counter_t
+Counter::byte_count() const
+{
+    counter_t c = 0;
+    for (int i = 0; i < _shards.size(); ++i)
+	c += _shards[i].byte_count;
+    return c;
+}
+
+// Rates are summed from copies brought up to date, so that readers never
+// write to a shard that another thread owns.
+Counter::counter_t
+Counter::scaled_rate() const
+{
+    counter_t r = 0;
+    for (int i = 0; i < _shards.size(); ++i) {
+	rate_t x = _shards[i].rate;
+	x.update(0);
+	r += x.scaled_average();
+    }
+    return r;
+}
+
+Counter::counter_t
+Counter::scaled_byte_rate() const
+{
+    counter_t r = 0;
+    for (int i = 0; i < _shards.size(); ++i) {
+	byte_rate_t x = _shards[i].byte_rate;
+	x.update(0);
+	r += x.scaled_average();
+    }
+    return r;
+}
+
 int
 Counter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -81,6 +126,7 @@ Counter::initialize(ErrorHandler *errh)
     return -1;
   if (_byte_trigger_h && _byte_trigger_h->initialize_write(this, errh) < 0)
     return -1;
+  _shards.initialize(master()->nthreads());
   reset();
   return 0;
 }
@@ -88,20 +134,22 @@ Counter::initialize(ErrorHandler *errh)
 Packet *
 Counter::simple_action(Packet *p)
 {
-    _count++;
-    _byte_count += p->length();
-    _rate.update(1);
-    _byte_rate.update(p->length());
+    Shard &s = _shards.local();
+    s.count++;
+    s.byte_count += p->length();
+    s.rate.update(1);
+    s.byte_rate.update(p->length());
 
-  if (_count == _count_trigger && !_count_triggered) {
+  // Summing the shards is slow, so do it only while a call is pending.
+  // Other threads' increments can carry the sum past the trigger between
+  // two checks, so test >=, not ==.
+  if (!_count_triggered && _count_trigger_h && count() >= _count_trigger) {
     _count_triggered = true;
-    if (_count_trigger_h)
-      (void) _count_trigger_h->call_write();
+    (void) _count_trigger_h->call_write();
   }
-  if (_byte_count >= _byte_trigger && !_byte_triggered) {
+  if (!_byte_triggered && _byte_trigger_h && byte_count() >= _byte_trigger) {
     _byte_triggered = true;
-    if (_byte_trigger_h)
-      (void) _byte_trigger_h->call_write();
+    (void) _byte_trigger_h->call_write();
   }
 
   return p;
@@ -117,23 +165,22 @@ Counter::read_handler(Element *e, void *thunk)
     Counter *c = (Counter *)e;
     switch ((intptr_t)thunk) {
       case H_COUNT:
-	return String(c->_count);
+	return String(c->count());
       case H_BYTE_COUNT:
-	return String(c->_byte_count);
+	return String(c->byte_count());
       case H_RATE:
-	c->_rate.update(0);	// drop rate after idle period
-	return c->_rate.unparse_rate();
-      case H_BIT_RATE:
-	c->_byte_rate.update(0); // drop rate after idle period
+	return cp_unparse_real2(c->scaled_rate() * rate_t::epoch_frequency(), c->_shards[0].rate.scale());
+      case H_BIT_RATE: {
+	const byte_rate_t &br = c->_shards[0].byte_rate;
 	// avoid integer overflow by adjusting scale factor instead of
 	// multiplying
-	if (c->_byte_rate.scale() >= 3)
-	    return cp_unparse_real2(c->_byte_rate.scaled_average() * c->_byte_rate.epoch_frequency(), c->_byte_rate.scale() - 3);
+	if (br.scale() >= 3)
+	    return cp_unparse_real2(c->scaled_byte_rate() * br.epoch_frequency(), br.scale() - 3);
 	else
-	    return cp_unparse_real2(c->_byte_rate.scaled_average() * c->_byte_rate.epoch_frequency() * 8, c->_byte_rate.scale());
+	    return cp_unparse_real2(c->scaled_byte_rate() * br.epoch_frequency() * 8, br.scale());
+      }
       case H_BYTE_RATE:
-	c->_byte_rate.update(0); // drop rate after idle period
-	return c->_byte_rate.unparse_rate();
+	return cp_unparse_real2(c->scaled_byte_rate() * byte_rate_t::epoch_frequency(), c->_shards[0].byte_rate.scale());
       case H_COUNT_CALL:
 	if (c->_count_trigger_h)
 	    return String(c->_count_trigger);
@@ -194,15 +241,14 @@ Counter::llrpc(unsigned command, void *data)
     uint32_t *val = reinterpret_cast<uint32_t *>(data);
     if (*val != 0)
       return -EINVAL;
-    _rate.update(0);		// drop rate after idle period
-    *val = _rate.rate();
+    *val = (scaled_rate() * rate_t::epoch_frequency()) >> _shards[0].rate.scale();
     return 0;
 
   } else if (command == CLICK_LLRPC_GET_COUNT) {
     uint32_t *val = reinterpret_cast<uint32_t *>(data);
     if (*val != 0 && *val != 1)
       return -EINVAL;
-    *val = (*val == 0 ? _count : _byte_count);
+    *val = (*val == 0 ? count() : byte_count());
     return 0;
 
   } else if (command == CLICK_LLRPC_GET_COUNTS) {
@@ -213,9 +259,9 @@ Counter::llrpc(unsigned command, void *data)
       return -EINVAL;
     for (unsigned i = 0; i < cs.n; i++) {
       if (cs.keys[i] == 0)
-	cs.values[i] = _count;
+	cs.values[i] = count();
       else if (cs.keys[i] == 1)
-	cs.values[i] = _byte_count;
+	cs.values[i] = byte_count();
       else
 	return -EINVAL;
     }
@@ -4,6 +4,7 @@
 #include <click/element.hh>
 #include <click/ewma.hh>
 #include <click/llrpc.h>
+#include <click/perthread.hh>
 CLICK_DECLS
 class HandlerCall;
 
@@ -21,15 +22,19 @@ measures packet count and rate
 Passes packets unchanged from its input to its output, maintaining statistics
 information about packet count and packet rate.
 
+In multithreaded drivers, each thread keeps its own counts and rates, and
+the read handlers combine them.  Threads pushing packets through the same
+Counter therefore neither lose updates nor contend for a cache line.
+
 Keyword arguments are:
 
 =over 8
 
 =item COUNT_CALL
 
-Argument is `I<N> I<HANDLER> [I<VALUE>]'. When the packet count reaches I<N>,
-call the write handler I<HANDLER> with value I<VALUE> before emitting the
-packet.
+Argument is `I<N> I<HANDLER> [I<VALUE>]'. When the packet count reaches or
+exceeds I<N>, call the write handler I<HANDLER> with value I<VALUE> before
+emitting the packet.
 
 =item BYTE_COUNT_CALL
 
@@ -128,10 +133,14 @@ class Counter : public Element { public:
     typedef RateEWMAX<RateEWMAXParameters<4, 4> > byte_rate_t;
 #endif
 
-    counter_t _count;
-    counter_t _byte_count;
-    rate_t _rate;
-    byte_rate_t _byte_rate;
+    struct Shard {
+	counter_t count;
+	counter_t byte_count;
+	rate_t rate;
+	byte_rate_t byte_rate;
+	Shard() : count(0), byte_count(0) { }
+    };
+    per_thread<Shard> _shards;
 
     counter_t _count_trigger;
     HandlerCall *_count_trigger_h;
@@ -142,6 +151,10 @@ class Counter : public Element { public:
     bool _count_triggered : 1;
     bool _byte_triggered : 1;
 
+    counter_t count() const;
+    counter_t byte_count() const;
+    counter_t scaled_rate() const;
+    counter_t scaled_byte_rate() const;
     static String read_handler(Element *, void *);
     static int write_handler(const String&, Element*, void*, ErrorHandler*);
 
@@ -20,6 +20,7 @@
 #include "cyclecountaccum.hh"
 #include <click/packet_anno.hh>
 #include <click/glue.hh>
+CLICK_DECLS
 
 CycleCountAccum::CycleCountAccum()
     : _accum(0), _count(0), _zero_count(0)
@@ -92,5 +93,6 @@ CycleCountAccum::add_handlers()
     add_write_handler("reset_counts", reset_handler, 0, Handler::BUTTON);
 }
 
-ELEMENT_REQUIRES(linuxmodule int64)
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
 EXPORT_ELEMENT(CycleCountAccum)
@@ -42,6 +42,7 @@ Resets C<count>, C<cycles>, and C<zero_count> counters to zero when written.
 =a SetCycleCount, RoundTripCycleCount, SetPerfCount, PerfCountAccum */
 
 #include <click/element.hh>
+CLICK_DECLS
 
 class CycleCountAccum : public Element { public:
 
@@ -68,4 +69,5 @@ class CycleCountAccum : public Element { public:
 
 };
 
+CLICK_ENDDECLS
 #endif
@@ -19,7 +19,7 @@ CLICK_DECLS
  *
  *   HashSwitch(16, 4)
  * =a
- * Switch, RoundRobinSwitch, StrideSwitch, RandomSwitch
+ * Switch, RoundRobinSwitch, StrideSwitch, RandomSwitch, FlowDispatch
  */
 
 class HashSwitch : public Element {
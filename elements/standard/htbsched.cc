@@ -0,0 +1,601 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * htbsched.{cc,hh} -- hierarchical token bucket scheduler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "htbsched.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/heap.hh>
+#include <click/integers.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+struct HTBSched::wait_less {
+    Class *c;
+    wait_less(Class *c_) : c(c_) { }
+    bool operator()(int a, int b) const {
+	return click_jiffies_less(c[a].wake, c[b].wake);
+    }
+};
+
+struct HTBSched::wait_place {
+    Class *c;
+    wait_place(Class *c_) : c(c_) { }
+    void operator()(int *begin, int *it) const {
+	c[*it].wait_pos = it - begin;
+    }
+};
+
+HTBSched::HTBSched()
+    : _classes(0), _nclasses(0), _nlevels(0), _mtu(1514), _timer(this)
+{
+}
+
+HTBSched::~HTBSched()
+{
+    delete[] _classes;
+}
+
+void *
+HTBSched::cast(const char *n)
+{
+    if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_notifier);
+    else
+	return Element::cast(n);
+}
+
+int
+HTBSched::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _notifier.initialize(Notifier::EMPTY_NOTIFIER, router());
+    if (Args(conf, this, errh).read("MTU", _mtu).consume() < 0)
+	return -1;
+    if (_mtu == 0)
+	return errh->error("MTU must be positive");
+    if (conf.size() == 0)
+	return errh->error("no classes defined");
+
+    delete[] _classes;
+    _nclasses = conf.size();
+    _classes = new Class[_nclasses];
+    _leaves.clear();
+
+    for (int i = 0; i < _nclasses; ++i) {
+	Class &k = _classes[i];
+	Vector<String> words;
+	cp_spacevec(conf[i], words);
+	if (words.size() == 0)
+	    return errh->error("class %d: empty definition", i);
+	k.name = words[0];
+	for (int j = 0; j < i; ++j)
+	    if (_classes[j].name == k.name)
+		return errh->error("class %<%s%> defined twice", k.name.c_str());
+	if (words.size() % 2 == 0)
+	    return errh->error("class %<%s%>: missing keyword value", k.name.c_str());
+
+	Vector<String> kv;
+	for (int j = 1; j < words.size(); j += 2)
+	    kv.push_back(words[j] + " " + words[j + 1]);
+
+	PrefixErrorHandler cerrh(errh, "class " + k.name + ": ");
+	String parent;
+	uint32_t rate, ceil = 0, burst, cburst;
+	bool have_burst, have_cburst;
+	int prio = 0;
+	uint32_t quantum = _mtu;
+	if (Args(kv, this, &cerrh)
+	    .read("PARENT", WordArg(), parent)
+	    .read_m("RATE", BandwidthArg(), rate)
+	    .read("CEIL", BandwidthArg(), ceil)
+	    .read("BURST", burst).read_status(have_burst)
+	    .read("CBURST", cburst).read_status(have_cburst)
+	    .read("PRIO", prio)
+	    .read("QUANTUM", quantum)
+	    .complete() < 0)
+	    return -1;
+
+	if (rate == 0)
+	    return cerrh.error("RATE must be positive");
+	if (ceil == 0)
+	    ceil = rate;
+	else if (ceil < rate)
+	    return cerrh.error("CEIL must be at least RATE");
+	if (prio < 0 || prio >= NPRIO)
+	    return cerrh.error("PRIO must be between 0 and %d", NPRIO - 1);
+	if (quantum == 0)
+	    return cerrh.error("QUANTUM must be positive");
+	// default bursts: 20 milliseconds of tokens; the buckets also hold
+	// an MTU, the threshold for changing color
+	if (!have_burst)
+	    burst = rate / 50;
+	if (!have_cburst)
+	    cburst = ceil / 50;
+	k.rate.assign(rate, burst + _mtu < burst ? UINT_MAX : burst + _mtu);
+	k.ceil.assign(ceil, cburst + _mtu < cburst ? UINT_MAX : cburst + _mtu);
+
+	k.parent = -1;
+	if (parent) {
+	    for (int j = 0; j < i; ++j)
+		if (_classes[j].name == parent)
+		    k.parent = j;
+	    if (k.parent < 0)
+		return cerrh.error("PARENT %<%s%> not defined earlier", parent.c_str());
+	}
+	k.level = 0;
+	k.prio = prio;
+	k.port = -1;
+	k.quantum = quantum;
+	k.owner = this;
+    }
+
+    // parents precede their children, so one backward pass computes levels
+    _nlevels = 1;
+    Vector<bool> inner(_nclasses, false);
+    for (int i = _nclasses - 1; i >= 0; --i) {
+	Class &k = _classes[i];
+	if (k.parent >= 0) {
+	    inner[k.parent] = true;
+	    Class &par = _classes[k.parent];
+	    if (par.level < k.level + 1)
+		par.level = k.level + 1;
+	}
+	if (k.level + 1 > _nlevels)
+	    _nlevels = k.level + 1;
+    }
+    if (_nlevels > MAXLEVEL)
+	return errh->error("class tree deeper than %d levels", MAXLEVEL);
+    for (int i = 0; i < _nclasses; ++i)
+	if (!inner[i]) {
+	    _classes[i].port = _leaves.size();
+	    _leaves.push_back(i);
+	}
+    if (_leaves.size() != ninputs())
+	return errh->error("%d leaf classes, but %d inputs", _leaves.size(), ninputs());
+    return 0;
+}
+
+int
+HTBSched::initialize(ErrorHandler *)
+{
+    click_jiffies_t now = click_jiffies();
+    for (int l = 0; l < MAXLEVEL; ++l) {
+	for (int p = 0; p < NPRIO; ++p)
+	    _row[l][p] = -1;
+	_row_mask[l] = 0;
+    }
+    for (int i = 0; i < _nclasses; ++i) {
+	Class &k = _classes[i];
+	k.rate.set_full();
+	k.rate.set_time_point(now);
+	k.ceil.set_full();
+	k.ceil.set_time_point(now);
+	k.rate_debt = k.ceil_debt = 0;
+	k.color = GREEN;
+	k.active = 0;
+	k.wait_pos = -1;
+	k.wake = now;
+	k.head = 0;
+	k.deficit = 0;
+	for (int p = 0; p < NPRIO; ++p)
+	    k.feed[p] = -1;
+	k.packets = k.bytes = k.borrowed = k.lent = 0;
+    }
+    for (int i = 0; i < _leaves.size(); ++i) {
+	Class &k = _classes[_leaves[i]];
+	k.signal = Notifier::upstream_empty_signal(this, k.port, leaf_wake, &k);
+	if (k.signal)
+	    activate(_leaves[i]);
+    }
+    _timer.initialize(this);
+    return 0;
+}
+
+void
+HTBSched::cleanup(CleanupStage)
+{
+    for (int i = 0; i < _leaves.size(); ++i)
+	if (Packet *p = _classes[_leaves[i]].head) {
+	    p->kill();
+	    _classes[_leaves[i]].head = 0;
+	}
+}
+
+int
+HTBSched::color_of(Class &k, uint32_t mtu)
+{
+    if (!k.ceil.contains(mtu))
+	return RED;
+    else if (k.rate.contains(mtu))
+	return GREEN;
+    else
+	return YELLOW;
+}
+
+// TokenBucket cannot go negative, so charges that overdraw a bucket are
+// recorded as debt and paid from later refills.  Otherwise a parent charged
+// by children sending on their own RATE would forget what they used and
+// lend it out again.
+void
+HTBSched::settle(TokenBucket &tb, uint32_t &debt)
+{
+    if (debt) {
+	uint32_t x = tb.size() < debt ? tb.size() : debt;
+	tb.remove(x);
+	debt -= x;
+    }
+}
+
+void
+HTBSched::take(TokenBucket &tb, uint32_t &debt, uint32_t len)
+{
+    settle(tb, debt);
+    if (tb.contains(len))
+	tb.remove(len);
+    else {
+	uint32_t over = len - tb.size();
+	debt = (debt + over < debt ? UINT_MAX : debt + over);
+	tb.remove(tb.size());
+    }
+}
+
+void
+HTBSched::ring_insert(int &ring, int c, int p)
+{
+    Link &l = _classes[c].link[p];
+    if (ring < 0) {
+	l.prev = l.next = c;
+	ring = c;
+    } else {
+	// insert at the tail, just behind the cursor
+	Link &head = _classes[ring].link[p];
+	l.next = ring;
+	l.prev = head.prev;
+	_classes[head.prev].link[p].next = c;
+	head.prev = c;
+    }
+}
+
+void
+HTBSched::ring_remove(int &ring, int c, int p)
+{
+    Link &l = _classes[c].link[p];
+    if (l.next == c)
+	ring = -1;
+    else {
+	_classes[l.prev].link[p].next = l.next;
+	_classes[l.next].link[p].prev = l.prev;
+	if (ring == c)
+	    ring = l.next;
+    }
+}
+
+void
+HTBSched::attach(int c, int p)
+{
+    Class &k = _classes[c];
+    if (k.color == GREEN) {
+	ring_insert(_row[k.level][p], c, p);
+	_row_mask[k.level] |= 1 << p;
+    } else if (k.color == YELLOW && k.parent >= 0) {
+	Class &par = _classes[k.parent];
+	bool was_empty = par.feed[p] < 0;
+	ring_insert(par.feed[p], c, p);
+	if (was_empty) {
+	    par.active |= 1 << p;
+	    attach(k.parent, p);
+	}
+    }
+}
+
+void
+HTBSched::detach(int c, int p)
+{
+    Class &k = _classes[c];
+    if (k.color == GREEN) {
+	int &ring = _row[k.level][p];
+	ring_remove(ring, c, p);
+	if (ring < 0)
+	    _row_mask[k.level] &= ~(1 << p);
+    } else if (k.color == YELLOW && k.parent >= 0) {
+	Class &par = _classes[k.parent];
+	ring_remove(par.feed[p], c, p);
+	if (par.feed[p] < 0) {
+	    detach(k.parent, p);
+	    par.active &= ~(1 << p);
+	}
+    }
+}
+
+void
+HTBSched::set_color(int c, int color)
+{
+    Class &k = _classes[c];
+    if (k.color == color)
+	return;
+    for (int p = 0; p < NPRIO; ++p)
+	if (k.active & (1 << p))
+	    detach(c, p);
+    k.color = color;
+    for (int p = 0; p < NPRIO; ++p)
+	if (k.active & (1 << p))
+	    attach(c, p);
+}
+
+void
+HTBSched::update(int c, click_jiffies_t now)
+{
+    Class &k = _classes[c];
+    k.rate.refill(now);
+    k.ceil.refill(now);
+    settle(k.rate, k.rate_debt);
+    settle(k.ceil, k.ceil_debt);
+    int color = color_of(k, _mtu);
+    set_color(c, color);
+    if (color == GREEN)
+	unwait(c);
+    else {
+	// A bucket never holds more than its capacity, so waiting for
+	// _mtu + debt at once could return "never", or lose the refills
+	// past capacity.  Debt is only owed while the bucket is empty; if
+	// debt and _mtu do not fit together, wait to repay the debt (a
+	// bucketful at most) and look again then.
+	TokenBucket &tb = (color == RED ? k.ceil : k.rate);
+	uint32_t debt = (color == RED ? k.ceil_debt : k.rate_debt);
+	uint32_t cap = tb.capacity();
+	uint32_t want = debt + (_mtu < cap ? _mtu : cap);
+	if (want > cap || want < debt)
+	    want = (debt < cap ? debt : cap);
+	TokenBucket::ticks_type t = tb.time_until_contains(want);
+	// A class that cannot refill stays off the rows; poll it rarely
+	// rather than dropping it from the wait heap.
+	if (t == (TokenBucket::ticks_type) -1)
+	    t = CLICK_HZ;
+	wait_for(c, now + (t ? t : 1));
+    }
+}
+
+void
+HTBSched::wait_for(int c, click_jiffies_t wake)
+{
+    Class &k = _classes[c];
+    k.wake = wake;
+    if (k.wait_pos < 0) {
+	_wait.push_back(c);
+	push_heap(_wait.begin(), _wait.end(),
+		  wait_less(_classes), wait_place(_classes));
+    } else
+	change_heap(_wait.begin(), _wait.end(), _wait.begin() + k.wait_pos,
+		    wait_less(_classes), wait_place(_classes));
+}
+
+void
+HTBSched::unwait(int c)
+{
+    Class &k = _classes[c];
+    if (k.wait_pos >= 0) {
+	remove_heap(_wait.begin(), _wait.end(), _wait.begin() + k.wait_pos,
+		    wait_less(_classes), wait_place(_classes));
+	_wait.pop_back();
+	k.wait_pos = -1;
+    }
+}
+
+void
+HTBSched::activate(int leaf)
+{
+    Class &k = _classes[leaf];
+    if (!(k.active & (1 << k.prio))) {
+	k.active |= 1 << k.prio;
+	k.deficit = 0;
+	attach(leaf, k.prio);
+    }
+}
+
+void
+HTBSched::deactivate(int leaf)
+{
+    Class &k = _classes[leaf];
+    if (k.active & (1 << k.prio)) {
+	detach(leaf, k.prio);
+	k.active &= ~(1 << k.prio);
+    }
+}
+
+void
+HTBSched::charge(int leaf, int lender, uint32_t len, click_jiffies_t now)
+{
+    bool lent = false;
+    for (int c = leaf; c >= 0; c = _classes[c].parent) {
+	Class &k = _classes[c];
+	k.rate.refill(now);
+	k.ceil.refill(now);
+	take(k.ceil, k.ceil_debt, len);
+	if (c == lender) {
+	    lent = true;
+	    if (c != leaf)
+		++k.lent;
+	}
+	if (lent)
+	    take(k.rate, k.rate_debt, len);
+	else
+	    ++k.borrowed;
+	++k.packets;
+	k.bytes += len;
+	update(c, now);
+    }
+}
+
+void
+HTBSched::advance(int level, int prio, int leaf)
+{
+    // rotate every ring on the path from the row down to the leaf, so the
+    // next pull offers the next class its turn
+    for (int c = leaf; _classes[c].level < level; c = _classes[c].parent) {
+	int &ring = _classes[_classes[c].parent].feed[prio];
+	ring = _classes[ring].link[prio].next;
+    }
+    int &ring = _row[level][prio];
+    ring = _classes[ring].link[prio].next;
+}
+
+Packet *
+HTBSched::pull(int)
+{
+    click_jiffies_t now = click_jiffies();
+    while (_wait.size() && !click_jiffies_less(now, _classes[_wait[0]].wake))
+	update(_wait[0], now);
+
+    bool recheck = false;
+    while (1) {
+	int level = 0;
+	while (level < _nlevels && !_row_mask[level])
+	    ++level;
+	if (level == _nlevels)
+	    break;
+	int prio = ffs_lsb((unsigned) _row_mask[level]) - 1;
+
+	int c = _row[level][prio];
+	int lender = c;
+	while (_classes[c].port < 0)
+	    c = _classes[c].feed[prio];
+	Class &leaf = _classes[c];
+
+	if (!leaf.head && !(leaf.head = input(leaf.port).pull())) {
+	    deactivate(c);
+	    // the signal may be stale; look again once the timer fires
+	    if (leaf.signal)
+		recheck = true;
+	    continue;
+	}
+
+	uint32_t len = leaf.head->length();
+	if (leaf.deficit < (int) len) {
+	    leaf.deficit += leaf.quantum;
+	    advance(level, prio, c);
+	    continue;
+	}
+
+	Packet *p = leaf.head;
+	leaf.head = 0;
+	leaf.deficit -= len;
+	charge(c, lender, len, now);
+	if (!leaf.signal)
+	    deactivate(c);
+	return p;
+    }
+
+    // Nothing can be sent.  Sleep until the next color change, if some
+    // leaf is backlogged; a newly backlogged leaf wakes us via leaf_wake.
+    _notifier.sleep();
+    bool backlog = recheck;
+    for (int i = 0; i < _leaves.size() && !backlog; ++i) {
+	Class &k = _classes[_leaves[i]];
+	backlog = (k.active & (1 << k.prio)) != 0;
+    }
+    if (backlog) {
+	click_jiffies_t wake = now + 1;
+	if (!recheck && _wait.size())
+	    wake = _classes[_wait[0]].wake;
+	if (!_timer.scheduled() || click_jiffies_less(wake, _timer.expiry().jiffies()))
+	    _timer.schedule_after(Timestamp::make_jiffies(wake - now));
+    }
+    return 0;
+}
+
+void
+HTBSched::run_timer(Timer *)
+{
+    for (int i = 0; i < _leaves.size(); ++i) {
+	Class &k = _classes[_leaves[i]];
+	if (k.signal)
+	    activate(_leaves[i]);
+    }
+    _notifier.wake();
+}
+
+void
+HTBSched::leaf_wake(void *user_data, Notifier *)
+{
+    Class *k = static_cast<Class *>(user_data);
+    HTBSched *htb = k->owner;
+    htb->activate(k - htb->_classes);
+    htb->_notifier.wake();
+}
+
+void
+HTBSched::unparse_class(StringAccum &sa, int c) const
+{
+    static const char * const colors[] = { "green", "yellow", "red" };
+    const Class &k = _classes[c];
+    sa << k.name << ',';
+    if (k.parent >= 0)
+	sa << _classes[k.parent].name;
+    sa << ',' << k.level << ',';
+    if (k.port >= 0)
+	sa << k.prio;
+    sa << ',' << k.rate.rate() << ',' << k.ceil.rate() << ','
+       << colors[k.color] << ',' << k.packets << ',' << k.bytes << ','
+       << k.borrowed << ',' << k.lent << '\n';
+}
+
+String
+HTBSched::read_handler(Element *e, void *)
+{
+    HTBSched *htb = static_cast<HTBSched *>(e);
+    StringAccum sa;
+    sa << "class,parent,level,prio,rate,ceil,color,packets,bytes,borrowed,lent\n";
+    for (int c = 0; c < htb->_nclasses; ++c)
+	htb->unparse_class(sa, c);
+    return sa.take_string();
+}
+
+int
+HTBSched::class_handler(int, String &data, Element *e, const Handler *,
+			ErrorHandler *errh)
+{
+    HTBSched *htb = static_cast<HTBSched *>(e);
+    String name = cp_uncomment(data);
+    for (int c = 0; c < htb->_nclasses; ++c)
+	if (htb->_classes[c].name == name) {
+	    StringAccum sa;
+	    htb->unparse_class(sa, c);
+	    data = sa.take_string();
+	    return 0;
+	}
+    return errh->error("no class %<%s%>", name.c_str());
+}
+
+int
+HTBSched::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    HTBSched *htb = static_cast<HTBSched *>(e);
+    for (int c = 0; c < htb->_nclasses; ++c) {
+	Class &k = htb->_classes[c];
+	k.packets = k.bytes = k.borrowed = k.lent = 0;
+    }
+    return 0;
+}
+
+void
+HTBSched::add_handlers()
+{
+    add_read_handler("stats", read_handler, 0);
+    set_handler("class", Handler::OP_READ | Handler::READ_PARAM, class_handler);
+    add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(HTBSched)
@@ -0,0 +1,201 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HTBSCHED_HH
+#define CLICK_HTBSCHED_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/tokenbucket.hh>
+#include <click/timer.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+HTBSched(CLASS1, CLASS2, ..., I<keywords> MTU)
+
+=s scheduling
+
+pulls from inputs with hierarchical token bucket scheduling
+
+=io
+
+one output, zero or more inputs
+
+=d
+
+Shapes and schedules packets with a hierarchical token bucket (HTB), after
+the Linux HTB queueing discipline.  Each argument defines a traffic class:
+
+   NAME [PARENT PARENTNAME] RATE RATE [CEIL CEIL] [BURST BYTES]
+        [CBURST BYTES] [PRIO PRIO] [QUANTUM BYTES]
+
+Classes form a tree; a class's PARENT must be defined before it.  Classes
+without children are leaves.  Each leaf corresponds to an input, in the order
+the leaves are defined, so HTBSched needs as many inputs as leaves.  The
+inputs usually come from Queues.
+
+Every class is guaranteed RATE (bytes per second, as in BandwidthShaper), and
+may borrow unused bandwidth from its ancestors up to CEIL (default RATE).
+BURST and CBURST are the token bucket sizes for RATE and CEIL; they default to
+20 milliseconds' worth of tokens.  Leaves with lower PRIO (0-7, default 0) are
+offered spare bandwidth first; leaves of equal priority share it by deficit
+round robin with the given QUANTUM (default MTU).  Leaves sending within
+their own RATE are always served before leaves that borrow.
+
+A class is "green" while its RATE bucket holds at least MTU bytes, "yellow"
+while only its CEIL bucket does, and "red" otherwise.  Green leaves send on
+their own tokens; yellow leaves borrow from their nearest green ancestor
+through a chain of yellow ones.  Each packet is charged to the CEIL bucket of
+every class on its path, and to the RATE buckets of the lender and its
+ancestors.
+
+Keyword arguments are:
+
+=over 8
+
+=item MTU
+
+Integer.  Largest packet size in bytes; determines when classes change
+color.  Default is 1514.
+
+=back
+
+HTBSched keeps green classes in per-level, per-priority rings, and yellow
+classes in per-priority rings at their parents, so choosing a packet costs
+time proportional to the depth of the tree, not the number of classes.
+Classes that are waiting for tokens sit in a heap ordered by the time their
+color changes.
+
+=n
+
+HTBSched is a notifier signal, active iff some leaf is backlogged and may
+send.  When every backlogged leaf must wait for tokens, HTBSched goes to
+sleep and sets a timer to wake itself.
+
+=h stats read-only
+
+Returns per-class statistics as CSV, with header line
+"class,parent,level,prio,rate,ceil,color,packets,bytes,borrowed,lent".
+The "borrowed" column counts packets the class sent beyond its RATE, and
+"lent" counts packets it lent to descendants.
+
+=h class read-only
+
+Takes a class name as a parameter and returns that class's line of the stats
+handler.
+
+=h reset_counts write-only
+
+Resets all class statistics to zero.
+
+=e
+
+  HTBSched(root RATE 10Mbps,
+           voice PARENT root RATE 1Mbps CEIL 2Mbps PRIO 0,
+           web PARENT root RATE 6Mbps CEIL 10Mbps PRIO 1,
+           bulk PARENT root RATE 3Mbps CEIL 10Mbps PRIO 2);
+
+Here the voice, web and bulk leaves correspond to inputs 0, 1 and 2.
+
+=a BandwidthShaper, DRRSched, PrioSched, BandwidthRatedUnqueue */
+
+class HTBSched : public Element { public:
+
+    HTBSched();
+    ~HTBSched();
+
+    const char *class_name() const		{ return "HTBSched"; }
+    const char *port_count() const		{ return "-/1"; }
+    const char *processing() const		{ return PULL; }
+    const char *flags() const			{ return "S0"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    Packet *pull(int port);
+    void run_timer(Timer *);
+
+  private:
+
+    enum { NPRIO = 8, MAXLEVEL = 8 };
+    enum { GREEN = 0, YELLOW = 1, RED = 2 };
+
+    // intrusive ring links, by class index; -1 terminates
+    struct Link {
+	int prev;
+	int next;
+    };
+
+    struct Class {
+	String name;
+	int parent;
+	int level;			// 0 for leaves
+	int prio;			// leaves only
+	int port;			// leaves only, else -1
+	uint32_t quantum;
+	TokenBucket rate;
+	TokenBucket ceil;
+	uint32_t rate_debt;		// tokens owed beyond an empty bucket
+	uint32_t ceil_debt;
+	int color;
+	uint8_t active;			// mask of priorities with backlog
+	int wait_pos;			// position in _wait, or -1
+	click_jiffies_t wake;
+	// leaves
+	Packet *head;
+	int deficit;
+	NotifierSignal signal;
+	HTBSched *owner;
+	// rings: this class's membership, and (inner classes) its feeds
+	Link link[NPRIO];
+	int feed[NPRIO];
+	// statistics
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t borrowed;
+	uint64_t lent;
+    };
+
+    Class *_classes;
+    int _nclasses;
+    int _nlevels;
+    uint32_t _mtu;
+    int _row[MAXLEVEL][NPRIO];		// rings of green classes
+    uint8_t _row_mask[MAXLEVEL];	// nonempty rows
+    Vector<int> _wait;			// heap ordered by Class::wake
+    Vector<int> _leaves;
+    ActiveNotifier _notifier;
+    Timer _timer;
+
+    struct wait_less;
+    struct wait_place;
+
+    static int color_of(Class &c, uint32_t mtu);
+    static void settle(TokenBucket &tb, uint32_t &debt);
+    static void take(TokenBucket &tb, uint32_t &debt, uint32_t len);
+    void ring_insert(int &ring, int c, int p);
+    void ring_remove(int &ring, int c, int p);
+    void attach(int c, int p);
+    void detach(int c, int p);
+    void set_color(int c, int color);
+    void update(int c, click_jiffies_t now);
+    void wait_for(int c, click_jiffies_t wake);
+    void unwait(int c);
+    void activate(int leaf);
+    void deactivate(int leaf);
+    void charge(int leaf, int lender, uint32_t len, click_jiffies_t now);
+    void advance(int level, int prio, int leaf);
+
+    static void leaf_wake(void *, Notifier *);
+    void unparse_class(StringAccum &sa, int c) const;
+    static String read_handler(Element *, void *);
+    static int class_handler(int, String &, Element *, const Handler *, ErrorHandler *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
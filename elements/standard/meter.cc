@@ -27,9 +27,7 @@ Meter::Meter()
 void
 Meter::push(int, Packet *p)
 {
-  _rate.update(1);		// packets, not bytes
-
-  unsigned r = _rate.scaled_average();
+  unsigned r = update_rate(1);	// packets, not bytes
   if (_nmeters < 2) {
     int n = (r >= _meter1);
     output(n).push(p);
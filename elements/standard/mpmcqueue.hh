@@ -0,0 +1,67 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_MPMCQUEUE_HH
+#define CLICK_MPMCQUEUE_HH
+#include "threadsafequeue.hh"
+CLICK_DECLS
+
+/*
+=c
+
+MPMCQueue
+MPMCQueue(CAPACITY)
+
+=s threads
+
+stores packets in a multiple-producer, multiple-consumer queue
+
+=d
+
+Stores incoming packets in a queue that any number of threads may push to and
+pull from.  The default for CAPACITY is 1000.
+
+MPMCQueue is equivalent to ThreadSafeQueue with MODE MPMC.  Each producer
+thread has its own lane that holds up to CAPACITY packets; a packet is
+dropped when its thread's lane is full.  Consumers take packets from the
+lanes in round-robin order, skipping lanes that another consumer is using, so
+no thread ever spins waiting for another.  Packets pushed by one thread leave
+the queue in order, but packets pushed by different threads may be
+reordered.
+
+=h length read-only
+
+Returns the current number of packets in the queue.
+
+=h highwater_length read-only
+
+Returns the maximum number of packets that have ever been in any one lane at
+once.
+
+=h capacity read-only
+
+Returns the queue's capacity.
+
+=h drops read-only
+
+Returns the number of packets dropped by the queue so far.
+
+=h reset_counts write-only
+
+When written, resets the C<drops> and C<highwater_length> counters.
+
+=h reset write-only
+
+When written, drops all packets in the queue.
+
+=a ThreadSafeQueue, SPSCQueue, MPSCQueue, Queue */
+
+class MPMCQueue : public ThreadSafeQueue { public:
+
+    MPMCQueue();
+
+    const char *class_name() const		{ return "MPMCQueue"; }
+    void *cast(const char *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,65 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_MPSCQUEUE_HH
+#define CLICK_MPSCQUEUE_HH
+#include "threadsafequeue.hh"
+CLICK_DECLS
+
+/*
+=c
+
+MPSCQueue
+MPSCQueue(CAPACITY)
+
+=s threads
+
+stores packets in a multiple-producer, single-consumer queue
+
+=d
+
+Stores incoming packets in a first-in-first-out queue that any number of
+threads may push to, but exactly one thread pulls from.  Drops incoming
+packets if the queue already holds CAPACITY packets.  The default for
+CAPACITY is 1000.
+
+MPSCQueue is equivalent to ThreadSafeQueue with MODE MPSC.  Each producer
+reserves a slot with one compare-and-swap and publishes its packet by storing
+it; producers never wait on each other.  The consumer dequeues packets in
+batches of up to 16.  Results are undefined if more than one thread pulls.
+
+=h length read-only
+
+Returns the current number of packets in the queue.
+
+=h highwater_length read-only
+
+Returns the maximum number of packets that have ever been in the queue at once.
+
+=h capacity read/write
+
+Returns or sets the queue's capacity.
+
+=h drops read-only
+
+Returns the number of packets dropped by the queue so far.
+
+=h reset_counts write-only
+
+When written, resets the C<drops> and C<highwater_length> counters.
+
+=h reset write-only
+
+When written, drops all packets in the queue.
+
+=a ThreadSafeQueue, SPSCQueue, MPMCQueue, Queue */
+
+class MPSCQueue : public ThreadSafeQueue { public:
+
+    MPSCQueue();
+
+    const char *class_name() const		{ return "MPSCQueue"; }
+    void *cast(const char *);
+
+};
+
+CLICK_ENDDECLS
+#endif
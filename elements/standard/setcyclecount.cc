@@ -19,6 +19,7 @@
 #include "setcyclecount.hh"
 #include <click/glue.hh>
 #include <click/packet_anno.hh>
+CLICK_DECLS
 
 SetCycleCount::SetCycleCount()
 {
@@ -44,5 +45,6 @@ SetCycleCount::pull(int)
   return p;
 }
 
-ELEMENT_REQUIRES(linuxmodule int64)
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
 EXPORT_ELEMENT(SetCycleCount)
@@ -20,6 +20,7 @@
  * =a CycleCountAccum, RoundTripCycleCount, SetPerfCount, PerfCountAccum */
 
 #include <click/element.hh>
+CLICK_DECLS
 
 class SetCycleCount : public Element { public:
 
@@ -34,4 +35,5 @@ class SetCycleCount : public Element { public:
 
 };
 
+CLICK_ENDDECLS
 #endif
@@ -20,10 +20,15 @@
 #include "simplequeue.hh"
 #include <click/args.hh>
 #include <click/error.hh>
+#include <click/numa.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+#include <click/routervisitor.hh>
+#include <click/algorithm.hh>
 CLICK_DECLS
 
 SimpleQueue::SimpleQueue()
-    : _q(0)
+    : _q(0), _q_node(-1)
 {
 }
 
@@ -49,11 +54,59 @@ SimpleQueue::configure(Vector<String> &conf, ErrorHandler *errh)
     return 0;
 }
 
+namespace {
+// Collects the home threads of the elements that push packets into, or pull
+// packets out of, a queue.  Elements that merely pass packets along run on
+// whatever thread calls them, so the search continues through them.
+class QueueThreadVisitor : public RouterVisitor { public:
+
+    QueueThreadVisitor(Router *router, Vector<int> &threads)
+	: _router(router), _threads(threads) {
+    }
+
+    bool visit(Element *e, bool isoutput, int port, Element *, int, int) {
+	Bitvector flow;
+	e->port_flow(isoutput, port, &flow);
+	if (isoutput ? !e->output_is_push(port) : !e->input_is_pull(port))
+	    return false;
+	for (int p = 0; p < flow.size(); ++p)
+	    if (flow[p] && (isoutput ? e->input_is_push(p) : e->output_is_pull(p)))
+		return true;
+	int t = _router->home_thread_id(e);
+	if (find(_threads.begin(), _threads.end(), t) == _threads.end())
+	    _threads.push_back(t);
+	return false;
+    }
+
+  private:
+
+    Router *_router;
+    Vector<int> &_threads;
+
+};
+}
+
+void
+SimpleQueue::find_threads(Vector<int> &producers, Vector<int> &consumers)
+{
+    QueueThreadVisitor pv(router(), producers), cv(router(), consumers);
+    router()->visit_upstream(this, 0, &pv);
+    router()->visit_downstream(this, 0, &cv);
+}
+
 int
 SimpleQueue::initialize(ErrorHandler *errh)
 {
     assert(!_q && _head == 0 && _tail == 0);
-    _q = (Packet **) CLICK_LALLOC(sizeof(Packet *) * (_capacity + 1));
+#if CLICK_USERLEVEL
+    // Keep the ring on the consumer's NUMA node.
+    Vector<int> producers, consumers;
+    find_threads(producers, consumers);
+    if (consumers.size() == 1 && consumers[0] >= 0
+	&& consumers[0] < master()->nthreads())
+	_q_node = master()->thread(consumers[0])->numa_node();
+#endif
+    _q = (Packet **) Numa::allocate(sizeof(Packet *) * (_capacity + 1), _q_node);
     if (_q == 0)
 	return errh->error("out of memory");
     _drops = 0;
@@ -74,7 +127,7 @@ SimpleQueue::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
     Storage::index_type new_capacity = _capacity;
     _capacity = old_capacity;
 
-    Packet **new_q = (Packet **) CLICK_LALLOC(sizeof(Packet *) * (new_capacity + 1));
+    Packet **new_q = (Packet **) Numa::allocate(sizeof(Packet *) * (new_capacity + 1), _q_node);
     if (new_q == 0)
 	return errh->error("out of memory");
 
@@ -84,7 +137,7 @@ SimpleQueue::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
     for (; i != _tail; i = next_i(i))
 	_q[i]->kill();
 
-    CLICK_LFREE(_q, sizeof(Packet *) * (_capacity + 1));
+    Numa::deallocate((void *) _q, sizeof(Packet *) * (_capacity + 1), _q_node);
     _q = new_q;
     _head = 0;
     _tail = j;
@@ -130,7 +183,7 @@ SimpleQueue::cleanup(CleanupStage)
 {
     for (Storage::index_type i = _head; i != _tail; i = next_i(i))
 	_q[i]->kill();
-    CLICK_LFREE(_q, sizeof(Packet *) * (_capacity + 1));
+    Numa::deallocate((void *) _q, sizeof(Packet *) * (_capacity + 1), _q_node);
     _q = 0;
 }
 
@@ -102,6 +102,9 @@ class SimpleQueue : public Element, public Storage { public:
     Packet* volatile * _q;
     volatile int _drops;
     int _highwater_length;
+    int _q_node;		// NUMA node holding _q, or -1
+
+    void find_threads(Vector<int> &producers, Vector<int> &consumers);
 
     friend class MixedQueue;
     friend class TokenQueue;
@@ -0,0 +1,37 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * spscqueue.{cc,hh} -- single-producer, single-consumer queue element
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "spscqueue.hh"
+CLICK_DECLS
+
+SPSCQueue::SPSCQueue()
+{
+    _config_mode = M_SPSC;
+    _mode_fixed = true;
+}
+
+void *
+SPSCQueue::cast(const char *n)
+{
+    if (strcmp(n, "SPSCQueue") == 0)
+	return (SPSCQueue *)this;
+    else
+	return ThreadSafeQueue::cast(n);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(ThreadSafeQueue)
+EXPORT_ELEMENT(SPSCQueue)
@@ -0,0 +1,65 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SPSCQUEUE_HH
+#define CLICK_SPSCQUEUE_HH
+#include "threadsafequeue.hh"
+CLICK_DECLS
+
+/*
+=c
+
+SPSCQueue
+SPSCQueue(CAPACITY)
+
+=s threads
+
+stores packets in a single-producer, single-consumer queue
+
+=d
+
+Stores incoming packets in a first-in-first-out queue that exactly one thread
+pushes to and exactly one thread pulls from.  Drops incoming packets if the
+queue already holds CAPACITY packets.  The default for CAPACITY is 1000.
+
+SPSCQueue is equivalent to ThreadSafeQueue with MODE SPSC.  The producer and
+consumer need no atomic operations; each caches the other's queue index on
+its own cache line and rereads the shared index only when the cached value
+says the queue is full or empty.  The consumer dequeues packets in batches
+of up to 16.  Results are undefined if more than one thread pushes or pulls.
+
+=h length read-only
+
+Returns the current number of packets in the queue.
+
+=h highwater_length read-only
+
+Returns the maximum number of packets that have ever been in the queue at once.
+
+=h capacity read/write
+
+Returns or sets the queue's capacity.
+
+=h drops read-only
+
+Returns the number of packets dropped by the queue so far.
+
+=h reset_counts write-only
+
+When written, resets the C<drops> and C<highwater_length> counters.
+
+=h reset write-only
+
+When written, drops all packets in the queue.
+
+=a ThreadSafeQueue, MPSCQueue, MPMCQueue, Queue */
+
+class SPSCQueue : public ThreadSafeQueue { public:
+
+    SPSCQueue();
+
+    const char *class_name() const		{ return "SPSCQueue"; }
+    void *cast(const char *);
+
+};
+
+CLICK_ENDDECLS
+#endif
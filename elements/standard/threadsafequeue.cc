@@ -18,11 +18,27 @@
 
 #include <click/config.h>
 #include "threadsafequeue.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+#include <click/algorithm.hh>
+#include <click/numa.hh>
 CLICK_DECLS
 
+static const char * const mode_names[] = {
+    "auto", "spsc", "mpsc", "mpmc", "cas"
+};
+
 ThreadSafeQueue::ThreadSafeQueue()
+    : _mode(M_CAS), _config_mode(M_AUTO), _mode_fixed(false),
+      _lanes(0), _nlanes(0)
 {
     _xhead = _xtail = 0;
+    _c.tail = 0;
+    _c.pos = _c.n = 0;
+    _p.head = 0;
+    _next_lane = 0;
 }
 
 void *
@@ -34,19 +50,247 @@ ThreadSafeQueue::cast(const char *n)
 	return FullNoteQueue::cast(n);
 }
 
+int
+ThreadSafeQueue::parse_mode(Vector<String> &conf, int &m, ErrorHandler *errh)
+{
+    String mode;
+    if (Args(this, errh).bind(conf)
+	.read("MODE", WordArg(), mode)
+	.consume() < 0)
+	return -1;
+    if (mode && _mode_fixed)
+	return errh->error("%s does not take MODE", class_name());
+    else if (mode) {
+	for (m = M_AUTO; m <= M_CAS; ++m)
+	    if (mode.lower() == mode_names[m])
+		break;
+	if (m > M_CAS)
+	    return errh->error("bad MODE %<%s%>", mode.c_str());
+    }
+    return 0;
+}
+
+int
+ThreadSafeQueue::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (parse_mode(conf, _config_mode, errh) < 0)
+	return -1;
+    return FullNoteQueue::configure(conf, errh);
+}
+
+
+int
+ThreadSafeQueue::choose_mode(const Vector<int> &producers,
+			     const Vector<int> &consumers) const
+{
+    if (_config_mode != M_AUTO)
+	return _config_mode;
+    if (master()->nthreads() <= 1)
+	return M_SPSC;
+
+    // BalancedThreadSched can move any task to any thread.
+    for (int i = 0; i < router()->nelements(); ++i)
+	if (router()->element(i)->cast("BalancedThreadSched"))
+	    return M_MPMC;
+
+    if (consumers.size() > 1)
+	return M_MPMC;
+    else if (producers.size() > 1)
+	return M_MPSC;
+    else
+	return M_SPSC;
+}
+
+int
+ThreadSafeQueue::initialize(ErrorHandler *errh)
+{
+    Vector<int> producers, consumers;
+    find_threads(producers, consumers);
+    if (FullNoteQueue::initialize(errh) < 0)
+	return -1;
+    _stats.initialize(master()->nthreads());
+    _mode = choose_mode(producers, consumers);
+#if !CLICK_THREADSAFEQUEUE_LANES
+    if (_mode == M_MPMC)
+	_mode = M_CAS;
+#endif
+    reset_ring();
+    if (_mode == M_MPMC)
+	return initialize_lanes(errh);
+    return 0;
+}
+
+void
+ThreadSafeQueue::reset_ring()
+{
+    // MPSC consumers recognize unpublished slots by their null pointers.
+    Storage::index_type i = _tail;
+    do {
+	_q[i] = 0;
+	i = next_i(i);
+    } while (i != _head);
+    _xhead = _head;
+    _xtail = _tail;
+    _c.tail = _tail;
+    _p.head = _head;
+}
+
+int
+ThreadSafeQueue::initialize_lanes(ErrorHandler *errh)
+{
+    _nlanes = master()->nthreads();
+    if (_nlanes < 1)
+	_nlanes = 1;
+    if (!(_lanes = new Lane[_nlanes]))
+	return errh->error("out of memory");
+    for (int i = 0; i < _nlanes; ++i) {
+	Lane &l = _lanes[i];
+	l.q = 0;
+	l.tail = l.head = l.head_cache = 0;
+	l.highwater = 0;
+    }
+    for (int i = 0; i < _nlanes; ++i) {
+	Lane &l = _lanes[i];
+	l.node = _q_node;
+#if CLICK_USERLEVEL
+	// Without a single consumer, keep each lane near its producer.
+	if (l.node < 0 && i < master()->nthreads())
+	    l.node = master()->thread(i)->numa_node();
+#endif
+	l.q = (Packet **) Numa::allocate(sizeof(Packet *) * (_capacity + 1), l.node);
+	if (!l.q)
+	    return errh->error("out of memory");
+    }
+    return 0;
+}
+
+void
+ThreadSafeQueue::cleanup_lanes()
+{
+    for (int i = 0; i < _nlanes; ++i) {
+	Lane &l = _lanes[i];
+	if (l.q) {
+	    for (Storage::index_type h = l.head; h != l.tail; h = next_i(h))
+		l.q[h]->kill();
+	    Numa::deallocate(l.q, sizeof(Packet *) * (_capacity + 1), l.node);
+	}
+    }
+    delete[] _lanes;
+    _lanes = 0;
+    _nlanes = 0;
+}
+
+void
+ThreadSafeQueue::cleanup(CleanupStage stage)
+{
+    while (_c.pos < _c.n)
+	_c.batch[_c.pos++]->kill();
+    if (_lanes)
+	cleanup_lanes();
+    FullNoteQueue::cleanup(stage);
+}
+
+bool
+ThreadSafeQueue::can_live_reconfigure() const
+{
+    // Resizing per-thread lanes would race with their producers.
+    return _mode != M_MPMC;
+}
+
 int
 ThreadSafeQueue::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
 {
+    // Pushers and pullers may be running the current algorithm, so the
+    // mode cannot change; MODE may only restate it.
+    int m = _config_mode;
+    if (parse_mode(conf, m, errh) < 0)
+	return -1;
+    if (m != _config_mode && m != _mode)
+	return errh->error("cannot change MODE from %<%s%> while running", mode_names[_mode]);
+    Storage::index_type old_capacity = _capacity;
     int r = NotifierQueue::live_reconfigure(conf, errh);
+    if (r >= 0 && _q && _capacity != old_capacity)
+	reset_ring();
     if (r >= 0 && size() < capacity() && _q)
 	_full_note.wake();
-    _xhead = _head;
-    _xtail = _tail;
     return r;
 }
 
 void
-ThreadSafeQueue::push(int, Packet *p)
+ThreadSafeQueue::take_state(Element *e, ErrorHandler *errh)
+{
+    FullNoteQueue::take_state(e, errh);
+    if (_mode != M_MPMC)
+	reset_ring();
+}
+
+
+inline void
+ThreadSafeQueue::note_push(Stats &st, int s)
+{
+    if (s > st.highwater)
+	st.highwater = s;
+
+    _empty_note.wake();
+
+    if (s == capacity()) {
+	_full_note.sleep();
+#if HAVE_MULTITHREAD
+	// See FullNoteQueue::push_success().
+	if (size() < capacity())
+	    _full_note.wake();
+#endif
+    }
+}
+
+inline void
+ThreadSafeQueue::push_spsc(Packet *p)
+{
+    // Only the producer writes _tail, so it needs no atomic operations.  The
+    // producer rereads the consumer's _head only when its cached copy says
+    // the queue is full or longer than ever before.
+    Stats &st = _stats.local();
+    Storage::index_type t = _tail, nt = next_i(t);
+    int s = size(_p.head, nt);
+    if (nt == _p.head || s > st.highwater) {
+	_p.head = _head;
+	if (nt == _p.head) {
+	    push_drop(st, p);
+	    return;
+	}
+	s = size(_p.head, nt);
+    }
+
+    _q[t] = p;
+    packet_memory_barrier(_q[t], _tail);
+    _tail = nt;
+    note_push(st, s);
+}
+
+inline void
+ThreadSafeQueue::push_mpsc(Packet *p)
+{
+    // Reserve a slot by advancing _tail, then publish the packet by storing
+    // it in the slot.  A producer never waits for another producer.
+    Stats &st = _stats.local();
+    Storage::index_type h, t, nt;
+    do {
+	t = _tail;
+	nt = next_i(t);
+	h = _head;
+	if (nt == h) {
+	    push_drop(st, p);
+	    return;
+	}
+    } while (atomic_uint32_t::compare_swap(_tail, t, nt) != t);
+
+    click_compiler_fence();
+    _q[t] = p;
+    note_push(st, size(h, nt));
+}
+
+void
+ThreadSafeQueue::push_cas(Packet *p)
 {
     // Code taken from SimpleQueue::push().
 
@@ -63,12 +307,94 @@ ThreadSafeQueue::push(int, Packet *p)
 	push_success(h, t, nt, p);
     else {
 	_xtail = t;
-	push_failure(p);
+	push_drop(_stats.local(), p);
+    }
+}
+
+void
+ThreadSafeQueue::push_mpmc(Packet *p)
+{
+#if CLICK_THREADSAFEQUEUE_LANES
+    Lane &l = _lanes[(unsigned) click_current_thread_id % _nlanes];
+    Storage::index_type t = l.tail, nt = next_i(t);
+    if (nt == l.head_cache && nt == (l.head_cache = l.head)) {
+	push_drop(_stats.local(), p);
+	return;
+    }
+
+    l.q[t] = p;
+    click_compiler_fence();
+    l.tail = nt;
+
+    int s = size(l.head_cache, nt);
+    if (s > l.highwater)
+	l.highwater = s;
+
+    _empty_note.wake();
+
+    if (s == capacity()) {
+	_full_note.sleep();
+	if (size(l.head, nt) < capacity())
+	    _full_note.wake();
+    }
+#else
+    push_cas(p);
+#endif
+}
+
+void
+ThreadSafeQueue::push(int, Packet *p)
+{
+    switch (_mode) {
+    case M_SPSC:
+	push_spsc(p);
+	break;
+    case M_MPSC:
+	push_mpsc(p);
+	break;
+    case M_MPMC:
+	push_mpmc(p);
+	break;
+    default:
+	push_cas(p);
+	break;
     }
 }
 
 Packet *
-ThreadSafeQueue::pull(int)
+ThreadSafeQueue::refill_batch()
+{
+    // Dequeue up to BATCH packets at once so the consumer writes the shared
+    // _head, and the producers see it change, once per batch.
+    Storage::index_type h = _head;
+    int n = 0;
+    if (_mode == M_SPSC) {
+	if (h == _c.tail)
+	    _c.tail = _tail;
+	for (; h != _c.tail && n < BATCH; h = next_i(h))
+	    _c.batch[n++] = _q[h];
+    } else {
+	Packet *p;
+	for (; n < BATCH && (p = _q[h]); h = next_i(h)) {
+	    _c.batch[n++] = p;
+	    _q[h] = 0;
+	}
+    }
+    if (n == 0)
+	return pull_failure();
+
+    click_compiler_fence();
+    _head = h;
+    _c.pos = 1;
+    _c.n = n;
+
+    _sleepiness = 0;
+    _full_note.wake();
+    return _c.batch[0];
+}
+
+Packet *
+ThreadSafeQueue::pull_cas()
 {
     // Code taken from SimpleQueue::deq.
 
@@ -89,6 +415,160 @@ ThreadSafeQueue::pull(int)
     }
 }
 
+Packet *
+ThreadSafeQueue::pull_mpmc()
+{
+    uint32_t start = _next_lane.value();
+    for (int i = 0; i < _nlanes; ++i) {
+	Lane &l = _lanes[(start + i) % _nlanes];
+	if (l.head == l.tail || !l.lock.attempt())
+	    continue;
+	Storage::index_type h = l.head;
+	if (h != l.tail) {
+	    Packet *p = l.q[h];
+	    click_compiler_fence();
+	    l.head = next_i(h);
+	    l.lock.release();
+	    _next_lane = start + i + 1;
+	    _sleepiness = 0;
+	    _full_note.wake();
+	    return p;
+	}
+	l.lock.release();
+    }
+
+    if (_sleepiness >= SLEEPINESS_TRIGGER) {
+	_empty_note.sleep();
+	// See FullNoteQueue::pull_failure().
+	if (lanes_size())
+	    _empty_note.wake();
+    } else
+	++_sleepiness;
+    return 0;
+}
+
+Packet *
+ThreadSafeQueue::pull(int)
+{
+    switch (_mode) {
+    case M_SPSC:
+    case M_MPSC:
+	if (_c.pos < _c.n) {
+	    _sleepiness = 0;
+	    return _c.batch[_c.pos++];
+	}
+	return refill_batch();
+    case M_MPMC:
+	return pull_mpmc();
+    default:
+	return pull_cas();
+    }
+}
+
+
+// Drops are counted per thread, so that producers overrunning the queue do not
+// contend for the counter.  Only a thread's first drop sums the counters.
+inline void
+ThreadSafeQueue::push_drop(Stats &st, Packet *p)
+{
+    if (st.drops == 0 && _capacity > 0 && drops() == 0)
+	click_chatter("%p{element}: overflow", this);
+    st.drops++;
+    checked_output_push(1, p);
+}
+
+uint32_t
+ThreadSafeQueue::drops() const
+{
+    uint32_t d = _drops;
+    for (int i = 0; i < _stats.size(); ++i)
+	d += _stats[i].drops;
+    return d;
+}
+
+int
+ThreadSafeQueue::highwater_length() const
+{
+    int s = _highwater_length;
+    for (int i = 0; i < _stats.size(); ++i)
+	if (_stats[i].highwater > s)
+	    s = _stats[i].highwater;
+    return s;
+}
+
+int
+ThreadSafeQueue::lanes_size() const
+{
+    int s = 0;
+    for (int i = 0; i < _nlanes; ++i)
+	s += size(_lanes[i].head, _lanes[i].tail);
+    return s;
+}
+
+int
+ThreadSafeQueue::lanes_highwater_length() const
+{
+    int s = 0;
+    for (int i = 0; i < _nlanes; ++i)
+	if (_lanes[i].highwater > s)
+	    s = _lanes[i].highwater;
+    return s;
+}
+
+enum { H_LENGTH, H_HIGHWATER_LENGTH, H_DROPS, H_MODE, H_RESET_COUNTS };
+
+String
+ThreadSafeQueue::read_handler(Element *e, void *thunk)
+{
+    ThreadSafeQueue *q = static_cast<ThreadSafeQueue *>(e);
+    switch ((intptr_t) thunk) {
+    case H_LENGTH:
+	if (q->_mode == M_MPMC)
+	    return String(q->lanes_size());
+	else
+	    return String(q->size() + q->_c.n - q->_c.pos);
+    case H_HIGHWATER_LENGTH:
+	if (q->_mode == M_MPMC)
+	    return String(q->lanes_highwater_length());
+	else
+	    return String(q->highwater_length());
+    case H_DROPS:
+	return String(q->drops());
+    case H_MODE:
+	return String::make_stable(mode_names[q->_mode]);
+    default:
+	return String();
+    }
+}
+
+int
+ThreadSafeQueue::write_handler(const String &, Element *e, void *thunk, ErrorHandler *)
+{
+    ThreadSafeQueue *q = static_cast<ThreadSafeQueue *>(e);
+    switch ((intptr_t) thunk) {
+    case H_RESET_COUNTS:
+	q->_drops = 0;
+	q->_highwater_length = q->size();
+	q->_stats.assign(Stats());
+	for (int i = 0; i < q->_nlanes; ++i)
+	    q->_lanes[i].highwater = q->size(q->_lanes[i].head, q->_lanes[i].tail);
+	return 0;
+    default:
+	return 0;
+    }
+}
+
+void
+ThreadSafeQueue::add_handlers()
+{
+    FullNoteQueue::add_handlers();
+    add_read_handler("length", read_handler, H_LENGTH);
+    add_read_handler("highwater_length", read_handler, H_HIGHWATER_LENGTH);
+    add_read_handler("drops", read_handler, H_DROPS);
+    add_read_handler("mode", read_handler, H_MODE, Handler::CALM);
+    add_write_handler("reset_counts", write_handler, H_RESET_COUNTS, Handler::BUTTON | Handler::NONEXCLUSIVE);
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(FullNoteQueue)
 EXPORT_ELEMENT(ThreadSafeQueue)
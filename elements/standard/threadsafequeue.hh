@@ -2,13 +2,18 @@
 #ifndef CLICK_THREADSAFEQUEUE_HH
 #define CLICK_THREADSAFEQUEUE_HH
 #include "fullnotequeue.hh"
+#include <click/sync.hh>
+#include <click/perthread.hh>
 CLICK_DECLS
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+# define CLICK_THREADSAFEQUEUE_LANES 1
+#endif
 
 /*
 =c
 
 ThreadSafeQueue
-ThreadSafeQueue(CAPACITY)
+ThreadSafeQueue(CAPACITY, I<keywords> MODE)
 
 =s storage
 
@@ -25,6 +30,61 @@ that it supports multiple concurrent pushers and pullers.  In all respects
 other than thread safety it behaves just like Queue, and like Queue it has
 non-full and non-empty notifiers.
 
+ThreadSafeQueue picks a synchronization algorithm based on how many threads
+can push to and pull from it.  The MODE keyword argument selects one
+explicitly:
+
+=over 8
+
+=item AUTO
+
+The default.  Examines the home threads of the elements that push packets to
+the queue and those that pull from it, then picks SPSC, MPSC, or MPMC.  If the
+router contains a BalancedThreadSched, which may move tasks between threads,
+picks MPMC.
+
+=item SPSC
+
+Single producer, single consumer.  The producer and consumer each keep a
+cached copy of the other side's index on their own cache line, so in steady
+state they touch shared cache lines only to exchange packets.
+
+=item MPSC
+
+Multiple producers, single consumer.  Each producer reserves a slot with a
+single compare-and-swap on the tail and publishes its packet by storing it.
+Producers never wait on each other; the consumer treats a reserved but
+unpublished slot as empty.
+
+=item MPMC
+
+Multiple producers, multiple consumers.  Each producer thread gets its own
+SPSC lane holding up to CAPACITY packets.  Consumers take packets from lanes
+in round-robin order, skipping lanes another consumer is using.  Packets from
+one thread stay in order, but packets from different threads may be
+reordered.  Requires thread-local storage; otherwise behaves like CAS.
+
+=item CAS
+
+The original algorithm.  Pushers and pullers reserve slots with
+compare-and-swap and may spin while another thread completes its operation.
+
+=back
+
+The SPSC and MPSC algorithms dequeue packets in batches of up to 16 into a
+consumer-private buffer, so the queue may hold up to 16 packets more than
+CAPACITY.  Buffered packets count toward C<length>.
+
+The SPSC, MPSC, and MPMC algorithms assume that the chosen number of threads
+is never exceeded, including by handlers such as C<reset>.  When in doubt,
+choose MODE explicitly.  A live reconfiguration cannot change the mode; it may
+omit MODE or restate the configured or chosen mode.
+
+Producers count drops and track the highwater length per thread, so that
+overrunning the queue from several threads does not make them contend for
+the counters.  The C<drops> and C<highwater_length> handlers combine the
+per-thread values.
+
 =h length read-only
 
 Returns the current number of packets in the queue.
@@ -41,6 +101,10 @@ Returns or sets the queue's capacity.
 
 Returns the number of packets dropped by the queue so far.
 
+=h mode read-only
+
+Returns the algorithm in use: C<spsc>, C<mpsc>, C<mpmc>, or C<cas>.
+
 =h reset_counts write-only
 
 When written, resets the C<drops> and C<highwater_length> counters.
@@ -49,7 +113,8 @@ When written, resets the C<drops> and C<highwater_length> counters.
 
 When written, drops all packets in the queue.
 
-=a Queue, SimpleQueue, NotifierQueue, MixedQueue, FrontDropQueue */
+=a Queue, SimpleQueue, NotifierQueue, MixedQueue, FrontDropQueue, SPSCQueue,
+MPSCQueue, MPMCQueue */
 
 class ThreadSafeQueue : public FullNoteQueue { public:
 
@@ -58,16 +123,90 @@ class ThreadSafeQueue : public FullNoteQueue { public:
     const char *class_name() const		{ return "ThreadSafeQueue"; }
     void *cast(const char *);
 
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    bool can_live_reconfigure() const;
     int live_reconfigure(Vector<String> &conf, ErrorHandler *errh);
+    void take_state(Element *e, ErrorHandler *errh);
+    void add_handlers();
 
     void push(int port, Packet *);
     Packet *pull(int port);
 
-  private:
+    enum { M_AUTO, M_SPSC, M_MPSC, M_MPMC, M_CAS };
+    int mode() const				{ return _mode; }
+
+  protected:
+
+    enum { BATCH = 16 };
+
+    int _mode;
+    int _config_mode;
+    bool _mode_fixed;
 
     atomic_uint32_t _xhead;
     atomic_uint32_t _xtail;
 
+    // SPSC and MPSC consumer state, written only by the consumer
+    struct Consumer {
+	Storage::index_type tail;
+	int pos;
+	int n;
+	Packet *batch[BATCH];
+    } _c CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    // SPSC producer state, written only by the producer
+    struct Producer {
+	Storage::index_type head;
+    } _p CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    struct Lane {
+	Packet **q;
+	volatile Storage::index_type tail CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+	Storage::index_type head_cache;
+	int highwater;
+	volatile Storage::index_type head CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+	SimpleSpinlock lock;
+	int node;
+    };
+    Lane *_lanes;
+    int _nlanes;
+    atomic_uint32_t _next_lane;
+
+    int parse_mode(Vector<String> &conf, int &m, ErrorHandler *errh);
+    int choose_mode(const Vector<int> &producers, const Vector<int> &consumers) const;
+    int initialize_lanes(ErrorHandler *errh);
+    void cleanup_lanes();
+    void reset_ring();
+    int lanes_size() const;
+    int lanes_highwater_length() const;
+
+    // Producer statistics, kept per thread
+    struct Stats {
+	uint32_t drops;
+	int highwater;
+	Stats() : drops(0), highwater(0) { }
+    };
+    per_thread<Stats> _stats;
+
+    uint32_t drops() const;
+    int highwater_length() const;
+
+    inline void note_push(Stats &st, int s);
+    inline void push_drop(Stats &st, Packet *p);
+
+    void push_cas(Packet *p);
+    Packet *pull_cas();
+    inline void push_spsc(Packet *p);
+    inline void push_mpsc(Packet *p);
+    Packet *refill_batch();
+    void push_mpmc(Packet *p);
+    Packet *pull_mpmc();
+
+    static String read_handler(Element *e, void *user_data);
+    static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh);
+
 };
 
 CLICK_ENDDECLS
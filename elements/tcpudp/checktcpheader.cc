@@ -23,6 +23,7 @@
 #include <click/glue.hh>
 #include <click/args.hh>
 #include <click/error.hh>
+#include <click/master.hh>
 #include <click/bitvector.hh>
 #include <click/straccum.hh>
 CLICK_DECLS
@@ -32,14 +33,12 @@ const char *CheckTCPHeader::reason_texts[NREASONS] = {
 };
 
 CheckTCPHeader::CheckTCPHeader()
-  : _reason_drops(0)
+  : _details(false)
 {
-  _drops = 0;
 }
 
 CheckTCPHeader::~CheckTCPHeader()
 {
-  delete[] _reason_drops;
 }
 
 int
@@ -55,24 +54,25 @@ CheckTCPHeader::configure(Vector<String> &conf, ErrorHandler *errh)
 	return -1;
 
   _verbose = verbose;
-  if (details) {
-    _reason_drops = new atomic_uint32_t[NREASONS];
-    for (int i = 0; i < NREASONS; ++i)
-      _reason_drops[i] = 0;
-  }
+  _details = details;
+  return 0;
+}
 
+int
+CheckTCPHeader::initialize(ErrorHandler *)
+{
+  _drops.initialize(master()->nthreads());
   return 0;
 }
 
 Packet *
 CheckTCPHeader::drop(Reason reason, Packet *p)
 {
-  if (_drops == 0 || _verbose)
+  Drops &d = _drops.local();
+  if (d.drops == 0 || _verbose)
     click_chatter("%p{element}: TCP header check failed: %s", this, reason_texts[reason]);
-  _drops++;
-
-  if (_reason_drops)
-    _reason_drops[reason]++;
+  ++d.drops;
+  ++d.reason_drops[reason];
 
   if (noutputs() == 2)
     output(1).push(p);
@@ -112,13 +112,21 @@ CheckTCPHeader::read_handler(Element *e, void *thunk)
   CheckTCPHeader *c = reinterpret_cast<CheckTCPHeader *>(e);
   switch ((intptr_t)thunk) {
 
-   case 0:			// drops
-    return String(c->_drops);
+   case 0: {			// drops
+     uint32_t n = 0;
+     for (int t = 0; t < c->_drops.size(); ++t)
+       n += c->_drops[t].drops;
+     return String(n);
+   }
 
    case 1: {			// drop_details
      StringAccum sa;
-     for (int i = 0; i < NREASONS; i++)
-       sa << c->_reason_drops[i] << '\t' << reason_texts[i] << '\n';
+     for (int i = 0; i < NREASONS; i++) {
+       uint32_t n = 0;
+       for (int t = 0; t < c->_drops.size(); ++t)
+	 n += c->_drops[t].reason_drops[i];
+       sa << n << '\t' << reason_texts[i] << '\n';
+     }
      return sa.take_string();
    }
 
@@ -132,7 +140,7 @@ void
 CheckTCPHeader::add_handlers()
 {
   add_read_handler("drops", read_handler, 0);
-  if (_reason_drops)
+  if (_details)
     add_read_handler("drop_details", read_handler, 1);
 }
 
@@ -1,7 +1,7 @@
 #ifndef CLICK_CHECKUDPHEADER_HH
 #define CLICK_CHECKUDPHEADER_HH
 #include <click/element.hh>
-#include <click/atomic.hh>
+#include <click/perthread.hh>
 CLICK_DECLS
 
 /*
@@ -61,6 +61,7 @@ class CheckUDPHeader : public Element { public:
   const char *processing() const		{ return PROCESSING_A_AH; }
 
   int configure(Vector<String> &, ErrorHandler *);
+  int initialize(ErrorHandler *);
   void add_handlers();
 
   Packet *simple_action(Packet *);
@@ -71,8 +72,7 @@ class CheckUDPHeader : public Element { public:
  private:
 
   bool _verbose : 1;
-  atomic_uint32_t _drops;
-  atomic_uint32_t *_reason_drops;
+  bool _details : 1;
 
   enum Reason {
     NOT_UDP,
@@ -82,6 +82,16 @@ class CheckUDPHeader : public Element { public:
   };
   static const char *reason_texts[NREASONS];
 
+  struct Drops {
+    uint32_t drops;
+    uint32_t reason_drops[NREASONS];
+    Drops() : drops(0) {
+      for (int i = 0; i < NREASONS; ++i)
+	reason_drops[i] = 0;
+    }
+  };
+  per_thread<Drops> _drops;
+
   Packet *drop(Reason, Packet *);
   static String read_handler(Element *, void *);
 
@@ -128,7 +128,7 @@ IPRewriter::push(int port, Packet *p_in)
     }
 
     IPFlowID flowid(p);
-    HashContainer<IPRewriterEntry> *map = (iph->ip_p == IP_PROTO_TCP ? &_map : &_udp_map);
+    Map *map = (iph->ip_p == IP_PROTO_TCP ? &_map : &_udp_map);
     IPRewriterEntry *m = map->get(flowid);
 
     if (!m) {			// create new mapping
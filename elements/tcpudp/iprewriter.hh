@@ -220,7 +220,7 @@ class IPRewriter : public TCPRewriter { public:
     int configure(Vector<String> &, ErrorHandler *);
 
     IPRewriterEntry *get_entry(int ip_p, const IPFlowID &flowid, int input);
-    HashContainer<IPRewriterEntry> *get_map(int mapid) {
+    Map *get_map(int mapid) {
 	if (mapid == IPRewriterInput::mapid_default)
 	    return &_map;
 	else if (mapid == IPRewriterInput::mapid_iprewriter_udp)
@@ -0,0 +1,325 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * tcpcoalesce.{cc,hh} -- merges consecutive TCP segments into large packets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "tcpcoalesce.hh"
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+TCPCoalesce::TCPCoalesce()
+    : _timer(this), _count(0), _merged(0)
+{
+}
+
+TCPCoalesce::~TCPCoalesce()
+{
+}
+
+int
+TCPCoalesce::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _max_length = 65535;
+    _max_flows = 8;
+    _timeout = Timestamp::make_msec(1);
+    if (Args(conf, this, errh)
+	.read("MAX_LENGTH", _max_length)
+	.read("FLOWS", _max_flows)
+	.read("TIMEOUT", _timeout)
+	.complete() < 0)
+	return -1;
+    if (_max_length > 65535 || _max_length < 576)
+	return errh->error("MAX_LENGTH must be between 576 and 65535");
+    if (_max_flows < 1)
+	return errh->error("FLOWS must be positive");
+    return 0;
+}
+
+int
+TCPCoalesce::initialize(ErrorHandler *)
+{
+    _timer.initialize(this);
+    return 0;
+}
+
+void
+TCPCoalesce::cleanup(CleanupStage)
+{
+    for (Flow *f = _flows.begin(); f != _flows.end(); ++f)
+	f->p->kill();
+    _flows.clear();
+}
+
+// Return the unfolded ones'-complement sum of len bytes of data, which start
+// offset bytes into the payload.
+static inline uint32_t
+payload_sum(const unsigned char *data, uint32_t len, uint32_t offset)
+{
+    uint32_t sum = (uint16_t) ~click_in_cksum(data, len);
+    if (offset & 1)
+	sum = ((sum & 0xFF) << 8) | (sum >> 8);
+    return sum;
+}
+
+bool
+TCPCoalesce::mergeable(const Packet *p)
+{
+    if (!p->has_network_header()
+	|| p->network_length() < (int) (sizeof(click_ip) + sizeof(click_tcp)))
+	return false;
+    const click_ip *ip = p->ip_header();
+    if (ip->ip_v != 4 || ip->ip_hl != (sizeof(click_ip) >> 2)
+	|| ip->ip_p != IP_PROTO_TCP || IP_ISFRAG(ip))
+	return false;
+    const click_tcp *th = reinterpret_cast<const click_tcp *>(ip + 1);
+    unsigned thl = th->th_off << 2;
+    unsigned len = ntohs(ip->ip_len);
+    return thl >= sizeof(click_tcp)
+	&& len > sizeof(click_ip) + thl
+	&& p->network_length() >= (int) len
+	&& (th->th_flags & ~TH_PUSH) == TH_ACK;
+}
+
+bool
+TCPCoalesce::can_join(const Flow &f, const Packet *p) const
+{
+    // A merged packet's payload may not be copied yet, so read only its
+    // headers, through WritablePacket.
+    int nh_off = p->network_header_offset();
+    if (f.p->network_header_offset() != nh_off)
+	return false;
+    const unsigned char *hdata = (f.merged ? static_cast<WritablePacket *>(f.p)->data() : f.p->data());
+    const click_ip *hip = reinterpret_cast<const click_ip *>(hdata + nh_off);
+    const click_tcp *hth = reinterpret_cast<const click_tcp *>(hip + 1);
+    const click_ip *ip = p->ip_header();
+    const click_tcp *th = reinterpret_cast<const click_tcp *>(ip + 1);
+    unsigned thl = th->th_off << 2;
+    uint32_t len = ntohs(ip->ip_len) - sizeof(click_ip) - thl;
+    return ntohl(th->th_seq) == f.next_seq
+	&& len <= f.gso_size
+	&& sizeof(click_ip) + thl + f.payload + len <= _max_length
+	&& hip->ip_tos == ip->ip_tos
+	&& hip->ip_ttl == ip->ip_ttl
+	&& hip->ip_off == ip->ip_off
+	&& hth->th_off == th->th_off
+	&& hth->th_ack == th->th_ack
+	&& hth->th_win == th->th_win
+	&& memcmp(hth + 1, th + 1, thl - sizeof(click_tcp)) == 0
+	&& memcmp(hdata, p->data(), nh_off) == 0;
+}
+
+void
+TCPCoalesce::hold(Flow &f, Packet *p)
+{
+    const click_ip *ip = p->ip_header();
+    const click_tcp *th = reinterpret_cast<const click_tcp *>(ip + 1);
+    f.id = IPFlowID(p);
+    f.p = p;
+    f.merged = false;
+    f.payload = f.gso_size = ntohs(ip->ip_len) - sizeof(click_ip) - (th->th_off << 2);
+    f.next_seq = ntohl(th->th_seq) + f.payload;
+    f.expiry = Timestamp::now() + _timeout;
+    if (!_timer.scheduled())
+	_timer.schedule_at(f.expiry);
+}
+
+bool
+TCPCoalesce::join(Flow &f, Packet *p)
+{
+    int nh_off = p->network_header_offset();
+    const click_ip *ip = p->ip_header();
+    const click_tcp *th = reinterpret_cast<const click_tcp *>(ip + 1);
+    uint32_t hdr_len = nh_off + sizeof(click_ip) + (th->th_off << 2);
+    uint32_t len = ntohs(ip->ip_len) - (hdr_len - nh_off);
+
+    if (!f.merged) {
+	// Replace the held segment with a header packet that has room for
+	// merged payloads, and that shares the held segment's payload.
+	Packet *h = f.p;
+	WritablePacket *q = Packet::make(h->headroom(), h->data(), hdr_len,
+					 _max_length - (hdr_len - nh_off));
+	if (!q)
+	    return false;
+	if (h->has_mac_header())
+	    q->set_mac_header(q->data() + h->mac_header_offset());
+	q->set_network_header(q->data() + nh_off, sizeof(click_ip));
+	q->copy_annotations(h);
+	f.csum = payload_sum(h->data() + hdr_len, f.payload, 0);
+	if (!q->append_shared(h, hdr_len, f.payload)) {
+	    q->kill();
+	    return false;
+	}
+	h->kill();
+	f.p = q;
+	f.merged = true;
+    }
+
+    WritablePacket *q = static_cast<WritablePacket *>(f.p);
+    const unsigned char *payload = p->data() + hdr_len;
+    f.csum += payload_sum(payload, len, f.payload);
+    if (!q->append_shared(p, hdr_len, len)) {
+	if (!(q = q->put(len))) {
+	    f.p = 0;
+	    p->kill();
+	    return true;
+	}
+	memcpy(q->end_data() - len, payload, len);
+	f.p = q;
+    }
+    if (th->th_flags & TH_PUSH)
+	reinterpret_cast<click_tcp *>(q->ip_header() + 1)->th_flags |= TH_PUSH;
+    f.payload += len;
+    f.next_seq += len;
+    p->kill();
+    ++_merged;
+    return true;
+}
+
+void
+TCPCoalesce::flush(int i)
+{
+    Flow f = _flows[i];
+    _flows.erase(_flows.begin() + i);
+    if (!f.p)
+	return;
+    if (f.merged) {
+	WritablePacket *q = static_cast<WritablePacket *>(f.p);
+	click_ip *ip = q->ip_header();
+	click_tcp *th = reinterpret_cast<click_tcp *>(ip + 1);
+	unsigned thl = th->th_off << 2;
+	ip->ip_len = htons(sizeof(click_ip) + thl + f.payload);
+	ip->ip_sum = 0;
+	ip->ip_sum = click_in_cksum((unsigned char *) ip, sizeof(click_ip));
+	// The TCP header has even length, so the payload sum adds directly.
+	th->th_sum = 0;
+	uint32_t sum = (uint16_t) ~click_in_cksum((unsigned char *) th, thl) + f.csum;
+	while (sum >> 16)
+	    sum = (sum & 0xFFFF) + (sum >> 16);
+	th->th_sum = click_in_cksum_pseudohdr(~sum & 0xFFFF, ip, thl + f.payload);
+	SET_GSO_SIZE_ANNO(q, f.gso_size);
+    } else
+	SET_GSO_SIZE_ANNO(f.p, 0);
+    output(0).push(f.p);
+}
+
+void
+TCPCoalesce::flush_all()
+{
+    while (_flows.size())
+	flush(0);
+}
+
+void
+TCPCoalesce::push(int, Packet *p)
+{
+    ++_count;
+    if (!mergeable(p)) {
+	// GSO_SIZE shares bytes with other protocols' annotations, so touch
+	// only IPv4 TCP packets.
+	const click_ip *ip = 0;
+	if (p->has_network_header()
+	    && p->network_length() >= (int) sizeof(click_ip)
+	    && p->ip_header()->ip_v == 4
+	    && p->ip_header()->ip_p == IP_PROTO_TCP)
+	    ip = p->ip_header();
+	// Keep the flow's order: emit its held packet first.
+	if (ip && _flows.size() && p->has_transport_header()
+	    && IP_FIRSTFRAG(ip)) {
+	    IPFlowID id(p);
+	    for (int i = 0; i < _flows.size(); ++i)
+		if (_flows[i].id == id) {
+		    flush(i);
+		    break;
+		}
+	}
+	if (ip)
+	    SET_GSO_SIZE_ANNO(p, 0);
+	output(0).push(p);
+	return;
+    }
+
+    IPFlowID id(p);
+    const click_ip *ip = p->ip_header();
+    const click_tcp *th = reinterpret_cast<const click_tcp *>(ip + 1);
+    for (int i = 0; i < _flows.size(); ++i)
+	if (_flows[i].id == id) {
+	    Flow &f = _flows[i];
+	    uint16_t gso_size = f.gso_size;
+	    uint32_t len = ntohs(ip->ip_len) - sizeof(click_ip) - (th->th_off << 2);
+	    bool push = th->th_flags & TH_PUSH;
+	    if (can_join(f, p) && join(f, p)) {
+		// Nothing can follow a pushed or short segment, and a full
+		// packet has no room.
+		if (!f.p || push || len < gso_size
+		    || sizeof(click_ip) + (th->th_off << 2) + f.payload + gso_size > _max_length)
+		    flush(i);
+		return;
+	    }
+	    flush(i);
+	    break;
+	}
+
+    if (th->th_flags & TH_PUSH) {
+	SET_GSO_SIZE_ANNO(p, 0);
+	output(0).push(p);
+	return;
+    }
+    if (_flows.size() >= _max_flows)
+	flush(0);
+    _flows.push_back(Flow());
+    hold(_flows.back(), p);
+}
+
+void
+TCPCoalesce::run_timer(Timer *)
+{
+    // Flows are held in arrival order, so expiries increase.
+    Timestamp now = Timestamp::now();
+    while (_flows.size() && _flows[0].expiry <= now)
+	flush(0);
+    if (_flows.size())
+	_timer.schedule_at(_flows[0].expiry);
+}
+
+String
+TCPCoalesce::read_handler(Element *e, void *user_data)
+{
+    TCPCoalesce *tc = static_cast<TCPCoalesce *>(e);
+    if (user_data)
+	return String(tc->_merged);
+    else
+	return String(tc->_count);
+}
+
+int
+TCPCoalesce::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<TCPCoalesce *>(e)->flush_all();
+    return 0;
+}
+
+void
+TCPCoalesce::add_handlers()
+{
+    add_read_handler("count", read_handler, 0);
+    add_read_handler("merged", read_handler, 1);
+    add_write_handler("flush", write_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TCPCoalesce)
@@ -0,0 +1,137 @@
+#ifndef CLICK_TCPCOALESCE_HH
+#define CLICK_TCPCOALESCE_HH
+#include <click/element.hh>
+#include <click/ipflowid.hh>
+#include <click/timer.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TCPCoalesce([I<keywords> MAX_LENGTH, FLOWS, TIMEOUT])
+
+=s tcp
+
+merges consecutive TCP segments into large packets
+
+=d
+
+Merges in-order TCP segments of the same flow into large packets, like the
+generic receive offload (GRO) of network stacks, so that later elements
+process one packet instead of many.  Expects IP packets with their network
+header annotations set, as by CheckIPHeader or MarkIPHeader; any bytes
+before the IP header, such as an Ethernet header, are kept.
+
+TCPCoalesce holds the latest packet of each flow, keyed by IPFlowID.  A
+segment joins the held packet if its sequence number follows it, its payload
+is no longer than the held packet's first segment, and its IP and TCP
+headers match apart from length, IP ID, checksums, sequence number and the
+PSH flag.  Only IPv4 segments without IP options or fragmentation, with
+nonempty payload, and whose only flags are ACK and PSH are merged; other
+packets pass through, after any held packet of their flow.
+
+A held packet is emitted when a segment of its flow cannot join it, when it
+reaches MAX_LENGTH or a segment with PSH or a short payload joins it, when
+it has been held for TIMEOUT, or when more than FLOWS flows are held.  Merged
+packets have the headers of their first segment, with the union of the PSH
+flags and with correct IP lengths and IP and TCP checksums.  Their GSO_SIZE
+annotation is set to the payload length of their first segment, which
+TCPSegment uses to split them again; other IPv4 TCP packets leave TCPCoalesce
+with a zero GSO_SIZE annotation.  The annotation shares bytes with DST_IP6, so
+TCPCoalesce leaves the annotations of all other packets unchanged.  Merged
+payloads share the input
+packets' buffers (see Packet::append_shared) until an element reads them.
+
+Keyword arguments are:
+
+=over 8
+
+=item MAX_LENGTH
+
+Unsigned.  The largest IP length of a merged packet.  Default is 65535.
+
+=item FLOWS
+
+Unsigned.  The most flows held at once.  When a new flow arrives and FLOWS
+flows are held, the flow held longest is emitted.  Default is 8.
+
+=item TIMEOUT
+
+Timestamp.  The longest time a packet is held.  Default is 0.001 (one
+millisecond).
+
+=back
+
+=h count read-only
+
+Returns the number of packets received.
+
+=h merged read-only
+
+Returns the number of segments merged into earlier packets.
+
+=h flush write-only
+
+Emits all held packets.
+
+=e
+
+  FromDevice(eth0) -> Strip(14) -> CheckIPHeader -> TCPCoalesce
+    -> IPFilter(...) -> ... -> TCPSegment -> EtherEncap(...) -> ToDevice(eth1);
+
+=a TCPSegment, TCPFragmenter, IPFlowID */
+
+class TCPCoalesce : public Element { public:
+
+    TCPCoalesce();
+    ~TCPCoalesce();
+
+    const char *class_name() const	{ return "TCPCoalesce"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void push(int, Packet *);
+    void run_timer(Timer *);
+
+  private:
+
+    struct Flow {
+	IPFlowID id;
+	Packet *p;
+	bool merged;		// p is a header packet built by merge()
+	uint16_t gso_size;	// payload length of the first segment
+	uint32_t next_seq;	// host order
+	uint32_t payload;	// total payload length
+	uint32_t csum;		// unfolded sum of the payload, if merged
+	Timestamp expiry;
+    };
+
+    Vector<Flow> _flows;
+    uint32_t _max_length;
+    int _max_flows;
+    Timestamp _timeout;
+    Timer _timer;
+
+    uint64_t _count;
+    uint64_t _merged;
+
+    static bool mergeable(const Packet *p);
+    bool can_join(const Flow &f, const Packet *p) const;
+    void hold(Flow &f, Packet *p);
+    bool join(Flow &f, Packet *p);
+    void flush(int i);
+    void flush_all();
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
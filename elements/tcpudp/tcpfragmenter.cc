@@ -22,6 +22,7 @@
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
+#include <click/packet_anno.hh>
 #include <click/standard/alignmentinfo.hh>
 CLICK_DECLS
 
@@ -52,6 +53,12 @@ TCPFragmenter::configure(Vector<String> &conf, ErrorHandler *errh)
 
 void
 TCPFragmenter::push(int, Packet *p)
+{
+    fragment(p, _mtu);
+}
+
+void
+TCPFragmenter::fragment(Packet *p, int mtu)
 {
     int32_t tcp_len;
     {
@@ -59,32 +66,44 @@ TCPFragmenter::push(int, Packet *p)
         const click_tcp *tcp = p->tcp_header();
         tcp_len = (ntohs(ip->ip_len)-(ip->ip_hl<<2)-(tcp->th_off<<2));
 
-        if (!_mtu || tcp_len < _mtu) {
+        if (!mtu || tcp_len <= mtu) {
             output(0).push(p);
             return;
         }
     }
 
-    for (int offset = 0; offset < tcp_len; offset += _mtu) {
-        Packet *p_clone;
-        if (offset + _mtu < tcp_len)
-            p_clone = p->clone();
-        else {
-            p_clone = p;
-            p = 0;
-        }
-        if (!p_clone)
+    // Each fragment is a copy of the headers followed by a slice of the
+    // payload that shares p's buffer.  A MAC header in the headroom, left
+    // by an earlier Strip, is copied too.
+    const click_tcp *tcp_in = p->tcp_header();
+    const unsigned char *tcp_data = (const unsigned char *) tcp_in + (tcp_in->th_off<<2);
+    uint32_t hdr_len = tcp_data - p->data();
+    uint32_t tcp_offset = p->transport_header_offset();
+    uint32_t mac_len = 0;
+    if (p->has_mac_header() && p->mac_header_offset() < 0)
+        mac_len = -p->mac_header_offset();
+
+    for (int offset = 0; offset < tcp_len; offset += mtu) {
+        int this_len = tcp_len - offset > mtu ? mtu : tcp_len - offset;
+        WritablePacket *q = Packet::make(p->headroom() - mac_len, p->data() - mac_len,
+                                         mac_len + hdr_len, this_len);
+        if (!q)
             break;
-        WritablePacket *q = p_clone->uniqueify();
-        p_clone = 0;
+        q->pull(mac_len);
+        if (p->has_mac_header())
+            q->set_mac_header(q->data() + p->mac_header_offset());
+        q->set_network_header(q->data() + p->network_header_offset(),
+                              tcp_offset - p->network_header_offset());
+        q->copy_annotations(p);
+        if (!q->append_shared(p, hdr_len + offset, this_len)) {
+            q = q->put(this_len);
+            memcpy(q->data() + hdr_len, tcp_data + offset, this_len);
+        }
+
         click_ip *ip = q->ip_header();
         click_tcp *tcp = q->tcp_header();
-        uint8_t *tcp_data = ((uint8_t *)tcp) + (tcp->th_off<<2);
-        int this_len = tcp_len - offset > _mtu ? _mtu : tcp_len - offset;
-        if (offset != 0)
-            memcpy(tcp_data, tcp_data + offset, this_len);
-        q->take(tcp_len - this_len);
-        ip->ip_len = htons(q->end_data() - q->network_header());
+        ip->ip_len = htons(hdr_len + this_len - q->network_header_offset());
+        ip->ip_id = htons(ntohs(ip->ip_id) + offset / mtu);
         ip->ip_sum = 0;
 #if HAVE_FAST_CHECKSUM
         ip->ip_sum = ip_fast_csum((unsigned char *)ip, q->network_header_length() >> 2);
@@ -93,14 +112,24 @@ TCPFragmenter::push(int, Packet *p)
 #endif
 
         tcp->th_seq = htonl(ntohl(tcp->th_seq) + offset);
+        // CWR belongs on the first fragment, FIN and PSH on the last
+        if (offset != 0)
+            tcp->th_flags &= ~TH_CWR;
+        if (offset + this_len < tcp_len)
+            tcp->th_flags &= ~(TH_FIN | TH_PUSH);
         tcp->th_sum = 0;
 
-        // now calculate tcp header cksum
-        int plen = q->end_data() - (uint8_t*)tcp;
-        unsigned csum = click_in_cksum((unsigned char *)tcp, plen);
-        tcp->th_sum = click_in_cksum_pseudohdr(csum, ip, plen);
+        // now calculate tcp header cksum; the TCP header has even length,
+        // so the header and payload sums combine
+        int tcp_hlen = hdr_len - tcp_offset;
+        uint32_t sum = (uint16_t) ~click_in_cksum((unsigned char *)tcp, tcp_hlen)
+            + (uint16_t) ~click_in_cksum(tcp_data + offset, this_len);
+        sum = (sum & 0xFFFF) + (sum >> 16);
+        unsigned csum = (uint16_t) ~((sum & 0xFFFF) + (sum >> 16));
+        tcp->th_sum = click_in_cksum_pseudohdr(csum, ip, tcp_hlen + this_len);
         output(0).push(q);
     }
+    p->kill();
 }
 
 CLICK_ENDDECLS
@@ -17,11 +17,17 @@ fragments TCP packets to a maximum TCP payload size
 TCP Packets with payload length greater than the MTU are fragmented into
 multiple packets each containing at most MTU bytes of TCP payload.  Each of
 these new packets will be a copy of the input packet except for checksums (ip
-and tcp), length (ip length), and tcp sequence number (for all fragments except
-the first).  This means that TCPFragmenter can operate on packets that have
+and tcp), length (ip length), ip id and tcp sequence number (for all fragments
+except the first), and tcp flags (FIN and PSH are kept only on the last
+fragment, and CWR only on the first).  This means that TCPFragmenter can operate on packets that have
 ethernet headers, and all ethernet headers will be copied to each fragment.
 
-=a IPFragmenter, TCPIPEncap
+Only the headers are copied.  Each fragment's payload shares the input
+packet's buffer (see Packet::append_shared) until some element reads it, so
+an output element that supports scattered packets, such as ToDevice or Socket
+at user level, can send the fragments without copying their payload.
+
+=a IPFragmenter, TCPSegment, TCPIPEncap
 */
 
 class TCPFragmenter : public Element { public:
@@ -38,8 +44,10 @@ class TCPFragmenter : public Element { public:
 
     void push(int, Packet *);
 
-  private:
+  protected:
     uint16_t _mtu;
+
+    void fragment(Packet *p, int mtu);
 };
 
 CLICK_ENDDECLS
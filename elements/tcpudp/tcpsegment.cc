@@ -0,0 +1,67 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * tcpsegment.{cc,hh} -- splits coalesced TCP packets into segments
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "tcpsegment.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+TCPSegment::TCPSegment()
+{
+}
+
+TCPSegment::~TCPSegment()
+{
+}
+
+int
+TCPSegment::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint16_t mtu = 0;
+    if (Args(conf, this, errh)
+	.read("MTU", mtu)
+	.complete() < 0)
+	return -1;
+    _mtu = mtu;
+    return 0;
+}
+
+void
+TCPSegment::push(int, Packet *p)
+{
+    // GSO_SIZE shares bytes with other protocols' annotations, so only
+    // IPv4 TCP packets carry it; pass anything else through untouched.
+    if (!p->has_network_header()
+	|| p->network_length() < (int) sizeof(click_ip)
+	|| p->ip_header()->ip_v != 4
+	|| p->ip_header()->ip_p != IP_PROTO_TCP
+	|| !p->has_transport_header()) {
+	output(0).push(p);
+	return;
+    }
+    int mtu = GSO_SIZE_ANNO(p);
+    if (mtu)
+	SET_GSO_SIZE_ANNO(p, 0);
+    if (_mtu && (!mtu || mtu > _mtu))
+	mtu = _mtu;
+    fragment(p, mtu);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(TCPFragmenter)
+EXPORT_ELEMENT(TCPSegment)
+ELEMENT_MT_SAFE(TCPSegment)
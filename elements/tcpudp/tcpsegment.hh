@@ -0,0 +1,59 @@
+#ifndef CLICK_TCPSEGMENT_HH
+#define CLICK_TCPSEGMENT_HH
+#include "tcpfragmenter.hh"
+CLICK_DECLS
+
+/*
+=c
+
+TCPSegment([I<keywords> MTU])
+
+=s tcp
+
+splits coalesced TCP packets back into segments
+
+=d
+
+Splits large TCP packets, such as those built by TCPCoalesce, into segments,
+like the generic segmentation offload (GSO) of network stacks.  Each packet's
+GSO_SIZE annotation gives the largest TCP payload of its segments; packets
+whose annotation is zero, and packets no larger than that, pass through
+unchanged.  Segments get correct IP lengths, IP IDs, TCP sequence numbers,
+flags and checksums, as with TCPFragmenter.  TCPSegment clears the GSO_SIZE
+annotation of every IPv4 TCP packet it emits.  Other packets pass through
+unchanged, annotations included, since GSO_SIZE shares bytes with DST_IP6.
+
+Keyword arguments are:
+
+=over 8
+
+=item MTU
+
+Unsigned.  The largest TCP payload of any output segment.  If set, packets
+are split into at most MTU-byte segments even if their GSO_SIZE annotation
+is larger or zero.  Default is 0, meaning only the annotation is used.
+
+=back
+
+=e
+
+  FromDevice(eth0) -> Strip(14) -> CheckIPHeader -> TCPCoalesce
+    -> IPFilter(...) -> ... -> TCPSegment -> EtherEncap(...) -> ToDevice(eth1);
+
+=a TCPCoalesce, TCPFragmenter */
+
+class TCPSegment : public TCPFragmenter { public:
+
+    TCPSegment();
+    ~TCPSegment();
+
+    const char *class_name() const	{ return "TCPSegment"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+
+    void push(int, Packet *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,151 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * dequebench.{cc,hh} -- benchmark element for the Deque template
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "dequebench.hh"
+#include "microbench.hh"
+#include <click/deque.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/algorithm.hh>
+CLICK_DECLS
+
+namespace {
+
+enum { op_push_back, op_pop_front, op_push_front, op_pop_back, op_iterate,
+       op_random, op_fifo, nops };
+const char * const op_names[] = {
+    "push_back", "pop_front", "push_front", "pop_back", "iterate",
+    "random", "fifo"
+};
+
+void
+bench_deque(uint32_t n, const uint32_t *order, MicroBench *mb)
+{
+    uint32_t sink = 0;
+    Deque<int> q;
+
+    mb[op_push_back].start();
+    for (uint32_t i = 0; i < n; ++i)
+	q.push_back(i);
+    mb[op_push_back].stop(n);
+
+    mb[op_pop_front].start();
+    for (uint32_t i = 0; i < n; ++i) {
+	sink += q.front();
+	q.pop_front();
+    }
+    mb[op_pop_front].stop(n);
+
+    mb[op_push_front].start();
+    for (uint32_t i = 0; i < n; ++i)
+	q.push_front(i);
+    mb[op_push_front].stop(n);
+
+    mb[op_pop_back].start();
+    for (uint32_t i = 0; i < n; ++i) {
+	sink += q.back();
+	q.pop_back();
+    }
+    mb[op_pop_back].stop(n);
+
+    // Refill so the contents wrap around the end of the buffer.
+    for (uint32_t i = 0; i < n / 2; ++i)
+	q.push_front(i);
+    for (uint32_t i = n / 2; i < n; ++i)
+	q.push_back(i);
+
+    mb[op_iterate].start();
+    for (Deque<int>::const_iterator it = q.begin(); it != q.end(); ++it)
+	sink += *it;
+    mb[op_iterate].stop(n);
+
+    mb[op_random].start();
+    for (uint32_t i = 0; i < n; ++i)
+	sink += q[order[i]];
+    mb[op_random].stop(n);
+
+    size_t bytes = q.capacity() * sizeof(int);
+    for (int op = 0; op < op_fifo; ++op)
+	mb[op].footprint(bytes, op == op_random ? 1 : (double) sizeof(int) / 64);
+
+    Deque<int> fifo;
+    for (int i = 0; i < 256; ++i)
+	fifo.push_back(i);
+    mb[op_fifo].start();
+    for (uint32_t i = 0; i < n; ++i) {
+	fifo.push_back(i);
+	sink += fifo.front();
+	fifo.pop_front();
+    }
+    mb[op_fifo].stop(n);
+    mb[op_fifo].footprint(fifo.capacity() * sizeof(int), 2 * (double) sizeof(int) / 64);
+    microbench_sink = sink;
+}
+
+}
+
+DequeBench::DequeBench()
+    : _n(1000000), _rounds(3)
+{
+}
+
+int
+DequeBench::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("N", _n)
+	.read("ROUNDS", _rounds)
+	.complete() < 0)
+	return -1;
+    if (_n == 0 || _rounds == 0)
+	return errh->error("N and ROUNDS must be positive");
+    return 0;
+}
+
+int
+DequeBench::initialize(ErrorHandler *errh)
+{
+    uint32_t *order = new uint32_t[_n];
+    if (!order)
+	return errh->error("out of memory");
+    for (uint32_t i = 0; i < _n; ++i)
+	order[i] = i;
+    for (uint32_t i = _n - 1; i > 0; --i)
+	click_swap(order[i], order[click_random(0, i)]);
+
+    MicroBench mb[nops];
+    for (uint32_t r = 0; r < _rounds; ++r)
+	bench_deque(_n, order, mb);
+    delete[] order;
+
+    StringAccum sa;
+    sa << MicroBench::header();
+    for (int op = 0; op < nops; ++op)
+	mb[op].unparse(sa, "Deque<int>", op_names[op], _n);
+    _results = sa.take_string();
+    return 0;
+}
+
+void
+DequeBench::add_handlers()
+{
+    add_data_handlers("results", Handler::OP_READ, &_results);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel MicroBench)
+EXPORT_ELEMENT(DequeBench)
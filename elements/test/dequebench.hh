@@ -0,0 +1,74 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_DEQUEBENCH_HH
+#define CLICK_DEQUEBENCH_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+DequeBench([I<keywords> N, ROUNDS])
+
+=s test
+
+benchmarks the Deque template
+
+=d
+
+DequeBench measures Click's Deque template at initialization time.  It
+does not route packets.  On a Deque<int> it times N push_back operations
+into an empty deque followed by N pop_front operations, then N push_front
+operations followed by N pop_back operations.  It also times sequential
+iteration and reads at random indexes on a deque of N elements whose
+contents wrap around the end of its buffer, and N "fifo" operations, each a
+push_back and a pop_front on a deque that holds 256 elements.  Each
+measurement is repeated ROUNDS times and the fastest round is reported.
+
+Keyword arguments are:
+
+=over 8
+
+=item N
+
+Integer. Number of elements. Default is 1000000.
+
+=item ROUNDS
+
+Integer. Number of times to repeat each measurement. Default is 3.
+
+=back
+
+=h results read-only
+
+Returns the measurements as CSV, with header line
+"structure,op,n,ns_per_op,allocs_per_op,misses_per_op,misses".  See
+VectorBench for the columns.
+
+=e
+
+  click -qe 'b :: DequeBench(N 100000)' -h b.results
+
+=a
+
+HashTableBench, VectorBench, StringBench, HeapBench, DequeTest */
+
+class DequeBench : public Element { public:
+
+    DequeBench();
+
+    const char *class_name() const		{ return "DequeBench"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+  private:
+
+    uint32_t _n;
+    uint32_t _rounds;
+    String _results;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,189 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * hashtablebench.{cc,hh} -- benchmark element for hash table templates
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "hashtablebench.hh"
+#include "microbench.hh"
+#include <click/hashtable.hh>
+#include <click/flathashtable.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/algorithm.hh>
+CLICK_DECLS
+
+namespace {
+
+struct BenchEntry {
+    uint32_t _key;
+    BenchEntry *_hashnext;
+    typedef uint32_t key_type;
+    typedef uint32_t key_const_reference;
+    key_const_reference hashkey() const {
+	return _key;
+    }
+};
+
+enum { op_insert, op_find, op_miss, op_erase, nops };
+const char * const op_names[] = { "insert", "find", "miss", "erase" };
+
+// Key microbench_key(i) is present; key microbench_key(i + n) is not.
+
+template <typename M>
+void
+bench_table(uint32_t n, const uint32_t *order, MicroBench *mb,
+	    size_t slot_size, size_t elt_size, double lines)
+{
+    M m;
+    uint32_t sink = 0;
+    mb[op_insert].start();
+    for (uint32_t i = 0; i < n; ++i)
+	m.set(microbench_key(i), i);
+    mb[op_insert].stop(n);
+
+    mb[op_find].start();
+    for (uint32_t i = 0; i < n; ++i)
+	sink += m.get(microbench_key(order[i]));
+    mb[op_find].stop(n);
+
+    mb[op_miss].start();
+    for (uint32_t i = n; i < 2 * n; ++i)
+	sink += m.get(microbench_key(i));
+    mb[op_miss].stop(n);
+
+    size_t bytes = m.bucket_count() * slot_size + n * elt_size;
+    for (int op = 0; op < nops; ++op)
+	mb[op].footprint(bytes, lines);
+
+    mb[op_erase].start();
+    for (uint32_t i = 0; i < n; ++i)
+	m.erase(microbench_key(order[i]));
+    mb[op_erase].stop(n);
+    microbench_sink = sink;
+}
+
+template <typename C>
+void
+bench_container(uint32_t n, const uint32_t *order, BenchEntry *entries,
+		MicroBench *mb, size_t slot_size, double lines)
+{
+    C c;
+    uintptr_t sink = 0;
+    mb[op_insert].start();
+    for (uint32_t i = 0; i < n; ++i) {
+	typename C::iterator it = c.find(entries[i]._key);
+	c.set(it, &entries[i]);
+	c.balance();
+    }
+    mb[op_insert].stop(n);
+
+    mb[op_find].start();
+    for (uint32_t i = 0; i < n; ++i)
+	sink += (uintptr_t) c.get(microbench_key(order[i]));
+    mb[op_find].stop(n);
+
+    mb[op_miss].start();
+    for (uint32_t i = n; i < 2 * n; ++i)
+	sink += (uintptr_t) c.get(microbench_key(i));
+    mb[op_miss].stop(n);
+
+    size_t bytes = c.bucket_count() * slot_size + n * sizeof(BenchEntry);
+    for (int op = 0; op < nops; ++op)
+	mb[op].footprint(bytes, lines);
+
+    mb[op_erase].start();
+    for (uint32_t i = 0; i < n; ++i)
+	c.erase(microbench_key(order[i]));
+    mb[op_erase].stop(n);
+    microbench_sink = sink;
+}
+
+}
+
+HashTableBench::HashTableBench()
+    : _n(1000000), _rounds(3)
+{
+}
+
+int
+HashTableBench::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("N", _n)
+	.read("ROUNDS", _rounds)
+	.complete() < 0)
+	return -1;
+    if (_n == 0 || _rounds == 0)
+	return errh->error("N and ROUNDS must be positive");
+    return 0;
+}
+
+int
+HashTableBench::initialize(ErrorHandler *errh)
+{
+    BenchEntry *entries = new BenchEntry[_n];
+    uint32_t *order = new uint32_t[_n];
+    if (!entries || !order) {
+	delete[] entries;
+	delete[] order;
+	return errh->error("out of memory");
+    }
+    // Lookups and erasures visit keys in a random order, so tables that
+    // allocate elements sequentially get no locality advantage.
+    for (uint32_t i = 0; i < _n; ++i) {
+	entries[i]._key = microbench_key(i);
+	order[i] = i;
+    }
+    for (uint32_t i = _n - 1; i > 0; --i)
+	click_swap(order[i], order[click_random(0, i)]);
+
+    // For cache-miss estimates: chained tables touch a bucket and an
+    // element per operation, flat tables touch a slot (plus its control
+    // byte), and containers also touch the entry itself.
+    static const char * const names[] = {
+	"HashTable", "FlatHashTable", "HashContainer", "FlatHashContainer"
+    };
+    MicroBench mb[4][nops];
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	bench_table<HashTable<uint32_t, uint32_t> >
+	    (_n, order, mb[0], sizeof(void *), 8 + sizeof(void *), 2);
+	bench_table<FlatHashTable<uint32_t, uint32_t> >
+	    (_n, order, mb[1], 8 + 1, 0, 1);
+	bench_container<HashContainer<BenchEntry> >
+	    (_n, order, entries, mb[2], sizeof(void *), 2);
+	bench_container<FlatHashContainer<BenchEntry> >
+	    (_n, order, entries, mb[3], sizeof(void *) + 1, 2);
+    }
+    delete[] entries;
+    delete[] order;
+
+    StringAccum sa;
+    sa << MicroBench::header();
+    for (int which = 0; which < 4; ++which)
+	for (int op = 0; op < nops; ++op)
+	    mb[which][op].unparse(sa, names[which], op_names[op], _n);
+    _results = sa.take_string();
+    return 0;
+}
+
+void
+HashTableBench::add_handlers()
+{
+    add_data_handlers("results", Handler::OP_READ, &_results);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel MicroBench)
+EXPORT_ELEMENT(HashTableBench)
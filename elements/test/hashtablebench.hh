@@ -0,0 +1,72 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HASHTABLEBENCH_HH
+#define CLICK_HASHTABLEBENCH_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+HashTableBench([I<keywords> N, ROUNDS])
+
+=s test
+
+compares hash table implementations
+
+=d
+
+HashTableBench measures Click's hash table templates at initialization time.
+It does not route packets.  It compares HashTable with FlatHashTable, and
+HashContainer with FlatHashContainer, on N distinct 32-bit keys.  For each
+table it times four operations: inserting every key, finding every key,
+looking up N keys that are not present, and erasing every key.  Each
+measurement is repeated ROUNDS times and the fastest round is reported.
+
+Keyword arguments are:
+
+=over 8
+
+=item N
+
+Integer. Number of keys. Default is 1000000.
+
+=item ROUNDS
+
+Integer. Number of times to repeat each measurement. Default is 3.
+
+=back
+
+=h results read-only
+
+Returns the measurements as CSV, with header line
+"structure,op,n,ns_per_op,allocs_per_op,misses_per_op,misses".  See
+VectorBench for the columns.
+
+=e
+
+  click -qe 'b :: HashTableBench(N 100000)' -h b.results
+
+=a
+
+HashTableTest, VectorBench, StringBench, DequeBench, HeapBench */
+
+class HashTableBench : public Element { public:
+
+    HashTableBench();
+
+    const char *class_name() const		{ return "HashTableBench"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+  private:
+
+    uint32_t _n;
+    uint32_t _rounds;
+    String _results;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -19,6 +19,7 @@
 #include <click/config.h>
 #include "hashtabletest.hh"
 #include <click/hashtable.hh>
+#include <click/flathashtable.hh>
 #include <click/error.hh>
 #if CLICK_USERLEVEL
 # include <sys/time.h>
@@ -54,15 +55,16 @@ HashTableTest::HashTableTest()
 #define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
 #define CHECK_DATA(x, y, l) CHECK(memcmp((x), (y), (l)) == 0)
 
+template <typename M>
 static int
-check1(MAP_S2I &h, ErrorHandler *errh)
+check1(M &h, ErrorHandler *errh)
 {
     CHECK(h.size() == 4);
     CHECK(!h.empty());
 
     char x[4] = "\0\0\0";
     int n = 0;
-    for (MAP_S2I::const_iterator i = h.begin(); i.live(); i++) {
+    for (typename M::const_iterator i = h.begin(); i.live(); i++) {
 	CHECK(IT_VALUE(i) >= 1 && IT_VALUE(i) <= 4);
 	CHECK(x[IT_VALUE(i) - 1] == 0);
 	x[IT_VALUE(i) - 1] = 1;
@@ -72,7 +74,7 @@ check1(MAP_S2I &h, ErrorHandler *errh)
 
     memset(x, 0, 4);
     n = 0;
-    for (MAP_S2I::iterator i = h.begin(); i.live(); i++) {
+    for (typename M::iterator i = h.begin(); i.live(); i++) {
 	int oldv = IT_VALUE(i);
 	CHECK(IT_VALUE(i) >= 1 && IT_VALUE(i) <= 4);
 	IT_VALUE(i) = 5;
@@ -427,46 +429,11 @@ static const char * const nonclasses[] = {
 };
 #endif
 
-struct MyHashContainerEntry {
-    int _key;
-    struct MyHashContainerEntry *_hashnext;
-
-    typedef int key_type;
-    typedef int key_const_reference;
-
-    key_const_reference hashkey() const {
-	return _key;
-    }
-
-    MyHashContainerEntry(int key) : _key(key), _hashnext(0) {};
-};
-
-typedef HashContainer<MyHashContainerEntry> MyHashContainer;
-
-int
-HashTableTest::initialize(ErrorHandler *errh)
+template <typename M>
+static int
+check_map(ErrorHandler *errh)
 {
-    MyHashContainer my_hashcontainer;
-    SizedHashAllocator<sizeof(MyHashContainerEntry)> my_alloc;
-    int my_num_to_insert = 1000;
-    for (int i = 0; i < my_num_to_insert; ++i) {
-	void *p = my_alloc.allocate();
-	MyHashContainerEntry *e = new(p) MyHashContainerEntry(i);
-	MyHashContainer::iterator insert_it = my_hashcontainer.find(i);
-	CHECK(!insert_it.get());
-	my_hashcontainer.insert_at(insert_it, e);
-	my_hashcontainer.balance();
-    }
-    CHECK(my_hashcontainer.size() == 1000);
-    for (MyHashContainer::iterator it = my_hashcontainer.begin(); it.live();) {
-	MyHashContainerEntry *e = it.get();
-	my_hashcontainer.erase(it);
-	e->~MyHashContainerEntry();
-	my_alloc.deallocate(e);
-    }
-    CHECK(my_hashcontainer.size() == 0);
-
-    MAP_S2I h;
+    M h;
 
     MAP_INSERT(h, "Foo", 1);
     MAP_INSERT(h, "bar", 2);
@@ -477,7 +444,7 @@ HashTableTest::initialize(ErrorHandler *errh)
 
     // check copy constructor
     {
-	MAP_S2I hh(h);
+	M hh(h);
 	CHECK(check1(hh, errh) == 0);
 	MAP_INSERT(hh, "crap", 5);
     }
@@ -492,13 +459,13 @@ HashTableTest::initialize(ErrorHandler *errh)
     CHECK(MAP_VALUE(h, "facker") == 3);
     CHECK(MAP_VALUE(h, "Anne Elizabeth Dudfield") == 4);
 
-    MAP_S2I hh;
+    M hh;
     h.clear();
     h["Crap"] = 1;
     h["Crud"] = 2;
     h["Crang"] = 3;
     h["Dumb"] = 3;
-    for (MAP_S2I::iterator it = h.begin(); it; )
+    for (typename M::iterator it = h.begin(); it; )
 	if (it.key() == "Crud")
 	    it = h.erase(it);
 	else {
@@ -511,6 +478,120 @@ HashTableTest::initialize(ErrorHandler *errh)
     CHECK(h.find("Crud") == h.end());
     CHECK(hh.find("Crud") == hh.end());
 
+    return 0;
+}
+
+struct MyHashContainerEntry {
+    int _key;
+    struct MyHashContainerEntry *_hashnext;
+
+    typedef int key_type;
+    typedef int key_const_reference;
+
+    key_const_reference hashkey() const {
+	return _key;
+    }
+
+    MyHashContainerEntry(int key) : _key(key), _hashnext(0) {};
+};
+
+typedef HashContainer<MyHashContainerEntry> MyHashContainer;
+
+static int
+check_flat(ErrorHandler *errh)
+{
+    // Large enough to exercise incremental growth.
+    enum { N = 100000 };
+    FlatHashTable<int, int> h(-1);
+    for (int i = 0; i < N; ++i)
+	CHECK(h.set(i, 2 * i));
+    CHECK(!h.set(7, 14));
+    CHECK(h.size() == N);
+    for (int i = 0; i < N; ++i)
+	CHECK(h.get(i) == 2 * i);
+    CHECK(h.get(-5) == -1);
+    CHECK(!h.get_pointer(N));
+
+    int n = 0;
+    for (FlatHashTable<int, int>::iterator it = h.begin(); it; )
+	if (it.key() & 1)
+	    it = h.erase(it);
+	else {
+	    CHECK(it.value() == 2 * it.key());
+	    ++n, ++it;
+	}
+    CHECK(n == N / 2 && h.size() == N / 2);
+
+    // Reinsert while the table is still moving elements.
+    for (int i = 1; i < N; i += 2)
+	h[i] = 3 * i;
+    for (int i = 0; i < N; i += 4)
+	CHECK(h.erase(i) == 1);
+    CHECK(h.erase(0) == 0);
+    CHECK(h.size() == N - N / 4);
+    for (int i = 0; i < N; ++i)
+	CHECK(h.get(i) == (i % 4 == 0 ? -1 : (i & 1 ? 3 * i : 2 * i)));
+
+    FlatHashTable<int, int> hh(h);
+    CHECK(hh.size() == h.size() && hh.get(3) == 9 && hh.get(4) == -1);
+    hh.clear();
+    CHECK(hh.empty() && hh.begin() == hh.end());
+    hh.swap(h);
+    CHECK(h.empty() && hh.size() == N - N / 4);
+
+    FlatHashContainer<MyHashContainerEntry> c;
+    SizedHashAllocator<sizeof(MyHashContainerEntry)> alloc;
+    for (int i = 0; i < 1000; ++i) {
+	MyHashContainerEntry *e = new(alloc.allocate()) MyHashContainerEntry(i);
+	FlatHashContainer<MyHashContainerEntry>::iterator it = c.find(i);
+	CHECK(!it.get() && it.can_insert());
+	CHECK(!c.set(it, e));
+	CHECK(it.get() == e);
+    }
+    CHECK(c.size() == 1000);
+    for (int i = 0; i < 1000; ++i)
+	CHECK(c.get(i) && c.get(i)->_key == i);
+    MyHashContainerEntry *e = c.erase(500);
+    CHECK(e && e->_key == 500 && !c.get(500) && c.size() == 999);
+    CHECK(!c.set(e) && c.get(500) == e);
+    for (FlatHashContainer<MyHashContainerEntry>::iterator it = c.begin(); it.live(); ) {
+	MyHashContainerEntry *e = it.get();
+	c.erase(it);
+	e->~MyHashContainerEntry();
+	alloc.deallocate(e);
+    }
+    CHECK(c.size() == 0);
+    return 0;
+}
+
+int
+HashTableTest::initialize(ErrorHandler *errh)
+{
+    MyHashContainer my_hashcontainer;
+    SizedHashAllocator<sizeof(MyHashContainerEntry)> my_alloc;
+    int my_num_to_insert = 1000;
+    for (int i = 0; i < my_num_to_insert; ++i) {
+	void *p = my_alloc.allocate();
+	MyHashContainerEntry *e = new(p) MyHashContainerEntry(i);
+	MyHashContainer::iterator insert_it = my_hashcontainer.find(i);
+	CHECK(!insert_it.get());
+	my_hashcontainer.insert_at(insert_it, e);
+	my_hashcontainer.balance();
+    }
+    CHECK(my_hashcontainer.size() == 1000);
+    for (MyHashContainer::iterator it = my_hashcontainer.begin(); it.live();) {
+	MyHashContainerEntry *e = it.get();
+	my_hashcontainer.erase(it);
+	e->~MyHashContainerEntry();
+	my_alloc.deallocate(e);
+    }
+    CHECK(my_hashcontainer.size() == 0);
+
+    if (check_map<MAP_S2I>(errh) < 0
+	|| check_map<FlatHashTable<String, int> >(errh) < 0
+	|| check_flat(errh) < 0)
+	return -1;
+
 #if CLICK_USERLEVEL
     MAP_S2I map;
 
@@ -0,0 +1,165 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * heapbench.{cc,hh} -- benchmark element for heap functions
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "heapbench.hh"
+#include "microbench.hh"
+#include <click/vector.hh>
+#include <click/heap.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/algorithm.hh>
+CLICK_DECLS
+
+namespace {
+
+enum { op_push, op_change, op_pop, nops };
+const char * const op_names[] = { "push", "change", "pop" };
+
+// heap_ops<2> uses the binary heap functions, heap_ops<4> the d-ary ones.
+template <int arity> struct heap_ops {
+    template <typename I, typename C>
+    static void push(I begin, I end, C comp) {
+	push_heap<arity>(begin, end, comp);
+    }
+    template <typename I, typename C>
+    static void change(I begin, I end, I element, C comp) {
+	change_heap<arity>(begin, end, element, comp);
+    }
+    template <typename I, typename C>
+    static void pop(I begin, I end, C comp) {
+	pop_heap<arity>(begin, end, comp);
+    }
+};
+
+template <> struct heap_ops<2> {
+    template <typename I, typename C>
+    static void push(I begin, I end, C comp) {
+	push_heap(begin, end, comp);
+    }
+    template <typename I, typename C>
+    static void change(I begin, I end, I element, C comp) {
+	change_heap(begin, end, element, comp);
+    }
+    template <typename I, typename C>
+    static void pop(I begin, I end, C comp) {
+	pop_heap(begin, end, comp);
+    }
+};
+
+template <int arity>
+void
+bench_heap(uint32_t n, const uint32_t *order, MicroBench *mb)
+{
+    typedef heap_ops<arity> ops;
+    less<uint32_t> comp;
+    uint32_t sink = 0;
+    Vector<uint32_t> v;
+    v.reserve(n);
+
+    mb[op_push].start();
+    for (uint32_t i = 0; i < n; ++i) {
+	v.push_back(microbench_key(i));
+	ops::push(v.begin(), v.end(), comp);
+    }
+    mb[op_push].stop(n);
+
+    mb[op_change].start();
+    for (uint32_t i = 0; i < n; ++i) {
+	Vector<uint32_t>::iterator it = v.begin() + order[i];
+	*it = microbench_key(i + n);
+	ops::change(v.begin(), v.end(), it, comp);
+    }
+    mb[op_change].stop(n);
+
+    mb[op_pop].start();
+    for (uint32_t i = 0; i < n; ++i) {
+	ops::pop(v.begin(), v.end(), comp);
+	sink += v.back();
+	v.pop_back();
+    }
+    mb[op_pop].stop(n);
+
+    // A random key inserted with push_heap rises about one level, touching
+    // about one line; change_heap and pop_heap may visit every level.  A
+    // 4-ary node's children share a cache line.
+    double depth = 1;
+    for (uint32_t x = n; x >= arity; x /= arity)
+	++depth;
+    size_t bytes = n * sizeof(uint32_t);
+    mb[op_push].footprint(bytes, 1);
+    mb[op_change].footprint(bytes, depth);
+    mb[op_pop].footprint(bytes, depth);
+    microbench_sink = sink;
+}
+
+}
+
+HeapBench::HeapBench()
+    : _n(1000000), _rounds(3)
+{
+}
+
+int
+HeapBench::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("N", _n)
+	.read("ROUNDS", _rounds)
+	.complete() < 0)
+	return -1;
+    if (_n == 0 || _rounds == 0)
+	return errh->error("N and ROUNDS must be positive");
+    return 0;
+}
+
+int
+HeapBench::initialize(ErrorHandler *errh)
+{
+    uint32_t *order = new uint32_t[_n];
+    if (!order)
+	return errh->error("out of memory");
+    for (uint32_t i = 0; i < _n; ++i)
+	order[i] = i;
+    for (uint32_t i = _n - 1; i > 0; --i)
+	click_swap(order[i], order[click_random(0, i)]);
+
+    MicroBench mb[2][nops];
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	bench_heap<2>(_n, order, mb[0]);
+	bench_heap<4>(_n, order, mb[1]);
+    }
+    delete[] order;
+
+    static const char * const names[] = { "heap2", "heap4" };
+    StringAccum sa;
+    sa << MicroBench::header();
+    for (int which = 0; which < 2; ++which)
+	for (int op = 0; op < nops; ++op)
+	    mb[which][op].unparse(sa, names[which], op_names[op], _n);
+    _results = sa.take_string();
+    return 0;
+}
+
+void
+HeapBench::add_handlers()
+{
+    add_data_handlers("results", Handler::OP_READ, &_results);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel MicroBench)
+EXPORT_ELEMENT(HeapBench)
@@ -0,0 +1,72 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HEAPBENCH_HH
+#define CLICK_HEAPBENCH_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+HeapBench([I<keywords> N, ROUNDS])
+
+=s test
+
+benchmarks heap functions
+
+=d
+
+HeapBench measures the heap functions in <click/heap.hh> at initialization
+time.  It does not route packets.  It compares binary heaps with the 4-ary
+heaps used for Click's timers.  For each arity it times inserting N random
+keys with push_heap, changing N randomly chosen keys with change_heap, and
+removing every key with pop_heap.  Each measurement is repeated ROUNDS
+times and the fastest round is reported.
+
+Keyword arguments are:
+
+=over 8
+
+=item N
+
+Integer. Number of keys. Default is 1000000.
+
+=item ROUNDS
+
+Integer. Number of times to repeat each measurement. Default is 3.
+
+=back
+
+=h results read-only
+
+Returns the measurements as CSV, with header line
+"structure,op,n,ns_per_op,allocs_per_op,misses_per_op,misses".  See
+VectorBench for the columns.  The structures are "heap2" and "heap4".
+
+=e
+
+  click -qe 'b :: HeapBench(N 100000)' -h b.results
+
+=a
+
+HashTableBench, VectorBench, StringBench, DequeBench, HeapTest */
+
+class HeapBench : public Element { public:
+
+    HeapBench();
+
+    const char *class_name() const		{ return "HeapBench"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+  private:
+
+    uint32_t _n;
+    uint32_t _rounds;
+    String _results;
+
+};
+
+CLICK_ENDDECLS
+#endif
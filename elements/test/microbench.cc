@@ -0,0 +1,195 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * microbench.{cc,hh} -- measurement helper for benchmark elements
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "microbench.hh"
+#include <click/atomic.hh>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#ifdef __linux__
+# include <sys/syscall.h>
+# include <linux/perf_event.h>
+#endif
+
+/* glue.cc: operator new counts into the thread's counter while
+   click_dmalloc_counting is nonzero */
+extern CLICK_NAME(atomic_uint32_t) click_dmalloc_counting;
+#if HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+extern __thread size_t click_dmalloc_thread_news;
+#else
+extern size_t click_dmalloc_thread_news;
+#endif
+
+CLICK_DECLS
+
+volatile uint32_t microbench_sink;
+
+MicroBench::MicroBench()
+    : _start_allocs(0), _start_misses(0), _measured(false),
+      _ns(0), _allocs(0), _misses(-1), _footprint(0), _lines_per_op(0)
+{
+}
+
+/** @brief Return a file descriptor counting this process's last-level
+ * cache misses, or -1 if hardware counters are unavailable. */
+int
+MicroBench::counter_fd()
+{
+    static int fd = -2;
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    if (fd == -2) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	if (fd < 0)
+	    fd = -1;
+    }
+#else
+    fd = -1;
+#endif
+    return fd;
+}
+
+bool
+MicroBench::read_misses(uint64_t &misses)
+{
+    int fd = counter_fd();
+    return fd >= 0 && read(fd, &misses, sizeof(misses)) == (ssize_t) sizeof(misses);
+}
+
+/** @brief Return the size of the largest CPU cache in bytes.
+ *
+ * Reads Linux's sysfs cache description, defaulting to 8MB. */
+size_t
+MicroBench::cache_size()
+{
+    static size_t size = 0;
+    if (size == 0) {
+	for (int i = 0; i < 10; ++i) {
+	    char buf[128];
+	    sprintf(buf, "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+	    FILE *f = fopen(buf, "r");
+	    if (!f)
+		break;
+	    unsigned long n = 0;
+	    char unit = 0;
+	    if (fscanf(f, "%lu%c", &n, &unit) >= 1) {
+		if (unit == 'K')
+		    n <<= 10;
+		else if (unit == 'M')
+		    n <<= 20;
+		if (n > size)
+		    size = n;
+	    }
+	    fclose(f);
+	}
+	if (size == 0)
+	    size = 8 << 20;
+    }
+    return size;
+}
+
+void
+MicroBench::start()
+{
+    click_dmalloc_counting++;
+    _start_allocs = click_dmalloc_thread_news;
+    if (!read_misses(_start_misses))
+	_start_misses = 0;
+    _start = Timestamp::now_steady();
+}
+
+/** @brief End a round of @a nops operations.
+ *
+ * The round's results replace earlier rounds' if it ran faster. */
+void
+MicroBench::stop(uint32_t nops)
+{
+    Timestamp end = Timestamp::now_steady();
+    size_t allocs = click_dmalloc_thread_news - _start_allocs;
+    click_dmalloc_counting--;
+    uint64_t misses;
+    bool have_misses = read_misses(misses);
+    if (nops == 0)
+	nops = 1;
+    double ns = (end - _start).doubleval() * 1e9 / nops;
+    if (!_measured || ns < _ns) {
+	_ns = ns;
+	_allocs = (double) allocs / nops;
+	_misses = (have_misses ? (double) (misses - _start_misses) / nops : -1);
+	_measured = true;
+    }
+}
+
+/** @brief Describe the structure for cache-miss estimates.
+ * @param bytes memory the structure occupies
+ * @param lines_per_op cache lines one operation touches */
+void
+MicroBench::footprint(size_t bytes, double lines_per_op)
+{
+    _footprint = bytes;
+    _lines_per_op = lines_per_op;
+}
+
+/** @brief Return measured or estimated cache misses per operation.
+ *
+ * Returns -1 if misses were not measured and footprint() was not called. */
+double
+MicroBench::misses_per_op() const
+{
+    if (_misses >= 0)
+	return _misses;
+    else if (_footprint == 0)
+	return -1;
+    size_t cache = cache_size();
+    if (_footprint <= cache)
+	return 0;
+    return _lines_per_op * (1 - (double) cache / _footprint);
+}
+
+const char *
+MicroBench::header()
+{
+    return "structure,op,n,ns_per_op,allocs_per_op,misses_per_op,misses\n";
+}
+
+/** @brief Append a CSV row describing the results.
+ *
+ * The last column says whether misses were "measured" with hardware
+ * counters or "estimated"; both misses columns are "-" if neither. */
+void
+MicroBench::unparse(StringAccum &sa, const char *structure, const char *op,
+		    uint32_t n) const
+{
+    sa << structure << ',' << op << ',' << n << ',';
+    sa.snprintf(64, "%.2f,%.3f,", _ns, _allocs);
+    double misses = misses_per_op();
+    if (misses < 0)
+	sa << "-,-\n";
+    else {
+	sa.snprintf(32, "%.3f,", misses);
+	sa << (_misses >= 0 ? "measured\n" : "estimated\n");
+    }
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+ELEMENT_PROVIDES(MicroBench)
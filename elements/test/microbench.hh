@@ -0,0 +1,76 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_MICROBENCH_HH
+#define CLICK_MICROBENCH_HH
+#include <click/timestamp.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+/** @brief Measurement helper for data structure benchmark elements.
+ *
+ * A MicroBench measures one operation over several rounds.  Each round
+ * brackets N operations with start() and stop(N); the fastest round is kept.
+ * Besides time, a round counts the calling thread's operator new calls
+ * (new counts only while some round is running) and, where Linux hardware
+ * performance counters are available, last-level cache misses.  Without
+ * counters, cache misses are estimated from the structure's size: an
+ * operation that touches L cache lines is expected to miss on each of them
+ * in proportion to how much of the structure does not fit in the last-level
+ * cache.  Call footprint() to supply the size and L.
+ *
+ * unparse() writes a CSV row matching header(). */
+class MicroBench { public:
+
+    MicroBench();
+
+    void start();
+    void stop(uint32_t nops);
+    void footprint(size_t bytes, double lines_per_op);
+
+    static const char *header();
+    void unparse(StringAccum &sa, const char *structure, const char *op,
+		 uint32_t n) const;
+
+    double ns_per_op() const		{ return _ns; }
+    double allocs_per_op() const	{ return _allocs; }
+    double misses_per_op() const;
+
+    static size_t cache_size();
+
+  private:
+
+    Timestamp _start;
+    size_t _start_allocs;
+    uint64_t _start_misses;
+    bool _measured;
+    double _ns;
+    double _allocs;
+    double _misses;
+    size_t _footprint;
+    double _lines_per_op;
+
+    static int counter_fd();
+    static bool read_misses(uint64_t &misses);
+
+};
+
+/** @brief Return a well-mixed 32-bit key for @a i.
+ *
+ * The mixing function (MurmurHash3's finalizer) permutes the 32-bit
+ * integers, so distinct @a i give distinct keys, and scatters them, so that
+ * successive keys do not land in successive buckets and hardware stride
+ * prefetching does not flatter chained tables. */
+inline uint32_t
+microbench_key(uint32_t i)
+{
+    i ^= i >> 16;
+    i *= 0x85EBCA6BU;
+    i ^= i >> 13;
+    i *= 0xC2B2AE35U;
+    return i ^ (i >> 16);
+}
+
+/** @brief Sink for benchmark results, to defeat dead-code elimination. */
+extern volatile uint32_t microbench_sink;
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,223 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * packetpoolbench.{cc,hh} -- benchmark element for packet metadata
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "packetpoolbench.hh"
+#include <click/packet.hh>
+#include <click/packet_anno.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/algorithm.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+namespace {
+
+enum { op_alloc, op_forward, op_clone, op_timestamp, nops };
+const char * const op_names[] = { "alloc", "forward", "clone", "timestamp" };
+
+}
+
+PacketPoolBench::PacketPoolBench()
+    : _n(200000), _batch(4096), _rounds(3)
+{
+}
+
+int
+PacketPoolBench::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("N", _n)
+	.read("BATCH", _batch)
+	.read("ROUNDS", _rounds)
+	.complete() < 0)
+	return -1;
+    if (_n == 0 || _batch == 0 || _rounds == 0)
+	return errh->error("N, BATCH, and ROUNDS must be positive");
+    return 0;
+}
+
+int
+PacketPoolBench::count_lines(const span *s, int n)
+{
+    uintptr_t lines[64];
+    int nlines = 0;
+    for (int i = 0; i < n; ++i) {
+	uintptr_t a = reinterpret_cast<uintptr_t>(s[i].p) / CLICK_CACHE_LINE_SIZE;
+	uintptr_t b = (reinterpret_cast<uintptr_t>(s[i].p) + s[i].len - 1) / CLICK_CACHE_LINE_SIZE;
+	for (; a <= b; ++a) {
+	    int j = 0;
+	    while (j < nlines && lines[j] != a)
+		++j;
+	    if (j == nlines && nlines < 64)
+		lines[nlines++] = a;
+	}
+    }
+    return nlines;
+}
+
+#define PPB_FIELD(p, f)		{ &(p)->f, sizeof((p)->f) }
+#define PPB_RANGE(p, from, to)	{ &(p)->from, static_cast<size_t>(reinterpret_cast<const char *>(&(p)->to) + sizeof((p)->to) - reinterpret_cast<const char *>(&(p)->from)) }
+#if HAVE_CLICK_PACKET_POOL && HAVE_MULTITHREAD
+# define PPB_DATA_NODE(p)	PPB_FIELD(p, _data_node),
+#else
+# define PPB_DATA_NODE(p)	/* nothing */
+#endif
+
+// The metadata that allocating a packet from the pool and killing it back
+// into the pool reads or writes.
+#define PPB_LIFE_CYCLE(p)						\
+    PPB_FIELD(p, _use_count), PPB_FIELD(p, _data_packet),		\
+    PPB_FIELD(p, _cold), PPB_DATA_NODE(p)				\
+    PPB_FIELD(p, _head), PPB_FIELD(p, _data),				\
+    PPB_FIELD(p, _tail), PPB_FIELD(p, _end),				\
+    PPB_FIELD(p, _aa)
+
+double
+PacketPoolBench::lines_touched(int op, Packet **ps, int n)
+{
+    int total = 0;
+    for (int i = 0; i < n; ++i) {
+	Packet *p = ps[i];
+	if (op == op_forward) {
+	    span s[] = { PPB_LIFE_CYCLE(p),
+			 PPB_FIELD(p, _aa.nh), PPB_FIELD(p, _aa.h),
+			 { p->anno_u8() + Packet::dst_ip_anno_offset, 4 },
+			 { p->anno_u8() + PAINT_ANNO_OFFSET, 1 } };
+	    total += count_lines(s, sizeof(s) / sizeof(s[0]));
+	} else if (op == op_clone) {
+	    // clone() copies the hot members, then both packets are killed
+	    Packet *q = ps[n + i];
+	    span s[] = { PPB_LIFE_CYCLE(p), PPB_RANGE(p, _use_count, _aa) };
+	    span t[] = { PPB_LIFE_CYCLE(q), PPB_RANGE(q, _use_count, _aa) };
+	    total += count_lines(s, sizeof(s) / sizeof(s[0]))
+		+ count_lines(t, sizeof(t) / sizeof(t[0]));
+	} else if (op == op_timestamp) {
+	    span s[] = { PPB_LIFE_CYCLE(p), PPB_FIELD(p, _ca) };
+	    total += count_lines(s, sizeof(s) / sizeof(s[0]));
+	} else {
+	    span s[] = { PPB_LIFE_CYCLE(p) };
+	    total += count_lines(s, sizeof(s) / sizeof(s[0]));
+	}
+    }
+    return (double) total / n;
+}
+
+double
+PacketPoolBench::run(int op, Packet **ps)
+{
+    double best = 0;
+    uint32_t sink = 0;
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	Timestamp start = Timestamp::now_steady();
+	for (uint32_t done = 0; done < _n; done += _batch) {
+	    uint32_t b = _n - done < _batch ? _n - done : _batch;
+	    for (uint32_t i = 0; i < b; ++i) {
+		WritablePacket *q = Packet::make(Packet::default_headroom, 0, 64, 0);
+		if (op == op_forward) {
+		    q->set_network_header(q->data() + 14, 20);
+		    q->set_dst_ip_anno(IPAddress(htonl(0x0A000001 + i)));
+		    SET_PAINT_ANNO(q, 1);
+		    sink += q->ip_header()->ip_p;
+		} else if (op == op_clone)
+		    ps[b + i] = q->clone();
+		else if (op == op_timestamp)
+		    q->set_timestamp_anno(Timestamp(done + i, 0));
+		ps[i] = q;
+	    }
+	    for (uint32_t i = 0; i < b; ++i) {
+		if (op == op_clone)
+		    ps[b + i]->kill();
+		ps[i]->kill();
+	    }
+	}
+	double ns = (Timestamp::now_steady() - start).doubleval() * 1e9 / _n;
+	if (r == 0 || ns < best)
+	    best = ns;
+    }
+    if (sink == 1)
+	click_chatter("%u", sink);
+    return best;
+}
+
+String
+PacketPoolBench::layout()
+{
+    WritablePacket *p = Packet::make(64);
+    StringAccum sa;
+    const char *base = reinterpret_cast<const char *>(p);
+    sa << "size " << sizeof(Packet) << '\n'
+       << "anno " << (reinterpret_cast<const char *>(p->anno()) - base) << '\n'
+       << "network_header " << (reinterpret_cast<const char *>(&p->_aa.nh) - base) << '\n'
+       << "next " << (reinterpret_cast<const char *>(&p->_aa.next) - base) << '\n'
+       << "timestamp " << (reinterpret_cast<const char *>(&p->_ca.timestamp) - base) << '\n'
+       << "aligned " << (reinterpret_cast<uintptr_t>(p) % CLICK_CACHE_LINE_SIZE == 0) << '\n';
+    p->kill();
+    return sa.take_string();
+}
+
+int
+PacketPoolBench::initialize(ErrorHandler *errh)
+{
+    Packet **ps = new Packet *[2 * _batch];
+    if (!ps)
+	return errh->error("out of memory");
+    StringAccum sa;
+    sa << "op,lines,ns_per_packet\n";
+    for (int op = 0; op < nops; ++op) {
+	double ns = run(op, ps);
+
+	// count lines on one batch of live packets
+	uint32_t b = _batch < _n ? _batch : _n;
+	for (uint32_t i = 0; i < b; ++i) {
+	    WritablePacket *q = Packet::make(Packet::default_headroom, 0, 64, 0);
+	    if (op == op_clone)
+		ps[b + i] = q->clone();
+	    ps[i] = q;
+	}
+	double lines = lines_touched(op, ps, b);
+	for (uint32_t i = 0; i < b; ++i) {
+	    if (op == op_clone)
+		ps[b + i]->kill();
+	    ps[i]->kill();
+	}
+
+	sa.snprintf(64, "%s,%.2f,%.1f\n", op_names[op], lines, ns);
+    }
+    delete[] ps;
+    _results = sa.take_string();
+    return 0;
+}
+
+String
+PacketPoolBench::read_handler(Element *e, void *thunk)
+{
+    if (thunk)
+	return layout();
+    else
+	return static_cast<PacketPoolBench *>(e)->_results;
+}
+
+void
+PacketPoolBench::add_handlers()
+{
+    add_read_handler("results", read_handler, 0);
+    add_read_handler("layout", read_handler, 1);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(PacketPoolBench)
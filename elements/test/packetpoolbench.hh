@@ -0,0 +1,116 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PACKETPOOLBENCH_HH
+#define CLICK_PACKETPOOLBENCH_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+PacketPoolBench([I<keywords> N, BATCH, ROUNDS])
+
+=s test
+
+measures packet metadata costs
+
+=d
+
+PacketPoolBench measures the cost of Packet metadata at initialization time.
+It does not route packets.  For each of several packet life cycles, it
+reports how many distinct cache lines of Packet metadata the cycle reads or
+writes, counted at the actual addresses of pool-allocated packets, and how
+long the cycle takes.  The cycles are:
+
+=over 8
+
+=item alloc
+
+Packet::make() a 64-byte packet, then kill() it.
+
+=item forward
+
+Allocate, set the network and transport header pointers, the destination
+address annotation and the paint annotation, read the IP header, then kill.
+
+=item clone
+
+Allocate, clone(), then kill both packets.
+
+=item timestamp
+
+Allocate, set the timestamp annotation, then kill.
+
+=back
+
+Packets are allocated BATCH at a time and then killed, so with a large BATCH
+the metadata is usually not in the cache.  Each measurement processes N
+packets, is repeated ROUNDS times, and reports the fastest round.
+
+Keyword arguments are:
+
+=over 8
+
+=item N
+
+Integer. Number of packets per measurement. Default is 200000.
+
+=item BATCH
+
+Integer. Number of packets in flight. Default is 4096.
+
+=item ROUNDS
+
+Integer. Number of times to repeat each measurement. Default is 3.
+
+=back
+
+=h results read-only
+
+Returns the measurements as CSV, with header line
+"op,lines,ns_per_packet".
+
+=h layout read-only
+
+Returns the size of the Packet structure and the offsets of its metadata
+fields.
+
+=e
+
+  click -qe 'b :: PacketPoolBench(N 100000)' -h b.results
+
+=a
+
+PacketTest */
+
+class PacketPoolBench : public Element { public:
+
+    PacketPoolBench();
+
+    const char *class_name() const		{ return "PacketPoolBench"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+  private:
+
+    uint32_t _n;
+    uint32_t _batch;
+    uint32_t _rounds;
+    String _results;
+
+    struct span {
+	const void *p;
+	size_t len;
+    };
+
+    static int count_lines(const span *s, int n);
+    static double lines_touched(int op, Packet **ps, int n);
+    static String layout();
+    double run(int op, Packet **ps);
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
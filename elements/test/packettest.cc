@@ -95,19 +95,21 @@ PacketTest::initialize(ErrorHandler *errh)
     p->kill();
 #endif
 
-    // test shift_data()
+    // test shift_data(); packet pools may add tailroom
     p = Packet::make(10, lowers, 60, 4);
-    CHECK(p->headroom() == 10 && p->tailroom() == 4);
+    uint32_t tailroom = p->tailroom();
+    CHECK(p->headroom() == 10 && tailroom >= 4);
     p = p->shift_data(-2);
-    CHECK(p->headroom() == 8 && p->tailroom() == 6);
+    CHECK(p->headroom() == 8 && p->tailroom() == tailroom + 2);
     CHECK(p->length() == 60);
     CHECK_DATA(p->data(), lowers, 60);
     CHECK_ALIGNED(p->data());
     p->kill();
 
     p = Packet::make(9, lowers, 60, 4);
+    tailroom = p->tailroom();
     p = p->shift_data(3);
-    CHECK(p->headroom() == 12 && p->tailroom() == 1 && p->length() == 60);
+    CHECK(p->headroom() == 12 && p->tailroom() == tailroom - 3 && p->length() == 60);
     CHECK_DATA(p->data(), lowers, 60);
     CHECK_ALIGNED(p->data());
     p->kill();
@@ -137,6 +139,77 @@ PacketTest::initialize(ErrorHandler *errh)
     CHECK_ALIGNED(p->data());
     p->kill();
 
+#if CLICK_USERLEVEL
+    // uniqueify_header() and push_header() copy only headers of long packets.
+    unsigned char longdata[400];
+    for (int i = 0; i < 400; ++i)
+	longdata[i] = lowers[i % 26];
+    p = Packet::make(16, longdata, 400, 0);
+    p->set_network_header(p->data() + 14, 20);
+    Packet *c = p->clone();
+    WritablePacket *q = p->uniqueify_header(34);
+    CHECK(q && q->copy_pending() && !c->copy_pending());
+    CHECK(q->length() == 400 && q->network_header() == q->data() + 14);
+    q->data()[0] = 'X';
+    CHECK(c->data()[0] == longdata[0]);
+    CHECK(q->uniqueify_header(20) == q && q->copy_pending());
+    p = q;
+    CHECK_DATA(p->data() + 1, longdata + 1, 399);
+    CHECK(!p->copy_pending() && p->data()[0] == 'X');
+    p->kill();
+    CHECK_DATA(c->data(), longdata, 400);
+    c->kill();
+
+    p = Packet::make(16, longdata, 400, 0);
+    c = p->clone();
+    q = p->push_header(14);
+    CHECK(q && q->copy_pending() && q->length() == 414);
+    memcpy(q->data(), lowers, 14);
+    q->take(100);
+    p = q;
+    CHECK(p->length() == 314);
+    CHECK_DATA(p->data(), lowers, 14);
+    CHECK_DATA(p->data() + 14, longdata, 300);
+    p->kill();
+    CHECK_DATA(c->data(), longdata, 400);
+    c->kill();
+
+    p = Packet::make(16, lowers, 52, 0);
+    c = p->clone();
+    q = p->uniqueify_header(20);
+    CHECK(q && !q->copy_pending() && !q->shared());
+    CHECK_DATA(q->data(), lowers, 52);
+    q->kill();
+    c->kill();
+
+    // append_shared() chains segments of other packets' data.
+    Packet::Segment seg[4];
+    p = Packet::make(16, longdata, 400, 0);
+    q = Packet::make(0, lowers, 10, 300);
+    CHECK(q->append_shared(p, 100, 200));
+    CHECK(q->copy_pending() && q->length() == 210 && p->shared());
+    CHECK(!q->append_shared(p, 300, 101));
+    CHECK(q->segments(seg, 4) == 2);
+    CHECK(seg[0].data == q->buffer() && seg[0].length == 10);
+    CHECK(seg[1].data == p->data() + 100 && seg[1].length == 200);
+    WritablePacket *q2 = Packet::make(0, 0, 0, 300);
+    CHECK(q2->append_shared(q, 5, 105));
+    CHECK(q2->segments(seg, 1) == 2 && seg[0].length == 5);
+    q->kill();
+    q2->pull(2);
+    q2->take(3);
+    CHECK(q2->segments(seg, 4) == 2);
+    CHECK(seg[0].length == 3 && seg[1].length == 97);
+    CHECK(seg[1].data == p->data() + 100);
+    c = q2;
+    CHECK_DATA(c->data(), lowers + 7, 3);
+    CHECK(!c->copy_pending() && c->length() == 100);
+    CHECK_DATA(c->data() + 3, longdata + 100, 97);
+    c->kill();
+    CHECK(!p->shared());
+    p->kill();
+#endif
+
     // Also check some packet header definition properties.
     union {
 	click_ip ip4;
@@ -0,0 +1,173 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * stringbench.{cc,hh} -- benchmark element for String and StringAccum
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "stringbench.hh"
+#include "microbench.hh"
+#include <click/vector.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/algorithm.hh>
+CLICK_DECLS
+
+namespace {
+
+enum { op_copy, op_substring, op_c_str, op_hashcode, op_equals,
+       op_append, op_sa_append, op_sa_int, op_sa_take, nops };
+const char * const op_names[] = {
+    "copy", "substring", "c_str", "hashcode", "equals",
+    "append", "append", "append_int", "take_string"
+};
+
+void
+bench_string(uint32_t n, uint32_t length, const uint32_t *order,
+	     const Vector<String> &strs, const Vector<String> &equals,
+	     MicroBench *mb)
+{
+    uint32_t sink = 0;
+    Vector<String> copies(n, String()), subs(n, String());
+
+    mb[op_copy].start();
+    for (uint32_t i = 0; i < n; ++i)
+	copies[i] = strs[order[i]];
+    mb[op_copy].stop(n);
+
+    mb[op_substring].start();
+    for (uint32_t i = 0; i < n; ++i)
+	subs[i] = strs[order[i]].substring(4, length - 8);
+    mb[op_substring].stop(n);
+
+    mb[op_c_str].start();
+    for (uint32_t i = 0; i < n; ++i)
+	sink += subs[i].c_str()[0];
+    mb[op_c_str].stop(n);
+
+    mb[op_hashcode].start();
+    for (uint32_t i = 0; i < n; ++i)
+	sink += strs[order[i]].hashcode();
+    mb[op_hashcode].stop(n);
+
+    mb[op_equals].start();
+    for (uint32_t i = 0; i < n; ++i)
+	sink += (strs[order[i]] == equals[order[i]]);
+    mb[op_equals].stop(n);
+
+    // Random-order operations touch a String object and its memo; equals
+    // touches two of each.
+    size_t bytes = n * (sizeof(String) + length + 32);
+    for (int op = op_copy; op <= op_hashcode; ++op)
+	mb[op].footprint(bytes, 2);
+    mb[op_equals].footprint(2 * bytes, 4);
+
+    String s;
+    mb[op_append].start();
+    for (uint32_t i = 0; i < n; ++i)
+	s += strs[i];
+    mb[op_append].stop(n);
+    sink += s.length();
+    s = String();
+
+    StringAccum sa;
+    mb[op_sa_append].start();
+    for (uint32_t i = 0; i < n; ++i)
+	sa << strs[i];
+    mb[op_sa_append].stop(n);
+
+    mb[op_sa_take].start();
+    s = sa.take_string();
+    mb[op_sa_take].stop(1);
+    sink += s.length();
+
+    mb[op_sa_int].start();
+    for (uint32_t i = 0; i < n; ++i)
+	sa << i;
+    mb[op_sa_int].stop(n);
+    sink += sa.length();
+
+    // Appends write sequentially to a buffer that grows to N*LENGTH bytes.
+    for (int op = op_append; op <= op_sa_int; ++op)
+	mb[op].footprint(n * length, (double) length / 64);
+    mb[op_sa_int].footprint(n * 8, 8.0 / 64);
+    microbench_sink = sink;
+}
+
+}
+
+StringBench::StringBench()
+    : _n(1000000), _length(32), _rounds(3)
+{
+}
+
+int
+StringBench::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("N", _n)
+	.read("LENGTH", _length)
+	.read("ROUNDS", _rounds)
+	.complete() < 0)
+	return -1;
+    if (_n == 0 || _rounds == 0)
+	return errh->error("N and ROUNDS must be positive");
+    if (_length < 16)
+	return errh->error("LENGTH must be at least 16");
+    return 0;
+}
+
+int
+StringBench::initialize(ErrorHandler *errh)
+{
+    // Each string has its own memo; "equals" holds equal strings with
+    // separate memos, so comparisons cannot short-circuit on pointers.
+    Vector<String> strs, equals;
+    uint32_t *order = new uint32_t[_n];
+    if (!order)
+	return errh->error("out of memory");
+    for (uint32_t i = 0; i < _n; ++i) {
+	StringAccum sa(_length);
+	sa.snprintf(16, "%08x", microbench_key(i));
+	while (sa.length() < (int) _length)
+	    sa << 'x';
+	strs.push_back(sa.take_string());
+	equals.push_back(String(strs.back().data(), strs.back().length()));
+	order[i] = i;
+    }
+    for (uint32_t i = _n - 1; i > 0; --i)
+	click_swap(order[i], order[click_random(0, i)]);
+
+    MicroBench mb[nops];
+    for (uint32_t r = 0; r < _rounds; ++r)
+	bench_string(_n, _length, order, strs, equals, mb);
+    delete[] order;
+
+    StringAccum sa;
+    sa << MicroBench::header();
+    for (int op = 0; op < nops; ++op)
+	mb[op].unparse(sa, op >= op_sa_append ? "StringAccum" : "String",
+		       op_names[op], _n);
+    _results = sa.take_string();
+    return 0;
+}
+
+void
+StringBench::add_handlers()
+{
+    add_data_handlers("results", Handler::OP_READ, &_results);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel MicroBench)
+EXPORT_ELEMENT(StringBench)
@@ -0,0 +1,87 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_STRINGBENCH_HH
+#define CLICK_STRINGBENCH_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+StringBench([I<keywords> N, LENGTH, ROUNDS])
+
+=s test
+
+benchmarks String and StringAccum
+
+=d
+
+StringBench measures Click's String and StringAccum classes at
+initialization time.  It does not route packets.  It creates N distinct
+strings of LENGTH bytes each, then times, in random order: copying each
+string, taking a substring of each, calling c_str() on those substrings,
+hashing each string, and comparing each string with an equal string stored
+in different memory.  It also times appending each string to a growing
+String, appending each string and each integer to a StringAccum, and
+StringAccum::take_string.
+
+Copies and substrings share the original string's memory (its memo), so
+they should not allocate.  Calling c_str() on a substring that does not end
+at the end of its memo must copy it, which does allocate.
+
+Each measurement is repeated ROUNDS times and the fastest round is
+reported.
+
+Keyword arguments are:
+
+=over 8
+
+=item N
+
+Integer. Number of strings. Default is 1000000.
+
+=item LENGTH
+
+Integer. Length of each string in bytes; at least 16. Default is 32.
+
+=item ROUNDS
+
+Integer. Number of times to repeat each measurement. Default is 3.
+
+=back
+
+=h results read-only
+
+Returns the measurements as CSV, with header line
+"structure,op,n,ns_per_op,allocs_per_op,misses_per_op,misses".  See
+VectorBench for the columns.  StringAccum's "take_string" line reports
+the time to take a single string of N*LENGTH bytes.
+
+=e
+
+  click -qe 'b :: StringBench(N 100000)' -h b.results
+
+=a
+
+HashTableBench, VectorBench, DequeBench, HeapBench */
+
+class StringBench : public Element { public:
+
+    StringBench();
+
+    const char *class_name() const		{ return "StringBench"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+  private:
+
+    uint32_t _n;
+    uint32_t _length;
+    uint32_t _rounds;
+    String _results;
+
+};
+
+CLICK_ENDDECLS
+#endif
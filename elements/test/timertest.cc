@@ -38,9 +38,11 @@ TimerTest::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("BENCHMARK", _benchmark)
 	.read("DELAY", delay)
 	.read("SCHEDULE", schedule)
+	.read("SLACK", _slack)
 	.complete() < 0)
 	return -1;
     _timer.initialize(this);
+    _timer.set_slack(_slack);
     if (schedule || delay)
 	_timer.schedule_after(delay);
     return 0;
@@ -65,6 +67,7 @@ TimerTest::initialize(ErrorHandler *)
 	for (int i = 0; i < _benchmark; ++i) {
 	    ts[i].assign();
 	    ts[i].initialize(this);
+	    ts[i].set_slack(_slack);
 	}
 	benchmark_schedules(ts, _benchmark, now);
 	benchmark_changes(ts, _benchmark, now);
@@ -35,6 +35,12 @@ Timestamp. If set, TimerTest schedules a timer starting DELAY seconds in the
 future. On expiry, a message such as "C<1000000000.010000: t1 :: TimerTest fired>"
 is printed to standard error.
 
+=item SLACK
+
+Timestamp.  If set, TimerTest's timers may fire up to SLACK late, which puts
+them in the timer wheel rather than the timer heap (see Timer::set_slack).
+Default is 0.
+
 =item BENCHMARK
 
 Integer.  If set to a positive number, then TimerTest runs a timer
@@ -77,6 +83,7 @@ class TimerTest : public Element { public:
 
     Timer _timer;
     int _benchmark;
+    Timestamp _slack;
 
     void benchmark_schedules(Timer *ts, int nts, const Timestamp &now);
     void benchmark_changes(Timer *ts, int nts, const Timestamp &now);
@@ -0,0 +1,151 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * vectorbench.{cc,hh} -- benchmark element for the Vector template
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "vectorbench.hh"
+#include "microbench.hh"
+#include <click/vector.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/algorithm.hh>
+CLICK_DECLS
+
+namespace {
+
+enum { op_push_back, op_reserved_push_back, op_iterate, op_random,
+       op_copy, op_pop_back, op_string_push_back, nops };
+const char * const op_names[] = {
+    "push_back", "reserved_push_back", "iterate", "random", "copy",
+    "pop_back", "push_back"
+};
+
+void
+bench_vector(uint32_t n, const uint32_t *order, MicroBench *mb)
+{
+    uint32_t sink = 0;
+    // Sequential operations share each cache line among several elements.
+    double seq_lines = (double) sizeof(int) / 64;
+    size_t bytes = n * sizeof(int);
+
+    {
+	Vector<int> v;
+	mb[op_push_back].start();
+	for (uint32_t i = 0; i < n; ++i)
+	    v.push_back(i);
+	mb[op_push_back].stop(n);
+	sink += v.size();
+    }
+
+    Vector<int> v;
+    v.reserve(n);
+    mb[op_reserved_push_back].start();
+    for (uint32_t i = 0; i < n; ++i)
+	v.push_back(i);
+    mb[op_reserved_push_back].stop(n);
+
+    mb[op_iterate].start();
+    for (Vector<int>::const_iterator it = v.begin(); it != v.end(); ++it)
+	sink += *it;
+    mb[op_iterate].stop(n);
+
+    mb[op_random].start();
+    for (uint32_t i = 0; i < n; ++i)
+	sink += v[order[i]];
+    mb[op_random].stop(n);
+
+    {
+	mb[op_copy].start();
+	Vector<int> copy(v);
+	mb[op_copy].stop(n);
+	sink += copy.back();
+    }
+
+    mb[op_pop_back].start();
+    for (uint32_t i = 0; i < n; ++i)
+	v.pop_back();
+    mb[op_pop_back].stop(n);
+
+    for (int op = op_push_back; op <= op_pop_back; ++op)
+	mb[op].footprint(bytes, op == op_random ? 1 : seq_lines);
+    mb[op_copy].footprint(2 * bytes, 2 * seq_lines);
+
+    // Elements share the string's memo, so push_back allocates only when
+    // the vector grows.
+    String s("Vector<String> element");
+    Vector<String> vs;
+    mb[op_string_push_back].start();
+    for (uint32_t i = 0; i < n; ++i)
+	vs.push_back(s);
+    mb[op_string_push_back].stop(n);
+    mb[op_string_push_back].footprint(n * sizeof(String),
+				      (double) sizeof(String) / 64);
+    microbench_sink = sink + vs.size();
+}
+
+}
+
+VectorBench::VectorBench()
+    : _n(1000000), _rounds(3)
+{
+}
+
+int
+VectorBench::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("N", _n)
+	.read("ROUNDS", _rounds)
+	.complete() < 0)
+	return -1;
+    if (_n == 0 || _rounds == 0)
+	return errh->error("N and ROUNDS must be positive");
+    return 0;
+}
+
+int
+VectorBench::initialize(ErrorHandler *errh)
+{
+    uint32_t *order = new uint32_t[_n];
+    if (!order)
+	return errh->error("out of memory");
+    for (uint32_t i = 0; i < _n; ++i)
+	order[i] = i;
+    for (uint32_t i = _n - 1; i > 0; --i)
+	click_swap(order[i], order[click_random(0, i)]);
+
+    MicroBench mb[nops];
+    for (uint32_t r = 0; r < _rounds; ++r)
+	bench_vector(_n, order, mb);
+    delete[] order;
+
+    StringAccum sa;
+    sa << MicroBench::header();
+    for (int op = 0; op < nops; ++op)
+	mb[op].unparse(sa, op == op_string_push_back ? "Vector<String>" : "Vector<int>",
+		       op_names[op], _n);
+    _results = sa.take_string();
+    return 0;
+}
+
+void
+VectorBench::add_handlers()
+{
+    add_data_handlers("results", Handler::OP_READ, &_results);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel MicroBench)
+EXPORT_ELEMENT(VectorBench)
@@ -0,0 +1,80 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_VECTORBENCH_HH
+#define CLICK_VECTORBENCH_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+VectorBench([I<keywords> N, ROUNDS])
+
+=s test
+
+benchmarks the Vector template
+
+=d
+
+VectorBench measures Click's Vector template at initialization time.  It
+does not route packets.  On a Vector<int> of N elements it times
+push_back into an empty vector, push_back after reserve(), sequential
+iteration, reads at random indexes, copying the vector, and pop_back.  It
+also times push_back on a Vector<String>, which exercises the non-POD
+element path.  Each measurement is repeated ROUNDS times and the fastest
+round is reported.
+
+Keyword arguments are:
+
+=over 8
+
+=item N
+
+Integer. Number of elements. Default is 1000000.
+
+=item ROUNDS
+
+Integer. Number of times to repeat each measurement. Default is 3.
+
+=back
+
+=h results read-only
+
+Returns the measurements as CSV, with header line
+"structure,op,n,ns_per_op,allocs_per_op,misses_per_op,misses".  Each
+following line reports one operation on a structure of size "n".  The
+"ns_per_op" column is the fastest round's time per operation in
+nanoseconds, and "allocs_per_op" is the number of operator new calls per
+operation in that round.  The "misses_per_op" column reports last-level
+cache misses per operation; "misses" is "measured" if these came from
+hardware performance counters, and "estimated" if they were computed from
+the structure's size and the size of the largest CPU cache.  Both columns
+are "-" if misses could be neither measured nor estimated.
+
+=e
+
+  click -qe 'b :: VectorBench(N 100000)' -h b.results
+
+=a
+
+HashTableBench, StringBench, DequeBench, HeapBench, VectorTest */
+
+class VectorBench : public Element { public:
+
+    VectorBench();
+
+    const char *class_name() const		{ return "VectorBench"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+  private:
+
+    uint32_t _n;
+    uint32_t _rounds;
+    String _results;
+
+};
+
+CLICK_ENDDECLS
+#endif
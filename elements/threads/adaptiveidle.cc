@@ -0,0 +1,142 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * adaptiveidle.{cc,hh} -- element sets adaptive idle policy for threads
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <click/config.h>
+#include "adaptiveidle.hh"
+#include <click/task.hh>
+#include <click/routerthread.hh>
+#include <click/master.hh>
+#include <click/router.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+AdaptiveIdle::AdaptiveIdle()
+{
+}
+
+AdaptiveIdle::~AdaptiveIdle()
+{
+}
+
+int
+AdaptiveIdle::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _threads.clear();
+    _spin = _pause = 1000;
+    _max_sleep = 1000;
+    _active = true;
+    if (Args(conf, this, errh)
+	.read_all("THREAD", _threads)
+	.read("SPIN", _spin)
+	.read("PAUSE", _pause)
+	.read("MAX_SLEEP", SecondsArg(6), _max_sleep)
+	.read("ACTIVE", _active)
+	.complete() < 0)
+	return -1;
+    for (int *tp = _threads.begin(); tp != _threads.end(); ++tp)
+	if (*tp < 0 || *tp >= master()->nthreads())
+	    return errh->error("thread %d out of range", *tp);
+    if (!_threads.size())
+	for (int t = 0; t < master()->nthreads(); ++t)
+	    _threads.push_back(t);
+    if (_max_sleep == 0)
+	_max_sleep = 1;
+    return 0;
+}
+
+int
+AdaptiveIdle::initialize(ErrorHandler *)
+{
+    apply(_active);
+    return 0;
+}
+
+void
+AdaptiveIdle::cleanup(CleanupStage stage)
+{
+    if (stage >= CLEANUP_INITIALIZED)
+	apply(false);
+}
+
+void
+AdaptiveIdle::apply(bool active)
+{
+    int policy = active ? RouterThread::IDLE_ADAPTIVE : RouterThread::IDLE_POLL;
+    for (int *tp = _threads.begin(); tp != _threads.end(); ++tp)
+	master()->thread(*tp)->set_idle_policy(policy, _spin, _pause, _max_sleep);
+}
+
+enum { H_STATS, H_ACTIVE, H_RESET };
+
+String
+AdaptiveIdle::read_handler(Element *e, void *thunk)
+{
+    AdaptiveIdle *ai = static_cast<AdaptiveIdle *>(e);
+    switch ((intptr_t) thunk) {
+    case H_STATS: {
+	StringAccum sa;
+	Master *m = ai->master();
+	for (int t = 0; t < m->nthreads(); ++t) {
+	    RouterThread *thread = m->thread(t);
+	    click_cycles_t busy = thread->busy_cycles();
+	    click_cycles_t idle = thread->idle_cycles();
+	    click_cycles_t total = busy + idle;
+	    sa << t << ' ' << busy << ' ' << idle << ' '
+	       << (total ? (busy * 100) / total : 0) << ' '
+	       << thread->idle_sleeps() << '\n';
+	}
+	return sa.take_string();
+    }
+    case H_ACTIVE:
+	return String(ai->_active);
+    default:
+	return String();
+    }
+}
+
+int
+AdaptiveIdle::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    AdaptiveIdle *ai = static_cast<AdaptiveIdle *>(e);
+    switch ((intptr_t) thunk) {
+    case H_ACTIVE:
+	if (!BoolArg().parse(str, ai->_active))
+	    return errh->error("syntax error");
+	ai->apply(ai->_active);
+	return 0;
+    case H_RESET: {
+	Master *m = ai->master();
+	for (int t = 0; t < m->nthreads(); ++t)
+	    m->thread(t)->reset_cycle_stats();
+	return 0;
+    }
+    default:
+	return -1;
+    }
+}
+
+void
+AdaptiveIdle::add_handlers()
+{
+    add_read_handler("stats", read_handler, H_STATS);
+    add_read_handler("active", read_handler, H_ACTIVE, Handler::CHECKBOX);
+    add_write_handler("active", write_handler, H_ACTIVE);
+    add_write_handler("reset", write_handler, H_RESET, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(AdaptiveIdle)
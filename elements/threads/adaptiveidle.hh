@@ -0,0 +1,110 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ADAPTIVEIDLE_HH
+#define CLICK_ADAPTIVEIDLE_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+AdaptiveIdle([THREAD, I<keywords> SPIN, PAUSE, MAX_SLEEP, ACTIVE])
+
+=s threads
+
+backs off polling threads when they are idle
+
+=d
+
+Sets an adaptive idle policy for user-level driver threads.  Normally a
+thread with scheduled tasks polls them continuously, even when they find no
+work, so idle polling configurations keep their CPUs busy.  Under the adaptive
+policy, a thread whose tasks stop finding work first busy-polls for SPIN driver
+iterations, then executes CPU pause instructions for PAUSE more iterations,
+and then sleeps for exponentially increasing periods, from one microsecond up
+to MAX_SLEEP.  Sleeps of a millisecond or more block in the thread's file
+descriptor set, so they end early when a file descriptor becomes ready or when
+another thread wakes one of this thread's tasks (for example, through a
+Notifier).  As soon as any task reports work, the thread returns to
+busy-polling.
+
+THREAD arguments name the affected threads; by default, AdaptiveIdle affects
+all threads.  AdaptiveIdle also reports how each thread divides its time
+between busy driver iterations, in which at least one task did work, and idle
+iterations.  These statistics are kept for every thread, whether or not the
+adaptive policy is active.
+
+Keyword arguments are:
+
+=over 8
+
+=item THREAD
+
+Integer.  A thread to configure.  May be given more than once.
+
+=item SPIN
+
+Unsigned.  Idle driver iterations to spend busy-polling.  Default is 1000.
+
+=item PAUSE
+
+Unsigned.  Further idle iterations to spend in pause loops.  Default is 1000.
+
+=item MAX_SLEEP
+
+Time.  Maximum sleep per idle iteration, with microsecond precision.  Larger
+values save more CPU, but may delay packets arriving on devices without file
+descriptor notification.  Default is 1ms.
+
+=item ACTIVE
+
+Boolean.  If false, threads keep the default busy-polling policy.  Default is
+true.
+
+=back
+
+=h stats read-only
+
+Returns one line per thread: the thread ID, busy cycles, idle cycles, busy
+percentage, and number of idle sleeps.
+
+=h active read/write
+
+Returns or sets the ACTIVE setting.
+
+=h reset write-only
+
+Resets all threads' cycle statistics.
+
+=a
+
+StaticThreadSched, BalancedThreadSched */
+
+class AdaptiveIdle : public Element { public:
+
+    AdaptiveIdle();
+    ~AdaptiveIdle();
+
+    const char *class_name() const	{ return "AdaptiveIdle"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+  private:
+
+    Vector<int> _threads;
+    unsigned _spin;
+    unsigned _pause;
+    uint32_t _max_sleep;
+    bool _active;
+
+    void apply(bool active);
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
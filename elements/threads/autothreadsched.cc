@@ -0,0 +1,367 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * autothreadsched.{cc,hh} -- element assigns tasks to threads from costs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "autothreadsched.hh"
+#include <click/master.hh>
+#include <click/router.hh>
+#include <click/handler.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+#include <click/algorithm.hh>
+#include <click/userutils.hh>
+CLICK_DECLS
+
+AutoThreadSched::AutoThreadSched()
+    : _next_thread_sched(0), _planned(false), _measured(false)
+{
+}
+
+AutoThreadSched::~AutoThreadSched()
+{
+}
+
+int
+AutoThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String costs_file;
+    _default_cost = 100;
+    _handoff_cost = 200;
+    if (Args(this, errh).bind(conf)
+	.read("COSTS", FilenameArg(), costs_file)
+	.read("DEFAULT_COST", _default_cost)
+	.read("HANDOFF_COST", _handoff_cost)
+	.consume() < 0)
+	return -1;
+
+    Vector<String> lines;
+    if (costs_file) {
+	// Each line is "CLASS CYCLES"; '#' starts a comment.
+	String text = file_string(costs_file, errh);
+	const char *s = text.begin(), *end = text.end();
+	while (s != end) {
+	    const char *eol = find(s, end, '\n');
+	    String line(s, eol);
+	    int hash = line.find_left('#');
+	    if (hash >= 0)
+		line = line.substring(0, hash);
+	    if (line.trim_space())
+		lines.push_back(line);
+	    s = (eol == end ? end : eol + 1);
+	}
+    }
+    // Arguments override the file.
+    for (String *l = conf.begin(); l != conf.end(); ++l)
+	lines.push_back(*l);
+
+    for (int i = 0; i < lines.size(); ++i) {
+	String type;
+	double cycles;
+	if (Args(this, errh).push_back_words(lines[i])
+	    .read_mp("CLASS", WordArg(), type)
+	    .read_mp("CYCLES", cycles)
+	    .complete() < 0)
+	    return -1;
+	_costs[type] = cycles;
+    }
+
+    _next_thread_sched = router()->thread_sched();
+    router()->set_thread_sched(this);
+    return 0;
+}
+
+int
+AutoThreadSched::initialize(ErrorHandler *)
+{
+    _init_time = Timestamp::now_steady();
+    return 0;
+}
+
+double
+AutoThreadSched::cost(const Element *e) const
+{
+    if (const double *c = _costs.get_pointer(e->class_name()))
+	return *c;
+    return _default_cost;
+}
+
+/** @brief Measure this router's per-element loads since initialization.
+ *
+ * Sets @a loads[NAME] for each element.  Packet rates require
+ * CLICK_STATS >= 1 and cycles require CLICK_STATS >= 2; without them, no
+ * loads are measured. */
+void
+AutoThreadSched::measure(HashTable<String, Load> &loads) const
+{
+#if CLICK_STATS >= 1
+    double elapsed = (Timestamp::now_steady() - _init_time).doubleval();
+    if (elapsed <= 0)
+	return;
+    for (int i = 0; i < router()->nelements(); ++i) {
+	Element *e = router()->element(i);
+	Load l;
+	l.packets = 0;
+	l.cycles = -1;
+	for (int p = 0; p < e->ninputs(); ++p)
+	    l.packets += e->input(p).npackets();
+	if (e->ninputs() == 0)
+	    for (int p = 0; p < e->noutputs(); ++p)
+		l.packets += e->output(p).npackets();
+	l.packets /= elapsed;
+# if CLICK_STATS >= 2
+	// "cycles" lines are "tasks|timers|xfer CALLS CYCLES".
+	if (const Handler *h = Router::handler(e, "cycles")) {
+	    Vector<String> words;
+	    cp_spacevec(h->call_read(e), words);
+	    l.cycles = 0;
+	    for (int w = 0; w + 2 < words.size(); w += 3) {
+		double c;
+		if (DoubleArg().parse(words[w + 2], c))
+		    l.cycles += c;
+	    }
+	    l.cycles /= elapsed;
+	}
+# endif
+	loads[e->name()] = l;
+    }
+#else
+    (void) loads;
+#endif
+}
+
+int
+AutoThreadSched::find_group(Vector<int> &parent, int x)
+{
+    while (parent[x] != x)
+	x = parent[x] = parent[parent[x]];
+    return x;
+}
+
+void
+AutoThreadSched::plan()
+{
+    _planned = true;
+    Router *r = router();
+    int n = r->nelements(), nthreads = master()->nthreads();
+
+    // Measurements from the router we are replacing, if any.
+    HashTable<String, Load> loads;
+    if (Router *old = r->hotswap_router())
+	if (Element *e = old->find(name()))
+	    if (AutoThreadSched *ats = static_cast<AutoThreadSched *>(e->cast("AutoThreadSched")))
+		ats->measure(loads);
+    _measured = (loads.size() > 0);
+
+    // Per-element load and role.
+    Vector<double> load(n, 0), rate(n, 0);
+    Vector<int> task(n, 0), queue(n, 0), safe(n, 0);
+    for (int i = 0; i < n; ++i) {
+	Element *e = r->element(i);
+	bool push_in = false, pull_in = false, push_out = false, pull_out = false;
+	for (int p = 0; p < e->ninputs(); ++p)
+	    (e->input_is_pull(p) ? pull_in : push_in) = true;
+	for (int p = 0; p < e->noutputs(); ++p)
+	    (e->output_is_push(p) ? push_out : pull_out) = true;
+	// Elements that pull packets and push them onward (Unqueue,
+	// ToDevice) and push-only sources run tasks.
+	task[i] = (pull_in && !pull_out)
+	    || (e->ninputs() == 0 && push_out && strcmp(e->class_name(), "Idle") != 0);
+	queue[i] = push_in && pull_out;
+	safe[i] = (e->cast("ThreadSafeQueue") != 0);
+	if (!e->ninputs() && !e->noutputs())
+	    continue;
+	if (_measured) {
+	    if (Load *l = loads.get_pointer(e->name())) {
+		rate[i] = l->packets;
+		load[i] = (l->cycles >= 0 ? l->cycles : l->packets * cost(e));
+	    }
+	} else {
+	    rate[i] = 1;
+	    load[i] = cost(e);
+	}
+    }
+
+    // Domains: the elements each task pushes to or pulls from.
+    Vector<int> tasks;
+    Vector<Vector<int> > pushers(n, Vector<int>()), pullers(n, Vector<int>());
+    for (int t = 0; t < n; ++t) {
+	if (!task[t])
+	    continue;
+	int d = tasks.size();
+	tasks.push_back(t);
+	for (int dir = 0; dir < 2; ++dir) {
+	    Vector<Vector<int> > &members = (dir ? pullers : pushers);
+	    Vector<int> stack;
+	    stack.push_back(t);
+	    while (stack.size()) {
+		Element *e = r->element(stack.back());
+		stack.pop_back();
+		Vector<int> &m = members[e->eindex()];
+		if (find(m.begin(), m.end(), d) != m.end())
+		    continue;
+		m.push_back(d);
+		if (dir == 0) {
+		    for (int p = 0; p < e->noutputs(); ++p)
+			if (e->output_is_push(p))
+			    stack.push_back(e->output(p).element()->eindex());
+		} else {
+		    for (int p = 0; p < e->ninputs(); ++p)
+			if (e->input_is_pull(p))
+			    stack.push_back(e->input(p).element()->eindex());
+		}
+	    }
+	}
+    }
+
+    // Group domains that must share a thread.
+    int ndomains = tasks.size();
+    Vector<int> parent(ndomains, 0);
+    Vector<double> gload(ndomains, 0);
+    for (int d = 0; d < ndomains; ++d)
+	parent[d] = d;
+    for (int x = 0; x < n; ++x) {
+	Vector<int> all = pushers[x];
+	for (int *d = pullers[x].begin(); d != pullers[x].end(); ++d)
+	    if (find(all.begin(), all.end(), *d) == all.end())
+		all.push_back(*d);
+	for (int *d = all.begin(); d != all.end(); ++d)
+	    gload[*d] += load[x] / all.size();
+	if (safe[x])
+	    continue;
+	else if (queue[x]) {
+	    for (int i = 1; i < pushers[x].size(); ++i)
+		parent[find_group(parent, pushers[x][i])] = find_group(parent, pushers[x][0]);
+	    for (int i = 1; i < pullers[x].size(); ++i)
+		parent[find_group(parent, pullers[x][i])] = find_group(parent, pullers[x][0]);
+	} else
+	    for (int i = 1; i < all.size(); ++i)
+		parent[find_group(parent, all[i])] = find_group(parent, all[0]);
+    }
+    for (int d = 0; d < ndomains; ++d)
+	if (find_group(parent, d) != d) {
+	    gload[find_group(parent, d)] += gload[d];
+	    gload[d] = 0;
+	}
+
+    // Groups containing a task that an earlier ThreadSched placed stay put.
+    Vector<int> gthread(ndomains, -1);
+    Vector<double> tload(nthreads, 0);
+    for (int d = 0; d < ndomains; ++d) {
+	int g = find_group(parent, d);
+	int t = (_next_thread_sched ? _next_thread_sched->initial_home_thread_id(r->element(tasks[d])) : THREAD_UNKNOWN);
+	if (gthread[g] < 0 && t >= 0 && t < nthreads) {
+	    gthread[g] = t;
+	    tload[t] += gload[g];
+	}
+    }
+
+    // Handoffs between groups: producer group, consumer group, rate.
+    struct Link {
+	int from, to;
+	double rate;
+    };
+    Vector<Link> links;
+    for (int x = 0; x < n; ++x)
+	if (queue[x])
+	    for (int *p = pushers[x].begin(); p != pushers[x].end(); ++p)
+		for (int *c = pullers[x].begin(); c != pullers[x].end(); ++c) {
+		    Link l = { find_group(parent, *p), find_group(parent, *c),
+			       rate[x] / (pushers[x].size() * pullers[x].size()) };
+		    if (l.from != l.to)
+			links.push_back(l);
+		}
+
+    // Place the remaining groups, largest first.
+    Vector<int> order;
+    for (int d = 0; d < ndomains; ++d)
+	if (find_group(parent, d) == d && gthread[d] < 0)
+	    order.push_back(d);
+    for (int i = 1; i < order.size(); ++i)
+	for (int j = i; j > 0 && gload[order[j]] > gload[order[j-1]]; --j)
+	    click_swap(order[j], order[j-1]);
+    for (int *g = order.begin(); g != order.end(); ++g) {
+	// Minimize the busiest thread's load, then this group's thread's load.
+	int best = 0;
+	double best_max = 0, best_own = 0;
+	for (int t = 0; t < nthreads; ++t) {
+	    Vector<double> l = tload;
+	    l[t] += gload[*g];
+	    for (Link *k = links.begin(); k != links.end(); ++k)
+		if (k->from == *g && gthread[k->to] >= 0 && gthread[k->to] != t)
+		    l[gthread[k->to]] += k->rate * _handoff_cost;
+		else if (k->to == *g && gthread[k->from] >= 0 && gthread[k->from] != t)
+		    l[t] += k->rate * _handoff_cost;
+	    double m = 0;
+	    for (int i = 0; i < nthreads; ++i)
+		if (l[i] > m)
+		    m = l[i];
+	    if (t == 0 || m < best_max || (m == best_max && l[t] < best_own)) {
+		best = t;
+		best_max = m;
+		best_own = l[t];
+	    }
+	}
+	gthread[*g] = best;
+	tload[best] += gload[*g];
+	for (Link *k = links.begin(); k != links.end(); ++k)
+	    if (k->from == *g && gthread[k->to] >= 0 && gthread[k->to] != best)
+		tload[gthread[k->to]] += k->rate * _handoff_cost;
+	    else if (k->to == *g && gthread[k->from] >= 0 && gthread[k->from] != best)
+		tload[best] += k->rate * _handoff_cost;
+    }
+
+    _threads.assign(n, THREAD_UNKNOWN);
+    for (int d = 0; d < ndomains; ++d)
+	_threads[tasks[d]] = gthread[find_group(parent, d)];
+}
+
+int
+AutoThreadSched::initial_home_thread_id(const Element *e)
+{
+    if (!_planned)
+	plan();
+    int eidx = e->eindex();
+    if (eidx >= 0 && eidx < _threads.size() && _threads[eidx] != THREAD_UNKNOWN)
+	return _threads[eidx];
+    if (_next_thread_sched)
+	return _next_thread_sched->initial_home_thread_id(e);
+    else
+	return THREAD_UNKNOWN;
+}
+
+String
+AutoThreadSched::read_handler(Element *e, void *user_data)
+{
+    AutoThreadSched *ats = static_cast<AutoThreadSched *>(e);
+    if (user_data)
+	return String(ats->_measured);
+    StringAccum sa;
+    for (int i = 0; i < ats->_threads.size(); ++i)
+	if (ats->_threads[i] != THREAD_UNKNOWN)
+	    sa << ats->router()->element(i)->name() << ' ' << ats->_threads[i] << '\n';
+    return sa.take_string();
+}
+
+void
+AutoThreadSched::add_handlers()
+{
+    add_read_handler("plan", read_handler, 0);
+    add_read_handler("measured", read_handler, 1);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(AutoThreadSched)
@@ -0,0 +1,120 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_AUTOTHREADSCHED_HH
+#define CLICK_AUTOTHREADSCHED_HH
+#include <click/element.hh>
+#include <click/hashtable.hh>
+#include <click/timestamp.hh>
+#include <click/standard/threadsched.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * AutoThreadSched(CLASS CYCLES, ..., I<keywords> COSTS, DEFAULT_COST, HANDOFF_COST)
+ * =s threads
+ * assigns tasks to threads from element costs
+ * =d
+ *
+ * Chooses a home thread for every task in the configuration, balancing
+ * estimated load while keeping packets from crossing threads.
+ *
+ * AutoThreadSched divides the configuration into domains, one per task: a
+ * task's domain contains the elements it pushes packets to and pulls packets
+ * from.  Domains that share an element must run on the same thread, unless
+ * the element is a ThreadSafeQueue, or a queue that one domain pushes into
+ * and the other pulls from.  AutoThreadSched packs the resulting groups of
+ * domains onto threads, largest first, placing each group where it least
+ * increases the busiest thread's load.  Packets that a queue hands between
+ * groups on different threads add HANDOFF_COST cycles each to the consumer's
+ * load.
+ *
+ * When the router is hot-swapped, AutoThreadSched measures the old router's
+ * per-element packet rates and, if Click was built with
+ * C<--enable-stats=2>, its per-element cycles, and plans the new router from
+ * the measurements.  Elements are matched by name.  Otherwise, each element's
+ * load is its class's cost in cycles per packet, and every element is assumed
+ * to handle the same packet rate.
+ *
+ * Tasks that a StaticThreadSched, configured before the AutoThreadSched,
+ * assigns to threads stay there; AutoThreadSched plans around them.
+ * AutoThreadSched cannot add queues.  The L<click-perf(1)> tool's
+ * C<--partition> option inserts ThreadSafeQueue boundaries where they help.
+ *
+ * Arguments are:
+ *
+ * =over 8
+ *
+ * =item CLASS CYCLES
+ *
+ * The cost of elements of class CLASS, in cycles per packet.
+ *
+ * =item COSTS
+ *
+ * Filename. Read more class costs from this file, which is in
+ * L<click-perf(1)>'s cost table format.
+ *
+ * =item DEFAULT_COST
+ *
+ * The cost of elements whose class has no cost.  Default is 100.
+ *
+ * =item HANDOFF_COST
+ *
+ * The extra cost, in cycles per packet, of handing a packet to another
+ * thread.  Default is 200.
+ *
+ * =back
+ *
+ * =e
+ *
+ *   AutoThreadSched(CheckIPHeader 60, LookupIPRoute 120);
+ *
+ * =h plan read-only
+ *
+ * Returns the plan as StaticThreadSched arguments: one "TASK THREAD" line
+ * per task.
+ *
+ * =h measured read-only
+ *
+ * Returns true if the plan was based on measurements.
+ *
+ * =a StaticThreadSched, BalancedThreadSched, ThreadSafeQueue, click-perf(1)
+ */
+
+class AutoThreadSched : public Element, public ThreadSched { public:
+
+    AutoThreadSched();
+    ~AutoThreadSched();
+
+    const char *class_name() const	{ return "AutoThreadSched"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+    int initial_home_thread_id(const Element *e);
+
+    struct Load {
+	double packets;		// per second
+	double cycles;		// per second, or -1 if unknown
+    };
+    void measure(HashTable<String, Load> &loads) const;
+
+  private:
+
+    HashTable<String, double> _costs;
+    double _default_cost;
+    double _handoff_cost;
+    ThreadSched *_next_thread_sched;
+    bool _planned;
+    bool _measured;
+    Vector<int> _threads;
+    Timestamp _init_time;
+
+    double cost(const Element *e) const;
+    void plan();
+    static int find_group(Vector<int> &parent, int x);
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -21,6 +21,7 @@
 #include <click/router.hh>
 #include <click/error.hh>
 #include <click/args.hh>
+#include <click/numa.hh>
 CLICK_DECLS
 
 StaticThreadSched::StaticThreadSched()
@@ -35,6 +36,13 @@ StaticThreadSched::~StaticThreadSched()
 int
 StaticThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
 {
+    String nodes, cpus;
+    if (Args(this, errh).bind(conf)
+	.read("NODES", AnyArg(), nodes)
+	.read("CPUS", AnyArg(), cpus)
+	.consume() < 0)
+	return -1;
+
     Element *e;
     int preference;
     for (int i = 0; i < conf.size(); i++) {
@@ -51,6 +59,40 @@ StaticThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
 	}
 	_thread_preferences[e->eindex()] = preference;
     }
+
+    Vector<String> words;
+    cp_spacevec(nodes, words);
+    for (int i = 0; i < words.size(); ++i) {
+	int node;
+	if (!IntArg().parse(words[i], node))
+	    return errh->error("NODES should be a list of integers");
+	if (i >= master()->nthreads()) {
+	    errh->warning("NODES has more entries than threads");
+	    break;
+	} else if (node < 0 || node >= Numa::nnodes())
+	    errh->warning("NUMA node %d out of range", node);
+#if CLICK_USERLEVEL
+	else
+	    master()->thread(i)->set_numa_node(node);
+#endif
+    }
+
+    words.clear();
+    cp_spacevec(cpus, words);
+    for (int i = 0; i < words.size(); ++i) {
+	int cpu;
+	if (!IntArg().parse(words[i], cpu))
+	    return errh->error("CPUS should be a list of integers");
+	if (i >= master()->nthreads()) {
+	    errh->warning("CPUS has more entries than threads");
+	    break;
+	} else if (cpu < 0)
+	    errh->warning("CPU %d out of range", cpu);
+#if CLICK_USERLEVEL
+	else
+	    master()->thread(i)->set_cpu(cpu);
+#endif
+    }
     _next_thread_sched = router()->thread_sched();
     router()->set_thread_sched(this);
     return 0;
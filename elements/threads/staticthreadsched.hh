@@ -7,15 +7,35 @@ CLICK_DECLS
 
 /*
  * =c
- * StaticThreadSched(ELEMENT THREAD, ...)
+ * StaticThreadSched(ELEMENT THREAD, ..., I<keywords> NODES, CPUS)
  * =s threads
  * specifies element and thread scheduling parameters
  * =d
  * Statically binds elements to threads. If more than one StaticThreadSched
  * is specified, they will all run. The one that runs later may override an
  * earlier run.
+ *
+ * At user level on Linux, the NODES keyword binds threads to NUMA nodes.  Its
+ * value is a space-separated list of node numbers, one per thread, starting
+ * with thread 0.  A bound thread runs only on its node's CPUs and prefers
+ * memory from that node, so packet buffers it allocates are node-local.
+ * ThreadSafeQueue allocates its storage on its consumer thread's node.  The
+ * global C<numa_memory> handler reports per-node CPUs, bound threads,
+ * node-local allocations, pooled packet buffers, and free memory.
+ *
+ * The CPUS keyword pins threads more tightly: its value is a space-separated
+ * list of CPU numbers, one per thread, and each thread runs only on its CPU.
+ * A thread's CPU overrides its NODES entry, although the thread still
+ * prefers memory from that CPU's node.  Pinning keeps benchmark results
+ * repeatable.
+ * =e
+ *   // threads 0 and 1 on node 0, threads 2 and 3 on node 1
+ *   StaticThreadSched(fd0 0, fd1 2, NODES 0 0 1 1);
+ *
+ *   // source on CPU 2, sink on CPU 3
+ *   StaticThreadSched(src 0, uq 1, CPUS 2 3);
  * =a
- * ThreadMonitor, BalancedThreadSched
+ * ThreadMonitor, BalancedThreadSched, AutoThreadSched
  */
 
 class StaticThreadSched : public Element, public ThreadSched { public:
@@ -27,6 +27,7 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
@@ -417,6 +418,8 @@ Socket::selected(int fd, int)
     run_task(0);
 }
 
+enum { max_iov = 16 };
+
 int
 Socket::write_packet(Packet *p)
 {
@@ -431,8 +434,26 @@ Socket::write_packet(Packet *p)
       _remote.in.sin_addr = p->dst_ip_anno();
     }
 
-    // write segment
-    if (_socktype == SOCK_STREAM)
+    // write segment; gather data that is still spread over several
+    // buffers, rather than copying it
+    Packet::Segment seg[max_iov];
+    int nseg;
+    if (p->copy_pending() && (nseg = p->segments(seg, max_iov)) <= max_iov) {
+      struct iovec iov[max_iov];
+      for (int i = 0; i < nseg; ++i) {
+	iov[i].iov_base = const_cast<unsigned char *>(seg[i].data);
+	iov[i].iov_len = seg[i].length;
+      }
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      if (_socktype != SOCK_STREAM) {
+	msg.msg_name = &_remote;
+	msg.msg_namelen = _remote_len;
+      }
+      msg.msg_iov = iov;
+      msg.msg_iovlen = nseg;
+      len = sendmsg(_active, &msg, 0);
+    } else if (_socktype == SOCK_STREAM)
       len = write(_active, p->data(), p->length());
     else
       len = sendto(_active, p->data(), p->length(), 0,
@@ -57,6 +57,9 @@
 #if TODEVICE_ALLOW_NETMAP
 # include <sys/mman.h>
 #endif
+#if TODEVICE_ALLOW_LINUX || TODEVICE_ALLOW_DEVBPF || TODEVICE_ALLOW_PCAPFD
+# include <sys/uio.h>
+#endif
 
 CLICK_DECLS
 
@@ -323,6 +326,28 @@ ToDevice::netmap_send_packet(Packet *p)
  * timer if buffers are not available.
  * --jbicket
  */
+#if TODEVICE_ALLOW_LINUX || TODEVICE_ALLOW_DEVBPF || TODEVICE_ALLOW_PCAPFD
+enum { max_iov = 16 };
+
+// Describe p's data with iovecs, so that packets whose data is still spread
+// over several buffers (see Packet::segments) are sent without copying it.
+static int
+packet_iovec(Packet *p, struct iovec *iov)
+{
+    Packet::Segment seg[max_iov];
+    int n = p->segments(seg, max_iov);
+    if (n > max_iov) {
+	p->finish_copy();
+	n = p->segments(seg, max_iov);
+    }
+    for (int i = 0; i < n; ++i) {
+	iov[i].iov_base = const_cast<unsigned char *>(seg[i].data);
+	iov[i].iov_len = seg[i].length;
+    }
+    return n;
+}
+#endif
+
 int
 ToDevice::send_packet(Packet *p)
 {
@@ -345,20 +370,30 @@ ToDevice::send_packet(Packet *p)
 #endif
 
 #if TODEVICE_ALLOW_LINUX
-    if (_method == method_linux)
-	r = send(_fd, p->data(), p->length(), 0);
+    if (_method == method_linux) {
+	struct iovec iov[max_iov];
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = packet_iovec(p, iov);
+	r = sendmsg(_fd, &msg, 0);
+    }
 #endif
 
 #if TODEVICE_ALLOW_DEVBPF
-    if (_method == method_devbpf)
-	if (write(_fd, p->data(), p->length()) != (ssize_t) p->length())
+    if (_method == method_devbpf) {
+	struct iovec iov[max_iov];
+	if (writev(_fd, iov, packet_iovec(p, iov)) != (ssize_t) p->length())
 	    r = -1;
+    }
 #endif
 
 #if TODEVICE_ALLOW_PCAPFD
-    if (_method == method_pcapfd)
-	if (write(_fd, p->data(), p->length()) != (ssize_t) p->length())
+    if (_method == method_pcapfd) {
+	struct iovec iov[max_iov];
+	if (writev(_fd, iov, packet_iovec(p, iov)) != (ssize_t) p->length())
 	    r = -1;
+    }
 #endif
 
     if (r >= 0)
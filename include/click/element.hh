@@ -6,6 +6,8 @@
 #include <click/string.hh>
 #include <click/packet.hh>
 #include <click/handler.hh>
+#include <click/profiler.hh>
+#include <click/latencytracer.hh>
 CLICK_DECLS
 class Router;
 class Master;
@@ -239,7 +241,7 @@ class Element { public:
 #if CLICK_STATS >= 1
 	mutable unsigned _packets;	// How many packets have we moved?
 #endif
-#if CLICK_STATS >= 2
+#if CLICK_STATS >= 2 || CLICK_LATENCY_TRACE
 	Element* _owner;		// Whose input or output are we?
 #endif
 
@@ -514,12 +516,15 @@ Element::input_is_push(int port) const
 	&& !_ports[0][port].active();
 }
 
-#if CLICK_STATS >= 2
-# define PORT_ASSIGN(o) _packets = 0; _owner = (o)
-#elif CLICK_STATS >= 1
-# define PORT_ASSIGN(o) _packets = 0; (void) (o)
+#if CLICK_STATS >= 2 || CLICK_LATENCY_TRACE
+# define PORT_ASSIGN_OWNER(o) _owner = (o)
+#else
+# define PORT_ASSIGN_OWNER(o) (void) (o)
+#endif
+#if CLICK_STATS >= 1
+# define PORT_ASSIGN(o) _packets = 0; PORT_ASSIGN_OWNER(o)
 #else
-# define PORT_ASSIGN(o) (void) (o)
+# define PORT_ASSIGN(o) PORT_ASSIGN_OWNER(o)
 #endif
 
 inline
@@ -611,6 +616,14 @@ Element::Port::push(Packet* p) const
 #if CLICK_STATS >= 1
     ++_packets;
 #endif
+#if CLICK_PROFILER
+    bool traced = unlikely(Profiler::tracing());
+    if (traced)
+	Profiler::enter(_e, _port);
+#endif
+#if CLICK_LATENCY_TRACE
+    LatencyTracer::hop(_e, p);
+#endif
 #if CLICK_STATS >= 2
     ++_e->input(_port)._packets;
     click_cycles_t start_cycles = click_get_cycles(),
@@ -632,6 +645,10 @@ Element::Port::push(Packet* p) const
     _e->push(_port, p);
 # endif
 #endif
+#if CLICK_PROFILER
+    if (traced)
+	Profiler::leave();
+#endif
 }
 
 /** @brief Pull a packet over this port and return it.
@@ -654,6 +671,11 @@ inline Packet*
 Element::Port::pull() const
 {
     assert(_e);
+#if CLICK_PROFILER
+    bool traced = unlikely(Profiler::tracing());
+    if (traced)
+	Profiler::enter(_e, -1 - _port);
+#endif
 #if CLICK_STATS >= 2
     click_cycles_t start_cycles = click_get_cycles(),
 	old_child_cycles = _e->_child_cycles;
@@ -676,6 +698,14 @@ Element::Port::pull() const
     Packet *p = _e->pull(_port);
 # endif
 #endif
+#if CLICK_PROFILER
+    if (traced)
+	Profiler::leave();
+#endif
+#if CLICK_LATENCY_TRACE
+    if (p)
+	LatencyTracer::hop(_owner, p);
+#endif
 #if CLICK_STATS >= 1
     if (p)
 	++_packets;
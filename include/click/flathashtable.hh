@@ -0,0 +1,1139 @@
+#ifndef CLICK_FLATHASHTABLE_HH
+#define CLICK_FLATHASHTABLE_HH
+/*
+ * flathashtable.hh -- open-addressing hash table templates
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software")
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <click/algorithm.hh>
+#include <click/pair.hh>
+#include <click/integers.hh>
+#include <click/hashcontainer.hh>
+#if defined(__SSE2__) && !CLICK_LINUXMODULE && !CLICK_BSDMODULE
+# include <emmintrin.h>
+# define CLICK_FLATHASH_SSE2 1
+#endif
+CLICK_DECLS
+
+/** @file <click/flathashtable.hh>
+ * @brief Open-addressing hash table templates.
+ */
+
+template <typename K, typename V> class FlatHashTable;
+template <typename T, typename A = HashContainer_adapter<T> > class FlatHashContainer;
+
+/** @cond never */
+/* FlatHash_rep is the storage engine shared by FlatHashTable and
+   FlatHashContainer.  Slots of type S are stored in groups of 16.  Each
+   group starts with 16 control bytes, one per slot: ctrl_empty,
+   ctrl_deleted, or the low 7 bits of the slot's hash.  SSE2 compares a
+   group's control bytes in one instruction.  Because control bytes and
+   slots share memory, a lookup usually touches one page and two adjacent
+   cache lines.
+
+   When the table fills, a new table is allocated and the old table's
+   elements move to it a few at a time, during later insertions.  Until the
+   move finishes, lookups check both tables. */
+template <typename S, typename X>
+class FlatHash_rep : public X { public:
+
+    typedef typename X::key_type key_type;
+    typedef size_t size_type;
+
+    enum { group_size = 16, min_capacity = 16, migrate_slots = 32,
+	   sync_migrate_capacity = 1024 };
+    enum { ctrl_empty = 0x80, ctrl_deleted = 0xFE };
+    enum { group_bytes = (group_size + group_size * sizeof(S) + 15) & ~15 };
+
+    struct table {
+	char *mem;
+	size_type capacity;
+	size_type size;
+	size_type deleted;
+	uint8_t *group(size_type g) const {
+	    return reinterpret_cast<uint8_t *>(mem + g * group_bytes);
+	}
+	uint8_t &ctrl(size_type i) const {
+	    return group(i / group_size)[i % group_size];
+	}
+	S &slot(size_type i) const {
+	    return reinterpret_cast<S *>(group(i / group_size) + group_size)[i % group_size];
+	}
+    };
+
+    table _t[2];		// _t[0] takes insertions; _t[1] is draining
+    size_type _migrate_pos;
+
+    explicit FlatHash_rep(size_type n = 0) {
+	_t[1].mem = 0;
+	_t[1].capacity = _t[1].size = _t[1].deleted = 0;
+	allocate(_t[0], capacity_for(n));
+	_migrate_pos = 0;
+    }
+
+    ~FlatHash_rep() {
+	destroy(_t[0]);
+	destroy(_t[1]);
+    }
+
+    size_type size() const {
+	return _t[0].size + _t[1].size;
+    }
+
+    static inline size_type capacity_for(size_type n) {
+	size_type cap = min_capacity;
+	while (cap * 7 < n * 8)
+	    cap *= 2;
+	return cap;
+    }
+
+    static inline size_type mix(hashcode_t h) {
+#if SIZEOF_SIZE_T == 8
+	uint64_t x = (uint64_t) h * 0x9E3779B97F4A7C15ULL;
+	return x ^ (x >> 29);
+#else
+	uint32_t x = (uint32_t) h * 0x9E3779B1U;
+	return x ^ (x >> 15);
+#endif
+    }
+
+    static inline unsigned match(const uint8_t *ctrl, uint8_t c) {
+#if CLICK_FLATHASH_SSE2
+	__m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char) c)));
+#else
+	unsigned m = 0;
+	for (int j = 0; j < group_size; ++j)
+	    if (ctrl[j] == c)
+		m |= 1U << j;
+	return m;
+#endif
+    }
+
+    // Match empty and deleted slots, which both have the high bit set.
+    static inline unsigned match_free(const uint8_t *ctrl) {
+#if CLICK_FLATHASH_SSE2
+	__m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+	return _mm_movemask_epi8(g);
+#else
+	unsigned m = 0;
+	for (int j = 0; j < group_size; ++j)
+	    if (ctrl[j] & 0x80)
+		m |= 1U << j;
+	return m;
+#endif
+    }
+
+    inline bool find_in(const table &t, const key_type &key, size_type h,
+			size_type &pos) const {
+	if (!t.size)
+	    return false;
+	size_type gmask = t.capacity / group_size - 1;
+	size_type g = (h >> 7) & gmask;
+	uint8_t c = h & 0x7F;
+	for (size_type step = 1; ; ++step) {
+	    const uint8_t *ctrl = t.group(g);
+	    for (unsigned m = match(ctrl, c); m; m &= m - 1) {
+		size_type i = g * group_size + ffs_lsb(m) - 1;
+		if (this->keyeq(this->key(t.slot(i)), key)) {
+		    pos = i;
+		    return true;
+		}
+	    }
+	    if (match(ctrl, ctrl_empty))
+		return false;
+	    g = (g + step) & gmask;
+	}
+    }
+
+    inline bool find(const key_type &key, size_type h, int &t, size_type &pos) const {
+	if (find_in(_t[0], key, h, pos)) {
+	    t = 0;
+	    return true;
+	} else if (_t[1].mem && find_in(_t[1], key, h, pos)) {
+	    t = 1;
+	    return true;
+	} else
+	    return false;
+    }
+
+    // Claim a free slot in _t[0] for hash @a h and return its index.  The
+    // caller must construct the slot.  Call prepare_insert() first.
+    size_type insert_slot(size_type h) {
+	table &t = _t[0];
+	size_type gmask = t.capacity / group_size - 1;
+	size_type g = (h >> 7) & gmask;
+	for (size_type step = 1; ; ++step) {
+	    uint8_t *ctrl = t.group(g);
+	    if (unsigned m = match_free(ctrl)) {
+		int j = ffs_lsb(m) - 1;
+		if (ctrl[j] == ctrl_deleted)
+		    --t.deleted;
+		ctrl[j] = h & 0x7F;
+		size_type i = g * group_size + j;
+		++t.size;
+		return i;
+	    }
+	    g = (g + step) & gmask;
+	}
+    }
+
+    inline void prepare_insert() {
+	if (_t[1].mem)
+	    migrate(migrate_slots);
+	table &t = _t[0];
+	if (unlikely((t.size + t.deleted + 1) * 8 > t.capacity * 7)) {
+	    if (_t[1].mem)
+		migrate(_t[1].capacity);
+	    // Double the table unless it's mostly tombstones.
+	    grow((t.size + 1) * 16 > t.capacity * 7 ? t.capacity * 2 : t.capacity);
+	}
+    }
+
+    void erase_at(int ti, size_type i) {
+	table &t = _t[ti];
+	t.slot(i).~S();
+	if (match(t.group(i / group_size), ctrl_empty))
+	    t.ctrl(i) = ctrl_empty;
+	else {
+	    t.ctrl(i) = ctrl_deleted;
+	    ++t.deleted;
+	}
+	--t.size;
+    }
+
+    // Move (ti, i) forward to the next full slot, or to (2, 0) at the end.
+    void advance(int &ti, size_type &i) const {
+	for (; ti < 2; ++ti, i = 0) {
+	    const table &t = _t[ti];
+	    if (t.mem)
+		for (; i < t.capacity; ++i)
+		    if (!(t.ctrl(i) & 0x80))
+			return;
+	}
+	i = 0;
+    }
+
+    void grow(size_type cap);
+    void migrate(size_type n);
+    void rehash(size_type n);
+    void clear();
+    void swap(FlatHash_rep<S, X> &x);
+
+    static void allocate(table &t, size_type cap);
+    static void destroy(table &t);
+
+  private:
+
+    FlatHash_rep(const FlatHash_rep<S, X> &);
+    FlatHash_rep<S, X> &operator=(const FlatHash_rep<S, X> &);
+
+};
+
+template <typename S, typename X>
+void FlatHash_rep<S, X>::allocate(table &t, size_type cap)
+{
+    t.mem = (char *) CLICK_LALLOC(cap / group_size * group_bytes);
+    t.capacity = cap;
+    for (size_type g = 0; g < cap / group_size; ++g)
+	memset(t.group(g), ctrl_empty, group_size);
+    t.size = t.deleted = 0;
+}
+
+template <typename S, typename X>
+void FlatHash_rep<S, X>::destroy(table &t)
+{
+    if (t.mem) {
+	for (size_type i = 0; t.size && i < t.capacity; ++i)
+	    if (!(t.ctrl(i) & 0x80)) {
+		t.slot(i).~S();
+		--t.size;
+	    }
+	CLICK_LFREE(t.mem, t.capacity / group_size * group_bytes);
+	t.mem = 0;
+	t.capacity = t.deleted = 0;
+    }
+}
+
+template <typename S, typename X>
+void FlatHash_rep<S, X>::grow(size_type cap)
+{
+    click_hash_assert(!_t[1].mem);
+    _t[1] = _t[0];
+    allocate(_t[0], cap);
+    _migrate_pos = 0;
+    // Small tables are cheap enough to move all at once.
+    if (_t[1].capacity <= sync_migrate_capacity)
+	migrate(_t[1].capacity);
+}
+
+template <typename S, typename X>
+void FlatHash_rep<S, X>::migrate(size_type n)
+{
+    table &o = _t[1];
+    size_type end = (o.capacity - _migrate_pos > n ? _migrate_pos + n : o.capacity);
+    for (; _migrate_pos < end && o.size; ++_migrate_pos)
+	if (!(o.ctrl(_migrate_pos) & 0x80)) {
+	    S &s = o.slot(_migrate_pos);
+	    size_type i = insert_slot(mix(hashcode(this->key(s))));
+	    new(reinterpret_cast<void *>(&_t[0].slot(i))) S(s);
+	    s.~S();
+	    o.ctrl(_migrate_pos) = ctrl_deleted;
+	    --o.size;
+	    ++o.deleted;
+	}
+    if (!o.size)
+	destroy(o);
+}
+
+template <typename S, typename X>
+void FlatHash_rep<S, X>::rehash(size_type n)
+{
+    if (_t[1].mem)
+	migrate(_t[1].capacity);
+    size_type cap = capacity_for(n);
+    if (cap > _t[0].capacity) {
+	grow(cap);
+	if (_t[1].mem)
+	    migrate(_t[1].capacity);
+    }
+}
+
+template <typename S, typename X>
+void FlatHash_rep<S, X>::clear()
+{
+    destroy(_t[1]);
+    table &t = _t[0];
+    for (size_type i = 0; t.size && i < t.capacity; ++i)
+	if (!(t.ctrl(i) & 0x80)) {
+	    t.slot(i).~S();
+	    --t.size;
+	}
+    for (size_type g = 0; g < t.capacity / group_size; ++g)
+	memset(t.group(g), ctrl_empty, group_size);
+    t.deleted = 0;
+}
+
+template <typename S, typename X>
+void FlatHash_rep<S, X>::swap(FlatHash_rep<S, X> &x)
+{
+    for (int i = 0; i < 2; ++i) {
+	table t = _t[i];
+	_t[i] = x._t[i];
+	x._t[i] = t;
+    }
+    click_swap(_migrate_pos, x._migrate_pos);
+}
+
+template <typename K, typename V>
+struct FlatHashTable_slots {
+    typedef K key_type;
+    typedef const K &key_const_reference;
+    static key_const_reference key(const Pair<const K, V> &p) {
+	return p.first;
+    }
+    static bool keyeq(const K &a, const K &b) {
+	return a == b;
+    }
+};
+
+template <typename T, typename A>
+struct FlatHashContainer_slots : public A {
+    typedef typename A::key_type key_type;
+    typedef typename A::key_const_reference key_const_reference;
+    key_const_reference key(T * const &e) const {
+	return this->hashkey(e);
+    }
+    bool keyeq(const key_type &a, const key_type &b) const {
+	return this->hashkeyeq(a, b);
+    }
+};
+/** @endcond */
+
+
+/** @class FlatHashContainer_const_iterator
+ * @brief The const_iterator type for FlatHashContainer. */
+template <typename T, typename A>
+class FlatHashContainer_const_iterator { public:
+
+    typedef typename FlatHashContainer<T, A>::size_type size_type;
+
+    /** @brief Construct an uninitialized iterator. */
+    FlatHashContainer_const_iterator() {
+    }
+
+    /** @brief Return a pointer to the element, null if *this == end(). */
+    T *get() const {
+	return _ti < 2 ? _rep->_t[_ti].slot(_i) : 0;
+    }
+
+    /** @brief Return a pointer to the element, null if *this == end(). */
+    T *operator->() const {
+	return get();
+    }
+
+    /** @brief Return a reference to the element.
+     * @pre *this != end() */
+    T &operator*() const {
+	return *get();
+    }
+
+    /** @brief Return true iff *this != end(). */
+    inline bool live() const {
+	return _ti < 2;
+    }
+
+    typedef T *(FlatHashContainer_const_iterator::*unspecified_bool_type)() const;
+    /** @brief Return true iff *this != end(). */
+    inline operator unspecified_bool_type() const {
+	return _ti < 2 ? &FlatHashContainer_const_iterator::get : 0;
+    }
+
+    /** @brief Advance this iterator to the next element. */
+    void operator++() {
+	if (_ti < 2) {
+	    ++_i;
+	    _rep->advance(_ti, _i);
+	}
+    }
+
+    /** @brief Advance this iterator to the next element. */
+    void operator++(int) {
+	++*this;
+    }
+
+  private:
+
+    typedef FlatHash_rep<T *, FlatHashContainer_slots<T, A> > rep_type;
+
+    const rep_type *_rep;
+    int _ti;
+    size_type _i;
+    size_type _hash;
+
+    inline FlatHashContainer_const_iterator(const rep_type *rep, int ti, size_type i, size_type hash = 0)
+	: _rep(rep), _ti(ti), _i(i), _hash(hash) {
+    }
+
+    friend class FlatHashContainer<T, A>;
+    template <typename TT, typename AA> friend class FlatHashContainer_iterator;
+
+};
+
+/** @class FlatHashContainer_iterator
+ * @brief The iterator type for FlatHashContainer. */
+template <typename T, typename A>
+class FlatHashContainer_iterator : public FlatHashContainer_const_iterator<T, A> { public:
+
+    typedef FlatHashContainer_const_iterator<T, A> inherited;
+
+    /** @brief Construct an uninitialized iterator. */
+    FlatHashContainer_iterator() {
+    }
+
+    /** @brief Return true iff elements can be inserted here.
+     *
+     * Every iterator returned by FlatHashContainer::find() can_insert(). */
+    bool can_insert() const {
+	return true;
+    }
+
+  private:
+
+    inline FlatHashContainer_iterator(const typename inherited::rep_type *rep, int ti, typename inherited::size_type i, typename inherited::size_type hash = 0)
+	: inherited(rep, ti, i, hash) {
+    }
+
+    friend class FlatHashContainer<T, A>;
+
+};
+
+/** @class FlatHashContainer
+  @brief Intrusive open-addressing hash table template.
+
+  FlatHashContainer stores pointers to elements in an open-addressing table,
+  and supports the parts of the HashContainer interface that make sense for
+  such a table.  It can replace HashContainer in performance-sensitive code
+  by changing a template parameter.  Elements must define the hashkey() and
+  key types HashContainer requires; the _hashnext member is not used.
+
+  Unlike HashContainer, FlatHashContainer grows itself as elements are added,
+  so unbalanced() is always false and balance() does nothing.  Growth is
+  incremental: a few elements move to the new table during each later
+  insertion.  Element pointers never change, but inserting an element
+  invalidates outstanding iterators.  The %find() and set() functions never
+  allocate except when growing.
+
+  @sa FlatHashTable, HashContainer */
+template <typename T, typename A>
+class FlatHashContainer { public:
+
+    /** @brief Key type. */
+    typedef typename A::key_type key_type;
+
+    /** @brief Value type. */
+    typedef T value_type;
+
+    /** @brief Type of sizes. */
+    typedef size_t size_type;
+
+    typedef FlatHashContainer_const_iterator<T, A> const_iterator;
+    typedef FlatHashContainer_iterator<T, A> iterator;
+
+    /** @brief Construct an empty FlatHashContainer. */
+    FlatHashContainer()
+	: _rep() {
+    }
+
+    /** @brief Construct an empty FlatHashContainer with room for @a n
+     * elements. */
+    explicit FlatHashContainer(size_type n)
+	: _rep(n) {
+    }
+
+    /** @brief Return the number of elements stored. */
+    inline size_type size() const {
+	return _rep.size();
+    }
+
+    /** @brief Return true iff size() == 0. */
+    inline bool empty() const {
+	return _rep.size() == 0;
+    }
+
+    /** @brief Return the number of slots. */
+    inline size_type bucket_count() const {
+	return _rep._t[0].capacity;
+    }
+
+    /** @brief Return false; FlatHashContainer grows itself. */
+    inline bool unbalanced() const {
+	return false;
+    }
+
+    /** @brief Do nothing; FlatHashContainer grows itself. */
+    inline void balance() {
+    }
+
+    /** @brief Return an iterator for the first element in the container. */
+    inline iterator begin() {
+	iterator it(&_rep, 0, 0);
+	_rep.advance(it._ti, it._i);
+	return it;
+    }
+    /** @overload */
+    inline const_iterator begin() const {
+	return const_cast<FlatHashContainer<T, A> *>(this)->begin();
+    }
+
+    /** @brief Return an iterator for the end of the container.
+     * @invariant end().live() == false */
+    inline iterator end() {
+	return iterator(&_rep, 2, 0);
+    }
+    /** @overload */
+    inline const_iterator end() const {
+	return const_iterator(&_rep, 2, 0);
+    }
+
+    /** @brief Return an iterator for an element with @a key, if any.
+     *
+     * If no element with @a key exists, returns an iterator that compares
+     * equal to end() but can be passed to set() to insert an element with
+     * @a key. */
+    inline iterator find(const key_type &key) {
+	size_type h = rep_type::mix(hashcode(key)), i;
+	int ti;
+	if (!_rep.find(key, h, ti, i))
+	    ti = 2, i = 0;
+	return iterator(&_rep, ti, i, h);
+    }
+    /** @overload */
+    inline const_iterator find(const key_type &key) const {
+	return const_cast<FlatHashContainer<T, A> *>(this)->find(key);
+    }
+
+    /** @brief Return an iterator for an element with @a key, if any.
+     *
+     * Equivalent to find(); provided for HashContainer compatibility. */
+    inline iterator find_prefer(const key_type &key) {
+	return find(key);
+    }
+
+    /** @brief Return an element for @a key, if any. */
+    inline T *get(const key_type &key) const {
+	size_type h = rep_type::mix(hashcode(key)), i;
+	int ti;
+	return _rep.find(key, h, ti, i) ? _rep._t[ti].slot(i) : 0;
+    }
+
+    /** @brief Replace the element at position @a it with @a element.
+     * @return the previous value of it.get()
+     * @pre @a it was returned by find(@a element->hashkey()), and no
+     * element has been inserted since
+     *
+     * Behaves like HashContainer::set().  If @a element is null, the former
+     * element is removed and @a it advances to the next element; otherwise
+     * @a it points at @a element on return. */
+    T *set(iterator &it, T *element, bool balance = false);
+
+    /** @brief Replace the element with @a element->hashkey() with @a element.
+     * @return the previous element with that key, if any */
+    inline T *set(T *element) {
+	iterator it = find(_rep.key(element));
+	return set(it, element);
+    }
+
+    /** @brief Remove the element at position @a it.
+     * @return the previous value of it.get()
+     *
+     * As a side effect, @a it is advanced to the next element. */
+    inline T *erase(iterator &it) {
+	return set(it, 0);
+    }
+
+    /** @brief Remove an element with hashkey @a key.
+     * @return the element removed, if any */
+    inline T *erase(const key_type &key) {
+	iterator it = find(key);
+	return set(it, 0);
+    }
+
+    /** @brief Remove all elements.
+     * @post size() == 0 */
+    void clear() {
+	_rep.clear();
+    }
+
+    /** @brief Swap the contents of *this and @a x. */
+    inline void swap(FlatHashContainer<T, A> &x) {
+	_rep.swap(x._rep);
+    }
+
+    /** @brief Ensure the table has room for at least @a n elements.
+     *
+     * @note Rehashing invalidates all existing iterators. */
+    void rehash(size_type n) {
+	_rep.rehash(n);
+    }
+
+  private:
+
+    typedef typename const_iterator::rep_type rep_type;
+    rep_type _rep;
+
+    FlatHashContainer(const FlatHashContainer<T, A> &);
+    FlatHashContainer<T, A> &operator=(const FlatHashContainer<T, A> &);
+
+};
+
+template <typename T, typename A>
+T *FlatHashContainer<T, A>::set(iterator &it, T *element, bool)
+{
+    T *old = it.get();
+    if (unlikely(old == element))
+	return old;
+    if (!element) {
+	_rep.erase_at(it._ti, it._i);
+	++it;
+    } else if (old)
+	_rep._t[it._ti].slot(it._i) = element;
+    else {
+	_rep.prepare_insert();
+	it._i = _rep.insert_slot(it._hash);
+	it._ti = 0;
+	_rep._t[0].slot(it._i) = element;
+    }
+    return old;
+}
+
+template <typename T, typename A>
+inline bool
+operator==(const FlatHashContainer_const_iterator<T, A> &a, const FlatHashContainer_const_iterator<T, A> &b)
+{
+    return a.get() == b.get();
+}
+
+template <typename T, typename A>
+inline bool
+operator!=(const FlatHashContainer_const_iterator<T, A> &a, const FlatHashContainer_const_iterator<T, A> &b)
+{
+    return a.get() != b.get();
+}
+
+
+/** @class FlatHashTable_const_iterator
+ * @brief The const_iterator type for FlatHashTable. */
+template <typename K, typename V>
+class FlatHashTable_const_iterator { public:
+
+    typedef Pair<const K, V> value_type;
+
+    /** @brief Construct an uninitialized iterator. */
+    FlatHashTable_const_iterator() {
+    }
+
+    /** @brief Return a pointer to the element, null if *this == end(). */
+    const value_type *get() const {
+	return _ti < 2 ? &_rep->_t[_ti].slot(_i) : 0;
+    }
+
+    /** @brief Return a pointer to the element.
+     * @pre *this != end() */
+    const value_type *operator->() const {
+	return get();
+    }
+
+    /** @brief Return a reference to the element.
+     * @pre *this != end() */
+    const value_type &operator*() const {
+	return *get();
+    }
+
+    /** @brief Return a reference to the element's key.
+     * @pre *this != end() */
+    const K &key() const {
+	return get()->first;
+    }
+
+    /** @brief Return a reference to the element's value.
+     * @pre *this != end() */
+    const V &value() const {
+	return get()->second;
+    }
+
+    /** @brief Return true iff *this != end(). */
+    bool live() const {
+	return _ti < 2;
+    }
+
+    typedef bool (FlatHashTable_const_iterator::*unspecified_bool_type)() const;
+    /** @brief Return true iff *this != end(). */
+    inline operator unspecified_bool_type() const {
+	return _ti < 2 ? &FlatHashTable_const_iterator::live : 0;
+    }
+
+    /** @brief Advance this iterator to the next element. */
+    void operator++() {
+	if (_ti < 2) {
+	    ++_i;
+	    _rep->advance(_ti, _i);
+	}
+    }
+
+    /** @brief Advance this iterator to the next element. */
+    void operator++(int) {
+	++*this;
+    }
+
+  private:
+
+    typedef FlatHash_rep<value_type, FlatHashTable_slots<K, V> > rep_type;
+
+    const rep_type *_rep;
+    int _ti;
+    size_t _i;
+
+    inline FlatHashTable_const_iterator(const rep_type *rep, int ti, size_t i)
+	: _rep(rep), _ti(ti), _i(i) {
+    }
+
+    friend class FlatHashTable<K, V>;
+    template <typename KK, typename VV> friend class FlatHashTable_iterator;
+
+};
+
+/** @class FlatHashTable_iterator
+ * @brief The iterator type for FlatHashTable. */
+template <typename K, typename V>
+class FlatHashTable_iterator : public FlatHashTable_const_iterator<K, V> { public:
+
+    typedef FlatHashTable_const_iterator<K, V> inherited;
+    typedef typename inherited::value_type value_type;
+
+    /** @brief Construct an uninitialized iterator. */
+    FlatHashTable_iterator() {
+    }
+
+    /** @brief Return a pointer to the element, null if *this == end(). */
+    value_type *get() const {
+	return const_cast<value_type *>(inherited::get());
+    }
+
+    /** @brief Return a pointer to the element.
+     * @pre *this != end() */
+    inline value_type *operator->() const {
+	return get();
+    }
+
+    /** @brief Return a reference to the element.
+     * @pre *this != end() */
+    inline value_type &operator*() const {
+	return *get();
+    }
+
+    /** @brief Return a mutable reference to the element's value.
+     * @pre *this != end() */
+    V &value() const {
+	return get()->second;
+    }
+
+  private:
+
+    inline FlatHashTable_iterator(const typename inherited::rep_type *rep, int ti, size_t i)
+	: inherited(rep, ti, i) {
+    }
+
+    friend class FlatHashTable<K, V>;
+
+};
+
+/** @class FlatHashTable
+  @brief Open-addressing hash table template.
+
+  FlatHashTable<K, V> maps keys K to values V, like HashTable<K, V>, and has
+  the same interface.  Code can switch between the two by changing a
+  template parameter or typedef.
+
+  HashTable is a chained hash table: each element is allocated separately,
+  and a lookup follows a pointer per element it examines.  FlatHashTable
+  stores elements in one flat array with a parallel array of one-byte
+  control codes, following the design of Google's "Swiss tables."  A lookup
+  compares 16 control bytes at once (with SSE2 when available) and then
+  usually examines a single element, so it typically touches two cache
+  lines.
+
+  FlatHashTable grows incrementally.  When the table fills, a table twice
+  the size is allocated, and existing elements move to it a few at a time
+  during later insertions, rather than all at once.  Very large tables
+  therefore do not cause latency spikes, and FlatHashTable has no
+  bucket-count limit.
+
+  Elements are stored by value and may be moved when the table grows.
+  Inserting an element invalidates outstanding iterators and element
+  pointers; HashTable keeps element pointers valid across insertions, so
+  code that depends on that cannot switch.  Removing an element never moves
+  other elements.
+
+  @sa HashTable, FlatHashContainer */
+template <typename K, typename V>
+class FlatHashTable { public:
+
+    /** @brief Key type. */
+    typedef K key_type;
+
+    /** @brief Const reference to key type. */
+    typedef const K &key_const_reference;
+
+    /** @brief Value type. */
+    typedef V mapped_type;
+
+    /** @brief Pair of key type and value type. */
+    typedef Pair<const K, V> value_type;
+
+    /** @brief Type of sizes. */
+    typedef size_t size_type;
+
+    typedef FlatHashTable_const_iterator<K, V> const_iterator;
+    typedef FlatHashTable_iterator<K, V> iterator;
+
+
+    /** @brief Construct an empty hash table with normal default value. */
+    FlatHashTable()
+	: _rep(), _default_value() {
+    }
+
+    /** @brief Construct an empty hash table with default value @a d. */
+    explicit FlatHashTable(const mapped_type &d)
+	: _rep(), _default_value(d) {
+    }
+
+    /** @brief Construct an empty hash table with room for @a n elements.
+     * @param d default value
+     * @param n minimum number of elements */
+    FlatHashTable(const mapped_type &d, size_type n)
+	: _rep(n), _default_value(d) {
+    }
+
+    /** @brief Construct a hash table as a copy of @a x. */
+    FlatHashTable(const FlatHashTable<K, V> &x)
+	: _rep(x.size()), _default_value(x._default_value) {
+	copy_elements(x);
+    }
+
+
+    /** @brief Return the number of elements in the hash table. */
+    inline size_type size() const {
+	return _rep.size();
+    }
+
+    /** @brief Return true iff size() == 0. */
+    inline bool empty() const {
+	return _rep.size() == 0;
+    }
+
+    /** @brief Return the number of slots in the hash table. */
+    inline size_type bucket_count() const {
+	return _rep._t[0].capacity;
+    }
+
+    /** @brief Return the hash table's default value. */
+    inline const mapped_type &default_value() const {
+	return _default_value;
+    }
+
+
+    /** @brief Return an iterator for the first element in the table.
+     *
+     * @note FlatHashTable iterators return elements in undefined order. */
+    inline iterator begin() {
+	iterator it(&_rep, 0, 0);
+	_rep.advance(it._ti, it._i);
+	return it;
+    }
+    /** @overload */
+    inline const_iterator begin() const {
+	return const_cast<FlatHashTable<K, V> *>(this)->begin();
+    }
+
+    /** @brief Return an iterator for the end of the table.
+     * @invariant end().live() == false */
+    inline iterator end() {
+	return iterator(&_rep, 2, 0);
+    }
+    /** @overload */
+    inline const_iterator end() const {
+	return const_iterator(&_rep, 2, 0);
+    }
+
+
+    /** @brief Return an iterator for the element with key @a key, if any.
+     *
+     * Returns end() if no such element exists. */
+    inline iterator find(const key_type &key) {
+	size_type i;
+	int ti;
+	if (!_rep.find(key, rep_type::mix(hashcode(key)), ti, i))
+	    ti = 2, i = 0;
+	return iterator(&_rep, ti, i);
+    }
+    /** @overload */
+    inline const_iterator find(const key_type &key) const {
+	return const_cast<FlatHashTable<K, V> *>(this)->find(key);
+    }
+
+    /** @brief Return an iterator for the element with key @a key, if any.
+     *
+     * Equivalent to find(); provided for HashTable compatibility. */
+    inline iterator find_prefer(const key_type &key) {
+	return find(key);
+    }
+
+
+    /** @brief Return the value for @a key, or default_value() if none. */
+    const mapped_type &get(const key_type &key) const {
+	if (const_iterator i = find(key))
+	    return i.value();
+	else
+	    return _default_value;
+    }
+
+    /** @brief Return a pointer to the value for @a key, or null if none. */
+    mapped_type *get_pointer(const key_type &key) {
+	if (iterator i = find(key))
+	    return &i.value();
+	else
+	    return 0;
+    }
+    /** @overload */
+    const mapped_type *get_pointer(const key_type &key) const {
+	if (const_iterator i = find(key))
+	    return &i.value();
+	else
+	    return 0;
+    }
+
+    /** @brief Return the value for @a key, or default_value() if none. */
+    const mapped_type &operator[](const key_type &key) const {
+	return get(key);
+    }
+
+    /** @brief Return a reference to the value for @a key.
+     *
+     * If no element for @a key exists, adds a new element with
+     * default_value() and returns a reference to that value.
+     *
+     * @note Inserting an element invalidates all existing iterators. */
+    inline mapped_type &operator[](const key_type &key) {
+	return find_insert(key, _default_value).value();
+    }
+
+
+    /** @brief Ensure an element with key @a key and return its iterator.
+     *
+     * If no element with @a key exists, adds one with value
+     * default_value().
+     *
+     * @note Inserting an element invalidates all existing iterators. */
+    inline iterator find_insert(const key_type &key) {
+	return find_insert(key, _default_value);
+    }
+
+    /** @brief Ensure an element for key @a key and return its iterator.
+     *
+     * If no element with @a key exists, adds one with value @a value.
+     *
+     * @note Inserting an element invalidates all existing iterators. */
+    iterator find_insert(const key_type &key, const mapped_type &value);
+
+
+    /** @brief Set the mapping for @a key to @a value.
+     * @return true if a new element was added, false if an existing
+     * element's value was assigned
+     *
+     * @note Inserting an element invalidates all existing iterators. */
+    bool set(const key_type &key, const mapped_type &value);
+
+    /** @brief Remove the element indicated by @a it.
+     * @return An iterator pointing at the next element remaining, or
+     * end() if no such element exists. */
+    iterator erase(const iterator &it) {
+	iterator next(it);
+	if (next._ti < 2) {
+	    _rep.erase_at(next._ti, next._i);
+	    ++next;
+	}
+	return next;
+    }
+
+    /** @brief Remove any element with @a key.
+     *
+     * Returns the number of elements removed, which is always 0 or 1. */
+    size_type erase(const key_type &key) {
+	iterator it = find(key);
+	if (it._ti < 2) {
+	    _rep.erase_at(it._ti, it._i);
+	    return 1;
+	} else
+	    return 0;
+    }
+
+    /** @brief Remove all elements.
+     * @post size() == 0 */
+    void clear() {
+	_rep.clear();
+    }
+
+
+    /** @brief Swap the contents of this hash table and @a x. */
+    void swap(FlatHashTable<K, V> &x) {
+	_rep.swap(x._rep);
+	click_swap(x._default_value, _default_value);
+    }
+
+    /** @brief Ensure the table has room for at least @a n elements.
+     *
+     * All existing iterators are invalidated. */
+    void rehash(size_type n) {
+	_rep.rehash(n);
+    }
+
+
+    /** @brief Assign this hash table's contents to a copy of @a x. */
+    FlatHashTable<K, V> &operator=(const FlatHashTable<K, V> &x) {
+	if (&x != this) {
+	    clear();
+	    _rep.rehash(x.size());
+	    copy_elements(x);
+	    _default_value = x._default_value;
+	}
+	return *this;
+    }
+
+  private:
+
+    typedef typename const_iterator::rep_type rep_type;
+
+    rep_type _rep;
+    V _default_value;
+
+    void copy_elements(const FlatHashTable<K, V> &x) {
+	for (const_iterator it = x.begin(); it; ++it)
+	    find_insert(it.key(), it.value());
+    }
+
+};
+
+template <typename K, typename V>
+typename FlatHashTable<K, V>::iterator
+FlatHashTable<K, V>::find_insert(const key_type &key, const mapped_type &value)
+{
+    size_type h = rep_type::mix(hashcode(key)), i;
+    int ti;
+    if (!_rep.find(key, h, ti, i)) {
+	_rep.prepare_insert();
+	i = _rep.insert_slot(h);
+	ti = 0;
+	new(reinterpret_cast<void *>(&_rep._t[0].slot(i))) value_type(key, value);
+    }
+    return iterator(&_rep, ti, i);
+}
+
+template <typename K, typename V>
+bool FlatHashTable<K, V>::set(const key_type &key, const mapped_type &value)
+{
+    size_type h = rep_type::mix(hashcode(key)), i;
+    int ti;
+    if (_rep.find(key, h, ti, i)) {
+	_rep._t[ti].slot(i).second = value;
+	return false;
+    }
+    _rep.prepare_insert();
+    i = _rep.insert_slot(h);
+    new(reinterpret_cast<void *>(&_rep._t[0].slot(i))) value_type(key, value);
+    return true;
+}
+
+/** @brief Compare two FlatHashTable iterators for equality. */
+template <typename K, typename V>
+inline bool operator==(const FlatHashTable_const_iterator<K, V> &a, const FlatHashTable_const_iterator<K, V> &b)
+{
+    return a.get() == b.get();
+}
+
+/** @brief Compare two FlatHashTable iterators for inequality. */
+template <typename K, typename V>
+inline bool operator!=(const FlatHashTable_const_iterator<K, V> &a, const FlatHashTable_const_iterator<K, V> &b)
+{
+    return a.get() != b.get();
+}
+
+template <typename K, typename V>
+inline void click_swap(FlatHashTable<K, V> &a, FlatHashTable<K, V> &b)
+{
+    a.swap(b);
+}
+
+template <typename K, typename V>
+inline void assign_consume(FlatHashTable<K, V> &a, FlatHashTable<K, V> &b)
+{
+    a.swap(b);
+}
+
+template <typename K, typename V>
+inline void clear_by_swap(FlatHashTable<K, V> &x)
+{
+    FlatHashTable<K, V> tmp(x.default_value());
+    x.swap(tmp);
+}
+
+CLICK_ENDDECLS
+#endif
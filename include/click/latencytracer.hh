@@ -0,0 +1,144 @@
+// -*- c-basic-offset: 4; related-file-name: "../../lib/latencytracer.cc" -*-
+#ifndef CLICK_LATENCYTRACER_HH
+#define CLICK_LATENCYTRACER_HH
+#include <click/glue.hh>
+#if CLICK_USERLEVEL && !defined(CLICK_LATENCY_TRACE)
+# define CLICK_LATENCY_TRACE 1
+#endif
+#if CLICK_LATENCY_TRACE
+# include <click/vector.hh>
+# include <click/hashtable.hh>
+# include <click/atomic.hh>
+# include <click/sync.hh>
+# include <click/packet.hh>
+CLICK_DECLS
+class Element;
+class Router;
+class StringAccum;
+
+/** @brief A log-linear latency histogram.
+ *
+ * Values below 2^SUB_BITS are counted exactly.  Larger values share a bucket
+ * with values that agree in their SUB_BITS most significant bits, so every
+ * bucket's width is within 1/2^SUB_BITS of its values. */
+class LatencyHistogram { public:
+
+    enum { SUB_BITS = 4, SUB = 1 << SUB_BITS, MAX_BITS = 48,
+	   NBUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB };
+
+    LatencyHistogram() {
+	clear();
+    }
+
+    void clear();
+    void add(uint64_t v);
+
+    uint64_t count() const		{ return _count; }
+    uint64_t min() const		{ return _count ? _min : 0; }
+    uint64_t max() const		{ return _max; }
+    uint64_t sum() const		{ return _sum; }
+    uint64_t percentile(double pct) const;
+
+  private:
+
+    uint64_t _count;
+    uint64_t _sum;
+    uint64_t _min;
+    uint64_t _max;
+    uint32_t _bucket[NBUCKETS];
+
+    static inline int bucket(uint64_t v);
+    static inline uint64_t bucket_high(int b);
+
+};
+
+/** @brief Per-router store of sampled packet latency traces. */
+class LatencyTracer { public:
+
+    enum { MAX_HOPS = 16 };
+
+    struct Hop {
+	int eindex;
+	click_cycles_t cycles;
+    };
+    struct Trace {
+	uint32_t id;
+	int nhops;
+	Timestamp start;
+	Hop hops[MAX_HOPS];
+    };
+
+    LatencyTracer(Router *router, int anno, int ntraces);
+    ~LatencyTracer();
+
+    int anno() const			{ return _anno; }
+    int ntraces() const			{ return _traces.size(); }
+    uint32_t nstarted() const		{ return _id.value(); }
+
+    inline bool traced(const Packet *p) const;
+    void begin(Element *e, Packet *p);
+
+    static inline bool active();
+    static inline void hop(Element *e, Packet *p);
+
+    double cycles_per_usec() const;
+    void reset();
+
+    void unparse_hops(StringAccum &sa) const;
+    void unparse_traces(StringAccum &sa) const;
+
+  private:
+
+    Router *_router;
+    int _anno;
+    Vector<Trace> _traces;
+    atomic_uint32_t _id;
+
+    // _lock protects the hop histograms and the trace slots, which
+    // packets on several threads may share
+    HashTable<uint64_t, int> _pair_map;
+    Vector<LatencyHistogram *> _pair_hist;
+    mutable SimpleSpinlock _lock;
+
+    click_cycles_t _epoch_cycles;
+    Timestamp _epoch;
+
+    static uint32_t nactive;
+
+    static void record_hop(Element *e, Packet *p);
+    void record(int from, int to, click_cycles_t delta);
+
+    LatencyTracer(const LatencyTracer &);
+    LatencyTracer &operator=(const LatencyTracer &);
+
+};
+
+/** @brief Return true iff some router is tracing packets. */
+inline bool
+LatencyTracer::active()
+{
+    return nactive != 0;
+}
+
+/** @brief Return true iff packet @a p carries a live trace. */
+inline bool
+LatencyTracer::traced(const Packet *p) const
+{
+    uint32_t id = p->anno_u32(_anno);
+    return id && _traces[id & (_traces.size() - 1)].id == id;
+}
+
+/** @brief Note that packet @a p has arrived at element @a e.
+ *
+ * Element::Port::push() and Element::Port::pull() call this for every
+ * transfer.  If @a p carries a live trace, records a hop. */
+inline void
+LatencyTracer::hop(Element *e, Packet *p)
+{
+    if (unlikely(active()))
+	record_hop(e, p);
+}
+
+CLICK_ENDDECLS
+#endif
+#endif
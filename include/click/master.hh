@@ -147,6 +147,29 @@ RouterThread::run_signals()
 	_master->process_signals(this);
 }
 
+/** @brief Decide how long the SelectSet may block.
+ * @param[out] t the delay, set if the return value is positive
+ * @return 0 to poll, 1 to block for at most @a t, -1 to block indefinitely
+ *
+ * Like TimerSet::next_timer_delay(), except that a thread sleeping off an
+ * idle period may block for up to its current sleep bound even though tasks
+ * are scheduled. */
+inline int
+RouterThread::next_select_delay(Timestamp &t) const
+{
+    bool more_tasks = active();
+    if (more_tasks && idle_sleeping()) {
+	int delay_type = _timers.next_timer_delay(false, t);
+	Timestamp bound = Timestamp::make_usec(_idle_sleep_usec);
+	if (delay_type < 0 || (delay_type > 0 && t > bound)) {
+	    t = bound;
+	    delay_type = 1;
+	}
+	return delay_type;
+    }
+    return _timers.next_timer_delay(more_tasks, t);
+}
+
 inline int
 TimerSet::next_timer_delay(bool more_tasks, Timestamp &t) const
 {
@@ -0,0 +1,103 @@
+// -*- c-basic-offset: 4; related-file-name: "../../lib/numa.cc" -*-
+#ifndef CLICK_NUMA_HH
+#define CLICK_NUMA_HH
+#include <click/glue.hh>
+#if CLICK_USERLEVEL && defined(__linux__) && !defined(CLICK_NUMA) && (!HAVE_MULTITHREAD || HAVE___THREAD_STORAGE_CLASS)
+# define CLICK_NUMA 1
+#endif
+CLICK_DECLS
+class StringAccum;
+
+/** @brief NUMA topology, thread binding, and node-local allocation.
+ *
+ * Without NUMA support, the machine looks like a single node 0, and
+ * allocate() and deallocate() are equivalent to CLICK_LALLOC() and
+ * CLICK_LFREE(). */
+class Numa { public:
+
+    enum { MAX_NODES = 16 };
+
+    static int nnodes();
+    static inline int current_node();
+    static int cpu_node(int cpu);
+
+    static int bind_current_thread(int node);
+    static int bind_current_cpu(int cpu);
+
+    static inline void *allocate(size_t size, int node);
+    static inline void deallocate(void *p, size_t size, int node);
+
+    static void unparse_stats(StringAccum &sa);
+
+#if CLICK_NUMA
+    /** @brief Node statistics, for unparse_stats(). */
+    struct Stats {
+	size_t allocated;	///< bytes allocated with allocate()
+	uint32_t pool_buffers;	///< packet data buffers in the global pool
+	uint32_t threads;	///< router threads bound to this node
+    };
+    static Stats stats[MAX_NODES];
+
+  private:
+
+    static int _nnodes;
+    static __thread int _current_node;
+
+    static int lookup_current_node();
+    static void *node_allocate(size_t size, int node);
+    static void node_deallocate(void *p, size_t size, int node);
+#endif
+
+};
+
+/** @brief Return the node of the CPU running the calling thread.
+ *
+ * The result is cached per thread, so a thread that is not bound to a node
+ * with bind_current_thread() may get a stale answer after it migrates. */
+inline int
+Numa::current_node()
+{
+#if CLICK_NUMA
+    int n = _current_node;
+    return n >= 0 ? n : lookup_current_node();
+#else
+    return 0;
+#endif
+}
+
+/** @brief Allocate @a size bytes of memory on NUMA node @a node.
+ * @param size number of bytes
+ * @param node node number, or -1 for no preference
+ *
+ * Free the result with deallocate(), passing the same @a size and @a node.
+ * Memory is placed on @a node if possible, and elsewhere otherwise.  Returns
+ * null on failure. */
+inline void *
+Numa::allocate(size_t size, int node)
+{
+#if CLICK_NUMA
+    if (node >= 0)
+	return node_allocate(size, node);
+#else
+    (void) node;
+#endif
+    return CLICK_LALLOC(size);
+}
+
+/** @brief Free memory returned by allocate(@a size, @a node). */
+inline void
+Numa::deallocate(void *p, size_t size, int node)
+{
+#if CLICK_NUMA
+    if (node >= 0) {
+	node_deallocate(p, size, node);
+	return;
+    }
+#else
+    (void) node;
+#endif
+    CLICK_LFREE(p, size);
+}
+
+CLICK_ENDDECLS
+#endif
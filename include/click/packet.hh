@@ -67,6 +67,18 @@ class Packet { public:
     inline bool shared() const;
     Packet *clone() CLICK_WARN_UNUSED_RESULT;
     inline WritablePacket *uniqueify() CLICK_WARN_UNUSED_RESULT;
+    inline WritablePacket *uniqueify_header(uint32_t len) CLICK_WARN_UNUSED_RESULT;
+    inline bool copy_pending() const;
+    inline void finish_copy() const;
+
+    /** @brief A contiguous run of packet data.
+     * @sa segments() */
+    struct Segment {
+	const unsigned char *data;
+	uint32_t length;
+    };
+    int segments(Segment *seg, int nseg) const;
+    bool append_shared(Packet *p, uint32_t offset, uint32_t len);
 
     inline const unsigned char *data() const;
     inline const unsigned char *end_data() const;
@@ -87,12 +99,12 @@ class Packet { public:
     struct mbuf *dup_jumbo_m(struct mbuf *mbuf);
 #elif CLICK_USERLEVEL
     buffer_destructor_type buffer_destructor() const {
-	return _destructor;
+	return _cold & COLD_DESTRUCTOR ? _destructor : 0;
     }
     void reset_buffer() {
 	assert(!shared());
 	_head = _data = _tail = _end = 0;
-	_destructor = 0;
+	_cold &= ~COLD_DESTRUCTOR;
     }
 #endif
 
@@ -134,6 +146,18 @@ class Packet { public:
      * @sa push */
     WritablePacket *push_mac_header(uint32_t len) CLICK_WARN_UNUSED_RESULT;
 
+    /** @brief Add space for a header before the packet, copying only headers.
+     * @param len amount of space to add
+     * @return packet with added header space, or null on failure
+     *
+     * This is a variant of push() for elements that write only the new
+     * header.  Like uniqueify_header(), it may leave the rest of a shared
+     * packet's data shared until it is read, so through the returned
+     * WritablePacket, only the @a len new bytes are valid.
+     *
+     * @sa push, uniqueify_header */
+    inline WritablePacket *push_header(uint32_t len) CLICK_WARN_UNUSED_RESULT;
+
     /** @brief Add space for a header before the packet.
      * @param len amount of space to add
      * @return packet with added header space, or null on failure
@@ -665,6 +689,19 @@ class Packet { public:
     inline void set_user_anno_i(int, int32_t) CLICK_DEPRECATED;
     inline uint32_t user_anno_u(int) const CLICK_DEPRECATED;
     inline void set_user_anno_u(int, uint32_t) CLICK_DEPRECATED;
+#if CLICK_USERLEVEL || CLICK_NS
+    // Align packets to cache lines so the hot members share as few lines
+    // as possible.
+    static void *operator new(size_t size) throw() {
+	void *p;
+	if (posix_memalign(&p, CLICK_CACHE_LINE_SIZE, size) != 0)
+	    return 0;
+	return p;
+    }
+    static void operator delete(void *p) {
+	free(p);
+    }
+#endif
     /** @endcond never */
 
   private:
@@ -683,43 +720,63 @@ class Packet { public:
     };
 
 #if !CLICK_LINUXMODULE
-    // All packet annotations are stored in AllAnno so that
-    // clear_annotations(true) can memset() the structure to zero.
+    // Frequently used annotations are stored in AllAnno, which fills the
+    // rest of the packet's first two cache lines, so that
+    // clear_annotations(true) can memset() the structure to zero.  Rarely
+    // used annotations are stored in ColdAnno, which is valid only when
+    // _cold has COLD_ANNO set; otherwise they read as zero (and HOST).
+    // Writing a cold annotation initializes ColdAnno first.
     struct AllAnno {
-	Anno cb;
-	unsigned char *mac;
 	unsigned char *nh;
 	unsigned char *h;
-	PacketType pkt_type;
-	Timestamp timestamp;
+	Anno cb;
 	Packet *next;
+	unsigned char *mac;
+    };
+    struct ColdAnno {
 	Packet *prev;
-	AllAnno()
+	PacketType pkt_type;
+	Timestamp timestamp;
+	ColdAnno()
 	    : timestamp(Timestamp::uninitialized_t()) {
 	}
     };
+    enum { COLD_ANNO = 1, COLD_DESTRUCTOR = 2, COLD_COPY = 4 };
 #endif
     /** @endcond never */
 
 #if !CLICK_LINUXMODULE
-    // User-space and BSD kernel module implementations.
+    // User-space and BSD kernel module implementations.  Members used on
+    // every packet come first; members after _ca are touched only by
+    // packets that need them.
     atomic_uint32_t _use_count;
+# if HAVE_CLICK_PACKET_POOL && HAVE_MULTITHREAD
+    int16_t _data_node;	/* NUMA node of a poolable buffer, or -1 */
+# endif
+    uint8_t _cold;	/* which cold members are valid: COLD_ANNO etc. */
     Packet *_data_packet;
     /* mimic Linux sk_buff */
     unsigned char *_head; /* start of allocated buffer */
     unsigned char *_data; /* where the packet starts */
     unsigned char *_tail; /* one beyond end of packet */
     unsigned char *_end;  /* one beyond end of allocated buffer */
+    AllAnno _aa;
+    ColdAnno _ca;
 # if CLICK_USERLEVEL
-    buffer_destructor_type _destructor;
+    buffer_destructor_type _destructor;	/* valid if COLD_DESTRUCTOR */
+    // Valid if COLD_COPY: data bytes [_copy_dst, _tail) have not yet been
+    // copied.  They are the data of a chain of segment packets, starting at
+    // _copy_packet and linked by next(), that share other packets' buffers.
+    Packet *_copy_packet;
+    unsigned char *_copy_dst;
 # endif
 # if CLICK_BSDMODULE
     struct mbuf *_m;
 # endif
-    AllAnno _aa;
 # if CLICK_NS
     SimPacketinfoWrapper _sim_packetinfo;
 # endif
+    static const Timestamp zero_timestamp;
 #endif
 
     inline Packet() {
@@ -732,6 +789,7 @@ class Packet { public:
     Packet &operator=(const Packet &x);
 
 #if !CLICK_LINUXMODULE
+    inline ColdAnno &cold_anno();
     bool alloc_data(uint32_t headroom, uint32_t length, uint32_t tailroom);
 #endif
 #if CLICK_BSDMODULE
@@ -741,10 +799,20 @@ class Packet { public:
 
     inline void shift_header_annotations(const unsigned char *old_head, int32_t extra_headroom);
     WritablePacket *expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom, bool free_on_failure);
+#if CLICK_USERLEVEL
+    WritablePacket *expensive_uniqueify_header(uint32_t len, uint32_t push_len);
+    void expensive_finish_copy();
+    static Packet *make_segment(Packet *owner, const unsigned char *data, uint32_t len);
+    static void kill_segments(Packet *seg);
+    template <typename F> void each_segment(F &f) const;
+    struct SegmentAppender;
+    friend struct SegmentAppender;
+#endif
     WritablePacket *expensive_push(uint32_t nbytes);
     WritablePacket *expensive_put(uint32_t nbytes);
 
     friend class WritablePacket;
+    friend class PacketPoolBench;
 
 };
 
@@ -820,7 +888,11 @@ Packet::clear_annotations(bool all)
 	set_prev(0);
     }
 #else
-    memset(&_aa, 0, all ? sizeof(AllAnno) : sizeof(Anno));
+    if (all) {
+	memset(&_aa, 0, sizeof(AllAnno));
+	_cold &= ~COLD_ANNO;
+    } else
+	memset(&_aa.cb, 0, sizeof(Anno));
 #endif
 }
 
@@ -847,11 +919,13 @@ inline void
 WritablePacket::initialize()
 {
     _use_count = 1;
+    _cold = 0;
     _data_packet = 0;
-# if CLICK_USERLEVEL
-    _destructor = 0;
-# elif CLICK_BSDMODULE
+# if CLICK_BSDMODULE
     _m = 0;
+# endif
+# if HAVE_CLICK_PACKET_POOL && HAVE_MULTITHREAD
+    _data_node = -1;
 # endif
     clear_annotations();
 }
@@ -866,6 +940,7 @@ Packet::data() const
 #if CLICK_LINUXMODULE
     return skb()->data;
 #else
+    finish_copy();
     return _data;
 #endif
 }
@@ -884,6 +959,7 @@ Packet::end_data() const
     return skb()->tail;
 # endif
 #else
+    finish_copy();
     return _tail;
 #endif
 }
@@ -939,7 +1015,11 @@ Packet::length() const
 inline uint32_t
 Packet::headroom() const
 {
+#if CLICK_LINUXMODULE
     return data() - buffer();
+#else
+    return _data - _head;
+#endif
 }
 
 /** @brief Return the packet's tailroom.
@@ -950,7 +1030,11 @@ Packet::headroom() const
 inline uint32_t
 Packet::tailroom() const
 {
+#if CLICK_LINUXMODULE
     return end_buffer() - end_data();
+#else
+    return _end - _tail;
+#endif
 }
 
 /** @brief Return the packet's buffer length.
@@ -992,13 +1076,29 @@ Packet::set_next(Packet *p)
 #endif
 }
 
+#if !CLICK_LINUXMODULE
+/** @cond never */
+inline Packet::ColdAnno &
+Packet::cold_anno()
+{
+    if (!(_cold & COLD_ANNO)) {
+	_ca.prev = 0;
+	_ca.pkt_type = HOST;
+	_ca.timestamp = Timestamp();
+	_cold |= COLD_ANNO;
+    }
+    return _ca;
+}
+/** @endcond never */
+#endif
+
 inline Packet *
 Packet::prev() const
 {
 #if CLICK_LINUXMODULE
     return (Packet *)(skb()->prev);
 #else
-    return _aa.prev;
+    return _cold & COLD_ANNO ? _ca.prev : 0;
 #endif
 }
 
@@ -1008,7 +1108,7 @@ Packet::prev()
 #if CLICK_LINUXMODULE
     return (Packet *&)(skb()->prev);
 #else
-    return _aa.prev;
+    return cold_anno().prev;
 #endif
 }
 
@@ -1018,7 +1118,8 @@ Packet::set_prev(Packet *p)
 #if CLICK_LINUXMODULE
     skb()->prev = p->skb();
 #else
-    _aa.prev = p;
+    if (p || (_cold & COLD_ANNO))
+	cold_anno().prev = p;
 #endif
 }
 
@@ -1052,6 +1153,7 @@ Packet::mac_header() const
     return skb()->mac.raw;
 # endif
 #else
+    finish_copy();
     return _aa.mac;
 #endif
 }
@@ -1090,6 +1192,7 @@ Packet::network_header() const
     return skb()->nh.raw;
 # endif
 #else
+    finish_copy();
     return _aa.nh;
 #endif
 }
@@ -1128,6 +1231,7 @@ Packet::transport_header() const
     return skb()->h.raw;
 # endif
 #else
+    finish_copy();
     return _aa.h;
 #endif
 }
@@ -1198,7 +1302,11 @@ Packet::udp_header() const
 inline int
 Packet::mac_length() const
 {
+#if CLICK_LINUXMODULE
     return end_data() - mac_header();
+#else
+    return _tail - _aa.mac;
+#endif
 }
 
 /** @brief Return the packet's length starting from its network header pointer.
@@ -1207,7 +1315,11 @@ Packet::mac_length() const
 inline int
 Packet::network_length() const
 {
+#if CLICK_LINUXMODULE
     return end_data() - network_header();
+#else
+    return _tail - _aa.nh;
+#endif
 }
 
 /** @brief Return the packet's length starting from its transport header pointer.
@@ -1216,7 +1328,11 @@ Packet::network_length() const
 inline int
 Packet::transport_length() const
 {
+#if CLICK_LINUXMODULE
     return end_data() - transport_header();
+#else
+    return _tail - _aa.h;
+#endif
 }
 
 inline const Timestamp &
@@ -1229,7 +1345,7 @@ Packet::timestamp_anno() const
     return *reinterpret_cast<const Timestamp *>(&skb()->tstamp);
 # endif
 #else
-    return _aa.timestamp;
+    return _cold & COLD_ANNO ? _ca.timestamp : zero_timestamp;
 #endif
 }
 
@@ -1243,13 +1359,17 @@ Packet::timestamp_anno()
     return *reinterpret_cast<Timestamp *>(&skb()->tstamp);
 # endif
 #else
-    return _aa.timestamp;
+    return cold_anno().timestamp;
 #endif
 }
 
 inline void
 Packet::set_timestamp_anno(const Timestamp &timestamp)
 {
+#if !CLICK_LINUXMODULE
+    if (!timestamp && !(_cold & COLD_ANNO))
+	return;
+#endif
     timestamp_anno() = timestamp;
 }
 
@@ -1289,7 +1409,7 @@ Packet::packet_type_anno() const
 #elif CLICK_LINUXMODULE
     return (PacketType)(skb()->pkt_type);
 #else
-    return _aa.pkt_type;
+    return _cold & COLD_ANNO ? _ca.pkt_type : HOST;
 #endif
 }
 
@@ -1301,7 +1421,8 @@ Packet::set_packet_type_anno(PacketType p)
 #elif CLICK_LINUXMODULE
     skb()->pkt_type = p;
 #else
-    _aa.pkt_type = p;
+    if (p != HOST || (_cold & COLD_ANNO))
+	cold_anno().pkt_type = p;
 #endif
 }
 
@@ -1522,15 +1643,89 @@ Packet::shared() const
 inline WritablePacket *
 Packet::uniqueify()
 {
+    finish_copy();
     if (!shared())
 	return static_cast<WritablePacket *>(this);
     else
 	return expensive_uniqueify(0, 0, true);
 }
 
+/** @brief Return a packet whose headers are unshared.
+ * @param len number of data bytes the caller will write
+ * @return the packet, or null on failure
+ *
+ * Like uniqueify(), but only the headroom and the first @a len bytes of data
+ * are guaranteed to be unshared.  If the packet is shared and much longer
+ * than @a len, uniqueify_header() copies just those bytes, and leaves the
+ * rest of the data shared until something reads it; copy_pending() is then
+ * true.  This makes header rewriting elements cheap on packets produced by
+ * clone(), for instance by Tee.
+ *
+ * Through the returned WritablePacket, only the headroom and the first @a
+ * len bytes of data are valid while copy_pending() is true.  The Packet
+ * accessors, such as Packet::data() and Packet::ip_header(), as well as
+ * uniqueify(), push() and put(), call finish_copy() first, so any element
+ * that reads the data sees all of it.  Only elements that access nothing
+ * beyond the header should use this function:
+ * @code
+ * WritablePacket *q = p->uniqueify_header(p->network_header_offset() + sizeof(click_ip));
+ * if (!q)
+ *     return 0;
+ * q->ip_header()->ip_ttl = 1;   // OK: within the unshared bytes
+ * @endcode
+ *
+ * @sa uniqueify, push_header, finish_copy */
+inline WritablePacket *
+Packet::uniqueify_header(uint32_t len)
+{
+#if CLICK_USERLEVEL
+    if (!shared() && (!copy_pending() || _data + len <= _copy_dst))
+	return static_cast<WritablePacket *>(this);
+    else
+	return expensive_uniqueify_header(len, 0);
+#else
+    (void) len;
+    return uniqueify();
+#endif
+}
+
+/** @brief Test whether part of this packet's data has not yet been copied.
+ *
+ * Returns true iff uniqueify_header(), push_header() or append_shared() left
+ * some of this packet's data in other packets' buffers.  The data is copied
+ * by finish_copy(), which every Packet data accessor calls first.  Code that
+ * can handle the data in pieces, such as a writev() call, can avoid the copy
+ * with segments().
+ * @sa uniqueify_header, segments */
+inline bool
+Packet::copy_pending() const
+{
+#if CLICK_USERLEVEL
+    return _cold & COLD_COPY;
+#else
+    return false;
+#endif
+}
+
+/** @brief Finish copying this packet's data.
+ *
+ * If copy_pending() is true, copy the rest of the data into this packet's
+ * buffer, after which it is no longer shared.  Data and header pointers do
+ * not change.
+ * @sa uniqueify_header */
+inline void
+Packet::finish_copy() const
+{
+#if CLICK_USERLEVEL
+    if (unlikely(_cold & COLD_COPY))
+	const_cast<Packet *>(this)->expensive_finish_copy();
+#endif
+}
+
 inline WritablePacket *
 Packet::push(uint32_t len)
 {
+    finish_copy();
     if (headroom() >= len && !shared()) {
 	WritablePacket *q = (WritablePacket *)this;
 #if CLICK_LINUXMODULE	/* Linux kernel module */
@@ -1589,6 +1784,7 @@ Packet::pull(uint32_t len)
 inline WritablePacket *
 Packet::put(uint32_t len)
 {
+    finish_copy();
     if (tailroom() >= len && !shared()) {
 	WritablePacket *q = (WritablePacket *)this;
 #if CLICK_LINUXMODULE	/* Linux kernel module */
@@ -1608,6 +1804,7 @@ Packet::put(uint32_t len)
 inline Packet *
 Packet::nonunique_put(uint32_t len)
 {
+    finish_copy();
     if (tailroom() >= len) {
 #if CLICK_LINUXMODULE	/* Linux kernel module */
 	__skb_put(skb(), len);
@@ -1699,6 +1896,7 @@ Packet::shrink_data(const unsigned char *data, uint32_t length)
 inline void
 Packet::change_headroom_and_length(uint32_t headroom, uint32_t length)
 {
+    finish_copy();
     if (headroom + length <= buffer_length()) {
 	_data = _head + headroom;
 	_tail = _data + length;
@@ -1791,6 +1989,7 @@ inline WritablePacket *
 Packet::push_mac_header(uint32_t len)
 {
     WritablePacket *q;
+    finish_copy();
     if (headroom() >= len && !shared()) {
 	q = (WritablePacket *)this;
 #if CLICK_LINUXMODULE	/* Linux kernel module */
@@ -1811,6 +2010,20 @@ Packet::push_mac_header(uint32_t len)
     return q;
 }
 
+inline WritablePacket *
+Packet::push_header(uint32_t len)
+{
+#if CLICK_USERLEVEL
+    if (headroom() >= len && !shared()) {
+	_data -= len;
+	return static_cast<WritablePacket *>(this);
+    } else
+	return expensive_uniqueify_header(0, len);
+#else
+    return push(len);
+#endif
+}
+
 /** @brief Set the network and transport header pointers.
  * @param p new network header pointer
  * @param len new network header length
@@ -1914,7 +2127,11 @@ Packet::clear_network_header()
 inline int
 Packet::mac_header_offset() const
 {
+#if CLICK_LINUXMODULE
     return mac_header() - data();
+#else
+    return _aa.mac - _data;
+#endif
 }
 
 /** @brief Return the MAC header length.
@@ -1926,7 +2143,11 @@ Packet::mac_header_offset() const
 inline uint32_t
 Packet::mac_header_length() const
 {
+#if CLICK_LINUXMODULE
     return network_header() - mac_header();
+#else
+    return _aa.nh - _aa.mac;
+#endif
 }
 
 /** @brief Return the offset from the packet data to the network header.
@@ -1935,7 +2156,11 @@ Packet::mac_header_length() const
 inline int
 Packet::network_header_offset() const
 {
+#if CLICK_LINUXMODULE
     return network_header() - data();
+#else
+    return _aa.nh - _data;
+#endif
 }
 
 /** @brief Return the network header length.
@@ -1947,7 +2172,11 @@ Packet::network_header_offset() const
 inline uint32_t
 Packet::network_header_length() const
 {
+#if CLICK_LINUXMODULE
     return transport_header() - network_header();
+#else
+    return _aa.h - _aa.nh;
+#endif
 }
 
 /** @brief Return the offset from the packet data to the IP header.
@@ -2002,7 +2231,11 @@ Packet::ip6_header_length() const
 inline int
 Packet::transport_header_offset() const
 {
+#if CLICK_LINUXMODULE
     return transport_header() - data();
+#else
+    return _aa.h - _data;
+#endif
 }
 
 /** @brief Unset the transport header pointer.
@@ -2306,79 +2539,107 @@ inline void Packet::set_user_anno_i(int i, int32_t v) {
 inline unsigned char *
 WritablePacket::data() const
 {
+#if CLICK_LINUXMODULE
     return const_cast<unsigned char *>(Packet::data());
+#else
+    return _data;
+#endif
 }
 
 inline unsigned char *
 WritablePacket::end_data() const
 {
+#if CLICK_LINUXMODULE
     return const_cast<unsigned char *>(Packet::end_data());
+#else
+    return _tail;
+#endif
 }
 
 inline unsigned char *
 WritablePacket::buffer() const
 {
+#if CLICK_LINUXMODULE
     return const_cast<unsigned char *>(Packet::buffer());
+#else
+    return _head;
+#endif
 }
 
 inline unsigned char *
 WritablePacket::end_buffer() const
 {
+#if CLICK_LINUXMODULE
     return const_cast<unsigned char *>(Packet::end_buffer());
+#else
+    return _end;
+#endif
 }
 
 inline unsigned char *
 WritablePacket::mac_header() const
 {
+#if CLICK_LINUXMODULE
     return const_cast<unsigned char *>(Packet::mac_header());
+#else
+    return _aa.mac;
+#endif
 }
 
 inline unsigned char *
 WritablePacket::network_header() const
 {
+#if CLICK_LINUXMODULE
     return const_cast<unsigned char *>(Packet::network_header());
+#else
+    return _aa.nh;
+#endif
 }
 
 inline unsigned char *
 WritablePacket::transport_header() const
 {
+#if CLICK_LINUXMODULE
     return const_cast<unsigned char *>(Packet::transport_header());
+#else
+    return _aa.h;
+#endif
 }
 
 inline click_ether *
 WritablePacket::ether_header() const
 {
-    return const_cast<click_ether *>(Packet::ether_header());
+    return reinterpret_cast<click_ether *>(mac_header());
 }
 
 inline click_ip *
 WritablePacket::ip_header() const
 {
-    return const_cast<click_ip *>(Packet::ip_header());
+    return reinterpret_cast<click_ip *>(network_header());
 }
 
 inline click_ip6 *
 WritablePacket::ip6_header() const
 {
-    return const_cast<click_ip6 *>(Packet::ip6_header());
+    return reinterpret_cast<click_ip6 *>(network_header());
 }
 
 inline click_icmp *
 WritablePacket::icmp_header() const
 {
-    return const_cast<click_icmp *>(Packet::icmp_header());
+    return reinterpret_cast<click_icmp *>(transport_header());
 }
 
 inline click_tcp *
 WritablePacket::tcp_header() const
 {
-    return const_cast<click_tcp *>(Packet::tcp_header());
+    return reinterpret_cast<click_tcp *>(transport_header());
 }
 
 inline click_udp *
 WritablePacket::udp_header() const
 {
-    return const_cast<click_udp *>(Packet::udp_header());
+    return reinterpret_cast<click_udp *>(transport_header());
 }
 
 /** @cond never */
@@ -11,6 +11,13 @@
 #define DST_IP6_ANNO_OFFSET		0
 #define DST_IP6_ANNO_SIZE		16
 
+// bytes 4-5: set by TCPCoalesce and read by TCPSegment on IPv4 TCP packets
+// only; they leave other packets' annotations, such as DST_IP6, alone
+#define GSO_SIZE_ANNO_OFFSET		4
+#define GSO_SIZE_ANNO_SIZE		2
+#define GSO_SIZE_ANNO(p)		((p)->anno_u16(GSO_SIZE_ANNO_OFFSET))
+#define SET_GSO_SIZE_ANNO(p, v)		((p)->set_anno_u16(GSO_SIZE_ANNO_OFFSET, (v)))
+
 // bytes 16-31
 #define WIFI_EXTRA_ANNO_OFFSET		16
 #define WIFI_EXTRA_ANNO_SIZE		24
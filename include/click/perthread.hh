@@ -0,0 +1,180 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PERTHREAD_HH
+#define CLICK_PERTHREAD_HH
+#include <click/glue.hh>
+#if CLICK_LINUXMODULE
+# include <click/cxxprotect.h>
+CLICK_CXX_PROTECT
+# include <linux/cpumask.h>
+CLICK_CXX_UNPROTECT
+# include <click/cxxunprotect.h>
+#endif
+CLICK_DECLS
+
+/** @file <click/perthread.hh>
+ * @brief Per-thread sharded values.
+ */
+
+/** @class per_thread
+ * @brief A value sharded across router threads.
+ *
+ * A per_thread<T> holds one T per router thread, each on its own cache
+ * line.  A thread updates only its own copy, returned by local(), with
+ * ordinary loads and stores; readers combine the copies, for example with
+ * sum() or max().  This suits statistics such as packet counts, which many
+ * threads update and few read: updates stay cheap and never bounce a cache
+ * line between processors, at the price of a slower read.
+ *
+ * A new per_thread has a single copy, which every thread shares.  Call
+ * initialize() before the router runs, typically from an element's
+ * configure() or initialize() method, to allocate one copy per thread.
+ * Without multithreading support there is only ever one copy.
+ *
+ * Readers may see a copy mid-update.  On platforms where T is wider than a
+ * machine word, a reader can therefore observe a torn value; the copies
+ * themselves are never corrupted. */
+template <typename T>
+class per_thread { public:
+
+    /** @brief Construct a per_thread with one value-initialized copy. */
+    per_thread()
+	: _v(&_one.v), _n(1), _mem(0), _one() {
+    }
+
+    /** @brief Destroy a per_thread. */
+    ~per_thread() {
+	release();
+    }
+
+    /** @brief Allocate one copy for each of @a nthreads router threads.
+     *
+     * Pass the router's Master::nthreads().  Existing copies are discarded
+     * and the new ones are value-initialized. */
+    void initialize(int nthreads);
+
+    /** @brief Return the number of copies. */
+    int size() const {
+	return _n;
+    }
+
+    /** @brief Return the calling thread's copy. */
+    T &local() {
+	unsigned i = current_index();
+	if (unlikely(i >= _n))
+	    i %= _n;
+	return slot(i);
+    }
+
+    /** @brief Return copy @a i, where 0 <= @a i < size(). */
+    T &operator[](int i) {
+	return slot(i);
+    }
+    /** @overload */
+    const T &operator[](int i) const {
+	return slot(i);
+    }
+
+    /** @brief Set every copy to @a value. */
+    void assign(const T &value) {
+	for (unsigned i = 0; i < _n; ++i)
+	    slot(i) = value;
+    }
+
+    /** @brief Return the sum of all copies. */
+    T sum() const {
+	T s = slot(0);
+	for (unsigned i = 1; i < _n; ++i)
+	    s += slot(i);
+	return s;
+    }
+
+    /** @brief Return the largest copy. */
+    T max() const {
+	T m = slot(0);
+	for (unsigned i = 1; i < _n; ++i)
+	    if (m < slot(i))
+		m = slot(i);
+	return m;
+    }
+
+  private:
+
+    struct one_slot {
+	T v;
+	one_slot() : v() { }
+    };
+
+    enum { stride = (sizeof(T) + CLICK_CACHE_LINE_SIZE - 1) & ~(CLICK_CACHE_LINE_SIZE - 1) };
+
+    T *_v;
+    unsigned _n;
+    char *_mem;
+    one_slot _one;
+
+    T &slot(unsigned i) {
+	return *reinterpret_cast<T *>(reinterpret_cast<char *>(_v) + i * stride);
+    }
+    const T &slot(unsigned i) const {
+	return *reinterpret_cast<const T *>(reinterpret_cast<const char *>(_v) + i * stride);
+    }
+
+    static inline unsigned current_index() {
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+	return click_current_thread_id;
+#elif CLICK_LINUXMODULE && HAVE_MULTITHREAD
+	return click_current_processor();
+#else
+	return 0;
+#endif
+    }
+
+    void release();
+
+    per_thread(const per_thread<T> &);
+    per_thread<T> &operator=(const per_thread<T> &);
+
+};
+
+template <typename T>
+void
+per_thread<T>::initialize(int nthreads)
+{
+#if CLICK_LINUXMODULE && HAVE_MULTITHREAD
+    // Kernel threads are indexed by processor, not by Click thread.
+    (void) nthreads;
+    unsigned n = nr_cpu_ids;
+#elif CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    unsigned n = nthreads > 1 ? nthreads : 1;
+#else
+    (void) nthreads;
+    unsigned n = 1;
+#endif
+    release();
+    if (n > 1
+	&& (_mem = new char[n * stride + CLICK_CACHE_LINE_SIZE - 1])) {
+	uintptr_t a = reinterpret_cast<uintptr_t>(_mem);
+	a = (a + CLICK_CACHE_LINE_SIZE - 1) & ~(uintptr_t) (CLICK_CACHE_LINE_SIZE - 1);
+	_v = reinterpret_cast<T *>(a);
+	_n = n;
+	for (unsigned i = 0; i < n; ++i)
+	    new(reinterpret_cast<void *>(&slot(i))) T();
+    } else
+	_one.v = T();
+}
+
+template <typename T>
+void
+per_thread<T>::release()
+{
+    if (_mem) {
+	for (unsigned i = 0; i < _n; ++i)
+	    slot(i).~T();
+	delete[] _mem;
+	_mem = 0;
+    }
+    _v = &_one.v;
+    _n = 1;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,135 @@
+// -*- c-basic-offset: 4; related-file-name: "../../lib/profiler.cc" -*-
+#ifndef CLICK_PROFILER_HH
+#define CLICK_PROFILER_HH
+#include <click/glue.hh>
+#if CLICK_USERLEVEL && (!HAVE_MULTITHREAD || HAVE___THREAD_STORAGE_CLASS) && !defined(CLICK_PROFILER)
+# define CLICK_PROFILER 1
+#endif
+#if CLICK_PROFILER
+# include <click/vector.hh>
+# include <click/string.hh>
+# include <click/hashtable.hh>
+# include <click/sync.hh>
+# include <click/timestamp.hh>
+CLICK_DECLS
+class Element;
+class Router;
+class StringAccum;
+class Profiler;
+
+struct ProfilerThreadState {
+    enum { MAX_DEPTH = 32 };
+    struct Frame {
+	Element *e;
+	int port;
+	click_cycles_t start;
+	click_cycles_t child;
+    };
+    int depth;			// > 0 while tracing a sampled event
+    uint32_t countdown;		// events to skip before the next sample
+    int kind;			// kind of the sampled event
+    Profiler *profiler;		// profiler of the sampled event's router
+    Frame frames[MAX_DEPTH];
+};
+
+# if HAVE_MULTITHREAD
+extern __thread ProfilerThreadState click_profiler_state;
+# else
+extern ProfilerThreadState click_profiler_state;
+# endif
+
+class Profiler { public:
+
+    enum { K_XFER, K_TASK, K_TIMER, K_SELECT, NKINDS };
+    enum { NBUCKETS = 32 };
+
+    Profiler(Router *router);
+    ~Profiler();
+
+    uint32_t period() const		{ return _period; }
+    void set_period(uint32_t period);
+    void reset();
+
+    static inline bool active();
+    static inline bool tracing();
+    static inline bool begin_sample(Element *owner, int kind);
+    static void end_sample();
+    static void enter(Element *e, int port);
+    static void leave();
+
+    void unparse_cycles(StringAccum &sa) const;
+    void unparse_ports(StringAccum &sa) const;
+    void unparse_flamegraph(StringAccum &sa) const;
+
+  private:
+
+    struct Histogram {
+	uint32_t count;
+	click_cycles_t cycles;
+	uint32_t bucket[NBUCKETS];
+	Histogram() {
+	    memset(this, 0, sizeof(*this));
+	}
+	void add(click_cycles_t c);
+	click_cycles_t percentile(int pct) const;
+    };
+
+    Router *_router;
+    uint32_t _period;
+    Timestamp _epoch;
+    Vector<Histogram> _hist[NKINDS];
+    HashTable<uint32_t, uint32_t> _port_samples;
+    HashTable<String, click_cycles_t> _stacks;
+    mutable SimpleSpinlock _lock;
+
+    static uint32_t nactive;
+
+    static bool start_sample(Element *owner, int kind);
+    void record(const ProfilerThreadState &ps, int nframes, int kind,
+		click_cycles_t own, click_cycles_t hist_cycles);
+
+    Profiler(const Profiler &);
+    Profiler &operator=(const Profiler &);
+
+};
+
+/** @brief Return true iff some router is sampling. */
+inline bool
+Profiler::active()
+{
+    return nactive != 0;
+}
+
+/** @brief Return true iff the current thread is tracing a sampled event.
+ *
+ * Element::Port::push() and Element::Port::pull() check this before calling
+ * enter() and leave(). */
+inline bool
+Profiler::tracing()
+{
+    return click_profiler_state.depth != 0;
+}
+
+/** @brief Possibly begin sampling an event owned by @a owner.
+ * @param owner element owning the task, timer, or file descriptor
+ * @param kind K_TASK, K_TIMER, or K_SELECT
+ * @return true if the event is sampled, in which case the caller must call
+ * end_sample() after the event completes
+ *
+ * On average, one in every period() events is sampled per thread. */
+inline bool
+Profiler::begin_sample(Element *owner, int kind)
+{
+    ProfilerThreadState &ps = click_profiler_state;
+    if (likely(!active()) || ps.depth)
+	return false;
+    if (likely(ps.countdown > 1)) {
+	--ps.countdown;
+	return false;
+    }
+    return start_sample(owner, kind);
+}
+
+CLICK_ENDDECLS
+#endif
+#endif
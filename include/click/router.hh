@@ -96,6 +96,15 @@ class Router { public:
     NameInfo* force_name_info();
     /** @endcond never */
 
+#if CLICK_PROFILER
+    inline Profiler* profiler() const;
+    Profiler* force_profiler();
+#endif
+#if CLICK_LATENCY_TRACE
+    inline LatencyTracer* latency_tracer() const;
+    void set_latency_tracer(LatencyTracer* tracer);
+#endif
+
     // UNPARSING
     String configuration_string() const;
     void unparse(StringAccum& sa, const String& indent = String()) const;
@@ -290,6 +299,12 @@ class Router { public:
     Router* _hotswap_router;
     ThreadSched* _thread_sched;
     mutable NameInfo* _name_info;
+#if CLICK_PROFILER
+    Profiler* _profiler;
+#endif
+#if CLICK_LATENCY_TRACE
+    LatencyTracer* _latency_tracer;
+#endif
     Vector<int> _flow_code_override_eindex;
     Vector<String> _flow_code_override;
 
@@ -462,6 +477,29 @@ Router::name_info() const
 }
 /** @endcond never */
 
+#if CLICK_PROFILER
+/** @brief  Return the sampling Profiler for this router, if it exists.
+ *
+ * The profiler is created on the first write to the profile_sample global
+ * handler. */
+inline Profiler*
+Router::profiler() const
+{
+    return _profiler;
+}
+#endif
+
+#if CLICK_LATENCY_TRACE
+/** @brief  Return the LatencyTracer for this router, if it exists.
+ *
+ * A tracer is installed by elements such as LatencyTrace. */
+inline LatencyTracer*
+Router::latency_tracer() const
+{
+    return _latency_tracer;
+}
+#endif
+
 /** @brief  Return the Master object for this router. */
 inline Master*
 Router::master() const
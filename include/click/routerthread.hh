@@ -77,6 +77,23 @@ class RouterThread { public:
 
 #if CLICK_USERLEVEL
     inline void run_signals();
+
+    enum { IDLE_POLL = 0, IDLE_ADAPTIVE = 1 };
+    int idle_policy() const		{ return _idle_policy; }
+    void set_idle_policy(int policy, unsigned spin = 1000,
+			 unsigned pause = 1000, uint32_t max_sleep_usec = 1000);
+    inline bool idle_sleeping() const;
+    inline int next_select_delay(Timestamp &t) const;
+
+    click_cycles_t busy_cycles() const	{ return _busy_cycles; }
+    click_cycles_t idle_cycles() const	{ return _idle_cycles; }
+    uint64_t idle_sleeps() const	{ return _idle_sleeps; }
+    void reset_cycle_stats();
+
+    int numa_node() const		{ return _numa_node; }
+    void set_numa_node(int node)	{ _numa_node = node; }
+    int cpu() const			{ return _cpu; }
+    void set_cpu(int cpu)		{ _cpu = cpu; }
 #endif
 
     enum { S_PAUSED, S_BLOCKED, S_TIMERWAIT,
@@ -124,6 +141,21 @@ class RouterThread { public:
     TimerSet _timers;
 #if CLICK_USERLEVEL
     SelectSet _selects;
+
+    // adaptive idle backoff
+    int _idle_policy;
+    unsigned _idle_iters;		// driver iterations since tasks did work
+    unsigned _idle_spin;		// idle iterations spent busy-polling
+    unsigned _idle_pause;		// idle iterations spent pausing
+    uint32_t _idle_sleep_usec;		// current sleep bound, 0 if not sleeping
+    uint32_t _idle_max_sleep_usec;
+    click_cycles_t _busy_cycles;
+    click_cycles_t _idle_cycles;
+    uint64_t _idle_sleeps;
+    enum { IDLE_PAUSE_BATCH = 32, IDLE_SELECT_USEC = 1000 };
+
+    int _numa_node;			// node to bind to when driver starts
+    int _cpu;				// CPU to bind to when driver starts
 #endif
 
 #if HAVE_ADAPTIVE_SCHEDULER
@@ -215,9 +247,12 @@ class RouterThread { public:
     // task running functions
     inline void driver_lock_tasks();
     inline void driver_unlock_tasks();
-    inline void run_tasks(int ntasks);
+    inline bool run_tasks(int ntasks);
     inline void process_pending();
     inline void run_os();
+#if CLICK_USERLEVEL
+    bool idle_backoff();
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     void client_set_tickets(int client, int tickets);
     inline void client_update_pass(int client, const Timestamp &before);
@@ -428,6 +463,18 @@ RouterThread::unlock_tasks()
     }
 }
 
+#if CLICK_USERLEVEL
+/** @brief Returns whether this thread is sleeping off an idle period.
+ *
+ * True when the adaptive idle policy has backed off far enough that the
+ * thread should block in its SelectSet even though tasks are scheduled. */
+inline bool
+RouterThread::idle_sleeping() const
+{
+    return _idle_sleep_usec >= IDLE_SELECT_USEC;
+}
+#endif
+
 inline void
 RouterThread::wake()
 {
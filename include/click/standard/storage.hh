@@ -38,8 +38,14 @@ class Storage { public:
   protected:
 
     index_type _capacity;
+#if HAVE_MULTITHREAD
+    // keep the consumer's and the producer's index on separate cache lines
+    volatile index_type _head CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+    volatile index_type _tail CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+#else
     volatile index_type _head;
     volatile index_type _tail;
+#endif
 
 };
 
@@ -610,6 +610,9 @@ Task::fire()
 #endif
 #if HAVE_MULTITHREAD
     _cycle_runs++;
+#endif
+#if CLICK_PROFILER
+    bool sampled = Profiler::begin_sample(_owner, Profiler::K_TASK);
 #endif
     bool work_done;
     if (!_hook)
@@ -625,6 +628,10 @@ Task::fire()
 	own_delta = all_delta - (_owner->_child_cycles - start_child_cycles);
     _owner->_task_calls += 1;
     _owner->_task_own_cycles += own_delta;
+#endif
+#if CLICK_PROFILER
+    if (unlikely(sampled))
+	Profiler::end_sample();
 #endif
     return work_done;
 }
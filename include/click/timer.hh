@@ -291,6 +291,28 @@ class Timer { public:
     }
 
 
+    /** @brief Return the timer's slack.
+     *
+     * @sa set_slack() */
+    inline Timestamp slack() const {
+	return Timestamp::make_msec(_slack_msec);
+    }
+
+    /** @brief Allow the timer to fire up to @a slack after its expiry.
+     *
+     * Timers with zero slack, the default, fire as close to their expiry as
+     * possible.  Timers with nonzero slack are kept in a hierarchical timer
+     * wheel rather than the timer heap, which makes scheduling and
+     * unscheduling them constant-time, and their expirations are rounded up
+     * so that timers with similar expiries fire together in one batch.  Slack
+     * has millisecond granularity; nonzero values are rounded up to a whole
+     * millisecond.  Use slack for timeouts and periodic housekeeping that
+     * need not be precise, especially when there are many such timers.
+     *
+     * The new slack takes effect the next time the timer is scheduled. */
+    void set_slack(const Timestamp &slack);
+
+
     /** @brief Return an adjustment interval useful for precise timers.
      *
      * Due to scheduling granularity, other tasks running on the same machine,
@@ -339,6 +361,7 @@ class Timer { public:
   private:
 
     int _schedpos1;
+    uint32_t _slack_msec;
     Timestamp _expiry_s;
     union {
 	TimerCallback callback;
@@ -346,6 +369,8 @@ class Timer { public:
     void *_thunk;
     Element *_owner;
     RouterThread *_thread;
+    Timer *_wheel_next;			// timer wheel slot list
+    Timer **_wheel_pprev;
 
     Timer &operator=(const Timer &x);
 
@@ -21,6 +21,21 @@ class TimerSet { public:
 
     Timer *next_timer();			// useful for benchmarking
 
+    /** @brief Timer statistics for one thread. */
+    struct stats_type {
+	uint64_t heap_schedules;	///< schedules of timers without slack
+	uint64_t wheel_schedules;	///< schedules of timers with slack
+	uint64_t heap_fires;
+	uint64_t wheel_fires;
+	uint64_t wheel_batches;		///< wheel slots that fired timers
+	uint64_t cascades;		///< timers moved to a finer wheel level
+    };
+
+    int heap_size() const			{ return _timer_heap.size(); }
+    unsigned wheel_size() const			{ return _wheel_count; }
+    const stats_type &stats() const		{ return _stats; }
+    void reset_stats();
+
     unsigned max_timer_stride() const		{ return _max_timer_stride; }
     unsigned timer_stride() const		{ return _timer_stride; }
     void set_max_timer_stride(unsigned timer_stride);
@@ -54,6 +69,13 @@ class TimerSet { public:
 	}
     };
 
+    // Timers with slack live in a hierarchical timer wheel.  Level L has
+    // wheel_slots slots of 2^(wheel_bits*L) milliseconds each; a timer sits
+    // at the coarsest level whose span includes its expiry, and moves down
+    // a level (cascades) when the current time reaches its slot.
+    enum { wheel_bits = 6, wheel_slots = 1 << wheel_bits, wheel_levels = 4 };
+    enum { schedpos_wheel = 0x7FFFFFFF };
+
     // Most likely _timer_expiry now fits in a cache line
     Timestamp _timer_expiry CLICK_ALIGNED(8);
 
@@ -71,15 +93,34 @@ class TimerSet { public:
     Timestamp _timer_check;
     uint32_t _timer_check_reports;
 
+    Timer *_wheel[wheel_levels][wheel_slots];
+    uint64_t _wheel_mask[wheel_levels];	// nonempty slots
+    uint64_t _wheel_now;		// next tick to process, in msec
+    unsigned _wheel_count;
+    Timestamp _wheel_expiry;		// next tick with work to do
+    stats_type _stats;
+
     inline void run_one_timer(Timer *);
+    void run_runchunk(RouterThread *thread);
 
     void set_timer_expiry() {
 	if (_timer_heap.size())
 	    _timer_expiry = _timer_heap.unchecked_at(0).expiry_s;
 	else
 	    _timer_expiry = Timestamp();
+	if (_wheel_count && (!_timer_expiry || _wheel_expiry < _timer_expiry))
+	    _timer_expiry = _wheel_expiry;
     }
     void check_timer_expiry(Timer *t);
+    void heap_remove(Timer *t);
+
+    static uint64_t wheel_tick(const Timer *t);
+    bool wheel_next(int &level, int &slot, uint64_t &tick) const;
+    void set_wheel_expiry();
+    void wheel_insert(Timer *t);
+    void wheel_remove(Timer *t);
+    void wheel_cascade(int level, int slot);
+    void run_wheel(RouterThread *thread);
 
     inline void lock_timers();
     inline bool attempt_lock_timers();
@@ -154,6 +195,10 @@ TimerSet::next_timer()
 {
     lock_timers();
     Timer *t = _timer_heap.empty() ? 0 : _timer_heap.unchecked_at(0).t;
+    int level, slot;
+    uint64_t tick;
+    if (!t && wheel_next(level, slot, tick))
+	t = _wheel[level][slot];
     unlock_timers();
     return t;
 }
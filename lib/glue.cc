@@ -26,6 +26,9 @@
 #include <click/error.hh>
 
 #ifdef CLICK_USERLEVEL
+# include <click/atomic.hh>
+# include <new>
+# include <stdlib.h>
 # include <stdarg.h>
 # include <unistd.h>
 # include <sys/types.h>
@@ -365,6 +368,68 @@ click_dmalloc_cleanup()
 
 #endif /* CLICK_LINUXMODULE || CLICK_BSDMODULE */
 
+#if CLICK_USERLEVEL
+// User-level new and delete use malloc() and free() as usual.  While a
+// benchmark is measuring, new also counts allocations in a per-thread
+// counter, so the benchmark can report allocations per operation.  Otherwise
+// new only reads one rarely written word.
+
+atomic_uint32_t click_dmalloc_counting;
+# if HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+__thread size_t click_dmalloc_thread_news;
+# else
+size_t click_dmalloc_thread_news;
+# endif
+
+void *
+operator new(size_t sz)
+{
+    if (click_dmalloc_counting.value())
+	click_dmalloc_thread_news++;
+    if (void *v = malloc(sz ? sz : 1))
+	return v;
+    click_dmalloc_failnew++;
+    throw std::bad_alloc();
+}
+
+void *
+operator new[](size_t sz)
+{
+    if (click_dmalloc_counting.value())
+	click_dmalloc_thread_news++;
+    if (void *v = malloc(sz ? sz : 1))
+	return v;
+    click_dmalloc_failnew++;
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void *addr) throw ()
+{
+    free(addr);
+}
+
+void
+operator delete[](void *addr) throw ()
+{
+    free(addr);
+}
+
+// C++14 sized deallocation would otherwise reach the library's delete,
+// which need not pair with the malloc() above.
+void
+operator delete(void *addr, size_t) throw ()
+{
+    free(addr);
+}
+
+void
+operator delete[](void *addr, size_t) throw ()
+{
+    free(addr);
+}
+#endif
+
 
 // LALLOC
 
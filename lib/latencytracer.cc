@@ -0,0 +1,284 @@
+// -*- c-basic-offset: 4; related-file-name: "../include/click/latencytracer.hh" -*-
+/*
+ * latencytracer.{cc,hh} -- per-packet latency traces
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/latencytracer.hh>
+#include <click/element.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+CLICK_DECLS
+#if CLICK_LATENCY_TRACE
+
+/** @file latencytracer.hh
+ * @brief Per-packet latency tracing.
+ */
+
+/** @class LatencyTracer
+ * @brief Per-router store of sampled packet latency traces.
+ *
+ * A LatencyTracer follows sampled packets through a router.  begin() marks a
+ * packet by storing a nonzero trace ID in a 32-bit user annotation.  Each
+ * later push or pull of that packet, on any thread, appends a cycle-counter
+ * timestamp to the packet's trace and adds the time since the previous hop
+ * to a LatencyHistogram for that pair of elements.
+ *
+ * Traces live in a fixed ring.  A new trace overwrites the oldest one; a
+ * packet whose trace was overwritten silently stops being traced.  Clones of
+ * a traced packet share its trace.  Latencies are measured with
+ * click_get_cycles(), so threads must run on CPUs with synchronized cycle
+ * counters. */
+
+uint32_t LatencyTracer::nactive;
+
+void
+LatencyHistogram::clear()
+{
+    _count = _sum = _max = 0;
+    _min = ~(uint64_t) 0;
+    memset(_bucket, 0, sizeof(_bucket));
+}
+
+inline int
+LatencyHistogram::bucket(uint64_t v)
+{
+    if (v < SUB)
+	return v;
+    int e = 64 - ffs_msb(v);
+    if (e >= MAX_BITS)
+	return NBUCKETS - 1;
+    return (e - SUB_BITS + 1) * SUB + (int) (v >> (e - SUB_BITS)) - SUB;
+}
+
+inline uint64_t
+LatencyHistogram::bucket_high(int b)
+{
+    if (b < SUB)
+	return b;
+    int e = b / SUB + SUB_BITS - 1;
+    uint64_t m = b % SUB + SUB;
+    return ((m + 1) << (e - SUB_BITS)) - 1;
+}
+
+void
+LatencyHistogram::add(uint64_t v)
+{
+    ++_bucket[bucket(v)];
+    ++_count;
+    _sum += v;
+    if (v < _min)
+	_min = v;
+    if (v > _max)
+	_max = v;
+}
+
+/** @brief Return an upper bound on the @a pct'th percentile value.
+ *
+ * The result is the largest value in the bucket containing the percentile,
+ * capped at max(). */
+uint64_t
+LatencyHistogram::percentile(double pct) const
+{
+    uint64_t want = (uint64_t) (_count * pct / 100 + 0.5), seen = 0;
+    if (want == 0)
+	want = 1;
+    for (int b = 0; b < NBUCKETS; ++b)
+	if ((seen += _bucket[b]) >= want) {
+	    uint64_t v = bucket_high(b);
+	    return v < _max ? v : _max;
+	}
+    return _max;
+}
+
+
+/** @brief Construct a tracer.
+ * @param router the router
+ * @param anno offset of the 32-bit trace ID annotation
+ * @param ntraces number of traces to keep, rounded up to a power of two */
+LatencyTracer::LatencyTracer(Router *router, int anno, int ntraces)
+    : _router(router), _anno(anno), _pair_map(-1)
+{
+    int n = 1;
+    while (n < ntraces)
+	n <<= 1;
+    _traces.resize(n);
+    for (Trace *t = _traces.begin(); t != _traces.end(); ++t)
+	t->id = t->nhops = 0;
+    _id = 0;
+    reset();
+    atomic_uint32_t::inc(nactive);
+}
+
+LatencyTracer::~LatencyTracer()
+{
+    atomic_uint32_t::dec_and_test(nactive);
+    for (LatencyHistogram **h = _pair_hist.begin(); h != _pair_hist.end(); ++h)
+	delete *h;
+}
+
+/** @brief Start tracing packet @a p at element @a e. */
+void
+LatencyTracer::begin(Element *e, Packet *p)
+{
+    uint32_t id;
+    do {
+	id = _id.fetch_and_add(1) + 1;
+    } while (!id);
+    Timestamp start = Timestamp::now();
+    click_cycles_t now = click_get_cycles();
+    Trace &t = _traces[id & (_traces.size() - 1)];
+    _lock.acquire();
+    t.id = id;
+    t.start = start;
+    t.hops[0].eindex = e->eindex();
+    t.hops[0].cycles = now;
+    t.nhops = 1;
+    _lock.release();
+    p->set_anno_u32(_anno, id);
+}
+
+void
+LatencyTracer::record_hop(Element *e, Packet *p)
+{
+    LatencyTracer *lt = e->router()->latency_tracer();
+    if (!lt || !lt->traced(p))
+	return;
+    uint32_t id = p->anno_u32(lt->_anno);
+    Trace &t = lt->_traces[id & (lt->_traces.size() - 1)];
+    click_cycles_t now = click_get_cycles();
+    // Clones share the trace, and a newer packet may take over the slot,
+    // so check and update it under the lock.
+    lt->_lock.acquire();
+    if (t.id == id && t.nhops) {
+	// a trace longer than MAX_HOPS keeps its last slot for the newest hop
+	int h = (t.nhops < MAX_HOPS ? t.nhops : MAX_HOPS - 1);
+	Hop &prev = t.hops[t.nhops - 1];
+	lt->record(prev.eindex, e->eindex(), now - prev.cycles);
+	t.hops[h].eindex = e->eindex();
+	t.hops[h].cycles = now;
+	t.nhops = h + 1;
+    }
+    lt->_lock.release();
+}
+
+// Call with _lock held.
+void
+LatencyTracer::record(int from, int to, click_cycles_t delta)
+{
+    uint64_t key = ((uint64_t) (uint32_t) from << 32) | (uint32_t) to;
+    int &x = _pair_map[key];
+    if (x < 0) {
+	x = _pair_hist.size();
+	_pair_hist.push_back(new LatencyHistogram);
+    }
+    _pair_hist[x]->add(delta);
+}
+
+/** @brief Return the measured cycle counter rate.
+ *
+ * The rate is measured over the time since the tracer was last reset. */
+double
+LatencyTracer::cycles_per_usec() const
+{
+    Timestamp now = Timestamp::now();
+    click_cycles_t cycles = click_get_cycles();
+    double usec = (now - _epoch).doubleval() * 1000000;
+    if (usec < 1)
+	return 1;
+    return (cycles - _epoch_cycles) / usec;
+}
+
+/** @brief Clear all hop histograms and traces. */
+void
+LatencyTracer::reset()
+{
+    _lock.acquire();
+    for (LatencyHistogram **h = _pair_hist.begin(); h != _pair_hist.end(); ++h)
+	(*h)->clear();
+    _epoch.assign_now();
+    _epoch_cycles = click_get_cycles();
+    for (Trace *t = _traces.begin(); t != _traces.end(); ++t)
+	t->nhops = 0;
+    _lock.release();
+}
+
+static String
+tracer_element_name(Router *router, int ei)
+{
+    if (ei >= 0 && ei < router->nelements())
+	return router->ename(ei);
+    else
+	return String::make_stable("<unknown>");
+}
+
+/** @brief Unparse hop latency statistics as CSV.
+ *
+ * Each row describes the latency from one element to the next along the
+ * paths of sampled packets, in nanoseconds. */
+void
+LatencyTracer::unparse_hops(StringAccum &sa) const
+{
+    double ns = 1000 / cycles_per_usec();
+    sa << "from,to,count,min_ns,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n";
+    _lock.acquire();
+    Vector<uint64_t> keys;
+    for (HashTable<uint64_t, int>::const_iterator it = _pair_map.begin();
+	 it != _pair_map.end(); ++it)
+	if (_pair_hist[it.value()]->count())
+	    keys.push_back(it.key());
+    click_qsort(keys.begin(), keys.size());
+    for (uint64_t *kp = keys.begin(); kp != keys.end(); ++kp) {
+	const LatencyHistogram &h = *_pair_hist[_pair_map.get(*kp)];
+	sa << tracer_element_name(_router, (int) (*kp >> 32)) << ','
+	   << tracer_element_name(_router, (int) (uint32_t) *kp) << ','
+	   << h.count() << ','
+	   << (uint64_t) (h.min() * ns) << ','
+	   << (uint64_t) (h.sum() * ns / h.count()) << ','
+	   << (uint64_t) (h.percentile(50) * ns) << ','
+	   << (uint64_t) (h.percentile(90) * ns) << ','
+	   << (uint64_t) (h.percentile(99) * ns) << ','
+	   << (uint64_t) (h.percentile(99.9) * ns) << ','
+	   << (uint64_t) (h.max() * ns) << '\n';
+    }
+    _lock.release();
+}
+
+/** @brief Unparse recent traces, oldest first.
+ *
+ * Each line has the form "ID START ELEMENT@NS ELEMENT@NS...", where START is
+ * the wall-clock time the trace began and each NS is the time since START
+ * in nanoseconds. */
+void
+LatencyTracer::unparse_traces(StringAccum &sa) const
+{
+    double ns = 1000 / cycles_per_usec();
+    uint32_t last = _id.value();
+    uint32_t first = (last > (uint32_t) _traces.size() ? last - _traces.size() + 1 : 1);
+    _lock.acquire();
+    for (uint32_t id = first; id && id <= last; ++id) {
+	const Trace &t = _traces[id & (_traces.size() - 1)];
+	if (t.id != id || !t.nhops)
+	    continue;
+	sa << t.id << ' ' << t.start;
+	for (int i = 0; i < t.nhops; ++i)
+	    sa << ' ' << tracer_element_name(_router, t.hops[i].eindex) << '@'
+	       << (uint64_t) ((t.hops[i].cycles - t.hops[0].cycles) * ns);
+	sa << '\n';
+    }
+    _lock.release();
+}
+
+#endif
+CLICK_ENDDECLS
@@ -0,0 +1,308 @@
+// -*- c-basic-offset: 4; related-file-name: "../include/click/numa.hh" -*-
+/*
+ * numa.{cc,hh} -- NUMA topology and node-local memory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/numa.hh>
+#include <click/straccum.hh>
+#include <click/sync.hh>
+#if CLICK_NUMA
+# include <sched.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# ifndef MPOL_PREFERRED
+#  define MPOL_PREFERRED 1
+# endif
+#endif
+CLICK_DECLS
+
+/** @file numa.hh
+ * @brief NUMA topology and node-local memory.
+ */
+
+/** @class Numa
+ * @brief NUMA topology, thread binding, and node-local allocation.
+ *
+ * Numa reads the machine's NUMA topology from /sys/devices/system/node.
+ * bind_current_thread() restricts a thread to one node's CPUs and makes that
+ * node its preferred source of memory, so that memory the thread touches
+ * first, including packet buffers, is local.  allocate() places larger
+ * structures, such as queue rings and lookup tables, on a specific node.
+ * Per-node statistics are available through unparse_stats() and the global
+ * C<numa_memory> handler. */
+
+#if CLICK_NUMA
+
+Numa::Stats Numa::stats[Numa::MAX_NODES];
+int Numa::_nnodes;
+__thread int Numa::_current_node = -1;
+static SimpleSpinlock numa_stats_lock;
+
+static String
+read_sysfs(const char *path)
+{
+    StringAccum sa;
+    if (FILE *f = fopen(path, "r")) {
+	char buf[256];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+	    sa.append(buf, n);
+	fclose(f);
+    }
+    while (sa.length() && isspace((unsigned char) sa.back()))
+	sa.pop_back();
+    return sa.take_string();
+}
+
+// Calls f(i) for every i in a Linux list such as "0-3,8,10-11".
+template <typename F>
+static void
+parse_list(const String &s, F &f)
+{
+    const char *x = s.begin(), *end = s.end();
+    while (x < end) {
+	char *next;
+	long a = strtol(x, &next, 10), b = a;
+	if (next == x)
+	    break;
+	if (next < end && *next == '-')
+	    b = strtol(next + 1, &next, 10);
+	for (long i = a; i <= b; ++i)
+	    f(i);
+	x = next;
+	while (x < end && (*x == ',' || isspace((unsigned char) *x)))
+	    ++x;
+    }
+}
+
+namespace {
+struct MaxFunctor {
+    long max;
+    MaxFunctor() : max(-1) { }
+    void operator()(long i) { if (i > max) max = i; }
+};
+struct FindFunctor {
+    long want;
+    bool found;
+    FindFunctor(long w) : want(w), found(false) { }
+    void operator()(long i) { if (i == want) found = true; }
+};
+struct CpuSetFunctor {
+    cpu_set_t set;
+    int count;
+    CpuSetFunctor() : count(0) { CPU_ZERO(&set); }
+    void operator()(long i) {
+	if (i >= 0 && i < CPU_SETSIZE) {
+	    CPU_SET(i, &set);
+	    ++count;
+	}
+    }
+};
+}
+
+static String
+node_file(int node, const char *file)
+{
+    char buf[128];
+    sprintf(buf, "/sys/devices/system/node/node%d/%s", node, file);
+    return read_sysfs(buf);
+}
+
+/** @brief Return the number of NUMA nodes, which is at least 1. */
+int
+Numa::nnodes()
+{
+    if (!_nnodes) {
+	MaxFunctor f;
+	parse_list(read_sysfs("/sys/devices/system/node/online"), f);
+	int n = f.max + 1;
+	_nnodes = (n < 1 ? 1 : (n > MAX_NODES ? (int) MAX_NODES : n));
+    }
+    return _nnodes;
+}
+
+/** @brief Return the NUMA node containing CPU @a cpu, or 0 if unknown. */
+int
+Numa::cpu_node(int cpu)
+{
+    for (int node = 0; node < nnodes(); ++node) {
+	FindFunctor f(cpu);
+	parse_list(node_file(node, "cpulist"), f);
+	if (f.found)
+	    return node;
+    }
+    return 0;
+}
+
+int
+Numa::lookup_current_node()
+{
+    int node = 0;
+# ifdef SYS_getcpu
+    unsigned cpu, n;
+    if (syscall(SYS_getcpu, &cpu, &n, (void *) 0) == 0 && (int) n < nnodes())
+	node = n;
+# endif
+    _current_node = node;
+    return node;
+}
+
+/** @brief Bind the calling thread to NUMA node @a node.
+ * @return 0 on success, or a negative errno value
+ *
+ * Restricts the thread to @a node's CPUs and makes @a node its preferred
+ * memory node. */
+int
+Numa::bind_current_thread(int node)
+{
+    if (node < 0 || node >= nnodes())
+	return -EINVAL;
+    CpuSetFunctor f;
+    parse_list(node_file(node, "cpulist"), f);
+    if (f.count && sched_setaffinity(0, sizeof(f.set), &f.set) < 0)
+	return -errno;
+# ifdef SYS_set_mempolicy
+    unsigned long mask = 1UL << node;
+    (void) syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8);
+# endif
+    if (_current_node != node) {
+	numa_stats_lock.acquire();
+	++stats[node].threads;
+	numa_stats_lock.release();
+    }
+    _current_node = node;
+    return 0;
+}
+
+/** @brief Bind the calling thread to CPU @a cpu.
+ * @return 0 on success, or a negative errno value
+ *
+ * Like bind_current_thread(), but restricts the thread to the single CPU
+ * @a cpu.  That CPU's node becomes the thread's preferred memory node. */
+int
+Numa::bind_current_cpu(int cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+	return -EINVAL;
+    int r = bind_current_thread(cpu_node(cpu));
+    if (r < 0)
+	return r;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0)
+	return -errno;
+    return 0;
+}
+
+static inline size_t
+page_round(size_t size)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (size + page - 1) & ~(page - 1);
+}
+
+void *
+Numa::node_allocate(size_t size, int node)
+{
+    if (node >= nnodes())
+	node = 0;
+    size_t psize = page_round(size);
+    void *p = mmap(0, psize, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+	return 0;
+# ifdef SYS_mbind
+    unsigned long mask = 1UL << node;
+    (void) syscall(SYS_mbind, p, psize, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+# endif
+    numa_stats_lock.acquire();
+    stats[node].allocated += psize;
+    numa_stats_lock.release();
+    return p;
+}
+
+void
+Numa::node_deallocate(void *p, size_t size, int node)
+{
+    if (!p)
+	return;
+    if (node >= nnodes())
+	node = 0;
+    size_t psize = page_round(size);
+    munmap(p, psize);
+    numa_stats_lock.acquire();
+    stats[node].allocated -= psize;
+    numa_stats_lock.release();
+}
+
+/** @brief Unparse per-node memory statistics as CSV.
+ *
+ * Each row reports a node's CPUs, the number of router threads bound to it,
+ * the bytes allocated on it with allocate(), the number of packet buffers in
+ * its global packet pool, and its free memory in kilobytes. */
+void
+Numa::unparse_stats(StringAccum &sa)
+{
+    sa << "node,cpus,threads,allocated,pool_buffers,free_kb\n";
+    for (int node = 0; node < nnodes(); ++node) {
+	String meminfo = node_file(node, "meminfo");
+	long free_kb = -1;
+	int pos = meminfo.find_left("MemFree:");
+	if (pos >= 0)
+	    free_kb = strtol(meminfo.c_str() + pos + 8, 0, 10);
+	numa_stats_lock.acquire();
+	Stats s = stats[node];
+	numa_stats_lock.release();
+	sa << node << ",\"" << node_file(node, "cpulist") << "\","
+	   << s.threads << ',' << (uint64_t) s.allocated << ','
+	   << s.pool_buffers << ',' << free_kb << '\n';
+    }
+}
+
+#else
+
+int
+Numa::nnodes()
+{
+    return 1;
+}
+
+int
+Numa::cpu_node(int)
+{
+    return 0;
+}
+
+int
+Numa::bind_current_thread(int node)
+{
+    return node == 0 ? 0 : -EINVAL;
+}
+
+int
+Numa::bind_current_cpu(int)
+{
+    return -EINVAL;
+}
+
+void
+Numa::unparse_stats(StringAccum &sa)
+{
+    sa << "node,cpus,threads,allocated,pool_buffers,free_kb\n";
+}
+
+#endif
+CLICK_ENDDECLS
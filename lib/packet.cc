@@ -23,6 +23,7 @@
 #include <click/packet_anno.hh>
 #include <click/glue.hh>
 #include <click/sync.hh>
+#include <click/numa.hh>
 #if CLICK_USERLEVEL
 # include <unistd.h>
 #endif
@@ -159,7 +160,9 @@ CLICK_DECLS
  *
  * WritablePacket objects are created by Packet::make(), Packet::uniqueify(),
  * Packet::push(), and Packet::put(), which ensure that the returned packet
- * does not share its data buffer.
+ * does not share its data buffer.  Packet::uniqueify_header() and
+ * Packet::push_header() return WritablePacket objects that may still share
+ * data beyond their headers; see Packet::copy_pending().
  *
  * WritablePacket's interface is the same as Packet's except for these type
  * differences.  For documentation, see Packet.
@@ -179,6 +182,10 @@ CLICK_DECLS
  * Avoid writing buggy code like this!  Use WritablePacket selectively, and
  * try to avoid calling WritablePacket::clone() when possible. */
 
+#if !CLICK_LINUXMODULE
+const Timestamp Packet::zero_timestamp;
+#endif
+
 Packet::~Packet()
 {
     // This is a convenient place to put static assertions.
@@ -207,10 +214,14 @@ Packet::~Packet()
 #if CLICK_LINUXMODULE
     panic("Packet destructor");
 #else
+# if CLICK_USERLEVEL
+    if (_cold & COLD_COPY)
+	kill_segments(_copy_packet);
+# endif
     if (_data_packet)
 	_data_packet->kill();
 # if CLICK_USERLEVEL
-    else if (_head && _destructor)
+    else if (_head && buffer_destructor())
 	_destructor(_head, _end - _head);
     else
 	delete[] _head;
@@ -242,14 +253,34 @@ struct PacketPool {
     unsigned pdcount;
 #  if HAVE_MULTITHREAD
     PacketPool *chain;
+    int node;
+    // data buffers freed here but allocated on other NUMA nodes
+    PacketData *remote_pd[Numa::MAX_NODES];
+    unsigned remote_pdcount[Numa::MAX_NODES];
 #  endif
 };
 }
 #  if HAVE_MULTITHREAD
+// Each NUMA node has its own global pool, so a thread's pool refills with
+// buffers local to its node.
 static __thread PacketPool *thread_packet_pool;
 static PacketPool *all_thread_packet_pools;
-static PacketPool global_packet_pool;
-static volatile uint32_t global_packet_pool_lock;
+static PacketPool global_packet_pool[Numa::MAX_NODES];
+static volatile uint32_t global_packet_pool_lock[Numa::MAX_NODES];
+
+static inline void
+lock_global_packet_pool(int node)
+{
+    while (atomic_uint32_t::swap(global_packet_pool_lock[node], 1) == 1)
+	/* do nothing */;
+}
+
+static inline void
+unlock_global_packet_pool(int node)
+{
+    click_compiler_fence();
+    global_packet_pool_lock[node] = 0;
+}
 
 static inline PacketPool *
 get_packet_pool()
@@ -257,16 +288,46 @@ get_packet_pool()
     PacketPool *pp = thread_packet_pool;
     if (!pp && (pp = new PacketPool)) {
 	memset(pp, 0, sizeof(PacketPool));
-	while (atomic_uint32_t::swap(global_packet_pool_lock, 1) == 1)
-	    /* do nothing */;
+	lock_global_packet_pool(0);
 	pp->chain = all_thread_packet_pools;
 	all_thread_packet_pools = pp;
 	thread_packet_pool = pp;
-	click_compiler_fence();
-	global_packet_pool_lock = 0;
+	unlock_global_packet_pool(0);
     }
+    // A thread's node changes when the thread is bound to a node.
+    if (pp)
+	pp->node = Numa::current_node();
     return pp;
 }
+
+static void
+recycle_remote_data(PacketPool &packet_pool, PacketData *pd, int node)
+{
+    pd->next = packet_pool.remote_pd[node];
+    packet_pool.remote_pd[node] = pd;
+    if (++packet_pool.remote_pdcount[node] < CLICK_PACKET_POOL_SIZE)
+	return;
+
+    // Send a full batch home.
+    PacketPool &gpp = global_packet_pool[node];
+    lock_global_packet_pool(node);
+    if (gpp.pdcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
+	while ((pd = packet_pool.remote_pd[node])) {
+	    packet_pool.remote_pd[node] = pd->next;
+	    delete[] reinterpret_cast<unsigned char *>(pd);
+	}
+    } else {
+	packet_pool.remote_pd[node]->pool_next = gpp.pd;
+	gpp.pd = packet_pool.remote_pd[node];
+	++gpp.pdcount;
+#   if CLICK_NUMA
+	Numa::stats[node].pool_buffers += CLICK_PACKET_POOL_SIZE;
+#   endif
+    }
+    unlock_global_packet_pool(node);
+    packet_pool.remote_pd[node] = 0;
+    packet_pool.remote_pdcount[node] = 0;
+}
 #  else
 static PacketPool packet_pool;
 #  endif
@@ -276,29 +337,32 @@ WritablePacket::pool_allocate(bool with_data)
 {
 #  if HAVE_MULTITHREAD
     PacketPool &packet_pool = *get_packet_pool();
-    if ((!packet_pool.p && global_packet_pool.p)
-	|| (with_data && !packet_pool.pd && global_packet_pool.pd)) {
-	while (atomic_uint32_t::swap(global_packet_pool_lock, 1) == 1)
-	    /* do nothing */;
+    int node = packet_pool.node;
+    PacketPool &gpp = global_packet_pool[node];
+    if ((!packet_pool.p && gpp.p)
+	|| (with_data && !packet_pool.pd && gpp.pd)) {
+	lock_global_packet_pool(node);
 
 	WritablePacket *pp;
-	if (!packet_pool.p && (pp = global_packet_pool.p)) {
-	    global_packet_pool.p = static_cast<WritablePacket *>(pp->prev());
-	    --global_packet_pool.pcount;
+	if (!packet_pool.p && (pp = gpp.p)) {
+	    gpp.p = static_cast<WritablePacket *>(pp->prev());
+	    --gpp.pcount;
 	    packet_pool.p = pp;
 	    packet_pool.pcount = CLICK_PACKET_POOL_SIZE;
 	}
 
 	PacketData *pd;
-	if (with_data && !packet_pool.pd && (pd = global_packet_pool.pd)) {
-	    global_packet_pool.pd = pd->pool_next;
-	    --global_packet_pool.pdcount;
+	if (with_data && !packet_pool.pd && (pd = gpp.pd)) {
+	    gpp.pd = pd->pool_next;
+	    --gpp.pdcount;
 	    packet_pool.pd = pd;
 	    packet_pool.pdcount = CLICK_PACKET_POOL_SIZE;
+#   if CLICK_NUMA
+	    Numa::stats[node].pool_buffers -= CLICK_PACKET_POOL_SIZE;
+#   endif
 	}
 
-	click_compiler_fence();
-	global_packet_pool_lock = 0;
+	unlock_global_packet_pool(node);
     }
 #  else
     (void) with_data;
@@ -337,6 +401,9 @@ WritablePacket::pool_allocate(uint32_t headroom, uint32_t length,
 	    delete p;
 	    return 0;
 	}
+#  if HAVE_MULTITHREAD
+	p->_data_node = packet_pool.node;
+#  endif
 	p->_data = p->_head + headroom;
 	p->_tail = p->_data + length;
 	p->_end = p->_head + n;
@@ -348,56 +415,67 @@ void
 WritablePacket::recycle(WritablePacket *p)
 {
     unsigned char *data = 0;
-    if (!p->_data_packet && p->_head && !p->_destructor
+    if (!p->_data_packet && p->_head && !p->buffer_destructor()
 	&& p->_end - p->_head == CLICK_PACKET_POOL_BUFSIZ) {
 	data = p->_head;
 	p->_head = 0;
     }
+#  if HAVE_MULTITHREAD
+    int data_node = p->_data_node;
+#  endif
     p->~WritablePacket();
 
 #  if HAVE_MULTITHREAD
     PacketPool &packet_pool = *get_packet_pool();
+    int node = packet_pool.node;
+    if (data && data_node >= 0 && data_node != node) {
+	recycle_remote_data(packet_pool, reinterpret_cast<PacketData *>(data), data_node);
+	data = 0;
+    }
+
+    PacketPool &gpp = global_packet_pool[node];
     if ((packet_pool.p && packet_pool.pcount == CLICK_PACKET_POOL_SIZE)
 	|| (data && packet_pool.pd && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE)) {
-	while (atomic_uint32_t::swap(global_packet_pool_lock, 1) == 1)
-	    /* do nothing */;
+	lock_global_packet_pool(node);
 
 	if (packet_pool.p && packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
-	    if (global_packet_pool.pcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
+	    if (gpp.pcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
 		while (WritablePacket *p = packet_pool.p) {
 		    packet_pool.p = static_cast<WritablePacket *>(p->next());
-		    ::operator delete((void *) p);
+		    Packet::operator delete((void *) p);
 		}
 	    } else {
-		packet_pool.p->set_prev(global_packet_pool.p);
-		global_packet_pool.p = packet_pool.p;
-		++global_packet_pool.pcount;
+		packet_pool.p->set_prev(gpp.p);
+		gpp.p = packet_pool.p;
+		++gpp.pcount;
 		packet_pool.p = 0;
 	    }
 	    packet_pool.pcount = 0;
 	}
 
 	if (data && packet_pool.pd && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
-	    if (global_packet_pool.pdcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
+	    if (gpp.pdcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
 		while (PacketData *pd = packet_pool.pd) {
 		    packet_pool.pd = pd->next;
 		    delete[] reinterpret_cast<unsigned char *>(pd);
 		}
 	    } else {
-		packet_pool.pd->pool_next = global_packet_pool.pd;
-		global_packet_pool.pd = packet_pool.pd;
-		++global_packet_pool.pdcount;
+		packet_pool.pd->pool_next = gpp.pd;
+		gpp.pd = packet_pool.pd;
+		++gpp.pdcount;
 		packet_pool.pd = 0;
+#   if CLICK_NUMA
+		Numa::stats[node].pool_buffers += CLICK_PACKET_POOL_SIZE;
+#   endif
 	    }
 	    packet_pool.pdcount = 0;
 	}
 
-	click_compiler_fence();
-	global_packet_pool_lock = 0;
+	unlock_global_packet_pool(node);
     }
 #  else
     if (packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
-	::operator delete((void *) p);
+	Packet::operator delete((void *) p);
 	p = 0;
     }
     if (data && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
@@ -435,6 +513,9 @@ Packet::alloc_data(uint32_t headroom, uint32_t length, uint32_t tailroom)
     unsigned char *d = new unsigned char[n];
     if (!d)
 	return false;
+# if HAVE_CLICK_PACKET_POOL && HAVE_MULTITHREAD
+    _data_node = Numa::current_node();
+# endif
     _head = d;
     _data = d + headroom;
     _tail = _data + length;
@@ -563,6 +644,8 @@ Packet::make(unsigned char *data, uint32_t length,
 	p->_head = p->_data = data;
 	p->_tail = p->_end = data + length;
 	p->_destructor = destructor;
+	if (destructor)
+	    p->_cold |= COLD_DESTRUCTOR;
     }
     return p;
 }
@@ -606,6 +689,7 @@ Packet::clone()
 # endif
 
     // timing: .31-.39 normal, .43-.55 two allocs, .55-.58 two memcpys
+    finish_copy();
 # if HAVE_CLICK_PACKET_POOL
     Packet *p = WritablePacket::pool_allocate(false);
 # else
@@ -613,13 +697,18 @@ Packet::clone()
 # endif
     if (!p)
 	return 0;
-    memcpy(p, this, sizeof(Packet));
+    // copy the hot members, and the cold ones only if they are in use
+    memcpy(p, this, reinterpret_cast<char *>(&_ca) - reinterpret_cast<char *>(this));
     p->_use_count = 1;
+    p->_cold = _cold & COLD_ANNO;
+    if (_cold & COLD_ANNO)
+	p->_ca = _ca;
     p->_data_packet = this;
-# if CLICK_USERLEVEL
-    p->_destructor = 0;
-# else
+# if CLICK_BSDMODULE
     p->_m = m;
+# endif
+# if CLICK_NS
+    p->_sim_packetinfo = _sim_packetinfo;
 # endif
     // increment our reference count because of _data_packet reference
     _use_count++;
@@ -701,6 +790,8 @@ Packet::expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom,
 
 #else /* !CLICK_LINUXMODULE */
 
+    finish_copy();
+
     // If someone else has cloned this packet, then we need to leave its data
     // pointers around. Make a clone and uniqueify that.
     if (_use_count > 1) {
@@ -730,11 +821,11 @@ Packet::expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom,
     if (_data_packet)
 	_data_packet->kill();
 # if CLICK_USERLEVEL
-    else if (_destructor)
+    else if (buffer_destructor())
 	_destructor(old_head, old_end - old_head);
     else
 	delete[] old_head;
-    _destructor = 0;
+    _cold &= ~COLD_DESTRUCTOR;
 # elif CLICK_BSDMODULE
     m_freem(old_m); // alloc_data() created a new mbuf, so free the old one
 # endif
@@ -748,6 +839,272 @@ Packet::expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom,
 }
 
 
+#if CLICK_USERLEVEL
+/* uniqueify_header() copies at least min_header_copy bytes, so that
+   consecutive header rewriters share one copy, and copies whole packets with
+   fewer than min_deferred_copy more bytes than that. */
+static const uint32_t min_header_copy = 128;
+static const uint32_t min_deferred_copy = 128;
+
+WritablePacket *
+Packet::expensive_uniqueify_header(uint32_t len, uint32_t push_len)
+{
+    int32_t extra_headroom = (headroom() < push_len ? (push_len + 128) & ~3 : 0);
+    if (len < min_header_copy)
+	len = min_header_copy;
+    WritablePacket *q;
+
+    // Short packets are copied whole.
+    finish_copy();
+    if (!shared()) {
+	if (extra_headroom)
+	    q = expensive_uniqueify(extra_headroom, 0, true);
+	else
+	    q = static_cast<WritablePacket *>(this);
+    } else if (len + min_deferred_copy > length())
+	q = expensive_uniqueify(extra_headroom, 0, true);
+    else if (_use_count > 1) {
+	// As in expensive_uniqueify(), leave our data to our clones.
+	Packet *p = clone();
+	q = (p ? p->expensive_uniqueify_header(len, push_len) : 0);
+	kill();
+	return q;
+    } else {
+	// Copy the headroom and the first len bytes of data into a buffer
+	// big enough for all of it, and leave the rest in a segment that
+	// shares the old buffer until it is copied.
+	Packet *owner = _data_packet;
+	unsigned char *old_head = _head, *old_data = _data;
+	Packet *seg = make_segment(owner, old_data + len, length() - len);
+	if (!seg)
+	    return expensive_uniqueify(extra_headroom, 0, true);
+	if (!alloc_data(headroom() + extra_headroom, length(), tailroom())) {
+	    seg->kill();
+	    kill();
+	    return 0;
+	}
+	memcpy(_head + extra_headroom, old_head, old_data - old_head + len);
+	_copy_packet = seg;
+	_copy_dst = _data + len;
+	_cold |= COLD_COPY;
+	_data_packet = 0;
+	owner->kill();
+	shift_header_annotations(old_head, extra_headroom);
+	q = static_cast<WritablePacket *>(this);
+    }
+
+    if (q)
+	q->_data -= push_len;
+    return q;
+}
+
+void
+Packet::expensive_finish_copy()
+{
+    unsigned char *dst = _copy_dst;
+    for (Packet *seg = _copy_packet; seg && dst < _tail; seg = seg->next()) {
+	uint32_t n = seg->_tail - seg->_data;
+	if (n > (uint32_t) (_tail - dst))
+	    n = _tail - dst;
+	memcpy(dst, seg->_data, n);
+	dst += n;
+    }
+    _cold &= ~COLD_COPY;
+    kill_segments(_copy_packet);
+}
+
+/* A segment packet's data is a piece of owner's buffer, which it keeps
+   alive through _data_packet, as a clone does. */
+Packet *
+Packet::make_segment(Packet *owner, const unsigned char *data, uint32_t len)
+{
+# if HAVE_CLICK_PACKET_POOL
+    WritablePacket *p = WritablePacket::pool_allocate(false);
+# else
+    WritablePacket *p = new WritablePacket;
+# endif
+    if (p) {
+	p->initialize();
+	p->_head = p->_data = const_cast<unsigned char *>(data);
+	p->_tail = p->_end = p->_data + len;
+	p->_data_packet = owner;
+	owner->_use_count++;
+    }
+    return p;
+}
+
+void
+Packet::kill_segments(Packet *seg)
+{
+    while (seg) {
+	Packet *next = seg->next();
+	seg->kill();
+	seg = next;
+    }
+}
+
+/* Call f(data, length, owner) for each contiguous run of this packet's data,
+   in order, without finishing a pending copy.  owner is the packet whose
+   buffer holds the run. */
+template <typename F> void
+Packet::each_segment(F &f) const
+{
+    Packet *self = const_cast<Packet *>(this);
+    const unsigned char *end = _tail;
+    if (_cold & COLD_COPY)
+	end = (_copy_dst < _tail ? _copy_dst : _tail);
+    if (_data < end)
+	f(_data, end - _data, _data_packet ? _data_packet : self);
+    if (!(_cold & COLD_COPY))
+	return;
+    // pos is where the current segment's data will go in our buffer.
+    const unsigned char *pos = _copy_dst;
+    for (Packet *seg = _copy_packet; seg && pos < _tail; seg = seg->next()) {
+	uint32_t n = seg->_tail - seg->_data;
+	const unsigned char *first = (pos < _data ? _data : pos);
+	const unsigned char *last = (pos + n < _tail ? pos + n : _tail);
+	if (first < last)
+	    f(seg->_data + (first - pos), last - first, seg->_data_packet);
+	pos += n;
+    }
+}
+
+namespace {
+struct SegmentRecorder {
+    Packet::Segment *seg;
+    int nseg;
+    int n;
+    void operator()(const unsigned char *data, uint32_t length, Packet *) {
+	if (n < nseg) {
+	    seg[n].data = data;
+	    seg[n].length = length;
+	}
+	++n;
+    }
+};
+}
+
+struct Packet::SegmentAppender {
+    Packet **tailp;
+    uint32_t offset;
+    uint32_t len;
+    bool ok;
+    void operator()(const unsigned char *data, uint32_t length, Packet *owner) {
+	if (offset >= length) {
+	    offset -= length;
+	    return;
+	}
+	data += offset;
+	length -= offset;
+	offset = 0;
+	if (length > len)
+	    length = len;
+	if (length && ok) {
+	    if ((*tailp = Packet::make_segment(owner, data, length))) {
+		tailp = &(*tailp)->next();
+		len -= length;
+	    } else
+		ok = false;
+	}
+    }
+};
+#endif
+
+/** @brief Return the contiguous runs of this packet's data.
+ * @param seg array of segments
+ * @param nseg size of @a seg
+ * @return the number of segments in the packet
+ *
+ * Stores up to @a nseg segments, which together hold the packet's data from
+ * data() to end_data(), in @a seg, and returns the total number of
+ * segments.  Unlike data(), this does not finish a pending copy, so it suits
+ * code that can handle scattered data, such as calls to writev():
+ * @code
+ * Packet::Segment seg[8];
+ * int n = p->segments(seg, 8);
+ * if (n > 8)
+ *     ... // too many segments; use p->data() instead
+ * @endcode
+ * The segments are valid until the packet's data or length changes.  A
+ * packet whose copy_pending() is false has exactly one segment.
+ * @sa append_shared, copy_pending */
+int
+Packet::segments(Segment *seg, int nseg) const
+{
+#if CLICK_USERLEVEL
+    SegmentRecorder f = { seg, nseg, 0 };
+    each_segment(f);
+    return f.n;
+#else
+    if (nseg > 0) {
+	seg[0].data = data();
+	seg[0].length = length();
+    }
+    return 1;
+#endif
+}
+
+/** @brief Append part of another packet's data to this packet.
+ * @param p source packet
+ * @param offset offset of the first byte to append in @a p's data
+ * @param len number of bytes to append
+ * @return true on success, false if the data could not be appended
+ *
+ * Appends @a len bytes of @a p's data, starting at @a offset, to the end of
+ * this packet's data, reserving tailroom() for them.  The bytes are not
+ * copied: this packet shares @a p's buffer for them, and copy_pending()
+ * becomes true, until something reads them through data() or another
+ * accessor.  Elements that split packets, such as IPFragmenter and
+ * TCPFragmenter, use append_shared() to build small header packets that
+ * refer to the payload of a large packet.
+ *
+ * Returns false, leaving this packet unchanged, if @a offset and @a len
+ * exceed @a p's length, if tailroom() is less than @a len, or if this packet
+ * is shared.  Builds without segment support copy the data instead. */
+bool
+Packet::append_shared(Packet *p, uint32_t offset, uint32_t len)
+{
+    if (offset > p->length() || len > p->length() - offset
+	|| tailroom() < len || shared() || p == this)
+	return false;
+#if CLICK_USERLEVEL
+    if (len == 0)
+	return true;
+    Packet **tailp = &_copy_packet;
+    if (_cold & COLD_COPY) {
+	// take() may have shortened the pending data; if so, finish copying
+	// it, since the chain must end at _tail.
+	uint32_t n = 0;
+	for (Packet *seg = _copy_packet; seg; seg = seg->next()) {
+	    n += seg->_tail - seg->_data;
+	    tailp = &seg->next();
+	}
+	if (n != (uint32_t) (_tail - _copy_dst)) {
+	    expensive_finish_copy();
+	    tailp = &_copy_packet;
+	}
+    }
+    Packet **oldtailp = tailp;
+    SegmentAppender f = { tailp, offset, len, true };
+    p->each_segment(f);
+    if (!f.ok) {
+	kill_segments(*oldtailp);
+	*oldtailp = 0;
+	return false;
+    }
+    if (!(_cold & COLD_COPY)) {
+	_copy_dst = _tail;
+	_cold |= COLD_COPY;
+    }
+    _tail += len;
+    return true;
+#else
+    WritablePacket *q = put(len);
+    memcpy(q->end_data() - len, p->data() + offset, len);
+    return true;
+#endif
+}
+
 
 #ifdef CLICK_BSDMODULE		/* BSD kernel module */
 struct mbuf *
@@ -916,7 +1273,7 @@ cleanup_pool(PacketPool *pp, int global)
     while (WritablePacket *p = pp->p) {
 	++pcount;
 	pp->p = static_cast<WritablePacket *>(p->next());
-	::operator delete((void *) p);
+	Packet::operator delete((void *) p);
     }
     while (PacketData *pd = pp->pd) {
 	++pdcount;
@@ -937,21 +1294,29 @@ Packet::static_cleanup()
     while (PacketPool *pp = all_thread_packet_pools) {
 	all_thread_packet_pools = pp->chain;
 	cleanup_pool(pp, 0);
+	for (int node = 0; node < Numa::MAX_NODES; ++node)
+	    while (PacketData *pd = pp->remote_pd[node]) {
+		pp->remote_pd[node] = pd->next;
+		delete[] reinterpret_cast<unsigned char *>(pd);
+	    }
 	delete pp;
     }
-    unsigned rounds = (global_packet_pool.pcount > global_packet_pool.pdcount ? global_packet_pool.pcount : global_packet_pool.pdcount);
-    assert(rounds <= CLICK_GLOBAL_PACKET_POOL_COUNT);
-    while (global_packet_pool.p || global_packet_pool.pd) {
-	WritablePacket *next_p = global_packet_pool.p;
-	next_p = (next_p ? static_cast<WritablePacket *>(next_p->prev()) : 0);
-	PacketData *next_pd = global_packet_pool.pd;
-	next_pd = (next_pd ? next_pd->pool_next : 0);
-	cleanup_pool(&global_packet_pool, 1);
-	global_packet_pool.p = next_p;
-	global_packet_pool.pd = next_pd;
-	--rounds;
-    }
-    assert(rounds == 0);
+    for (int node = 0; node < Numa::MAX_NODES; ++node) {
+	PacketPool &gpp = global_packet_pool[node];
+	unsigned rounds = (gpp.pcount > gpp.pdcount ? gpp.pcount : gpp.pdcount);
+	assert(rounds <= CLICK_GLOBAL_PACKET_POOL_COUNT);
+	while (gpp.p || gpp.pd) {
+	    WritablePacket *next_p = gpp.p;
+	    next_p = (next_p ? static_cast<WritablePacket *>(next_p->prev()) : 0);
+	    PacketData *next_pd = gpp.pd;
+	    next_pd = (next_pd ? next_pd->pool_next : 0);
+	    cleanup_pool(&gpp, 1);
+	    gpp.p = next_p;
+	    gpp.pd = next_pd;
+	    --rounds;
+	}
+	assert(rounds == 0);
+    }
 # else
     cleanup_pool(&packet_pool, 0);
 # endif
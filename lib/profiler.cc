@@ -0,0 +1,300 @@
+// -*- c-basic-offset: 4; related-file-name: "../include/click/profiler.hh" -*-
+/*
+ * profiler.{cc,hh} -- sampling cycle profiler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/profiler.hh>
+#include <click/element.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+CLICK_DECLS
+#if CLICK_PROFILER
+
+/** @file profiler.hh
+ * @brief A sampling cycle profiler for user-level drivers.
+ */
+
+/** @class Profiler
+ * @brief Sampling cycle profiler for a router.
+ *
+ * A Profiler samples about one in every period() events per thread, where an
+ * event is a task firing, a timer firing, or a file descriptor selection.
+ * Gaps between samples are randomized to avoid aliasing with periodic
+ * schedules.  While a sampled event runs, every push and pull transfer records its element's own
+ * cycle count and the path of elements leading to it.  Unsampled events and
+ * transfers cost a predictable branch each.
+ *
+ * The results are per-element and per-event cycle histograms, estimated
+ * per-port packet rates, and folded call stacks suitable for flame graph
+ * tools.  They are available through the router's profile_* global
+ * handlers. */
+
+#if HAVE_MULTITHREAD
+__thread ProfilerThreadState click_profiler_state;
+#else
+ProfilerThreadState click_profiler_state;
+#endif
+uint32_t Profiler::nactive;
+
+static const char * const kind_names[] = { "xfer", "task", "timer", "select" };
+
+void
+Profiler::Histogram::add(click_cycles_t c)
+{
+    int b = (c ? (int) (sizeof(c) * 8) - ffs_msb(c) : 0);
+    ++bucket[b < NBUCKETS ? b : NBUCKETS - 1];
+    ++count;
+    cycles += c;
+}
+
+click_cycles_t
+Profiler::Histogram::percentile(int pct) const
+{
+    // upper bound of the bucket containing the pct'th percentile
+    uint64_t want = ((uint64_t) count * pct + 99) / 100, seen = 0;
+    for (int b = 0; b < NBUCKETS; ++b)
+	if ((seen += bucket[b]) >= want && seen)
+	    return ((click_cycles_t) 2 << b) - 1;
+    return 0;
+}
+
+Profiler::Profiler(Router *router)
+    : _router(router), _period(0), _port_samples(0), _stacks(0)
+{
+    reset();
+}
+
+Profiler::~Profiler()
+{
+    set_period(0);
+}
+
+/** @brief Set the sampling period.
+ * @param period sample one in @a period events per thread; 0 disables
+ * sampling */
+void
+Profiler::set_period(uint32_t period)
+{
+    if (period > 0x40000000)
+	period = 0x40000000;
+    if (!_period && period)
+	atomic_uint32_t::inc(nactive);
+    else if (_period && !period)
+	atomic_uint32_t::dec_and_test(nactive);
+    _period = period;
+}
+
+/** @brief Discard all samples and restart the rate measurement epoch. */
+void
+Profiler::reset()
+{
+    _lock.acquire();
+    for (int k = 0; k < NKINDS; ++k)
+	_hist[k].clear();
+    _port_samples.clear();
+    _stacks.clear();
+    _epoch = Timestamp::now();
+    _lock.release();
+}
+
+bool
+Profiler::start_sample(Element *owner, int kind)
+{
+    ProfilerThreadState &ps = click_profiler_state;
+    Profiler *prof = (owner ? owner->router()->profiler() : 0);
+    if (!prof || !prof->_period) {
+	// another router is sampling; check again later
+	ps.countdown = 1024;
+	return false;
+    }
+    // mean gap is _period; two tasks alternating on one thread would alias
+    // with a fixed gap
+    ps.countdown = 1 + click_random(0, 2 * prof->_period - 2);
+    ps.kind = kind;
+    ps.profiler = prof;
+    ps.depth = 1;
+    ProfilerThreadState::Frame &f = ps.frames[0];
+    f.e = owner;
+    f.port = 0;
+    f.child = 0;
+    f.start = click_get_cycles();
+    return true;
+}
+
+/** @brief Finish sampling the current event.
+ * @pre begin_sample() returned true */
+void
+Profiler::end_sample()
+{
+    ProfilerThreadState &ps = click_profiler_state;
+    ProfilerThreadState::Frame &f = ps.frames[0];
+    click_cycles_t total = click_get_cycles() - f.start;
+    ps.profiler->record(ps, 1, ps.kind, total - f.child, total);
+    ps.depth = 0;
+}
+
+/** @brief Record entry into element @a e during a sampled event.
+ * @param e element being pushed to or pulled from
+ * @param port input port for a push, or -1 - output port for a pull */
+void
+Profiler::enter(Element *e, int port)
+{
+    ProfilerThreadState &ps = click_profiler_state;
+    if (ps.depth < ProfilerThreadState::MAX_DEPTH) {
+	ProfilerThreadState::Frame &f = ps.frames[ps.depth];
+	f.e = e;
+	f.port = port;
+	f.child = 0;
+	f.start = click_get_cycles();
+    }
+    ++ps.depth;
+}
+
+/** @brief Record exit from the element most recently enter()ed. */
+void
+Profiler::leave()
+{
+    ProfilerThreadState &ps = click_profiler_state;
+    int d = --ps.depth;
+    if (d < ProfilerThreadState::MAX_DEPTH) {
+	ProfilerThreadState::Frame &f = ps.frames[d];
+	click_cycles_t total = click_get_cycles() - f.start;
+	ps.frames[d - 1].child += total;
+	ps.profiler->record(ps, d + 1, K_XFER, total - f.child, total - f.child);
+    }
+}
+
+void
+Profiler::record(const ProfilerThreadState &ps, int nframes, int kind,
+		 click_cycles_t own, click_cycles_t hist_cycles)
+{
+    const ProfilerThreadState::Frame &f = ps.frames[nframes - 1];
+    int stack[ProfilerThreadState::MAX_DEPTH + 1];
+    stack[0] = ps.kind;
+    for (int i = 0; i < nframes; ++i)
+	stack[i + 1] = ps.frames[i].e->eindex();
+    String key(reinterpret_cast<const char *>(stack), (nframes + 1) * sizeof(int));
+
+    _lock.acquire();
+    int ei = f.e->eindex();
+    if (ei >= 0) {
+	if (ei >= _hist[kind].size())
+	    _hist[kind].resize(ei + 1);
+	_hist[kind][ei].add(hist_cycles);
+	if (kind == K_XFER) {
+	    uint32_t pkey = (ei << 16) | (f.port < 0 ? 0x8000 | (-1 - f.port) : f.port);
+	    ++_port_samples[pkey];
+	}
+    }
+    _stacks[key] += own;
+    _lock.release();
+}
+
+static String
+profiler_element_name(Router *router, int ei)
+{
+    if (ei >= 0 && ei < router->nelements())
+	return router->ename(ei);
+    else
+	return String::make_stable("<unknown>");
+}
+
+/** @brief Unparse cycle histograms as CSV.
+ *
+ * Each row describes one element and one kind of sample: "xfer" rows
+ * measure the element's own cycles per push or pull, while "task", "timer",
+ * and "select" rows measure the total cycles of events the element owns.
+ * Percentiles are upper bounds from power-of-two histogram buckets. */
+void
+Profiler::unparse_cycles(StringAccum &sa) const
+{
+    sa << "name,class,kind,samples,cycles,cycles_per_sample,p50,p90,p99\n";
+    _lock.acquire();
+    for (int ei = 0; ei < _router->nelements(); ++ei)
+	for (int k = 0; k < NKINDS; ++k)
+	    if (ei < _hist[k].size() && _hist[k][ei].count) {
+		const Histogram &h = _hist[k][ei];
+		sa << _router->ename(ei) << ','
+		   << _router->element(ei)->class_name() << ','
+		   << kind_names[k] << ','
+		   << h.count << ','
+		   << h.cycles << ','
+		   << int_divide(h.cycles, h.count) << ','
+		   << h.percentile(50) << ','
+		   << h.percentile(90) << ','
+		   << h.percentile(99) << '\n';
+	    }
+    _lock.release();
+}
+
+/** @brief Unparse estimated per-port packet counts and rates as CSV.
+ *
+ * Ports are named like "i0" (an input port, for pushes) or "o1" (an output
+ * port, for pulls).  Estimates scale sampled transfers by period(). */
+void
+Profiler::unparse_ports(StringAccum &sa) const
+{
+    sa << "name,port,samples,packets,packets_per_sec\n";
+    _lock.acquire();
+    Vector<uint32_t> keys;
+    for (HashTable<uint32_t, uint32_t>::const_iterator it = _port_samples.begin();
+	 it != _port_samples.end(); ++it)
+	keys.push_back(it.key());
+    click_qsort(keys.begin(), keys.size());
+    Timestamp::value_type msec = (Timestamp::now() - _epoch).msecval();
+    if (msec <= 0)
+	msec = 1;
+    for (uint32_t *kp = keys.begin(); kp != keys.end(); ++kp) {
+	uint32_t samples = _port_samples.get(*kp);
+	uint64_t packets = (uint64_t) samples * (_period ? _period : 1);
+	sa << profiler_element_name(_router, *kp >> 16) << ','
+	   << (*kp & 0x8000 ? 'o' : 'i') << (*kp & 0x7FFF) << ','
+	   << samples << ','
+	   << packets << ','
+	   << int_divide(packets * 1000, (uint32_t) msec) << '\n';
+    }
+    _lock.release();
+}
+
+/** @brief Unparse sampled call stacks in folded format.
+ *
+ * Each line has the form "KIND;ELEMENT;ELEMENT... CYCLES", where the first
+ * element owns the sampled event and each following element was reached by
+ * push or pull.  CYCLES counts sampled cycles spent in the last element
+ * itself.  The format is accepted by common flame graph tools. */
+void
+Profiler::unparse_flamegraph(StringAccum &sa) const
+{
+    Vector<String> lines;
+    _lock.acquire();
+    for (HashTable<String, click_cycles_t>::const_iterator it = _stacks.begin();
+	 it != _stacks.end(); ++it) {
+	StringAccum line;
+	const int *stack = reinterpret_cast<const int *>(it.key().data());
+	int n = it.key().length() / sizeof(int);
+	line << kind_names[stack[0]];
+	for (int i = 1; i < n; ++i)
+	    line << ';' << profiler_element_name(_router, stack[i]);
+	line << ' ' << it.value() << '\n';
+	lines.push_back(line.take_string());
+    }
+    _lock.release();
+    click_qsort(lines.begin(), lines.size());
+    for (String *lp = lines.begin(); lp != lines.end(); ++lp)
+	sa << *lp;
+}
+
+#endif
+CLICK_ENDDECLS
@@ -37,6 +37,13 @@
 #if CLICK_STATS >= 2
 # include <click/hashtable.hh>
 #endif
+#if CLICK_PROFILER
+# include <click/profiler.hh>
+#endif
+#if CLICK_LATENCY_TRACE
+# include <click/latencytracer.hh>
+#endif
+#include <click/numa.hh>
 #include <click/standard/errorelement.hh>
 #include <click/standard/threadsched.hh>
 #if CLICK_BSDMODULE
@@ -83,7 +90,14 @@ Router::Router(const String &configuration, Master *master)
       _configuration(configuration),
       _notifier_signals(0),
       _arena_factory(new HashMap_ArenaFactory),
-      _hotswap_router(0), _thread_sched(0), _name_info(0), _next_router(0)
+      _hotswap_router(0), _thread_sched(0), _name_info(0),
+#if CLICK_PROFILER
+      _profiler(0),
+#endif
+#if CLICK_LATENCY_TRACE
+      _latency_tracer(0),
+#endif
+      _next_router(0)
 {
     _refcount = 0;
     _runcount = 0;
@@ -151,6 +165,12 @@ Router::~Router()
 	delete ns;
     }
     delete _name_info;
+#if CLICK_PROFILER
+    delete _profiler;
+#endif
+#if CLICK_LATENCY_TRACE
+    delete _latency_tracer;
+#endif
     if (_master)
 	_master->unregister_router(this);
 }
@@ -1940,6 +1960,32 @@ Router::force_name_info()
 }
 /** @endcond never */
 
+#if CLICK_PROFILER
+/** @brief  Create (if necessary) and return the Profiler for this router. */
+Profiler*
+Router::force_profiler()
+{
+    if (!_profiler)
+	_profiler = new Profiler(this);
+    return _profiler;
+}
+#endif
+
+#if CLICK_LATENCY_TRACE
+/** @brief  Install @a tracer as this router's LatencyTracer.
+ *
+ * The router takes ownership of @a tracer and deletes any previous
+ * tracer. */
+void
+Router::set_latency_tracer(LatencyTracer* tracer)
+{
+    if (tracer != _latency_tracer) {
+	delete _latency_tracer;
+	_latency_tracer = tracer;
+    }
+}
+#endif
+
 
 // PRINTING
 
@@ -2169,7 +2215,10 @@ Router::configuration_string() const
 enum { GH_VERSION, GH_CONFIG, GH_FLATCONFIG, GH_LIST, GH_REQUIREMENTS,
        GH_DRIVER, GH_ACTIVE_PORTS, GH_ACTIVE_PORT_STATS, GH_STRING_PROFILE,
        GH_STRING_PROFILE_LONG, GH_SCHEDULING_PROFILE, GH_STOP,
-       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES };
+       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES,
+       GH_PROFILE_SAMPLE, GH_PROFILE_CYCLES, GH_PROFILE_PORTS,
+       GH_PROFILE_FLAMEGRAPH, GH_RESET_PROFILE, GH_NUMA_MEMORY,
+       GH_TIMER_STATS, GH_RESET_TIMER_STATS };
 
 #if CLICK_STATS >= 2
 struct stats_info {
@@ -2354,6 +2403,50 @@ Router::router_read_handler(Element *e, void *thunk)
     }
 #endif
 
+#if CLICK_PROFILER
+    case GH_PROFILE_SAMPLE:
+	if (r && r->_profiler)
+	    sa << r->_profiler->period();
+	else
+	    sa << 0;
+	break;
+
+    case GH_PROFILE_CYCLES:
+	if (r && r->_profiler)
+	    r->_profiler->unparse_cycles(sa);
+	break;
+
+    case GH_PROFILE_PORTS:
+	if (r && r->_profiler)
+	    r->_profiler->unparse_ports(sa);
+	break;
+
+    case GH_PROFILE_FLAMEGRAPH:
+	if (r && r->_profiler)
+	    r->_profiler->unparse_flamegraph(sa);
+	break;
+#endif
+
+#if CLICK_NUMA
+    case GH_NUMA_MEMORY:
+	Numa::unparse_stats(sa);
+	break;
+#endif
+
+    case GH_TIMER_STATS:
+	if (!r)
+	    break;
+	sa << "thread,heap,wheel,heap_schedules,wheel_schedules,heap_fires,wheel_fires,wheel_batches,cascades\n";
+	for (int i = 0; i < r->master()->nthreads(); ++i) {
+	    const TimerSet &ts = r->master()->thread(i)->timer_set();
+	    const TimerSet::stats_type &st = ts.stats();
+	    sa << i << ',' << ts.heap_size() << ',' << ts.wheel_size() << ','
+	       << st.heap_schedules << ',' << st.wheel_schedules << ','
+	       << st.heap_fires << ',' << st.wheel_fires << ','
+	       << st.wheel_batches << ',' << st.cascades << '\n';
+	}
+	break;
+
     }
     return sa.take_string();
 }
@@ -2374,11 +2467,29 @@ Router::router_write_handler(const String &s, Element *e, void *thunk, ErrorHand
 	    errh->message("no router to stop");
 	break;
     }
+    case GH_RESET_TIMER_STATS:
+	for (int i = 0; i < r->master()->nthreads(); ++i)
+	    r->master()->thread(i)->timer_set().reset_stats();
+	break;
 #if CLICK_STATS >= 2
     case GH_RESET_CYCLES:
 	for (int i = 0; i < (r ? r->nelements() : 0); i++)
 	    r->_elements[i]->reset_cycles();
 	break;
+#endif
+#if CLICK_PROFILER
+    case GH_PROFILE_SAMPLE: {
+	uint32_t period;
+	if (!IntArg().parse(s, period))
+	    return errh->error("syntax error");
+	if (period || r->_profiler)
+	    r->force_profiler()->set_period(period);
+	break;
+    }
+    case GH_RESET_PROFILE:
+	if (r->_profiler)
+	    r->_profiler->reset();
+	break;
 #endif
     default:
 	break;
@@ -2399,6 +2510,8 @@ Router::static_initialize()
 	add_read_handler(0, "handlers", Element::read_handlers_handler, 0);
 	add_read_handler(0, "list", router_read_handler, (void *)GH_LIST);
 	add_write_handler(0, "stop", router_write_handler, (void *)GH_STOP);
+	add_read_handler(0, "timer_stats", router_read_handler, (void *)GH_TIMER_STATS);
+	add_write_handler(0, "reset_timer_stats", router_write_handler, (void *)GH_RESET_TIMER_STATS);
 #if CLICK_STATS >= 1
 	add_read_handler(0, "active_ports", router_read_handler, (void *)GH_ACTIVE_PORTS);
 	add_read_handler(0, "active_port_stats", router_read_handler, (void *)GH_ACTIVE_PORT_STATS);
@@ -2416,6 +2529,17 @@ Router::static_initialize()
         add_read_handler(0, "element_cycles.csv", router_read_handler, (void *)GH_ELEMENT_CYCLES);
         add_read_handler(0, "class_cycles.csv", router_read_handler, (void *)GH_CLASS_CYCLES);
         add_write_handler(0, "reset_cycles", router_write_handler, (void *)GH_RESET_CYCLES);
+#endif
+#if CLICK_PROFILER
+	add_read_handler(0, "profile_sample", router_read_handler, (void *)GH_PROFILE_SAMPLE);
+	add_write_handler(0, "profile_sample", router_write_handler, (void *)GH_PROFILE_SAMPLE);
+	add_read_handler(0, "profile_cycles.csv", router_read_handler, (void *)GH_PROFILE_CYCLES);
+	add_read_handler(0, "profile_ports.csv", router_read_handler, (void *)GH_PROFILE_PORTS);
+	add_read_handler(0, "profile_flamegraph", router_read_handler, (void *)GH_PROFILE_FLAMEGRAPH);
+	add_write_handler(0, "reset_profile", router_write_handler, (void *)GH_RESET_PROFILE);
+#endif
+#if CLICK_NUMA
+	add_read_handler(0, "numa_memory", router_read_handler, (void *)GH_NUMA_MEMORY);
 #endif
     }
 }
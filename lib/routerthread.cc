@@ -25,6 +25,7 @@
 #include <click/router.hh>
 #include <click/routerthread.hh>
 #include <click/master.hh>
+#include <click/numa.hh>
 #if CLICK_LINUXMODULE
 # include <click/cxxprotect.h>
 CLICK_CXX_PROTECT
@@ -40,6 +41,7 @@ CLICK_CXX_UNPROTECT
 # include <click/cxxunprotect.h>
 #elif CLICK_USERLEVEL
 # include <fcntl.h>
+# include <time.h>
 #endif
 CLICK_DECLS
 
@@ -109,6 +111,16 @@ RouterThread::RouterThread(Master *master, int id)
 #if CLICK_LINUXMODULE
     greedy_schedule_jiffies = jiffies;
 #endif
+#if CLICK_USERLEVEL
+    _idle_policy = IDLE_POLL;
+    _idle_iters = 0;
+    _idle_spin = _idle_pause = 1000;
+    _idle_sleep_usec = 0;
+    _idle_max_sleep_usec = 1000;
+    reset_cycle_stats();
+    _numa_node = -1;
+    _cpu = -1;
+#endif
 
 #if CLICK_NS
     _ns_scheduled = _ns_last_active = Timestamp(-1, 0);
@@ -301,6 +313,82 @@ RouterThread::client_update_pass(int client, const Timestamp &t_before)
 
 #endif
 
+/******************************/
+/* Adaptive idle policy       */
+/******************************/
+
+#if CLICK_USERLEVEL
+
+/** @brief Set this thread's idle policy.
+ * @param policy IDLE_POLL or IDLE_ADAPTIVE
+ * @param spin idle driver iterations to busy-poll before backing off
+ * @param pause further idle iterations to spend in CPU pause loops
+ * @param max_sleep_usec maximum sleep per idle iteration, in microseconds
+ *
+ * Under IDLE_POLL, the default, a thread with scheduled tasks polls them
+ * continuously even if they find no work.  Under IDLE_ADAPTIVE, a thread
+ * whose tasks stop finding work first busy-polls for @a spin iterations,
+ * then executes pause instructions for @a pause iterations, then sleeps for
+ * exponentially increasing periods up to @a max_sleep_usec.  Sleeps shorter
+ * than a millisecond use nanosleep(); longer sleeps block in the thread's
+ * SelectSet, so file descriptor events and wakeups from other threads (for
+ * instance, Notifier signals that reschedule a task) end them early.  Any
+ * task that reports work returns the thread to busy-polling. */
+void
+RouterThread::set_idle_policy(int policy, unsigned spin, unsigned pause,
+			      uint32_t max_sleep_usec)
+{
+    _idle_spin = spin;
+    _idle_pause = pause;
+    _idle_max_sleep_usec = (max_sleep_usec ? max_sleep_usec : 1);
+    _idle_sleep_usec = 0;
+    _idle_policy = policy;
+    wake();
+}
+
+/** @brief Reset this thread's busy and idle cycle counts. */
+void
+RouterThread::reset_cycle_stats()
+{
+    _busy_cycles = _idle_cycles = 0;
+    _idle_sleeps = 0;
+}
+
+bool
+RouterThread::idle_backoff()
+{
+    // must be called with thread's lock acquired
+    if (_idle_iters - _idle_spin <= _idle_pause) {
+	set_thread_state(S_PAUSED);
+	for (int i = 0; i < IDLE_PAUSE_BATCH; ++i)
+	    click_relax_fence();
+	return false;
+    }
+
+    if (_idle_sleep_usec < _idle_max_sleep_usec)
+	_idle_sleep_usec = (_idle_sleep_usec ? _idle_sleep_usec * 2 : 1);
+    if (_idle_sleep_usec > _idle_max_sleep_usec)
+	_idle_sleep_usec = _idle_max_sleep_usec;
+    ++_idle_sleeps;
+
+    if (idle_sleeping()) {
+	// block in select; wake() and file descriptors interrupt the sleep
+	run_os();
+	return true;
+    }
+
+    set_thread_state(S_PAUSED);
+    driver_unlock_tasks();
+    struct timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = _idle_sleep_usec * 1000;
+    nanosleep(&ts, 0);
+    driver_lock_tasks();
+    return false;
+}
+
+#endif
+
 /******************************/
 /* Debugging                  */
 /******************************/
@@ -362,8 +450,8 @@ RouterThread::task_reheapify_from(int pos, Task* t)
 }
 #endif
 
-/* Run at most 'ntasks' tasks. */
-inline void
+/* Run at most 'ntasks' tasks. Return true if any task did work. */
+inline bool
 RouterThread::run_tasks(int ntasks)
 {
     set_thread_state(S_RUNTASK);
@@ -398,7 +486,10 @@ RouterThread::run_tasks(int ntasks)
 #if HAVE_MULTITHREAD
     int runs;
 #endif
-    bool work_done;
+    bool work_done, any_work_done = false;
+#if CLICK_USERLEVEL
+    bool any_fired = false;
+#endif
 
     for (; ntasks >= 0; --ntasks) {
 	t = task_begin();
@@ -420,6 +511,10 @@ RouterThread::run_tasks(int ntasks)
 
 	t->_status.is_scheduled = false;
 	work_done = t->fire();
+	any_work_done |= work_done;
+#if CLICK_USERLEVEL
+	any_fired = true;
+#endif
 
 #if HAVE_MULTITHREAD
 	if (runs > PROFILE_ELEMENT) {
@@ -482,12 +577,20 @@ RouterThread::run_tasks(int ntasks)
 	    t->remove_from_scheduled_list();
     }
 
+#if CLICK_USERLEVEL
+    // count iterations in which scheduled tasks found no work
+    if (any_work_done)
+	_idle_iters = _idle_sleep_usec = 0;
+    else if (any_fired && _idle_iters + 1 != 0)
+	++_idle_iters;
+#endif
 #if CLICK_BSDMODULE && !BSD_NETISRSCHED
     splx(bsd_spl);
 #endif
 #if HAVE_ADAPTIVE_SCHEDULER
     client_update_pass(C_CLICK, t_before);
 #endif
+    return any_work_done;
 }
 
 inline void
@@ -584,6 +687,17 @@ RouterThread::driver()
     _linux_task = current;
 #elif CLICK_USERLEVEL
     select_set().initialize();
+# if CLICK_NUMA
+    if (_cpu >= 0) {
+	int r = Numa::bind_current_cpu(_cpu);
+	if (r < 0)
+	    click_chatter("thread %d: cannot bind to CPU %d: %s", _id, _cpu, strerror(-r));
+    } else if (_numa_node >= 0) {
+	int r = Numa::bind_current_thread(_numa_node);
+	if (r < 0)
+	    click_chatter("thread %d: cannot bind to NUMA node %d: %s", _id, _numa_node, strerror(-r));
+    }
+# endif
 # if CLICK_USERLEVEL && HAVE_MULTITHREAD
     _running_processor = click_current_processor();
 #  if HAVE___THREAD_STORAGE_CLASS
@@ -610,6 +724,10 @@ RouterThread::driver()
     _adaptive_restride_iter = 0;
 #endif
 
+#if CLICK_USERLEVEL
+    click_cycles_t cycles = click_get_cycles();
+#endif
+
     while (1) {
 #if CLICK_DEBUG_SCHEDULING
 	_driver_epoch++;
@@ -635,12 +753,19 @@ RouterThread::driver()
 	    process_pending();
 
 	// run tasks
+#if CLICK_USERLEVEL
+	bool busy = false;
+#endif
 	do {
 #if HAVE_ADAPTIVE_SCHEDULER
 	    if (PASS_GT(_clients[C_CLICK].pass, _clients[C_KERNEL].pass))
 		break;
 #endif
+#if CLICK_USERLEVEL
+	    busy = run_tasks(_tasks_per_iter);
+#else
 	    run_tasks(_tasks_per_iter);
+#endif
 	} while (0);
 
 #if CLICK_USERLEVEL
@@ -663,6 +788,12 @@ RouterThread::driver()
 
 	// run operating system
 	do {
+#if CLICK_USERLEVEL
+	    // back off when scheduled tasks stop finding work
+	    if (_idle_policy == IDLE_ADAPTIVE && _idle_iters > _idle_spin
+		&& active() && idle_backoff())
+		break;
+#endif
 #if !HAVE_ADAPTIVE_SCHEDULER && !BSD_NETISRSCHED
 	    if (iter % _iters_per_os)
 		break;
@@ -675,6 +806,16 @@ RouterThread::driver()
 	    run_os();
 	} while (0);
 
+#if CLICK_USERLEVEL
+	// account this iteration as busy if any task did work
+	click_cycles_t now_cycles = click_get_cycles();
+	if (busy)
+	    _busy_cycles += now_cycles - cycles;
+	else
+	    _idle_cycles += now_cycles - cycles;
+	cycles = now_cycles;
+#endif
+
 #if CLICK_NS || BSD_NETISRSCHED
 	// Everyone except the NS driver stays in driver() until the driver is
 	// stopped.
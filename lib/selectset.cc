@@ -363,10 +363,26 @@ SelectSet::call_selected(int fd, int mask) const
 	if (mask & Element::SELECT_WRITE)
 	    write = es.write;
     }
-    if (read)
+    if (read) {
+#if CLICK_PROFILER
+	bool sampled = Profiler::begin_sample(read, Profiler::K_SELECT);
+#endif
 	read->selected(fd, write == read ? mask : Element::SELECT_READ);
-    if (write && write != read)
+#if CLICK_PROFILER
+	if (unlikely(sampled))
+	    Profiler::end_sample();
+#endif
+    }
+    if (write && write != read) {
+#if CLICK_PROFILER
+	bool sampled = Profiler::begin_sample(write, Profiler::K_SELECT);
+#endif
 	write->selected(fd, Element::SELECT_WRITE);
+#if CLICK_PROFILER
+	if (unlikely(sampled))
+	    Profiler::end_sample();
+#endif
+    }
 }
 
 #if HAVE_ALLOW_KQUEUE
@@ -390,7 +406,7 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
     // Decide how long to wait.
     struct timespec wait, *wait_ptr = &wait;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = thread->next_select_delay(t);
     if (delay_type == 0)
 	wait.tv_sec = wait.tv_nsec = 0;
     else if (delay_type > 0)
@@ -441,7 +457,7 @@ SelectSet::run_selects_poll(RouterThread *thread)
     // Decide how long to wait.
     int timeout;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = thread->next_select_delay(t);
     if (delay_type == 0)
 	timeout = 0;
     else if (delay_type > 0)
@@ -497,7 +513,7 @@ SelectSet::run_selects_select(RouterThread *thread)
     // Decide how long to wait.
     struct timeval wait, *wait_ptr = &wait;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = thread->next_select_delay(t);
     if (delay_type == 0)
 	timerclear(&wait);
     else if (delay_type > 0)
@@ -560,8 +576,8 @@ SelectSet::run_selects(RouterThread *thread)
 
     // Return early (just run signals) if there are no selectors and there are
     // tasks to run.  NB there will always be at least one _pollfd (the
-    // _wake_pipe).
-    if (_pollfds.size() < 2 && thread->active()) {
+    // _wake_pipe).  An idle-sleeping thread still blocks on the wake pipe.
+    if (_pollfds.size() < 2 && thread->active() && !thread->idle_sleeping()) {
 #if HAVE_MULTITHREAD
 	_select_lock.release();
 #endif
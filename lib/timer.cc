@@ -193,38 +193,38 @@ Timer::task_hook(Timer *, void *thunk)
 
 
 Timer::Timer()
-    : _schedpos1(0), _thunk(0), _owner(0), _thread(0)
+    : _schedpos1(0), _slack_msec(0), _thunk(0), _owner(0), _thread(0)
 {
     static_assert(sizeof(TimerSet::heap_element) == 16, "size_element should be 16 bytes long.");
     _hook.callback = do_nothing_hook;
 }
 
 Timer::Timer(const do_nothing_t &)
-    : _schedpos1(0), _thunk((void *) 1), _owner(0), _thread(0)
+    : _schedpos1(0), _slack_msec(0), _thunk((void *) 1), _owner(0), _thread(0)
 {
     _hook.callback = do_nothing_hook;
 }
 
 Timer::Timer(TimerCallback f, void *user_data)
-    : _schedpos1(0), _thunk(user_data), _owner(0), _thread(0)
+    : _schedpos1(0), _slack_msec(0), _thunk(user_data), _owner(0), _thread(0)
 {
     _hook.callback = f;
 }
 
 Timer::Timer(Element* element)
-    : _schedpos1(0), _thunk(element), _owner(0), _thread(0)
+    : _schedpos1(0), _slack_msec(0), _thunk(element), _owner(0), _thread(0)
 {
     _hook.callback = element_hook;
 }
 
 Timer::Timer(Task* task)
-    : _schedpos1(0), _thunk(task), _owner(0), _thread(0)
+    : _schedpos1(0), _slack_msec(0), _thunk(task), _owner(0), _thread(0)
 {
     _hook.callback = task_hook;
 }
 
 Timer::Timer(const Timer &x)
-    : _schedpos1(0), _hook(x._hook), _thunk(x._thunk), _owner(0), _thread(0)
+    : _schedpos1(0), _slack_msec(x._slack_msec), _hook(x._hook), _thunk(x._thunk), _owner(0), _thread(0)
 {
 }
 
@@ -267,9 +267,28 @@ Timer::schedule_at_steady(const Timestamp &when)
     _expiry_s = when ? when : Timestamp::epsilon();
     ts.check_timer_expiry(this);
 
+    // timers with slack go in the wheel
+    if (_schedpos1 == TimerSet::schedpos_wheel)
+	ts.wheel_remove(this);
+    if (_slack_msec) {
+	if (_schedpos1 > 0)
+	    ts.heap_remove(this);
+	else if (_schedpos1 < 0)
+	    ts._timer_runchunk[-_schedpos1 - 1] = 0;
+	Timestamp old_expiry = ts._timer_expiry;
+	ts.wheel_insert(this);
+	ts.set_wheel_expiry();
+	++ts._stats.wheel_schedules;
+	if (!old_expiry || ts._timer_expiry < old_expiry)
+	    _thread->wake();
+	ts.unlock_timers();
+	return;
+    }
+
     // manipulate list; this is essentially a "decrease-key" operation
     // any reschedule removes a timer from the runchunk (XXX -- even backwards
     // reschedulings)
+    ++ts._stats.heap_schedules;
     int old_schedpos1 = _schedpos1;
     if (_schedpos1 <= 0) {
 	if (_schedpos1 < 0)
@@ -305,20 +324,30 @@ Timer::unschedule()
 	return;
     TimerSet &ts = _thread->timer_set();
     ts.lock_timers();
-    int old_schedpos1 = _schedpos1;
-    if (_schedpos1 > 0) {
-	remove_heap<4>(ts._timer_heap.begin(), ts._timer_heap.end(),
-		       ts._timer_heap.begin() + _schedpos1 - 1,
-		       TimerSet::heap_less(), TimerSet::heap_place());
-	ts._timer_heap.pop_back();
-	if (old_schedpos1 == 1)
-	    ts.set_timer_expiry();
-    } else if (_schedpos1 < 0)
+    if (_schedpos1 == TimerSet::schedpos_wheel) {
+	ts.wheel_remove(this);
+	ts.set_wheel_expiry();
+    } else if (_schedpos1 > 0)
+	ts.heap_remove(this);
+    else if (_schedpos1 < 0)
 	ts._timer_runchunk[-_schedpos1 - 1] = 0;
     _schedpos1 = 0;
     ts.unlock_timers();
 }
 
+void
+Timer::set_slack(const Timestamp &slack)
+{
+    if (slack.is_negative() || !slack)
+	_slack_msec = 0;
+    else {
+	Timestamp::value_type msec = slack.msecval();
+	if (Timestamp::make_msec(msec) < slack)
+	    ++msec;
+	_slack_msec = msec > 0x7FFFFFFF ? 0x7FFFFFFF : msec;
+    }
+}
+
 // list-related functions in master.cc
 
 CLICK_ENDDECLS
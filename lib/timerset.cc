@@ -48,6 +48,18 @@ TimerSet::TimerSet()
 #endif
     _timer_check = Timestamp::now_steady();
     _timer_check_reports = 0;
+
+    memset(_wheel, 0, sizeof(_wheel));
+    memset(_wheel_mask, 0, sizeof(_wheel_mask));
+    _wheel_now = _timer_check.msecval();
+    _wheel_count = 0;
+    reset_stats();
+}
+
+void
+TimerSet::reset_stats()
+{
+    memset(&_stats, 0, sizeof(_stats));
 }
 
 void
@@ -66,7 +78,16 @@ TimerSet::kill_router(Router *router)
 	    t->_schedpos1 = 0;
 	}
     }
-    set_timer_expiry();
+    for (int l = 0; l < wheel_levels; ++l)
+	for (int s = 0; s < wheel_slots; ++s)
+	    for (Timer *t = _wheel[l][s], *next; t; t = next) {
+		next = t->_wheel_next;
+		if (t->router() == router) {
+		    wheel_remove(t);
+		    t->_owner = 0;
+		}
+	    }
+    set_wheel_expiry();
     unlock_timers();
 }
 
@@ -91,6 +112,178 @@ TimerSet::check_timer_expiry(Timer *t)
     }
 }
 
+void
+TimerSet::heap_remove(Timer *t)
+{
+    int old_schedpos1 = t->_schedpos1;
+    remove_heap<4>(_timer_heap.begin(), _timer_heap.end(),
+		   _timer_heap.begin() + t->_schedpos1 - 1,
+		   heap_less(), heap_place());
+    _timer_heap.pop_back();
+    t->_schedpos1 = 0;
+    if (old_schedpos1 == 1)
+	set_timer_expiry();
+}
+
+/** Return the wheel tick at which @a t fires: its expiry rounded up to a
+ * whole millisecond, then to a multiple of the largest power of two no
+ * greater than its slack.  Timers with nearby expiries thus share a tick. */
+uint64_t
+TimerSet::wheel_tick(const Timer *t)
+{
+    uint64_t tick = t->_expiry_s.msecval();
+    if (Timestamp::make_msec(tick) < t->_expiry_s)
+	++tick;
+    uint64_t g = 1;
+    while (g * 2 <= t->_slack_msec)
+	g *= 2;
+    return (tick + g - 1) & ~(g - 1);
+}
+
+/** Find the wheel slot with the earliest work: a level-0 slot whose timers
+ * fire, or a higher-level slot whose timers cascade. */
+bool
+TimerSet::wheel_next(int &level, int &slot, uint64_t &tick) const
+{
+    bool found = false;
+    for (int l = 0; l < wheel_levels; ++l) {
+	uint64_t m = _wheel_mask[l];
+	if (!m)
+	    continue;
+	int shift = wheel_bits * l;
+	uint64_t base = (_wheel_now >> (shift + wheel_bits)) << (shift + wheel_bits);
+	// the current slot is still due if we are exactly at its start
+	unsigned start = (_wheel_now >> shift) & (wheel_slots - 1);
+	if (_wheel_now & ((uint64_t(1) << shift) - 1))
+	    ++start;
+	uint64_t ahead = start < wheel_slots ? m & (~uint64_t(0) << start) : 0;
+	uint64_t t;
+	int s;
+	if (ahead) {
+	    s = ffs_lsb(ahead) - 1;
+	    t = base + (uint64_t(s) << shift);
+	} else {
+	    s = ffs_lsb(m) - 1;
+	    t = base + (uint64_t(wheel_slots + s) << shift);
+	}
+	if (!found || t < tick) {
+	    level = l;
+	    slot = s;
+	    tick = t;
+	    found = true;
+	}
+    }
+    return found;
+}
+
+void
+TimerSet::set_wheel_expiry()
+{
+    int level, slot;
+    uint64_t tick;
+    if (wheel_next(level, slot, tick))
+	_wheel_expiry = Timestamp::make_msec(tick);
+    set_timer_expiry();
+}
+
+void
+TimerSet::wheel_insert(Timer *t)
+{
+    if (!_wheel_count) {
+	uint64_t now = Timestamp::recent_steady().msecval();
+	if (_wheel_now < now)
+	    _wheel_now = now;
+    }
+    uint64_t tick = wheel_tick(t);
+    if (tick < _wheel_now)
+	tick = _wheel_now;
+    uint64_t delta = tick - _wheel_now;
+    int level = 0;
+    while (level < wheel_levels - 1
+	   && delta >= (uint64_t(1) << (wheel_bits * (level + 1))))
+	++level;
+    if (delta >= (uint64_t(1) << (wheel_bits * wheel_levels)))
+	// beyond the wheel: park in the last level, cascade again later
+	tick = _wheel_now + (uint64_t(1) << (wheel_bits * wheel_levels)) - 1;
+    int slot = (tick >> (wheel_bits * level)) & (wheel_slots - 1);
+
+    Timer **head = &_wheel[level][slot];
+    t->_wheel_next = *head;
+    t->_wheel_pprev = head;
+    if (*head)
+	(*head)->_wheel_pprev = &t->_wheel_next;
+    *head = t;
+    _wheel_mask[level] |= uint64_t(1) << slot;
+    t->_schedpos1 = schedpos_wheel;
+    ++_wheel_count;
+}
+
+void
+TimerSet::wheel_remove(Timer *t)
+{
+    *t->_wheel_pprev = t->_wheel_next;
+    if (t->_wheel_next)
+	t->_wheel_next->_wheel_pprev = t->_wheel_pprev;
+    else {
+	// the slot may be empty now; recover its index from the list head
+	Timer **first = &_wheel[0][0];
+	if (t->_wheel_pprev >= first
+	    && t->_wheel_pprev < first + wheel_levels * wheel_slots
+	    && !*t->_wheel_pprev) {
+	    int i = t->_wheel_pprev - first;
+	    _wheel_mask[i / wheel_slots] &= ~(uint64_t(1) << (i % wheel_slots));
+	}
+    }
+    t->_schedpos1 = 0;
+    --_wheel_count;
+}
+
+void
+TimerSet::wheel_cascade(int level, int slot)
+{
+    Timer *t = _wheel[level][slot];
+    _wheel[level][slot] = 0;
+    _wheel_mask[level] &= ~(uint64_t(1) << slot);
+    while (t) {
+	Timer *next = t->_wheel_next;
+	--_wheel_count;
+	wheel_insert(t);
+	++_stats.cascades;
+	t = next;
+    }
+}
+
+void
+TimerSet::run_wheel(RouterThread *thread)
+{
+    uint64_t now = _timer_check.msecval();
+    int level, slot;
+    uint64_t tick;
+    while (wheel_next(level, slot, tick) && tick <= now) {
+	_wheel_now = tick;
+	for (int l = wheel_levels - 1; l > 0; --l)
+	    if (!(tick & ((uint64_t(1) << (wheel_bits * l)) - 1)))
+		wheel_cascade(l, (tick >> (wheel_bits * l)) & (wheel_slots - 1));
+	int s = tick & (wheel_slots - 1);
+	if (Timer *t = _wheel[0][s]) {
+	    _wheel[0][s] = 0;
+	    _wheel_mask[0] &= ~(uint64_t(1) << s);
+	    for (; t; t = t->_wheel_next) {
+		t->_schedpos1 = -_timer_runchunk.size() - 1;
+		_timer_runchunk.push_back(t);
+		--_wheel_count;
+	    }
+	    ++_stats.wheel_batches;
+	}
+	_wheel_now = tick + 1;
+    }
+    if (_wheel_now <= now)
+	_wheel_now = now + 1;
+    _stats.wheel_fires += _timer_runchunk.size();
+    set_wheel_expiry();
+    run_runchunk(thread);
+}
+
 inline void
 TimerSet::run_one_timer(Timer *t)
 {
@@ -99,6 +292,9 @@ TimerSet::run_one_timer(Timer *t)
     click_cycles_t start_cycles = click_get_cycles(),
 	start_child_cycles = owner->_child_cycles;
 #endif
+#if CLICK_PROFILER
+    bool sampled = Profiler::begin_sample(t->_owner, Profiler::K_TIMER);
+#endif
 
     t->_hook.callback(t, t->_thunk);
 
@@ -108,6 +304,29 @@ TimerSet::run_one_timer(Timer *t)
     owner->_timer_calls += 1;
     owner->_timer_own_cycles += own_delta;
 #endif
+#if CLICK_PROFILER
+    if (unlikely(sampled))
+	Profiler::end_sample();
+#endif
+}
+
+void
+TimerSet::run_runchunk(RouterThread *thread)
+{
+    Vector<Timer*>::iterator i = _timer_runchunk.begin();
+    for (; !thread->stop_flag() && i != _timer_runchunk.end(); ++i)
+	if (*i) {
+	    (*i)->_schedpos1 = 0;
+	    run_one_timer(*i);
+	}
+
+    // reschedule unrun timers if stopped early
+    for (; i != _timer_runchunk.end(); ++i)
+	if (*i) {
+	    (*i)->_schedpos1 = 0;
+	    (*i)->schedule_at_steady((*i)->_expiry_s);
+	}
+    _timer_runchunk.clear();
 }
 
 void
@@ -115,7 +334,8 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 {
     if (!_timer_lock.attempt())
 	return;
-    if (!master->paused() && _timer_heap.size() > 0 && !thread->stop_flag()) {
+    if (!master->paused() && (_timer_heap.size() > 0 || _wheel_count)
+	&& !thread->stop_flag()) {
 	thread->set_thread_state(RouterThread::S_RUNTIMER);
 #if CLICK_LINUXMODULE
 	_timer_task = current;
@@ -123,9 +343,12 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 	_timer_processor = click_current_processor();
 #endif
 	_timer_check = Timestamp::now_steady();
+	if (_wheel_count && _wheel_expiry <= _timer_check)
+	    run_wheel(thread);
 	heap_element *th = _timer_heap.begin();
 
-	if (th->expiry_s <= _timer_check) {
+	if (_timer_heap.size() > 0 && !thread->stop_flag()
+	    && th->expiry_s <= _timer_check) {
 	    // potentially adjust timer stride
 	    Timestamp adj_expiry = th->expiry_s + Timer::adjustment();
 	    if (adj_expiry <= _timer_check) {
@@ -148,6 +371,7 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 		set_timer_expiry();
 		t->_schedpos1 = 0;
 
+		++_stats.heap_fires;
 		run_one_timer(t);
 	    } while (_timer_heap.size() > 0 && !thread->stop_flag()
 		     && (th = _timer_heap.begin(), th->expiry_s <= _timer_check)
@@ -171,20 +395,8 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 			 && (th = _timer_heap.begin(), th->expiry_s <= _timer_check));
 		set_timer_expiry();
 
-		Vector<Timer*>::iterator i = _timer_runchunk.begin();
-		for (; !thread->stop_flag() && i != _timer_runchunk.end(); ++i)
-		    if (*i) {
-			(*i)->_schedpos1 = 0;
-			run_one_timer(*i);
-		    }
-
-		// reschedule unrun timers if stopped early
-		for (; i != _timer_runchunk.end(); ++i)
-		    if (*i) {
-			(*i)->_schedpos1 = 0;
-			(*i)->schedule_at_steady((*i)->_expiry_s);
-		    }
-		_timer_runchunk.clear();
+		_stats.heap_fires += _timer_runchunk.size();
+		run_runchunk(thread);
 	    }
 	}
 
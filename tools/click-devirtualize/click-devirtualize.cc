@@ -53,6 +53,7 @@
 #define DEVIRTUALIZE_OPT	311
 #define INSTRS_OPT		312
 #define REVERSE_OPT		313
+#define FUSE_OPT		314
 
 static const Clp_Option options[] = {
   { "clickpath", 'C', CLICKPATH_OPT, Clp_ValString, 0 },
@@ -60,6 +61,7 @@ static const Clp_Option options[] = {
   { "devirtualize", 0, DEVIRTUALIZE_OPT, Clp_ValString, Clp_Negate },
   { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
   { "file", 'f', ROUTER_OPT, Clp_ValString, 0 },
+  { "fuse", 0, FUSE_OPT, 0, Clp_Negate },
   { "help", 0, HELP_OPT, 0, 0 },
   { 0, 'n', NO_DEVIRTUALIZE_OPT, Clp_ValString, 0 },
   { "kernel", 'k', KERNEL_OPT, 0, Clp_Negate }, // DEPRECATED
@@ -241,6 +243,7 @@ main(int argc, char **argv)
   int compile_kernel = 0;
   int compile_user = 0;
   int reverse = 0;
+  int fuse = 0;
   Vector<const char *> instruction_files;
   HashTable<String, int> specializing;
 
@@ -324,6 +327,10 @@ particular purpose.\n");
       reverse = !clp->negated;
       break;
 
+     case FUSE_OPT:
+      fuse = !clp->negated;
+      break;
+
      bad_option:
      case Clp_BadOption:
       short_usage();
@@ -420,6 +427,8 @@ particular purpose.\n");
   // initialize specializer
   Specializer specializer(router, full_elementmap);
   specializer.specialize(sigs, errh);
+  if (fuse)
+    specializer.fuse_paths();
 
   // quit early if nothing was done
   if (specializer.nspecials() == 0) {
@@ -312,6 +312,7 @@ Specializer::do_simple_action(SpecializedClass &spc)
   return (p ? smaction(p) : 0);\n", ""));
   spc.cxxc->find("output_push")->unkill();
   spc.cxxc->find("input_pull")->unkill();
+  spc.has_smaction = true;
 }
 
 inline const String &
@@ -439,6 +440,248 @@ Specializer::specialize(const Signatures &sigs, ErrorHandler *errh)
       create_connector_methods(_specials[s]);
 }
 
+// Path fusion.  A push path through simple_action elements, such as
+// CheckIPHeader -> GetIPAddress -> DecIPTTL, becomes one push function in
+// the first element's class.  It calls each stage's smaction in turn and
+// hands the result straight to the element after the last stage.
+
+static inline bool
+cxx_word_char(char c)
+{
+  return isalnum((unsigned char) c) || c == '_';
+}
+
+static bool
+word_at(const String &text, int pos, const String &word)
+{
+  int end = pos + word.length();
+  return text.substring(pos, word.length()) == word
+    && (pos == 0 || !cxx_word_char(text[pos - 1]))
+    && (end == text.length() || !cxx_word_char(text[end]));
+}
+
+static int
+find_word(const String &text, const String &word, int pos = 0)
+{
+  for (; (pos = text.find_left(word, pos)) >= 0; pos += word.length())
+    if (word_at(text, pos, word))
+      return pos;
+  return -1;
+}
+
+static int
+skip_space(const String &text, int pos)
+{
+  while (pos < text.length() && isspace((unsigned char) text[pos]))
+    pos++;
+  return pos;
+}
+
+// Return the packet argument's name from an argument list like
+// "(Packet *p)".
+static String
+packet_argument(const String &args)
+{
+  int end = args.length();
+  while (end > 0 && !cxx_word_char(args[end - 1]))
+    end--;
+  int start = end;
+  while (start > 0 && cxx_word_char(args[start - 1]))
+    start--;
+  return args.substring(start, end - start);
+}
+
+static bool
+declares_writable(const String &text, const String &name)
+{
+  for (int pos = 0; (pos = find_word(text, "WritablePacket", pos)) >= 0; ) {
+    pos = skip_space(text, pos + 14);
+    if (pos < text.length() && text[pos] == '*'
+	&& word_at(text, skip_space(text, pos + 1), name))
+      return true;
+  }
+  return false;
+}
+
+static bool
+assigns(const String &text, const String &name)
+{
+  for (int pos = 0; (pos = find_word(text, name, pos)) >= 0; ) {
+    pos = skip_space(text, pos + name.length());
+    if (pos + 1 < text.length() && text[pos] == '=' && text[pos + 1] != '=')
+      return true;
+  }
+  return false;
+}
+
+// Return true iff every packet fn returns is unshared.  By convention a
+// WritablePacket is never shared, so each return value must be null, a
+// WritablePacket local, or, if arg_unique, the unmodified argument.  A
+// clone() anywhere disqualifies fn.
+static bool
+returns_unique(const CxxFunction *fn, bool arg_unique)
+{
+  const String &text = fn->clean_body();
+  String arg = packet_argument(fn->args());
+  if (find_word(text, "clone") >= 0)
+    return false;
+  arg_unique = arg_unique && !assigns(text, arg);
+  for (int pos = 0; (pos = find_word(text, "return", pos)) >= 0; ) {
+    int semi = text.find_left(';', pos);
+    if (semi < 0)
+      return false;
+    int start = skip_space(text, pos + 6);
+    String value = text.substring(start, semi - start).trim_space();
+    pos = semi;
+    if (value == "0" || value == "NULL")
+      continue;
+    else if (value == arg ? !arg_unique : !declares_writable(text, value))
+      return false;
+  }
+  return true;
+}
+
+// Rewrite uniqueify() and uniqueify_header() calls on arg, which is known to
+// be unshared, so they skip the shared() test.  Returns the number of calls
+// rewritten.
+static int
+assume_unique(String &body, String &clean_body, const String &arg)
+{
+  StringAccum sa, clean_sa;
+  int last = 0, nrewritten = 0;
+  for (int pos = 0; (pos = find_word(clean_body, arg, pos)) >= 0; ) {
+    int start = pos;
+    pos += arg.length();
+    if (start > 0 && (clean_body[start - 1] == '.'
+		      || clean_body[start - 1] == '>'
+		      || clean_body[start - 1] == ':'))
+      continue;
+    int p = skip_space(clean_body, pos);
+    if (clean_body.substring(p, 2) != "->")
+      continue;
+    p = skip_space(clean_body, p + 2);
+    bool header = word_at(clean_body, p, "uniqueify_header");
+    if (!header && !word_at(clean_body, p, "uniqueify"))
+      continue;
+    p = skip_space(clean_body, p + (header ? 16 : 9));
+    if (p >= clean_body.length() || clean_body[p] != '(')
+      continue;
+    int close = p, depth = 0;
+    for (; close < clean_body.length(); close++)
+      if (clean_body[close] == '(')
+	depth++;
+      else if (clean_body[close] == ')' && --depth == 0)
+	break;
+    if (close >= clean_body.length())
+      continue;
+
+    String cast = "static_cast<WritablePacket *>(" + arg + "))";
+    String len = body.substring(p + 1, close - p - 1);
+    String clean_len = clean_body.substring(p + 1, close - p - 1);
+    sa << body.substring(last, start - last);
+    clean_sa << clean_body.substring(last, start - last);
+    if (header) {
+      sa << "(" << arg << "->copy_pending() ? " << arg << "->uniqueify_header("
+	 << len << ") : " << cast;
+      clean_sa << "(" << arg << "->copy_pending() ? " << arg
+	       << "->uniqueify_header(" << clean_len << ") : " << cast;
+    } else {
+      sa << "(" << arg << "->finish_copy(), " << cast;
+      clean_sa << "(" << arg << "->finish_copy(), " << cast;
+    }
+    last = pos = close + 1;
+    nrewritten++;
+  }
+  if (nrewritten) {
+    sa << body.substring(last);
+    clean_sa << clean_body.substring(last);
+    body = sa.take_string();
+    clean_body = clean_sa.take_string();
+  }
+  return nrewritten;
+}
+
+int
+Specializer::fusable_successor(int eindex) const
+{
+  if (_noutputs[eindex] == 0)
+    return -1;
+  RouterT::conn_iterator it =
+    _router->find_connections_from(PortT(_router->element(eindex), 0));
+  if (it == _router->end_connections())
+    return -1;
+  int next = it->to_eindex();
+  const SpecializedClass &spc = _specials[_specialize[next]];
+  if (!spc.special() || !spc.has_smaction || _ninputs[next] != 1
+      || it->to_port() != 0)
+    return -1;
+  return next;
+}
+
+String
+Specializer::unique_smaction(SpecializedClass &spc)
+{
+  CxxClass *cxxc = spc.cxxc;
+  if (cxxc->find("smaction_unique"))
+    return "smaction_unique";
+  CxxFunction *smaction = cxxc->find("smaction");
+  String args = smaction->args(), arg = packet_argument(args);
+  String body = smaction->body(), clean_body = smaction->clean_body();
+  if (assigns(clean_body, arg) || !assume_unique(body, clean_body, arg))
+    return "smaction";
+  cxxc->defun(CxxFunction("smaction_unique", false, "inline Packet *", args,
+			  body, clean_body));
+  return "smaction_unique";
+}
+
+void
+Specializer::fuse_path(SpecializedClass &spc)
+{
+  enum { MAX_PATH = 16 };
+  int eindex = spc.eindex;
+  if (!spc.has_smaction || _ninputs[eindex] != 1)
+    return;
+
+  StringAccum sa;
+  sa << "\n  (void) port;\n  Packet *q = smaction(p);\n  if (!q)\n    return;";
+  bool unique = returns_unique(spc.cxxc->find("smaction"), false);
+  Vector<int> path(1, eindex);
+  String var = "this", cxx_name = spc.cxx_name;
+  while (path.size() < MAX_PATH) {
+    int next = fusable_successor(path.back());
+    for (int i = 0; next >= 0 && i < path.size(); i++)
+      if (path[i] == next)
+	next = -1;
+    if (next < 0)
+      break;
+
+    SpecializedClass &nspc = _specials[_specialize[next]];
+    String fn = (unique ? unique_smaction(nspc) : String("smaction"));
+    unique = returns_unique(nspc.cxxc->find(fn), unique);
+    String nvar = "e" + String(path.size());
+    sa << "\n  " << nspc.cxx_name << " *" << nvar << " = ("
+       << nspc.cxx_name << " *)" << var << "->output(0).element();"
+       << "\n  if (!(q = " << nvar << "->" << nspc.cxx_name << "::" << fn
+       << "(q)))\n    return;";
+    path.push_back(next);
+    var = nvar;
+    cxx_name = nspc.cxx_name;
+  }
+
+  if (path.size() > 1) {
+    sa << "\n  " << var << "->" << cxx_name << "::output_push(0, q);\n";
+    spc.cxxc->find("push")->set_body(sa.take_string());
+  }
+}
+
+void
+Specializer::fuse_paths()
+{
+  for (int s = 0; s < _specials.size(); s++)
+    if (_specials[s].special())
+      fuse_path(_specials[s]);
+}
+
 void
 Specializer::fix_elements()
 {
@@ -30,8 +30,9 @@ struct SpecializedClass {
   String cxx_name;
   CxxClass *cxxc;
   int eindex;
+  bool has_smaction;
 
-  SpecializedClass() : cxxc(0), eindex(-3)	{ }
+  SpecializedClass() : cxxc(0), eindex(-3), has_smaction(false) { }
   bool special() const				{ return cxxc != 0; }
 };
 
@@ -47,6 +48,7 @@ class Specializer { public:
 		     const String &header_file, const String &source_dir);
 
   void specialize(const Signatures &, ErrorHandler *);
+  void fuse_paths();
   void fix_elements();
 
   int nspecials() const				{ return _specials.size(); }
@@ -84,6 +86,9 @@ class Specializer { public:
   bool create_class(SpecializedClass &);
   void do_simple_action(SpecializedClass &);
   void create_connector_methods(SpecializedClass &);
+  int fusable_successor(int) const;
+  String unique_smaction(SpecializedClass &);
+  void fuse_path(SpecializedClass &);
 
   void output_includes(ElementTypeInfo &, StringAccum &);
 
@@ -32,6 +32,7 @@
 #include <click/bitvector.hh>
 #include "toolutils.hh"
 #include "elementmap.hh"
+#include "classifiert.hh"
 #include "click-fastclassifier.hh"
 #include <click/md5.h>
 #include <stdio.h>
@@ -106,7 +107,8 @@ Options:\n\
   -f, --file FILE               Read router configuration from FILE.\n\
   -e, --expression EXPR         Use EXPR as router configuration.\n\
   -o, --output FILE             Write output to FILE.\n\
-      --no-combine              Do not combine adjacent Classifiers.\n\
+      --no-combine              Do not combine cascaded Classifiers and\n\
+                                IPClassifiers.\n\
       --no-classes              Do not generate FastClassifier elements.\n\
   -k, --kernel                  Compile into Linux kernel binary package.\n\
   -u, --user                    Compile into user-level binary package.\n\
@@ -166,96 +168,6 @@ Classifier_Insn::write_state(int state, bool check_length, bool take_short,
     }
 }
 
-static bool
-combine_classifiers(RouterT *router, ElementT *from, int from_port, ElementT *to)
-{
-  ElementClassT *classifier_t = ElementClassT::base_type("Classifier");
-  assert(from->type() == classifier_t && to->type() == classifier_t);
-
-  // find where 'to' is heading for
-  Vector<RouterT::conn_iterator> first_hop, second_hop;
-  router->find_connection_vector_from(from, first_hop);
-  router->find_connection_vector_from(to, second_hop);
-
-  // check for weird configurations
-  for (int i = 0; i < first_hop.size(); i++)
-    if (!first_hop[i].is_back())
-      return false;
-  Vector<PortT> second_hop_to;
-  for (int i = 0; i < second_hop.size(); i++) {
-    if (!second_hop[i].is_back())
-      return false;
-    second_hop_to.push_back(second_hop[i]->to());
-  }
-  if (second_hop.size() == 0)
-    return false;
-
-  // combine configurations
-  Vector<String> from_words, to_words;
-  cp_argvec(from->configuration(), from_words);
-  cp_argvec(to->configuration(), to_words);
-  if (from_words.size() != first_hop.size()
-      || to_words.size() != second_hop.size())
-    return false;
-  Vector<String> new_words;
-  for (int i = 0; i < from_port; i++)
-    new_words.push_back(from_words[i]);
-  for (int i = 0; i < to_words.size(); i++)
-    if (to_words[i] == "-")
-      new_words.push_back(from_words[from_port]);
-    else if (from_words[from_port] == "-")
-      new_words.push_back(to_words[i]);
-    else
-      new_words.push_back(from_words[from_port] + " " + to_words[i]);
-  for (int i = from_port + 1; i < from_words.size(); i++)
-    new_words.push_back(from_words[i]);
-  from->set_configuration(cp_unargvec(new_words));
-
-  // change connections
-  router->erase(first_hop[from_port]);
-  for (int i = from_port + 1; i < first_hop.size(); i++)
-    router->change_connection_from(first_hop[i], PortT(from, i + to_words.size() - 1));
-  for (int i = 0; i < second_hop_to.size(); i++)
-    router->add_connection(PortT(from, from_port + i), second_hop_to[i]);
-
-  return true;
-}
-
-static bool
-try_combine_classifiers(RouterT *router, ElementT *classifier)
-{
-  ElementClassT *classifier_t = ElementClassT::base_type("Classifier");
-  if (classifier->type() != classifier_t)
-    // cannot combine IPClassifiers yet
-    return false;
-
-  Vector<PortT> branches;
-  router->find_connections_to(PortT(classifier, 0), branches);
-  for (int i = 0; i < branches.size(); i++)
-    if (branches[i].element->type() == classifier_t) {
-      // perform a combination
-      if (combine_classifiers(router, branches[i].element, branches[i].port, classifier)) {
-	try_combine_classifiers(router, classifier);
-	return true;
-      }
-    }
-
-  return false;
-}
-
-static void
-try_remove_classifiers(RouterT *router, Vector<ElementT *> &classifiers)
-{
-    for (int i = 0; i < classifiers.size(); i++)
-	if (!router->find_connections_to(PortT(classifiers[i], 0))) {
-	    classifiers[i]->kill();
-	    classifiers[i] = classifiers.back();
-	    classifiers.pop_back();
-	    i--;
-	}
-    router->remove_dead_elements();
-}
-
 
 /*
  * FastClassifier structures
@@ -1026,11 +938,15 @@ particular purpose.\n");
 
   // try combining classifiers
   if (combine_classifiers) {
-    bool any_combined = false;
-    for (int i = 0; i < classifiers.size(); i++)
-      any_combined |= try_combine_classifiers(r, classifiers[i]);
-    if (any_combined)
-      try_remove_classifiers(r, classifiers);
+    ClassifierT ct(r);
+    if (ct.combine() + ct.remove_unreachable(verbose ? errh : 0)) {
+      classifiers.clear();
+      for (RouterT::iterator x = r->begin_elements(); x; x++)
+	if (cid_name_map.get(x->type_name()) >= 0)
+	  classifiers.push_back(x.get());
+    }
+    if (verbose)
+      errh->message("combined %d classifiers, saving up to %d header inspections per packet; removed %d unreachable outputs", ct.ncombined(), ct.inspections_saved(), ct.nunreachable());
   }
 
   // create classifiers program
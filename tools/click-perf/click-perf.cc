@@ -0,0 +1,1408 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * click-perf.cc -- estimate a Click configuration's per-thread load
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/pathvars.h>
+
+#include "routert.hh"
+#include "lexert.hh"
+#include "processingt.hh"
+#include "elementmap.hh"
+#include <click/error.hh>
+#include <click/confparse.hh>
+#include <click/straccum.hh>
+#include <click/driver.hh>
+#include <click/userutils.hh>
+#include <click/algorithm.hh>
+#include <click/clp.h>
+#include "toolutils.hh"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netdb.h>
+
+#define HELP_OPT		300
+#define VERSION_OPT		301
+#define CLICKPATH_OPT		302
+#define ROUTER_OPT		303
+#define EXPRESSION_OPT		304
+#define OUTPUT_OPT		305
+#define COSTS_OPT		306
+#define DEFAULT_COST_OPT	307
+#define PORT_OPT		308
+#define UNIX_SOCKET_OPT		309
+#define INTERVAL_OPT		310
+#define SAVE_COSTS_OPT		311
+#define DOT_OPT			312
+#define CPU_MHZ_OPT		313
+#define PARTITION_OPT		314
+#define HANDOFF_COST_OPT	315
+
+static const Clp_Option options[] = {
+    { "clickpath", 'C', CLICKPATH_OPT, Clp_ValString, 0 },
+    { "costs", 'c', COSTS_OPT, Clp_ValString, 0 },
+    { "cpu-mhz", 'M', CPU_MHZ_OPT, Clp_ValDouble, 0 },
+    { "default-cost", 0, DEFAULT_COST_OPT, Clp_ValDouble, 0 },
+    { "dot", 'd', DOT_OPT, 0, Clp_Negate },
+    { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
+    { "file", 'f', ROUTER_OPT, Clp_ValString, 0 },
+    { "handoff-cost", 0, HANDOFF_COST_OPT, Clp_ValDouble, 0 },
+    { "help", 0, HELP_OPT, 0, 0 },
+    { "interval", 'i', INTERVAL_OPT, Clp_ValDouble, 0 },
+    { "output", 'o', OUTPUT_OPT, Clp_ValString, 0 },
+    { "partition", 'P', PARTITION_OPT, Clp_ValInt, 0 },
+    { "port", 'p', PORT_OPT, Clp_ValString, 0 },
+    { "save-costs", 0, SAVE_COSTS_OPT, Clp_ValString, 0 },
+    { "unix-socket", 'u', UNIX_SOCKET_OPT, Clp_ValString, 0 },
+    { "version", 'v', VERSION_OPT, 0, 0 },
+};
+
+static const char *program_name;
+
+void
+short_usage()
+{
+    fprintf(stderr, "Usage: %s [OPTION]... [ROUTERFILE]\n\
+Try '%s --help' for more information.\n",
+	    program_name, program_name);
+}
+
+void
+usage()
+{
+    printf("\
+'Click-perf' estimates how much CPU a router configuration needs on each\n\
+thread, reports the bottleneck thread, elements, and queues, and the packet\n\
+rate the configuration can sustain. Costs come from per-class cost tables,\n\
+or are measured from a running router through its ControlSocket.\n\
+\n\
+Usage: %s [OPTION]... [ROUTERFILE]\n\
+\n\
+Options:\n\
+  -f, --file FILE               Read router configuration from FILE.\n\
+  -e, --expression EXPR         Use EXPR as router configuration.\n\
+  -o, --output FILE             Write output to FILE.\n\
+  -c, --costs FILE              Read per-class costs from FILE.\n\
+      --default-cost CYCLES     Cost of classes not in any table [100].\n\
+  -p, --port [HOST:]PORT        Read counters from a ControlSocket on PORT.\n\
+  -u, --unix-socket FILE        Read counters from a ControlSocket on FILE.\n\
+  -i, --interval SEC            Sample running counters over SEC seconds [1].\n\
+      --save-costs FILE         Write measured per-class costs to FILE.\n\
+  -M, --cpu-mhz MHZ             CPU clock rate [from /proc/cpuinfo].\n\
+  -d, --dot                     Output an annotated 'dot' graph definition.\n\
+  -P, --partition N             Output the configuration partitioned among N\n\
+                                threads.\n\
+      --handoff-cost CYCLES     Extra cost of a cross-thread handoff [200].\n\
+  -C, --clickpath PATH          Use PATH for CLICKPATH.\n\
+      --help                    Print this message and exit.\n\
+  -v, --version                 Print version number and exit.\n\
+\n\
+Report bugs to <click@pdos.lcs.mit.edu>.\n", program_name);
+}
+
+
+// CONTROLSOCKET CLIENT
+
+class ControlClient { public:
+
+    ControlClient()
+	: _fd(-1) {
+    }
+    ~ControlClient() {
+	if (_fd >= 0)
+	    close(_fd);
+    }
+
+    bool ok() const {
+	return _fd >= 0;
+    }
+    int connect_tcp(const String &hostport, ErrorHandler *errh);
+    int connect_unix(const String &path, ErrorHandler *errh);
+    bool read(const String &handler, String &result);
+
+  private:
+
+    int _fd;
+    String _buf;
+
+    int greet(const String &where, ErrorHandler *errh);
+    bool read_line(String &line);
+    bool read_bytes(int n, String &result);
+    bool fill();
+
+};
+
+int
+ControlClient::connect_tcp(const String &hostport, ErrorHandler *errh)
+{
+    String host = "localhost", port = hostport;
+    int colon = hostport.find_right(':');
+    if (colon >= 0) {
+	host = hostport.substring(0, colon);
+	port = hostport.substring(colon + 1);
+    }
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int r = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+    if (r != 0)
+	return errh->error("%s: %s", hostport.c_str(), gai_strerror(r));
+    for (struct addrinfo *ai = res; ai && _fd < 0; ai = ai->ai_next) {
+	_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+	if (_fd >= 0 && connect(_fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+	    close(_fd);
+	    _fd = -1;
+	}
+    }
+    freeaddrinfo(res);
+    if (_fd < 0)
+	return errh->error("%s: %s", hostport.c_str(), strerror(errno));
+    return greet(hostport, errh);
+}
+
+int
+ControlClient::connect_unix(const String &path, ErrorHandler *errh)
+{
+    struct sockaddr_un sa;
+    if (path.length() >= (int) sizeof(sa.sun_path))
+	return errh->error("%s: filename too long", path.c_str());
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    memcpy(sa.sun_path, path.data(), path.length());
+    _fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (_fd >= 0 && connect(_fd, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+	close(_fd);
+	_fd = -1;
+    }
+    if (_fd < 0)
+	return errh->error("%s: %s", path.c_str(), strerror(errno));
+    return greet(path, errh);
+}
+
+int
+ControlClient::greet(const String &where, ErrorHandler *errh)
+{
+    String line;
+    if (!read_line(line) || !line.starts_with("Click::ControlSocket/")) {
+	close(_fd);
+	_fd = -1;
+	return errh->error("%s: not a Click ControlSocket", where.c_str());
+    }
+    return 0;
+}
+
+bool
+ControlClient::fill()
+{
+    char buf[4096];
+    ssize_t r;
+    do {
+	r = ::read(_fd, buf, sizeof(buf));
+    } while (r < 0 && errno == EINTR);
+    if (r <= 0)
+	return false;
+    _buf += String(buf, r);
+    return true;
+}
+
+bool
+ControlClient::read_line(String &line)
+{
+    int nl;
+    while ((nl = _buf.find_left('\n')) < 0)
+	if (!fill())
+	    return false;
+    line = _buf.substring(0, nl > 0 && _buf[nl - 1] == '\r' ? nl - 1 : nl);
+    _buf = _buf.substring(nl + 1);
+    return true;
+}
+
+bool
+ControlClient::read_bytes(int n, String &result)
+{
+    while (_buf.length() < n)
+	if (!fill())
+	    return false;
+    result = _buf.substring(0, n);
+    _buf = _buf.substring(n);
+    return true;
+}
+
+/** Read @a handler; return false if it does not exist or fails. */
+bool
+ControlClient::read(const String &handler, String &result)
+{
+    if (_fd < 0)
+	return false;
+    String cmd = "READ " + handler + "\r\n";
+    if (write(_fd, cmd.data(), cmd.length()) != cmd.length()) {
+	close(_fd);
+	_fd = -1;
+	return false;
+    }
+    String line;
+    int code, len;
+    // A response may take several lines ("200-..." continues, "200 " ends).
+    do {
+	if (!read_line(line) || line.length() < 4
+	    || !cp_integer(line.substring(0, 3), &code))
+	    return false;
+    } while (line[3] == '-');
+    if (code != 200)
+	return false;
+    if (!read_line(line) || !line.starts_with("DATA ")
+	|| !cp_integer(line.substring(5), &len))
+	return false;
+    return read_bytes(len, result);
+}
+
+
+// MODEL
+
+struct ElementInfo {
+    bool task;			// has a task (drives packets)
+    bool queue;			// push input, pull output
+    int task_thread;		// home thread, for tasks
+    Vector<int> threads;	// threads that execute this element
+    Vector<int> pull_threads;	// threads that pull from this element
+    double rate;		// packets per second through element
+    double cost;		// cycles per packet
+    char cost_source;		// 'm'easured, 't'able, 'd'efault
+    double cycles;		// cycles per second
+    // runtime counters
+    Vector<double> ocounts;
+    double packets;
+    double own_cycles;
+    bool have_counts;
+    bool have_cycles;
+    String queue_info;
+    bool queue_full;
+    ElementInfo()
+	: task(false), queue(false), task_thread(0), rate(0), cost(0),
+	  cost_source('d'), cycles(0), packets(0), own_cycles(0),
+	  have_counts(false), have_cycles(false), queue_full(false) {
+    }
+};
+
+struct EdgeInfo {
+    int from, from_port, to, to_port;
+    double rate;
+};
+
+class PerfModel { public:
+
+    PerfModel(RouterT *r, ProcessingT *processing, double hz)
+	: _r(r), _processing(processing), _hz(hz), _measured_rates(false),
+	  _measured_threads(false), _bottleneck(-1) {
+    }
+
+    void prepare();
+    void read_costs(const String &text, const String &filename, ErrorHandler *errh);
+    void set_default_cost(double c) {
+	_default_cost = c;
+    }
+    void read_counters(ControlClient &cc, double interval);
+    void compute(ErrorHandler *errh);
+
+    void write_report(FILE *f, const char *filename) const;
+    void write_dot(FILE *f) const;
+    int save_costs(const char *filename, ErrorHandler *errh) const;
+    int partition(int nthreads, double handoff_cost, ErrorHandler *errh);
+
+  private:
+
+    RouterT *_r;
+    ProcessingT *_processing;
+    double _hz;
+    double _default_cost;
+    HashTable<String, double> _class_costs;
+    Vector<ElementInfo> _info;
+    Vector<EdgeInfo> _edges;
+    Vector<double> _thread_cycles;
+    Vector<int> _thread_nelements;
+    bool _measured_rates;
+    bool _measured_threads;
+    int _bottleneck;
+    double _input_rate;
+
+    void mark_threads(int task, bool downstream);
+    void static_rates();
+    double split_fraction(ElementT *e, int port) const;
+    double bottleneck_share(const ElementInfo &ei) const;
+    double class_cost(const String &type) const;
+
+};
+
+void
+PerfModel::read_costs(const String &text, const String &filename, ErrorHandler *errh)
+{
+    // Each line is "CLASS CYCLES"; '#' starts a comment.
+    const char *s = text.begin(), *end = text.end();
+    int lineno = 0;
+    while (s != end) {
+	const char *eol = find(s, end, '\n');
+	++lineno;
+	String line = String(s, eol);
+	int hash = line.find_left('#');
+	if (hash >= 0)
+	    line = line.substring(0, hash);
+	Vector<String> words;
+	cp_spacevec(line, words);
+	double c;
+	if (words.size() == 2 && cp_double(words[1], &c) && c >= 0)
+	    _class_costs[words[0]] = c;
+	else if (words.size())
+	    errh->lwarning(filename + ":" + String(lineno), "expected %<CLASS CYCLES%>");
+	s = (eol == end ? end : eol + 1);
+    }
+}
+
+void
+PerfModel::prepare()
+{
+    _info.resize(_r->nelements());
+    for (RouterT::iterator e = _r->begin_elements(); e; ++e) {
+	ElementInfo &ei = _info[e->eindex()];
+	bool pull_in = false, push_in = false, push_out = false, pull_out = false;
+	for (int p = 0; p < e->ninputs(); ++p)
+	    (_processing->input_is_pull(e->eindex(), p) ? pull_in : push_in) = true;
+	for (int p = 0; p < e->noutputs(); ++p)
+	    (_processing->output_is_push(e->eindex(), p) ? push_out : pull_out) = true;
+	ei.queue = push_in && pull_out;
+	// Elements that pull packets and push them onward (Unqueue,
+	// ToDevice) and push-only sources (InfiniteSource, FromDevice) run
+	// tasks.
+	ei.task = (pull_in && !pull_out)
+	    || (e->ninputs() == 0 && push_out && e->type_name() != "Idle");
+    }
+
+    // StaticThreadSched(ELEMENT THREAD, ...) assigns tasks to threads.
+    for (RouterT::iterator e = _r->begin_elements(); e; ++e)
+	if (e->type_name() == "StaticThreadSched") {
+	    Vector<String> args;
+	    cp_argvec(e->configuration(), args);
+	    for (int i = 0; i < args.size(); ++i) {
+		Vector<String> words;
+		cp_spacevec(args[i], words);
+		int thread;
+		ElementT *te;
+		if (words.size() == 2 && cp_integer(words[1], &thread)
+		    && (te = _r->element(words[0])))
+		    _info[te->eindex()].task_thread = thread;
+	    }
+	}
+}
+
+void
+PerfModel::read_counters(ControlClient &cc, double interval)
+{
+    String s;
+    // Threads and tasks.
+    for (RouterT::iterator e = _r->begin_elements(); e; ++e) {
+	ElementInfo &ei = _info[e->eindex()];
+	int thread;
+	if (cc.read(e->name() + ".home_thread", s)
+	    && cp_integer(cp_uncomment(s), &thread)) {
+	    ei.task = true;
+	    ei.task_thread = thread;
+	    _measured_threads = true;
+	} else if (cc.read(e->name() + ".handlers", s))
+	    ei.task = false;
+    }
+
+    // Counters, sampled twice.
+    struct timeval tv0, tv1;
+    Vector<ElementInfo> first;
+    for (int round = 0; round < 2; ++round) {
+	if (round) {
+	    usleep((useconds_t) (interval * 1e6));
+	    first = _info;
+	}
+	gettimeofday(round ? &tv1 : &tv0, 0);
+	for (RouterT::iterator e = _r->begin_elements(); e; ++e) {
+	    ElementInfo &ei = _info[e->eindex()];
+	    ei.ocounts.clear();
+	    ei.packets = ei.own_cycles = 0;
+	    ei.have_counts = ei.have_cycles = false;
+	    Vector<String> words;
+	    double d;
+	    if (cc.read(e->name() + ".ocounts", s)) {
+		cp_spacevec(s, words);
+		for (String *w = words.begin(); w != words.end(); ++w)
+		    ei.ocounts.push_back(cp_double(*w, &d) ? d : 0);
+		ei.have_counts = true;
+	    }
+	    if (cc.read(e->name() + ".icounts", s)) {
+		cp_spacevec(s, (words.clear(), words));
+		for (String *w = words.begin(); w != words.end(); ++w)
+		    if (cp_double(*w, &d))
+			ei.packets += d;
+	    }
+	    if (e->ninputs() == 0)
+		for (double *o = ei.ocounts.begin(); o != ei.ocounts.end(); ++o)
+		    ei.packets += *o;
+	    // "cycles" lines are "tasks|timers|xfer CALLS CYCLES".
+	    if (cc.read(e->name() + ".cycles", s)) {
+		cp_spacevec(s, (words.clear(), words));
+		for (int i = 0; i + 2 < words.size(); i += 3)
+		    if (cp_double(words[i + 2], &d))
+			ei.own_cycles += d;
+		ei.have_cycles = true;
+	    }
+	}
+    }
+
+    double dt = (tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6;
+    if (dt <= 0)
+	dt = interval;
+    for (int i = 0; i < _info.size(); ++i) {
+	ElementInfo &ei = _info[i];
+	if (!ei.have_counts || !first[i].have_counts)
+	    continue;
+	_measured_rates = true;
+	double packets = ei.packets - first[i].packets;
+	ei.rate = packets / dt;
+	for (int p = 0; p < ei.ocounts.size() && p < first[i].ocounts.size(); ++p)
+	    ei.ocounts[p] = (ei.ocounts[p] - first[i].ocounts[p]) / dt;
+	if (ei.have_cycles && first[i].have_cycles && packets > 0) {
+	    ei.cost = (ei.own_cycles - first[i].own_cycles) / packets;
+	    ei.cost_source = 'm';
+	}
+    }
+
+    // Queues.
+    for (RouterT::iterator e = _r->begin_elements(); e; ++e) {
+	ElementInfo &ei = _info[e->eindex()];
+	String cap, high, drops;
+	if (!ei.queue || !cc.read(e->name() + ".capacity", cap))
+	    continue;
+	cap = cp_uncomment(cap);
+	cc.read(e->name() + ".highwater_length", high);
+	cc.read(e->name() + ".drops", drops);
+	high = cp_uncomment(high);
+	drops = cp_uncomment(drops);
+	ei.queue_info = "capacity " + cap + ", highwater " + (high ? high : String("?"))
+	    + ", drops " + (drops ? drops : String("?"));
+	ei.queue_full = (high && high == cap) || (drops && drops != "0");
+    }
+}
+
+void
+PerfModel::mark_threads(int task, bool downstream)
+{
+    // Follow push outputs downstream, or pull inputs upstream, from a task.
+    int thread = _info[task].task_thread;
+    Vector<int> visited(_info.size(), 0), stack;
+    stack.push_back(task);
+    while (stack.size()) {
+	int x = stack.back();
+	stack.pop_back();
+	ElementInfo &ei = _info[x];
+	if (find(ei.threads.begin(), ei.threads.end(), thread) == ei.threads.end())
+	    ei.threads.push_back(thread);
+	if (!downstream && x != task
+	    && find(ei.pull_threads.begin(), ei.pull_threads.end(), thread) == ei.pull_threads.end())
+	    ei.pull_threads.push_back(thread);
+	for (EdgeInfo *ed = _edges.begin(); ed != _edges.end(); ++ed)
+	    if (downstream && ed->from == x && !visited[ed->to]
+		&& _processing->output_is_push(x, ed->from_port)) {
+		visited[ed->to] = 1;
+		stack.push_back(ed->to);
+	    } else if (!downstream && ed->to == x && !visited[ed->from]
+		       && _processing->input_is_pull(x, ed->to_port)) {
+		visited[ed->from] = 1;
+		stack.push_back(ed->from);
+	    }
+    }
+}
+
+/** Return the fraction of @a e's packets leaving on output @a port when
+ * no counters are available. */
+double
+PerfModel::split_fraction(ElementT *e, int port) const
+{
+    int n = e->noutputs();
+    String type = e->type_name();
+    if (type == "Tee" || type == "PullTee")
+	return 1;
+    // Outputs beyond the minimum port count are optional and usually carry
+    // errors (CheckIPHeader's output 1); assume they are unused.
+    const String &pc = e->type()->port_count_code();
+    int slash = pc.find_left('/');
+    const char *s = pc.begin() + (slash >= 0 ? slash + 1 : 0);
+    int lo = 0;
+    while (s != pc.end() && isdigit((unsigned char) *s))
+	lo = 10 * lo + *s++ - '0';
+    if (lo > 0 && lo < n)
+	n = lo;
+    return port < n ? 1.0 / n : 0;
+}
+
+void
+PerfModel::static_rates()
+{
+    // Visit elements in topological order from sources, ignoring edges that
+    // close cycles.  Each source emits one packet per unit time.
+    int n = _info.size();
+    Vector<int> order, state(n, 0), stack;
+    for (int i = 0; i < n; ++i)
+	if (_r->element(i)->ninputs() == 0 && _r->element(i)->noutputs() > 0
+	    && _r->element(i)->type_name() != "Idle")
+	    _info[i].rate = 1;
+    for (int root = 0; root < n; ++root) {
+	if (state[root])
+	    continue;
+	// iterative DFS; postorder gives reverse topological order
+	stack.push_back(root);
+	while (stack.size()) {
+	    int x = stack.back();
+	    if (state[x] == 0) {
+		state[x] = 1;
+		for (EdgeInfo *ed = _edges.begin(); ed != _edges.end(); ++ed)
+		    if (ed->from == x && state[ed->to] == 0)
+			stack.push_back(ed->to);
+	    } else {
+		stack.pop_back();
+		if (state[x] == 1) {
+		    state[x] = 2;
+		    order.push_back(x);
+		}
+	    }
+	}
+    }
+    Vector<int> position(n, 0);
+    for (int i = 0; i < order.size(); ++i)
+	position[order[i]] = i;
+    for (int i = order.size() - 1; i >= 0; --i) {
+	int x = order[i];
+	ElementT *e = _r->element(x);
+	for (EdgeInfo *ed = _edges.begin(); ed != _edges.end(); ++ed)
+	    if (ed->from == x) {
+		int nconn = 0;
+		for (EdgeInfo *ed2 = _edges.begin(); ed2 != _edges.end(); ++ed2)
+		    nconn += (ed2->from == x && ed2->from_port == ed->from_port);
+		ed->rate = _info[x].rate * split_fraction(e, ed->from_port) / nconn;
+		if (position[ed->to] < position[x])
+		    _info[ed->to].rate += ed->rate;
+	    }
+    }
+}
+
+void
+PerfModel::compute(ErrorHandler *errh)
+{
+    _edges.clear();
+    for (RouterT::conn_iterator it = _r->begin_connections();
+	 it != _r->end_connections(); ++it) {
+	EdgeInfo ed;
+	ed.from = it->from_eindex();
+	ed.from_port = it->from_port();
+	ed.to = it->to_eindex();
+	ed.to_port = it->to_port();
+	ed.rate = 0;
+	_edges.push_back(ed);
+    }
+    for (int i = 0; i < _info.size(); ++i)
+	if (_info[i].task) {
+	    mark_threads(i, true);
+	    mark_threads(i, false);
+	}
+
+    if (_measured_rates)
+	for (EdgeInfo *ed = _edges.begin(); ed != _edges.end(); ++ed) {
+	    const ElementInfo &from = _info[ed->from];
+	    int nconn = 0;
+	    for (EdgeInfo *ed2 = _edges.begin(); ed2 != _edges.end(); ++ed2)
+		nconn += (ed2->from == ed->from && ed2->from_port == ed->from_port);
+	    if (ed->from_port < from.ocounts.size())
+		ed->rate = from.ocounts[ed->from_port] / nconn;
+	}
+    else
+	static_rates();
+
+    // Costs and per-thread load.
+    for (RouterT::iterator e = _r->begin_elements(); e; ++e) {
+	ElementInfo &ei = _info[e->eindex()];
+	if (ei.cost_source != 'm') {
+	    if (double *c = _class_costs.get_pointer(e->type_name())) {
+		ei.cost = *c;
+		ei.cost_source = 't';
+	    } else
+		ei.cost = _default_cost;
+	}
+	ei.cycles = ei.rate * ei.cost;
+	for (int *t = ei.threads.begin(); t != ei.threads.end(); ++t) {
+	    if (*t >= _thread_cycles.size()) {
+		_thread_cycles.resize(*t + 1, 0);
+		_thread_nelements.resize(*t + 1, 0);
+	    }
+	    _thread_cycles[*t] += ei.cycles / ei.threads.size();
+	    _thread_nelements[*t]++;
+	}
+    }
+
+    _input_rate = 0;
+    for (RouterT::iterator e = _r->begin_elements(); e; ++e)
+	if (e->ninputs() == 0 && e->type_name() != "Idle")
+	    _input_rate += _info[e->eindex()].rate;
+
+    for (int t = 0; t < _thread_cycles.size(); ++t)
+	if (_bottleneck < 0 || _thread_cycles[t] > _thread_cycles[_bottleneck])
+	    _bottleneck = t;
+    if (_bottleneck < 0 || _thread_cycles[_bottleneck] <= 0) {
+	errh->warning("no packets flow through this configuration");
+	return;
+    }
+
+    // Without measured rates, scale so the bottleneck thread is saturated.
+    if (!_measured_rates) {
+	double scale = _hz / _thread_cycles[_bottleneck];
+	for (ElementInfo *ei = _info.begin(); ei != _info.end(); ++ei) {
+	    ei->rate *= scale;
+	    ei->cycles *= scale;
+	}
+	for (EdgeInfo *ed = _edges.begin(); ed != _edges.end(); ++ed)
+	    ed->rate *= scale;
+	for (double *c = _thread_cycles.begin(); c != _thread_cycles.end(); ++c)
+	    *c *= scale;
+	_input_rate *= scale;
+	// A queue filled by another thread and drained by the bottleneck
+	// thread will fill up.
+	for (ElementInfo *ei = _info.begin(); ei != _info.end(); ++ei)
+	    if (ei->queue && ei->threads.size() > 1
+		&& find(ei->pull_threads.begin(), ei->pull_threads.end(), _bottleneck) != ei->pull_threads.end()) {
+		ei->queue_info = "drained by bottleneck thread";
+		ei->queue_full = true;
+	    }
+    }
+}
+
+static String
+format_rate(double pps)
+{
+    char buf[40];
+    sprintf(buf, "%.3f", pps / 1e6);
+    return String(buf);
+}
+
+/** @brief Return the fraction of the bottleneck thread's cycles that @a ei
+ * uses. */
+double
+PerfModel::bottleneck_share(const ElementInfo &ei) const
+{
+    for (int k = 0; k < ei.threads.size(); ++k)
+	if (ei.threads[k] == _bottleneck)
+	    return ei.cycles / ei.threads.size() / _thread_cycles[_bottleneck];
+    return 0;
+}
+
+void
+PerfModel::write_report(FILE *f, const char *filename) const
+{
+    fprintf(f, "# %s: %s rates, %s threads, %.0f MHz\n", filename,
+	    _measured_rates ? "measured" : "estimated",
+	    _measured_threads ? "measured" : "configured", _hz / 1e6);
+    if (_bottleneck < 0)
+	return;
+
+    // The input rate the configuration could sustain is limited by the
+    // busiest thread.
+    double max_input = _input_rate * _hz / _thread_cycles[_bottleneck];
+    fprintf(f, "input_mpps %s\nmax_input_mpps %s\n\n",
+	    format_rate(_input_rate).c_str(), format_rate(max_input).c_str());
+
+    fprintf(f, "%-8s %8s %10s %8s\n", "thread", "elements", "Mcycles/s", "load");
+    for (int t = 0; t < _thread_cycles.size(); ++t)
+	if (_thread_nelements[t])
+	    fprintf(f, "%-8d %8d %10.1f %7.1f%%%s\n", t, _thread_nelements[t],
+		    _thread_cycles[t] / 1e6, 100 * _thread_cycles[t] / _hz,
+		    t == _bottleneck ? "  bottleneck" : "");
+
+    // Elements without ports handle no packets.
+    Vector<int> order;
+    int namew = 7, classw = 5;
+    for (int i = 0; i < _info.size(); ++i) {
+	ElementT *e = _r->element(i);
+	if (e->ninputs() || e->noutputs()) {
+	    order.push_back(i);
+	    if (e->name().length() > namew)
+		namew = e->name().length();
+	    if (e->type_name().length() > classw)
+		classw = e->type_name().length();
+	}
+    }
+    fprintf(f, "\n%-*s %-*s %-7s %9s %11s %8s\n", namew, "element",
+	    classw, "class", "thread", "Mpps", "cycles/pkt", "share");
+    // insertion sort by share of the bottleneck thread, then by cycles,
+    // descending
+    Vector<double> shares;
+    for (int i = 0; i < order.size(); ++i)
+	shares.push_back(bottleneck_share(_info[order[i]]));
+    for (int i = 1; i < order.size(); ++i)
+	for (int j = i; j > 0 && (shares[j] > shares[j-1]
+				  || (shares[j] == shares[j-1]
+				      && _info[order[j]].cycles > _info[order[j-1]].cycles)); --j) {
+	    click_swap(order[j], order[j-1]);
+	    click_swap(shares[j], shares[j-1]);
+	}
+    for (int i = 0; i < order.size(); ++i) {
+	const ElementInfo &ei = _info[order[i]];
+	ElementT *e = _r->element(order[i]);
+	StringAccum threads;
+	for (int k = 0; k < ei.threads.size(); ++k)
+	    threads << (k ? "," : "") << ei.threads[k];
+	fprintf(f, "%-*s %-*s %-7s %9s %10.1f%c %7.1f%%\n", namew, e->name_c_str(),
+		classw, e->type_name().c_str(), threads.length() ? threads.c_str() : "-",
+		format_rate(ei.rate).c_str(), ei.cost, ei.cost_source,
+		100 * shares[i]);
+    }
+
+    bool any_queue = false;
+    for (int i = 0; i < _info.size(); ++i)
+	if (_info[i].queue && _info[i].queue_info) {
+	    if (!any_queue)
+		fprintf(f, "\n");
+	    any_queue = true;
+	    fprintf(f, "queue %s: %s%s\n", _r->element(i)->name_c_str(),
+		    _info[i].queue_info.c_str(),
+		    _info[i].queue_full ? "  bottleneck" : "");
+	}
+}
+
+void
+PerfModel::write_dot(FILE *f) const
+{
+    fprintf(f, "digraph clickrouter {\n\
+  node [shape=record,height=.1]\n\
+  edge [arrowhead=normal,arrowtail=none,tailclip=false]\n");
+
+    for (RouterT::iterator n = _r->begin_elements(); n; ++n) {
+	const ElementInfo &ei = _info[n->eindex()];
+	fprintf(f, "  \"%s\" [label=\"", n->name_c_str());
+	if (n->ninputs() || n->noutputs())
+	    fprintf(f, "{");
+	if (n->ninputs()) {
+	    fprintf(f, "{");
+	    for (int i = 0; i < n->ninputs(); i++)
+		fprintf(f, (i ? "|<i%d>" : "<i%d>"), i);
+	    fprintf(f, "}|");
+	}
+	fprintf(f, "%s\\n%s", n->name_c_str(), n->type_name().c_str());
+	if (n->ninputs() || n->noutputs())
+	    fprintf(f, "\\n%.1f cycles/pkt", ei.cost);
+	if (n->noutputs()) {
+	    fprintf(f, "|{");
+	    for (int i = 0; i < n->noutputs(); i++)
+		fprintf(f, (i ? "|<o%d>" : "<o%d>"), i);
+	    fprintf(f, "}");
+	}
+	if (n->ninputs() || n->noutputs())
+	    fprintf(f, "}");
+	fprintf(f, "\"");
+	// Highlight elements that use a tenth or more of the bottleneck
+	// thread, and full queues.
+	if (bottleneck_share(ei) >= 0.1 || ei.queue_full)
+	    fprintf(f, ",style=filled,fillcolor=\"%s\"", ei.queue_full ? "orange" : "salmon");
+	fprintf(f, "];\n");
+    }
+
+    for (const EdgeInfo *ed = _edges.begin(); ed != _edges.end(); ++ed)
+	fprintf(f, "  \"%s\":o%d -> \"%s\":i%d [label=\"%s Mpps\"];\n",
+		_r->element(ed->from)->name_c_str(), ed->from_port,
+		_r->element(ed->to)->name_c_str(), ed->to_port,
+		format_rate(ed->rate).c_str());
+
+    fprintf(f, "}\n");
+}
+
+int
+PerfModel::save_costs(const char *filename, ErrorHandler *errh) const
+{
+    // Average measured costs by class, weighted by packets.
+    HashTable<String, double> cycles(0), packets(0);
+    Vector<String> classes;
+    for (RouterT::iterator e = _r->begin_elements(); e; ++e) {
+	const ElementInfo &ei = _info[e->eindex()];
+	if (ei.cost_source != 'm')
+	    continue;
+	if (!packets.get_pointer(e->type_name()))
+	    classes.push_back(e->type_name());
+	cycles[e->type_name()] += ei.cost * ei.rate;
+	packets[e->type_name()] += ei.rate;
+    }
+    if (!classes.size())
+	return errh->error("no measured costs to save (is the driver built with --enable-stats=2?)");
+    FILE *f = fopen(filename, "w");
+    if (!f)
+	return errh->error("%s: %s", filename, strerror(errno));
+    fprintf(f, "# click-perf cost table: CLASS CYCLES_PER_PACKET\n");
+    for (String *c = classes.begin(); c != classes.end(); ++c)
+	fprintf(f, "%s %.1f\n", c->c_str(), cycles[*c] / packets[*c]);
+    fclose(f);
+    return 0;
+}
+
+
+// PARTITIONING
+
+/** @brief A configuration's task graph, for choosing thread assignments.
+ *
+ * Each task, with the elements it runs, forms a domain.  Domains that share
+ * an element must run on the same thread, unless the element is a
+ * ThreadSafeQueue, or a queue that one domain pushes and the other pulls.
+ * Such constrained domains form groups, which are bin-packed onto threads.
+ * A handoff through a queue between groups on different threads costs the
+ * consumer extra cycles for each packet. */
+class PartitionGraph { public:
+
+    struct Node {
+	double cycles;
+	double rate;
+	bool task;
+	bool queue;
+	bool safe;		// may be used by several threads at once
+    };
+
+    struct Edge {
+	int from, to;
+	bool push;
+	double rate;
+	int orig;		// index of original connection, or -1
+    };
+
+    Vector<Node> nodes;
+    Vector<Edge> edges;
+
+    void cut(int edge, double queue_cost, double unqueue_cost);
+    double assign(int nthreads, double handoff_cost,
+		  Vector<int> *task_threads) const;
+
+  private:
+
+    static int find_group(Vector<int> &parent, int x) {
+	while (parent[x] != x)
+	    x = parent[x] = parent[parent[x]];
+	return x;
+    }
+
+};
+
+/** @brief Hand packets on @a edge off through a new ThreadSafeQueue and
+ * Unqueue. */
+void
+PartitionGraph::cut(int edge, double queue_cost, double unqueue_cost)
+{
+    double rate = edges[edge].rate;
+    int q = nodes.size(), u = q + 1;
+    Node qn = { rate * queue_cost, rate, false, true, true };
+    Node un = { rate * unqueue_cost, rate, true, false, false };
+    nodes.push_back(qn);
+    nodes.push_back(un);
+    Edge qe = { q, u, false, rate, -1 };
+    Edge ue = { u, edges[edge].to, true, rate, -1 };
+    edges[edge].to = q;
+    edges.push_back(qe);
+    edges.push_back(ue);
+}
+
+/** @brief Assign groups to @a nthreads threads and return the busiest
+ * thread's cycles.
+ *
+ * Groups are placed largest first, each on the thread that minimizes the
+ * busiest thread's load, counting handoffs to groups already placed.  If
+ * @a task_threads is nonnull, it is set to each node's thread, or -1 for
+ * nodes that are not tasks. */
+double
+PartitionGraph::assign(int nthreads, double handoff_cost,
+		       Vector<int> *task_threads) const
+{
+    int n = nodes.size();
+    Vector<Vector<int> > down(n, Vector<int>()), up(n, Vector<int>());
+    for (int i = 0; i < edges.size(); ++i)
+	(edges[i].push ? down[edges[i].from] : up[edges[i].to]).push_back(i);
+
+    // Domains: the elements each task pushes to or pulls from.
+    Vector<int> tasks;
+    Vector<Vector<int> > pushers(n, Vector<int>()), pullers(n, Vector<int>());
+    for (int t = 0; t < n; ++t) {
+	if (!nodes[t].task)
+	    continue;
+	int d = tasks.size();
+	tasks.push_back(t);
+	for (int dir = 0; dir < 2; ++dir) {
+	    Vector<Vector<int> > &adj = (dir ? up : down);
+	    Vector<Vector<int> > &members = (dir ? pullers : pushers);
+	    Vector<int> stack;
+	    stack.push_back(t);
+	    while (stack.size()) {
+		int x = stack.back();
+		stack.pop_back();
+		if (find(members[x].begin(), members[x].end(), d) != members[x].end())
+		    continue;
+		members[x].push_back(d);
+		for (int *e = adj[x].begin(); e != adj[x].end(); ++e)
+		    stack.push_back(dir ? edges[*e].from : edges[*e].to);
+	    }
+	}
+    }
+
+    int ndomains = tasks.size();
+    Vector<int> parent(ndomains, 0);
+    for (int d = 0; d < ndomains; ++d)
+	parent[d] = d;
+    Vector<double> dload(ndomains, 0);
+    for (int x = 0; x < n; ++x) {
+	Vector<int> all = pushers[x];
+	for (int *d = pullers[x].begin(); d != pullers[x].end(); ++d)
+	    if (find(all.begin(), all.end(), *d) == all.end())
+		all.push_back(*d);
+	for (int *d = all.begin(); d != all.end(); ++d)
+	    dload[*d] += nodes[x].cycles / all.size();
+	if (nodes[x].safe)
+	    continue;
+	else if (nodes[x].queue) {
+	    for (int i = 1; i < pushers[x].size(); ++i)
+		parent[find_group(parent, pushers[x][i])] = find_group(parent, pushers[x][0]);
+	    for (int i = 1; i < pullers[x].size(); ++i)
+		parent[find_group(parent, pullers[x][i])] = find_group(parent, pullers[x][0]);
+	} else
+	    for (int i = 1; i < all.size(); ++i)
+		parent[find_group(parent, all[i])] = find_group(parent, all[0]);
+    }
+
+    Vector<double> gload(ndomains, 0);
+    for (int d = 0; d < ndomains; ++d)
+	gload[find_group(parent, d)] += dload[d];
+
+    // Handoffs between groups: producer group, consumer group, rate.
+    struct Link {
+	int from, to;
+	double rate;
+    };
+    Vector<Link> links;
+    for (int x = 0; x < n; ++x)
+	if (nodes[x].queue)
+	    for (int *p = pushers[x].begin(); p != pushers[x].end(); ++p)
+		for (int *c = pullers[x].begin(); c != pullers[x].end(); ++c) {
+		    Link l = { find_group(parent, *p), find_group(parent, *c),
+			       nodes[x].rate / (pushers[x].size() * pullers[x].size()) };
+		    if (l.from != l.to)
+			links.push_back(l);
+		}
+
+    Vector<int> order;
+    for (int d = 0; d < ndomains; ++d)
+	if (find_group(parent, d) == d)
+	    order.push_back(d);
+    for (int i = 1; i < order.size(); ++i)
+	for (int j = i; j > 0 && gload[order[j]] > gload[order[j-1]]; --j)
+	    click_swap(order[j], order[j-1]);
+
+    Vector<int> gthread(ndomains, -1);
+    Vector<double> load(nthreads, 0);
+    for (int *g = order.begin(); g != order.end(); ++g) {
+	// Minimize the busiest thread's load, then this group's thread's load.
+	int best = 0;
+	double best_max = 0, best_own = 0;
+	for (int t = 0; t < nthreads; ++t) {
+	    Vector<double> l = load;
+	    l[t] += gload[*g];
+	    for (Link *k = links.begin(); k != links.end(); ++k)
+		if (k->from == *g && gthread[k->to] >= 0 && gthread[k->to] != t)
+		    l[gthread[k->to]] += k->rate * handoff_cost;
+		else if (k->to == *g && gthread[k->from] >= 0 && gthread[k->from] != t)
+		    l[t] += k->rate * handoff_cost;
+	    double m = 0;
+	    for (int i = 0; i < nthreads; ++i)
+		if (l[i] > m)
+		    m = l[i];
+	    if (t == 0 || m < best_max || (m == best_max && l[t] < best_own)) {
+		best = t;
+		best_max = m;
+		best_own = l[t];
+	    }
+	}
+	gthread[*g] = best;
+	load[best] += gload[*g];
+	for (Link *k = links.begin(); k != links.end(); ++k)
+	    if (k->from == *g && gthread[k->to] >= 0 && gthread[k->to] != best)
+		load[gthread[k->to]] += k->rate * handoff_cost;
+	    else if (k->to == *g && gthread[k->from] >= 0 && gthread[k->from] != best)
+		load[best] += k->rate * handoff_cost;
+    }
+
+    if (task_threads) {
+	task_threads->assign(n, -1);
+	for (int d = 0; d < ndomains; ++d)
+	    (*task_threads)[tasks[d]] = gthread[find_group(parent, d)];
+    }
+    double m = 0;
+    for (int t = 0; t < nthreads; ++t)
+	if (load[t] > m)
+	    m = load[t];
+    return m;
+}
+
+double
+PerfModel::class_cost(const String &type) const
+{
+    if (const double *c = _class_costs.get_pointer(type))
+	return *c;
+    return _default_cost;
+}
+
+/** @brief Rewrite the configuration to run on @a nthreads threads.
+ *
+ * Starting from the configuration's own tasks, repeatedly hands off the
+ * push connection whose new ThreadSafeQueue and Unqueue most reduce the
+ * busiest thread's load, then assigns tasks to threads with a new
+ * StaticThreadSched.  Element-to-thread arguments of existing
+ * StaticThreadScheds are removed. */
+int
+PerfModel::partition(int nthreads, double handoff_cost, ErrorHandler *errh)
+{
+    if (_bottleneck < 0)
+	return errh->error("nothing to partition");
+
+    PartitionGraph g;
+    for (int i = 0; i < _info.size(); ++i) {
+	PartitionGraph::Node n = { _info[i].cycles, _info[i].rate, _info[i].task,
+				   _info[i].queue,
+				   _r->element(i)->type_name() == "ThreadSafeQueue" };
+	g.nodes.push_back(n);
+    }
+    for (int i = 0; i < _edges.size(); ++i) {
+	const EdgeInfo &ed = _edges[i];
+	PartitionGraph::Edge e = { ed.from, ed.to,
+				   _processing->output_is_push(ed.from, ed.from_port),
+				   ed.rate, i };
+	g.edges.push_back(e);
+    }
+
+    double queue_cost = class_cost("ThreadSafeQueue");
+    double unqueue_cost = class_cost("Unqueue");
+    double best = g.assign(nthreads, handoff_cost, 0);
+    Vector<int> cuts;
+    while (1) {
+	int best_edge = -1;
+	// Demand a real improvement, not rounding noise.
+	double want = best * 0.99;
+	for (int i = 0; i < g.edges.size(); ++i) {
+	    const PartitionGraph::Edge &e = g.edges[i];
+	    if (!e.push || e.rate <= 0 || e.orig < 0 || g.nodes[e.to].queue)
+		continue;
+	    PartitionGraph h(g);
+	    h.cut(i, queue_cost, unqueue_cost);
+	    double m = h.assign(nthreads, handoff_cost, 0);
+	    if (m < want) {
+		want = best = m;
+		best_edge = i;
+	    }
+	}
+	if (best_edge < 0)
+	    break;
+	cuts.push_back(g.edges[best_edge].orig);
+	g.cut(best_edge, queue_cost, unqueue_cost);
+    }
+    Vector<int> threads;
+    g.assign(nthreads, handoff_cost, &threads);
+
+    // Apply the cuts.
+    LandmarkT landmark("<click-perf>");
+    ElementClassT *queue_class = ElementClassT::base_type("ThreadSafeQueue");
+    ElementClassT *unqueue_class = ElementClassT::base_type("Unqueue");
+    Vector<ElementT *> tasks;
+    for (int i = 0; i < _info.size(); ++i)
+	tasks.push_back(_info[i].task ? _r->element(i) : 0);
+    int anonymizer = 1;
+    for (int *c = cuts.begin(); c != cuts.end(); ++c) {
+	const EdgeInfo &ed = _edges[*c];
+	PortT from(_r->element(ed.from), ed.from_port), to(_r->element(ed.to), ed.to_port);
+	RouterT::conn_iterator it = _r->find_connections_from(from);
+	while (it->to() != to)
+	    ++it;
+	while (_r->element("ThreadSafeQueue@click_perf@" + String(anonymizer))
+	       || _r->element("Unqueue@click_perf@" + String(anonymizer)))
+	    ++anonymizer;
+	ElementT *q = _r->get_element("ThreadSafeQueue@click_perf@" + String(anonymizer),
+				      queue_class, "1024", landmark);
+	ElementT *u = _r->get_element("Unqueue@click_perf@" + String(anonymizer),
+				      unqueue_class, "BURST 32", landmark);
+	_r->change_connection_to(it, PortT(q, 0));
+	_r->add_connection(q, 0, u, 0, landmark);
+	_r->add_connection(u, 0, to.element, to.port, landmark);
+	tasks.push_back(0);
+	tasks.push_back(u);
+    }
+
+    StringAccum sa;
+    for (int i = 0; i < threads.size(); ++i)
+	if (threads[i] >= 0 && tasks[i])
+	    sa << (sa.length() ? ", " : "") << tasks[i]->name() << ' ' << threads[i];
+
+    // Replace existing thread assignments.
+    for (RouterT::iterator e = _r->begin_elements(); e; ++e)
+	if (e->type_name() == "StaticThreadSched") {
+	    Vector<String> args, keep;
+	    cp_argvec(e->configuration(), args);
+	    for (String *a = args.begin(); a != args.end(); ++a) {
+		Vector<String> words;
+		int thread;
+		cp_spacevec(*a, words);
+		if (!(words.size() == 2 && cp_integer(words[1], &thread)
+		      && _r->element(words[0])))
+		    keep.push_back(*a);
+	    }
+	    if (keep.size())
+		e->set_configuration(cp_unargvec(keep));
+	    else
+		e->kill();
+	}
+    _r->remove_dead_elements();
+    if (sa.length())
+	_r->add_anon_element(ElementClassT::base_type("StaticThreadSched"),
+			     sa.take_string(), landmark);
+    return 0;
+}
+
+static double
+default_cpu_hz()
+{
+    double mhz = 0;
+    if (FILE *f = fopen("/proc/cpuinfo", "r")) {
+	char buf[256];
+	while (fgets(buf, sizeof(buf), f) && mhz <= 0)
+	    if (strncmp(buf, "cpu MHz", 7) == 0)
+		if (char *colon = strchr(buf, ':'))
+		    mhz = strtod(colon + 1, 0);
+	fclose(f);
+    }
+    return (mhz > 0 ? mhz : 2000) * 1e6;
+}
+
+int
+main(int argc, char **argv)
+{
+    click_static_initialize();
+    CLICK_DEFAULT_PROVIDES;
+    ErrorHandler *errh = ErrorHandler::default_handler();
+    ErrorHandler *p_errh = new PrefixErrorHandler(errh, "click-perf: ");
+
+    // read command line arguments
+    Clp_Parser *clp =
+	Clp_NewParser(argc, argv, sizeof(options) / sizeof(options[0]), options);
+    Clp_SetOptionChar(clp, '+', Clp_ShortNegated);
+    program_name = Clp_ProgramName(clp);
+
+    const char *router_file = 0;
+    bool file_is_expr = false;
+    const char *output_file = 0;
+    const char *save_costs_file = 0;
+    Vector<String> cost_files;
+    double default_cost = 100;
+    String port, unix_socket;
+    double interval = 1;
+    double hz = 0;
+    bool dot = false;
+    int partition_threads = 0;
+    double handoff_cost = 200;
+
+    while (1) {
+	int opt = Clp_Next(clp);
+	switch (opt) {
+
+	case HELP_OPT:
+	    usage();
+	    exit(0);
+	    break;
+
+	case VERSION_OPT:
+	    printf("click-perf (Click) %s\n", CLICK_VERSION);
+	    printf("This is free software; see the source for copying conditions.\n\
+There is NO warranty, not even for merchantability or fitness for a\n\
+particular purpose.\n");
+	    exit(0);
+	    break;
+
+	case CLICKPATH_OPT:
+	    set_clickpath(clp->vstr);
+	    break;
+
+	case ROUTER_OPT:
+	case EXPRESSION_OPT:
+	router_file:
+	    if (router_file) {
+		p_errh->error("router configuration specified twice");
+		goto bad_option;
+	    }
+	    router_file = clp->vstr;
+	    file_is_expr = (opt == EXPRESSION_OPT);
+	    break;
+
+	case Clp_NotOption:
+	    if (!click_maybe_define(clp->vstr, p_errh))
+		goto router_file;
+	    break;
+
+	case OUTPUT_OPT:
+	    if (output_file) {
+		p_errh->error("output file specified twice");
+		goto bad_option;
+	    }
+	    output_file = clp->vstr;
+	    break;
+
+	case COSTS_OPT:
+	    cost_files.push_back(clp->vstr);
+	    break;
+
+	case DEFAULT_COST_OPT:
+	    default_cost = clp->val.d;
+	    break;
+
+	case PORT_OPT:
+	    port = clp->vstr;
+	    break;
+
+	case UNIX_SOCKET_OPT:
+	    unix_socket = clp->vstr;
+	    break;
+
+	case INTERVAL_OPT:
+	    if (clp->val.d <= 0) {
+		p_errh->error("interval must be positive");
+		goto bad_option;
+	    }
+	    interval = clp->val.d;
+	    break;
+
+	case SAVE_COSTS_OPT:
+	    save_costs_file = clp->vstr;
+	    break;
+
+	case CPU_MHZ_OPT:
+	    if (clp->val.d <= 0) {
+		p_errh->error("CPU rate must be positive");
+		goto bad_option;
+	    }
+	    hz = clp->val.d * 1e6;
+	    break;
+
+	case DOT_OPT:
+	    dot = !clp->negated;
+	    break;
+
+	case PARTITION_OPT:
+	    if (clp->val.i <= 0) {
+		p_errh->error("number of threads must be positive");
+		goto bad_option;
+	    }
+	    partition_threads = clp->val.i;
+	    break;
+
+	case HANDOFF_COST_OPT:
+	    handoff_cost = clp->val.d;
+	    break;
+
+	bad_option:
+	case Clp_BadOption:
+	    short_usage();
+	    exit(1);
+	    break;
+
+	case Clp_Done:
+	    goto done;
+
+	}
+    }
+
+  done:
+    // connect to the running router, if any
+    ControlClient cc;
+    if (port && unix_socket)
+	p_errh->fatal("specify at most one of --port and --unix-socket");
+    else if (port && cc.connect_tcp(port, p_errh) < 0)
+	exit(1);
+    else if (unix_socket && cc.connect_unix(unix_socket, p_errh) < 0)
+	exit(1);
+    if (save_costs_file && !cc.ok())
+	p_errh->fatal("--save-costs requires --port or --unix-socket");
+
+    // read the configuration, from the running router if no file is given
+    RouterT *r;
+    if (!router_file && cc.ok()) {
+	String config;
+	if (!cc.read("flatconfig", config))
+	    p_errh->fatal("cannot read configuration from router");
+	r = read_router(config, true, errh);
+	router_file = "<router>";
+    } else {
+	r = read_router(router_file, file_is_expr, errh);
+	if (file_is_expr)
+	    router_file = "config";
+	else if (!router_file || strcmp(router_file, "-") == 0)
+	    router_file = "<stdin>";
+    }
+    if (r)
+	r->flatten(errh);
+    if (!r || errh->nerrors() > 0)
+	exit(1);
+
+    ElementMap *emap = ElementMap::default_map();
+    emap->parse_all_files(r, CLICK_DATADIR, p_errh);
+    emap->set_driver(emap->pick_driver(Driver::USERLEVEL, r, p_errh));
+    ProcessingT processing(r, emap, errh);
+
+    if (!hz)
+	hz = default_cpu_hz();
+    PerfModel model(r, &processing, hz);
+    model.set_default_cost(default_cost);
+    for (String *fn = cost_files.begin(); fn != cost_files.end(); ++fn)
+	model.read_costs(file_string(*fn, p_errh), *fn, p_errh);
+    model.prepare();
+    if (cc.ok())
+	model.read_counters(cc, interval);
+    model.compute(p_errh);
+
+    FILE *outf = stdout;
+    if (output_file && strcmp(output_file, "-") != 0) {
+	outf = fopen(output_file, "w");
+	if (!outf)
+	    p_errh->fatal("%s: %s", output_file, strerror(errno));
+    }
+    if (partition_threads) {
+	if (model.partition(partition_threads, handoff_cost, p_errh) < 0)
+	    exit(1);
+	write_router_file(r, outf, errh);
+    } else if (dot)
+	model.write_dot(outf);
+    else
+	model.write_report(outf, router_file);
+    if (outf != stdout)
+	fclose(outf);
+
+    if (save_costs_file && model.save_costs(save_costs_file, p_errh) < 0)
+	exit(1);
+    exit(0);
+}
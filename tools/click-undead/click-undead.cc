@@ -23,6 +23,7 @@
 #include "lexert.hh"
 #include "processingt.hh"
 #include "elementmap.hh"
+#include "classifiert.hh"
 #include <click/error.hh>
 #include <click/args.hh>
 #include <click/straccum.hh>
@@ -86,7 +87,8 @@ usage()
   printf("\
 'Click-undead' transforms a router configuration by removing dead code. This\n\
 includes any elements that are not connected both to a packet source and to a\n\
-packet sink. It also removes redundant elements, such as Null and StaticSwitch.\n\
+packet sink. It also removes redundant elements, such as Null and StaticSwitch,\n\
+and Classifier outputs that no packet can reach.\n\
 \n\
 Usage: %s [OPTION]... [ROUTERFILE]\n\
 \n\
@@ -637,6 +639,9 @@ particular purpose.\n");
     }
   }
 
+  // remove unreachable Classifier outputs
+  ClassifierT(r).remove_unreachable(verbose ? default_errh : 0);
+
   // save numbers of inputs and outputs for later
   save_element_nports(r);
 
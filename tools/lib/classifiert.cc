@@ -0,0 +1,386 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * classifiert.{cc,hh} -- combine cascaded Classifiers in a configuration
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+
+#include "classifiert.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <ctype.h>
+
+ClassifierT::ClassifierT(RouterT *router)
+    : _router(router),
+      _classifier_type(ElementClassT::base_type("Classifier")),
+      _ipclassifier_type(ElementClassT::base_type("IPClassifier")),
+      _discard_type(ElementClassT::base_type("Discard")),
+      _idle_type(ElementClassT::base_type("Idle")),
+      _ncombined(0), _nunreachable(0), _inspections_saved(0)
+{
+}
+
+/** @brief Collect the targets of @a e's outputs into @a outs.
+ *
+ * Fails unless @a e has exactly @a noutputs outputs, each connected once. */
+bool
+ClassifierT::output_ports(ElementT *e, int noutputs, Vector<PortT> &outs) const
+{
+    outs.assign(noutputs, PortT());
+    for (RouterT::conn_iterator it = _router->find_connections_from(e);
+	 it; ++it) {
+	int p = it->from_port();
+	if (p >= noutputs || outs[p].element)
+	    return false;
+	outs[p] = it->to();
+    }
+    for (int i = 0; i < noutputs; i++)
+	if (!outs[i].element)
+	    return false;
+    return true;
+}
+
+void
+ClassifierT::set_outputs(ElementT *e, const Vector<String> &words,
+			 const Vector<PortT> &outs)
+{
+    RouterT::conn_iterator it = _router->find_connections_from(e);
+    while (it)
+	it = _router->erase(it);
+    for (int i = 0; i < outs.size(); i++)
+	_router->add_connection(PortT(e, i), outs[i]);
+    e->set_configuration(cp_unargvec(words));
+}
+
+static String
+trim(const String &s)
+{
+    const char *b = s.begin(), *e = s.end();
+    while (b < e && isspace((unsigned char) *b))
+	b++;
+    while (e > b && isspace((unsigned char) e[-1]))
+	e--;
+    return s.substring(b, e);
+}
+
+// IPClassifier words that begin a primitive with its own qualifiers.  A
+// primitive that starts with anything else, such as a bare address or
+// port, inherits the qualifiers of the primitive before it.
+static const char * const ip_qualifiers[] = {
+    "ah", "ce", "dccp", "dest", "dscp", "dst", "ect", "esp", "ether",
+    "false", "frag", "gre", "hl", "host", "icmp", "id", "igmp", "ip",
+    "ipip", "len", "net", "opt", "port", "proto", "sctp", "src", "tcp",
+    "tos", "true", "ttl", "type", "udp", "unfrag", "vers", "win"
+};
+
+static void
+ip_words(const String &p, Vector<String> &words)
+{
+    StringAccum sa;
+    for (const char *s = p.begin(); s != p.end(); ++s)
+	if (*s == '(' || *s == ')')
+	    sa << ' ' << *s << ' ';
+	else
+	    sa << *s;
+    cp_spacevec(sa.take_string(), words);
+}
+
+static bool
+ip_qualifier(const String &word)
+{
+    for (size_t i = 0; i < sizeof(ip_qualifiers) / sizeof(ip_qualifiers[0]); i++)
+	if (word == ip_qualifiers[i])
+	    return true;
+    return false;
+}
+
+// "src and dst host A" splits at "and" into "src", which is not a term.
+static bool
+ip_explicit(const String &term)
+{
+    Vector<String> words;
+    ip_words(term, words);
+    return words.size() && ip_qualifier(words[0])
+	&& !(words.size() == 1 && words[0] == "src");
+}
+
+// True if pattern @a p's first primitive names its own qualifiers, so it
+// does not inherit them from a primitive conjoined before it.
+static bool
+ip_leads_explicit(const String &p)
+{
+    Vector<String> words;
+    ip_words(p, words);
+    int i = 0;
+    while (i < words.size() && (words[i] == "(" || words[i] == "not"))
+	i++;
+    return i < words.size() && ip_qualifier(words[i]);
+}
+
+static String
+conjoin(const String &a, const String &b, bool ip)
+{
+    if (a == "-")
+	return b;
+    else if (b == "-")
+	return a;
+    else if (ip)
+	return "(" + a + ") and (" + b + ")";
+    else
+	return a + " " + b;
+}
+
+/** @brief Fold classifier @a to into @a from's output @a from_port.
+ *
+ * Output @a from_port's pattern P is replaced by P conjoined with each of
+ * @a to's patterns.  Packets that match P but none of @a to's patterns were
+ * dropped by @a to, so unless @a to ends with a catch-all, P itself is added
+ * last and sent to a new Discard.  IPClassifiers are not combined if one of
+ * @a to's patterns starts with a bare value, such as "10.0.0.0/8", since in
+ * the conjunction it would inherit the qualifiers of P. */
+bool
+ClassifierT::combine(ElementT *from, int from_port, ElementT *to)
+{
+    Vector<String> from_words, to_words;
+    cp_argvec(from->configuration(), from_words);
+    cp_argvec(to->configuration(), to_words);
+    Vector<PortT> from_outs, to_outs;
+    if (!output_ports(from, from_words.size(), from_outs)
+	|| !output_ports(to, to_words.size(), to_outs)
+	|| to_words.size() == 0)
+	return false;
+
+    // In "(P) and (Q)", Q's first primitive would inherit P's qualifiers
+    bool ip = (from->type() == _ipclassifier_type);
+    for (int i = 0; ip && i < to_words.size(); i++)
+	if (trim(to_words[i]) != "-" && !ip_leads_explicit(to_words[i]))
+	    return false;
+
+    Vector<String> words;
+    Vector<PortT> outs;
+    for (int i = 0; i < from_port; i++) {
+	words.push_back(from_words[i]);
+	outs.push_back(from_outs[i]);
+    }
+    bool catch_all = false;
+    for (int i = 0; i < to_words.size(); i++) {
+	words.push_back(conjoin(from_words[from_port], to_words[i], ip));
+	outs.push_back(to_outs[i]);
+	catch_all = catch_all || to_words[i] == "-";
+    }
+    if (!catch_all) {
+	ElementT *discard = _router->add_anon_element(_discard_type, String(), to->landmarkt());
+	words.push_back(from_words[from_port]);
+	outs.push_back(PortT(discard, 0));
+    }
+    for (int i = from_port + 1; i < from_words.size(); i++) {
+	words.push_back(from_words[i]);
+	outs.push_back(from_outs[i]);
+    }
+
+    set_outputs(from, words, outs);
+    to->kill();
+
+    // Packets on this path now skip one header inspection, plus whatever
+    // was already saved by combining into 'to'.
+    if (_saved.size() < _router->nelements())
+	_saved.resize(_router->nelements(), 0);
+    int saved = _saved[to->eindex()] + 1;
+    if (saved > _saved[from->eindex()])
+	_saved[from->eindex()] = saved;
+    if (saved > _inspections_saved)
+	_inspections_saved = saved;
+    return true;
+}
+
+/** @brief Combine cascaded classifiers throughout the router.
+ *
+ * A Classifier (IPClassifier) whose only input comes from another
+ * Classifier (IPClassifier) is folded into that classifier, so packets are
+ * classified once.  Combined classifiers are removed from the router.
+ * Returns the number of classifiers removed. */
+int
+ClassifierT::combine()
+{
+    int n = 0;
+    for (bool any = true; any; ) {
+	any = false;
+	for (int i = 0; i < _router->nelements(); i++) {
+	    ElementT *to = _router->element(i);
+	    if (to->dead() || !is_classifier(to))
+		continue;
+	    RouterT::conn_iterator it = _router->find_connections_to(to);
+	    if (!it || it->to_port() != 0)
+		continue;
+	    RouterT::conn_iterator next = it;
+	    ++next;
+	    ElementT *from = it->from_element();
+	    if (!next && from != to && from->type() == to->type()
+		&& combine(from, it->from_port(), to)) {
+		any = true;
+		n++;
+	    }
+	}
+    }
+    _router->remove_dead_elements();
+    _saved.clear();
+    _ncombined += n;
+    return n;
+}
+
+static bool
+ip_conjuncts(const String &p, Vector<String> &terms)
+{
+    int depth = 0, start = 0;
+    for (int i = 0; i <= p.length(); i++) {
+	if (i < p.length() && p[i] == '(')
+	    depth++;
+	else if (i < p.length() && p[i] == ')')
+	    depth--;
+	else if (i == p.length()
+		 || (depth == 0 && p.substring(i, 5) == " and "
+		     && i + 5 < p.length())) {
+	    String term = trim(p.substring(start, i - start));
+	    int close = -1;
+	    if (term && term[0] == '(') {
+		for (int j = 0, d = 0; j < term.length(); j++)
+		    if (term[j] == '(')
+			d++;
+		    else if (term[j] == ')' && --d == 0) {
+			close = j;
+			break;
+		    }
+	    }
+	    if (close == term.length() - 1 && close > 0) {
+		if (!ip_conjuncts(trim(term.substring(1, close - 1)), terms))
+		    return false;
+	    } else if (!ip_explicit(term))
+		return false;
+	    else
+		terms.push_back(term);
+	    start = i + 5;
+	}
+    }
+    return true;
+}
+
+/** @brief Split a classifier pattern into the terms it requires.
+ *
+ * Classifier terms are separated by spaces; IPClassifier terms are joined by
+ * "and" outside parentheses.  The catch-all "-" has no terms.  Terms are
+ * compared textually, so a pattern written two ways is two terms.
+ *
+ * An IPClassifier pattern is kept whole, as a single term, unless it is a
+ * plain conjunction whose every term names its own qualifiers: "src net A
+ * and B" means "src net A and src net B", so "B" is not a term by itself,
+ * and "or", "not", and "?:" make the pattern's terms optional. */
+static void
+conjuncts(const String &pattern, bool ip, Vector<String> &terms)
+{
+    String p = trim(pattern);
+    if (p == "-")
+	return;
+    else if (!ip) {
+	Vector<String> words;
+	cp_spacevec(p, words);
+	for (int i = 0; i < words.size(); i++)
+	    terms.push_back(words[i]);
+	return;
+    }
+
+    Vector<String> words;
+    ip_words(p, words);
+    for (int i = 0; i < words.size(); i++)
+	if (words[i] == "or" || words[i] == "not"
+	    || words[i].find_left('?') >= 0 || words[i].find_left('!') >= 0
+	    || words[i].find_left('|') >= 0 || words[i].find_left('&') >= 0) {
+	    terms.push_back(p);
+	    return;
+	}
+
+    int nterms = terms.size();
+    if (!ip_conjuncts(p, terms)) {
+	terms.resize(nterms);
+	terms.push_back(p);
+    }
+}
+
+static bool
+subsumes(const Vector<String> &general, const Vector<String> &specific)
+{
+    for (int i = 0; i < general.size(); i++) {
+	int j = 0;
+	while (j < specific.size() && specific[j] != general[i])
+	    j++;
+	if (j == specific.size())
+	    return false;
+    }
+    return true;
+}
+
+/** @brief Remove classifier outputs that can never receive packets.
+ *
+ * A pattern is unreachable if an earlier pattern requires a subset of its
+ * terms; for instance, anything after a catch-all "-", or "(tcp) and (dst
+ * port 80)" after "tcp".  Such patterns are deleted.  Elements downstream of
+ * a deleted output are fed from a new Idle, so click-undead can remove them.
+ * Returns the number of outputs removed. */
+int
+ClassifierT::remove_unreachable(ErrorHandler *errh)
+{
+    int n = 0;
+    for (int i = 0; i < _router->nelements(); i++) {
+	ElementT *e = _router->element(i);
+	if (e->dead() || !is_classifier(e))
+	    continue;
+
+	Vector<String> words;
+	cp_argvec(e->configuration(), words);
+	Vector<PortT> outs;
+	if (!output_ports(e, words.size(), outs))
+	    continue;
+
+	bool ip = (e->type() == _ipclassifier_type);
+	Vector<Vector<String> > kept_terms;
+	Vector<String> new_words;
+	Vector<PortT> new_outs, dead_outs;
+	for (int j = 0; j < words.size(); j++) {
+	    Vector<String> terms;
+	    conjuncts(words[j], ip, terms);
+	    bool reachable = true;
+	    for (int k = 0; reachable && k < kept_terms.size(); k++)
+		if (subsumes(kept_terms[k], terms))
+		    reachable = false;
+	    if (reachable) {
+		kept_terms.push_back(terms);
+		new_words.push_back(words[j]);
+		new_outs.push_back(outs[j]);
+	    } else {
+		dead_outs.push_back(outs[j]);
+		if (errh)
+		    errh->lmessage(e->landmark(), "%s: output %d unreachable", e->name_c_str(), j);
+	    }
+	}
+
+	if (dead_outs.size()) {
+	    set_outputs(e, new_words, new_outs);
+	    ElementT *idle = _router->add_anon_element(_idle_type, String(), e->landmarkt());
+	    for (int j = 0; j < dead_outs.size(); j++)
+		_router->add_connection(PortT(idle, j), dead_outs[j]);
+	    n += dead_outs.size();
+	}
+    }
+    _nunreachable += n;
+    return n;
+}
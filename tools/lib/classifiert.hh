@@ -0,0 +1,40 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CLASSIFIERT_HH
+#define CLICK_CLASSIFIERT_HH
+#include "routert.hh"
+
+class ClassifierT { public:
+
+    ClassifierT(RouterT *router);
+
+    bool is_classifier(const ElementT *e) const {
+	return e->type() == _classifier_type || e->type() == _ipclassifier_type;
+    }
+
+    int combine();
+    int remove_unreachable(ErrorHandler *errh = 0);
+
+    int ncombined() const		{ return _ncombined; }
+    int nunreachable() const		{ return _nunreachable; }
+    int inspections_saved() const	{ return _inspections_saved; }
+
+  private:
+
+    RouterT *_router;
+    ElementClassT *_classifier_type;
+    ElementClassT *_ipclassifier_type;
+    ElementClassT *_discard_type;
+    ElementClassT *_idle_type;
+    Vector<int> _saved;
+    int _ncombined;
+    int _nunreachable;
+    int _inspections_saved;
+
+    bool output_ports(ElementT *e, int noutputs, Vector<PortT> &outs) const;
+    void set_outputs(ElementT *e, const Vector<String> &words,
+		     const Vector<PortT> &outs);
+    bool combine(ElementT *from, int from_port, ElementT *to);
+
+};
+
+#endif
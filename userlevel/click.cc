@@ -52,6 +52,7 @@
 #include <click/userutils.hh>
 #include <click/args.hh>
 #include <click/handlercall.hh>
+#include <click/md5.h>
 #include "elements/standard/quitwatcher.hh"
 #include "elements/userlevel/controlsocket.hh"
 CLICK_USING_DECLS
@@ -74,6 +75,7 @@ CLICK_USING_DECLS
 #define THREADS_OPT		316
 #define SIMTIME_OPT		317
 #define SOCKET_OPT		318
+#define SPECIALIZE_OPT		319
 
 static const Clp_Option options[] = {
     { "allow-reconfigure", 'R', ALLOW_RECONFIG_OPT, 0, Clp_Negate },
@@ -84,6 +86,7 @@ static const Clp_Option options[] = {
     { "help", 0, HELP_OPT, 0, 0 },
     { "output", 'o', OUTPUT_OPT, Clp_ValString, 0 },
     { "socket", 0, SOCKET_OPT, Clp_ValInt, 0 },
+    { "specialize", 'O', SPECIALIZE_OPT, 0, Clp_Negate },
     { "port", 'p', PORT_OPT, Clp_ValString, 0 },
     { "quit", 'q', QUIT_OPT, 0, 0 },
     { "simtime", 0, SIMTIME_OPT, Clp_ValDouble, Clp_Optional },
@@ -125,6 +128,8 @@ Options:\n\
   -u, --unix-socket FILE        Listen for control connections on Unix socket.\n\
       --socket FD               Add a file descriptor control connection.\n\
   -R, --allow-reconfigure       Provide a writable 'hotconfig' handler.\n\
+  -O, --specialize              Devirtualize and fastclassify the configuration,\n\
+                                caching compiled packages between runs.\n\
   -h, --handler ELEMENT.H       Call ELEMENT's read handler H after running\n\
                                 driver and print result to standard output.\n\
   -x, --exit-handler ELEMENT.H  Use handler ELEMENT.H value for exit status.\n\
@@ -411,6 +416,159 @@ timewarp_write_handler(const String &text, Element *, void *, ErrorHandler *errh
 }
 
 
+// specializing
+
+static String
+specialized_read_handler(Element *, void *)
+{
+    StringAccum sa;
+    for (int i = 0; i < router->nelements(); i++) {
+	String cname = router->element(i)->class_name();
+	if (cname.find_left("@@") >= 0)
+	    sa << router->ename(i) << '\t' << cname << '\n';
+    }
+    return sa.take_string();
+}
+
+static bool
+make_directories(const String &dir)
+{
+    for (int slash = dir.find_left('/', 1); slash >= 0;
+	 slash = dir.find_left('/', slash + 1))
+	if (mkdir(dir.substring(0, slash).c_str(), 0777) < 0 && errno != EEXIST)
+	    return false;
+    return mkdir(dir.c_str(), 0777) >= 0 || errno == EEXIST;
+}
+
+// Add the identity of file @a name, which changes whenever the file is
+// rebuilt or reinstalled, to @a pms.
+static void
+md5_append_file_identity(md5_state_t *pms, const String &name)
+{
+    struct stat st;
+    StringAccum sa;
+    sa << name;
+    if (name && stat(name.c_str(), &st) >= 0)
+	sa << ' ' << (unsigned long) st.st_dev << ' ' << (unsigned long) st.st_ino
+	   << ' ' << (long long) st.st_size << ' ' << (long long) st.st_mtime;
+    sa << '\n';
+    md5_append(pms, (const md5_byte_t *) sa.data(), sa.length());
+}
+
+// Create a new, uniquely named file starting with @a prefix.  Returns its
+// name and, in @a fd, an open descriptor.
+static String
+make_temporary(const String &prefix, int &fd)
+{
+    String name = prefix + ".XXXXXX";
+    fd = mkstemp(name.mutable_c_str());
+    return fd >= 0 ? name : String();
+}
+
+// Run the configuration through click-fastclassifier and
+// click-devirtualize, caching the result, which includes compiled packages.
+// The cache key hashes the configuration with the identities of this click
+// binary and of the tools, so a rebuilt driver, whose Packet layout may have
+// changed, never loads packages compiled for another.  Returns the
+// specialized configuration file, or the empty string to run the
+// configuration as written.
+static String
+specialize_configuration(const char *router_file, bool file_is_expr,
+			 ErrorHandler *errh)
+{
+    String text;
+    if (file_is_expr)
+	text = router_file;
+    else if (!router_file || strcmp(router_file, "-") == 0) {
+	errh->warning("cannot specialize a configuration read from standard input");
+	return String();
+    } else if (!(text = file_string(router_file)))
+	return String();
+
+    String dir;
+    if (const char *s = getenv("CLICK_SPECIALIZE_CACHE"))
+	dir = s;
+    else if (const char *s = getenv("HOME"))
+	dir = String(s) + "/.click/specialize";
+    if (!dir || !make_directories(dir)) {
+	errh->warning("no specialization cache directory, running generic configuration");
+	return String();
+    }
+
+    String fastclassifier = clickpath_find_file("click-fastclassifier", "bin", CLICK_BINDIR);
+    String devirtualize = clickpath_find_file("click-devirtualize", "bin", CLICK_BINDIR);
+    if (!fastclassifier || !devirtualize) {
+	errh->warning("specialization tools not found, running generic configuration");
+	return String();
+    }
+
+    String self = "/proc/self/exe";
+    if (access(self.c_str(), F_OK) < 0)
+	self = clickpath_find_file("click", "bin", CLICK_BINDIR);
+
+    md5_state_t pms;
+    char digest[MD5_TEXT_DIGEST_MAX_SIZE];
+    md5_init(&pms);
+    md5_append(&pms, (const md5_byte_t *) CLICK_VERSION, strlen(CLICK_VERSION) + 1);
+    md5_append_file_identity(&pms, self);
+    md5_append_file_identity(&pms, fastclassifier);
+    md5_append_file_identity(&pms, devirtualize);
+    md5_append_file_identity(&pms, String(CLICK_DATADIR) + "/config.mk");
+    md5_append(&pms, (const md5_byte_t *) text.data(), text.length());
+    int digest_len = md5_finish_text(&pms, digest, 0);
+    md5_free(&pms);
+    String base = dir + "/" + String(digest, digest_len);
+    String result = base + ".click";
+    if (access(result.c_str(), R_OK) == 0)
+	return result;
+
+    // Concurrent runs may specialize the same configuration, so each uses
+    // its own temporary files; the last rename wins.
+    static const char * const suffixes[] = { ".in", ".fc", ".tmp", ".log" };
+    String in, fc, tmp, log;
+    String *names[] = { &in, &fc, &tmp, &log };
+    int in_fd = -1;
+    bool ok = true;
+    for (int i = 0; ok && i < 4; ++i) {
+	int fd;
+	if (!(*names[i] = make_temporary(base + suffixes[i], fd))) {
+	    errh->warning("%s: %s", dir.c_str(), strerror(errno));
+	    ok = false;
+	} else if (i == 0)
+	    in_fd = fd;
+	else
+	    close(fd);
+    }
+    if (ok && write(in_fd, text.data(), text.length()) != (ssize_t) text.length()) {
+	errh->warning("%s: %s", in.c_str(), strerror(errno));
+	ok = false;
+    }
+    if (in_fd >= 0)
+	close(in_fd);
+
+    int status = -1;
+    if (ok) {
+	StringAccum cmd;
+	cmd << shell_quote(fastclassifier) << " -q -u " << shell_quote(in)
+	    << " > " << shell_quote(fc) << " 2> " << shell_quote(log)
+	    << " && " << shell_quote(devirtualize) << " --fuse -u " << shell_quote(fc)
+	    << " > " << shell_quote(tmp) << " 2>> " << shell_quote(log);
+	status = system(cmd.c_str());
+    }
+    if (status != 0 || rename(tmp.c_str(), result.c_str()) < 0) {
+	if (ok) {
+	    errh->warning("specialization failed (see %s), running generic configuration", log.c_str());
+	    log = String();	// keep it
+	}
+	result = String();
+    }
+    for (int i = 0; i < 4; ++i)
+	if (*names[i])
+	    unlink(names[i]->c_str());
+    return result;
+}
+
+
 // main
 
 static void
@@ -459,6 +617,7 @@ main(int argc, char **argv)
   bool quit_immediately = false;
   bool report_time = false;
   bool allow_reconfigure = false;
+  bool specialize = false;
   Vector<String> handlers;
   String exit_handler;
 
@@ -536,6 +695,10 @@ main(int argc, char **argv)
       allow_reconfigure = !clp->negated;
       break;
 
+     case SPECIALIZE_OPT:
+      specialize = !clp->negated;
+      break;
+
      case QUIT_OPT:
       quit_immediately = true;
       break;
@@ -610,9 +773,22 @@ particular purpose.\n");
   Router::add_read_handler(0, "timewarp", timewarp_read_handler, 0);
   if (Timestamp::warp_class() != Timestamp::warp_simulation)
       Router::add_write_handler(0, "timewarp", timewarp_write_handler, 0);
+  Router::add_read_handler(0, "specialized", specialized_read_handler, 0);
 
   // parse configuration
-  router = parse_configuration(router_file, file_is_expr, false, errh);
+  String specialized_file;
+  if (specialize)
+    specialized_file = specialize_configuration(router_file, file_is_expr, errh);
+  if (specialized_file) {
+    SilentErrorHandler serrh;
+    router = parse_configuration(specialized_file, false, false, &serrh);
+    if (!router) {
+      unlink(specialized_file.c_str());
+      errh->warning("specialized configuration failed, running generic configuration");
+    }
+  }
+  if (!router)
+    router = parse_configuration(router_file, file_is_expr, false, errh);
   if (!router)
     return cleanup(clp, 1);
   router->use();